@@ -59,3 +59,61 @@ void AJ_IOBufRebase(AJ_IOBuffer* ioBuf, size_t preserve)
     ioBuf->readPtr = ioBuf->bufStart + preserve;
     ioBuf->writePtr = ioBuf->bufStart + preserve + unconsumed;
 }
+
+void AJ_RingBufInit(AJ_RingBuffer* ring, uint8_t* buffer, uint16_t bufLen)
+{
+    AJ_ASSERT((bufLen & (bufLen - 1)) == 0);
+    ring->data = buffer;
+    ring->size = bufLen;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+uint8_t* AJ_RingBufWritePtr(AJ_RingBuffer* ring, uint16_t* contig)
+{
+    uint16_t offset = ring->head & (ring->size - 1);
+
+    *contig = min(AJ_RING_BUF_SPACE(ring), ring->size - offset);
+    return ring->data + offset;
+}
+
+void AJ_RingBufCommit(AJ_RingBuffer* ring, uint16_t len)
+{
+    ring->head += len;
+}
+
+uint16_t AJ_RingBufWrite(AJ_RingBuffer* ring, const uint8_t* src, uint16_t len)
+{
+    uint16_t done = 0;
+
+    /*
+     * At most two copies, one up to the end of the storage and one from the start
+     */
+    while (done < len) {
+        uint16_t contig;
+        uint8_t* dest = AJ_RingBufWritePtr(ring, &contig);
+        if (!contig) {
+            break;
+        }
+        contig = min(contig, len - done);
+        memcpy(dest, src + done, contig);
+        AJ_RingBufCommit(ring, contig);
+        done += contig;
+    }
+    return done;
+}
+
+uint16_t AJ_RingBufRead(AJ_RingBuffer* ring, uint8_t* dest, uint16_t len)
+{
+    uint16_t done = 0;
+
+    len = min(len, AJ_RING_BUF_AVAIL(ring));
+    while (done < len) {
+        uint16_t offset = ring->tail & (ring->size - 1);
+        uint16_t contig = min(len - done, ring->size - offset);
+        memcpy(dest + done, ring->data + offset, contig);
+        ring->tail += contig;
+        done += contig;
+    }
+    return done;
+}
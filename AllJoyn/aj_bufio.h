@@ -119,4 +119,76 @@ void AJ_IOBufInit(AJ_IOBuffer* ioBuf, uint8_t* buffer, uint32_t bufLen, uint8_t
  */
 void AJ_IOBufRebase(AJ_IOBuffer* ioBuf, size_t preserve);
 
+/**
+ * A single-producer/single-consumer byte ring used by the network layer to hold data read ahead of
+ * what the unmarshaller has asked for. The head and tail indices run freely and are masked on
+ * access so the ring never needs to move data.
+ */
+typedef struct _AJ_RingBuffer {
+    uint8_t* data;              /**< Storage for the ring, size must be a power of two */
+    uint16_t size;              /**< Size of the storage */
+    volatile uint16_t head;     /**< Total bytes written (producer index) */
+    volatile uint16_t tail;     /**< Total bytes read (consumer index) */
+} AJ_RingBuffer;
+
+/**
+ * How much data is available to read from the ring
+ */
+#define AJ_RING_BUF_AVAIL(ring)  ((uint16_t)((ring)->head - (ring)->tail))
+
+/**
+ * How much space is available to write to the ring
+ */
+#define AJ_RING_BUF_SPACE(ring)  ((uint16_t)((ring)->size - AJ_RING_BUF_AVAIL(ring)))
+
+/**
+ * Initialize a ring buffer.
+ *
+ * @param ring    The ring buffer to initialize
+ * @param buffer  The storage to use
+ * @param bufLen  The size of the storage, must be a power of two no larger than 32768
+ */
+void AJ_RingBufInit(AJ_RingBuffer* ring, uint8_t* buffer, uint16_t bufLen);
+
+/**
+ * Get the largest contiguous free region of the ring so a producer can write (or recv) into it in
+ * place. Call AJ_RingBufCommit() with the number of bytes actually written.
+ *
+ * @param ring    The ring buffer
+ * @param contig  Returns the number of bytes that can be written at the returned pointer
+ *
+ * @return  Pointer to the start of the free region
+ */
+uint8_t* AJ_RingBufWritePtr(AJ_RingBuffer* ring, uint16_t* contig);
+
+/**
+ * Make bytes written at the pointer returned by AJ_RingBufWritePtr() available to the consumer.
+ *
+ * @param ring  The ring buffer
+ * @param len   Number of bytes written, must not exceed the contiguous region
+ */
+void AJ_RingBufCommit(AJ_RingBuffer* ring, uint16_t len);
+
+/**
+ * Copy bytes into the ring.
+ *
+ * @param ring  The ring buffer
+ * @param src   The data to copy
+ * @param len   The number of bytes to copy
+ *
+ * @return  The number of bytes copied, less than len if the ring is full
+ */
+uint16_t AJ_RingBufWrite(AJ_RingBuffer* ring, const uint8_t* src, uint16_t len);
+
+/**
+ * Copy bytes out of the ring, handling wrap-around.
+ *
+ * @param ring  The ring buffer
+ * @param dest  Where to copy the data
+ * @param len   The maximum number of bytes to copy
+ *
+ * @return  The number of bytes copied
+ */
+uint16_t AJ_RingBufRead(AJ_RingBuffer* ring, uint8_t* dest, uint16_t len);
+
 #endif
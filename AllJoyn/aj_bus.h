@@ -51,6 +51,9 @@ typedef struct _AJ_BusAttachment {
     AJ_NetSocket sock;           /**< Abstracts a network socket */
     uint32_t serial;             /**< Next outgoing message serial number */
     AJ_AuthPwdFunc pwdCallback;  /**< Callback for obtaining passwords */
+    uint16_t txCoalesceBytes;    /**< Delivered messages are held back until this many bytes are queued, zero disables coalescing */
+    uint16_t txCoalesceDelay;    /**< Maximum time in milliseconds a delivered message is held back */
+    AJ_Time txCoalesceTimer;     /**< Started when the first held back message was delivered */
 } AJ_BusAttachment;
 
 /**
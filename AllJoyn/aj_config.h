@@ -31,21 +31,52 @@
 #define AJ_DUMP_BYTE_SIZE           16          //aj_debug.c
 
 /* Network options */
+#ifndef AJ_CONNECT_LOCALHOST
 #define AJ_CONNECT_LOCALHOST        0           //Enable to bypass discovery and connect locally
+#endif
 #define AJ_WHO_HAS_REPEAT           4           //number of times to send WHO_HAS       (aj_disco.c)
-#define AJ_MAX_TIMERS               4           //maximum number of timers              (aj_helper.c)
+#if !defined(AJ_MAX_TIMERS)
+#define AJ_MAX_TIMERS               16          //maximum number of timers              (aj_helper.c)
+#endif
+#if !defined(AJ_TIMER_WHEEL_SIZE)
+#define AJ_TIMER_WHEEL_SIZE         32          //timer wheel buckets, power of 2       (aj_helper.c)
+#endif
+#if !defined(AJ_TIMER_TICK_SHIFT)
+#define AJ_TIMER_TICK_SHIFT         5           //log2 of the msec covered by a bucket  (aj_helper.c)
+#endif
 
 /* Auth options */
 #define AJ_NONCE_LEN                28          //Length of the nonce.
 #define AJ_VERIFIER_LEN             12          //Length of the verifier string
 #define AJ_MASTER_SECRET_LEN        24          //Length of the master secret
 #define AJ_ADHOC_LEN                16          //AD-HOC maximal passcode length        (aj_auth.h)
-#define AJ_NAME_MAP_GUID_SIZE       2           //aj_guid.c
-#define AJ_MAX_NAME_SIZE            14          //aj_guid.c
+#if !defined(AJ_NAME_MAP_GUID_SIZE)
+#define AJ_NAME_MAP_GUID_SIZE       4           //number of secure peers kept, least recently used is evicted (aj_guid.c)
+#endif
+#if !defined(AJ_NAME_MAP_HASH_SIZE)
+#define AJ_NAME_MAP_HASH_SIZE       8           //buckets in the peer table, power of 2 (aj_guid.c)
+#endif
+#if !defined(AJ_MAX_NAME_SIZE)
+#define AJ_MAX_NAME_SIZE            14          //longest peer unique name, up to 255 for any bus name (aj_guid.c)
+#endif
+#if !defined(AJ_NAME_MAP_NAME_POOL)
+#define AJ_NAME_MAP_NAME_POOL       ((AJ_NAME_MAP_GUID_SIZE - 1) * 16 + AJ_MAX_NAME_SIZE + 1) //bytes shared by the peer unique names (aj_guid.c)
+#endif
+/*
+ * Each secure peer costs sizeof(NameToGUID) bytes of RAM, 252 on the Due, 176 of them the expanded
+ * session key, plus its unique name and terminator in the name pool. The table adds a 176 byte group
+ * key schedule and 4 bytes per hash bucket, so the defaults use about 1.3 KB on the Due.
+ */
 #define AJ_MAX_AUTH_COUNT           8           //check to prevent broken state machine loops (aj_sasl.c)
 #define AJ_LOCAL_GUID_NV_ID         1
 #define AJ_REMOTE_CREDS_NV_ID_BEGIN (AJ_LOCAL_GUID_NV_ID + 1)
-#define AJ_REMOTE_CREDS_NV_ID_END   (AJ_REMOTE_CREDS_NV_ID_BEGIN + 12)
+#if !defined(AJ_MAX_CREDS)
+#define AJ_MAX_CREDS                12          //number of peer credentials kept, each uses 52 bytes of NVRAM (aj_creds.c)
+#endif
+#if !defined(AJ_CREDS_HASH_SIZE)
+#define AJ_CREDS_HASH_SIZE          16          //buckets in the credential table, power of 2 (aj_creds.c)
+#endif
+#define AJ_REMOTE_CREDS_NV_ID_END   (AJ_REMOTE_CREDS_NV_ID_BEGIN + AJ_MAX_CREDS)
 
 /* Timeouts */
 #define AJ_WHO_HAS_TIMEOUT       (1000)            //how long to wait for WHO_HAS response            (aj_disco.c)
@@ -64,15 +95,27 @@
 /* Message identification related */
 
 #if !defined(AJ_NUM_REPLY_CONTEXTS)
-#define AJ_NUM_REPLY_CONTEXTS    (2)               //number of concurrent method calls     (aj_introspect.c)
+#define AJ_NUM_REPLY_CONTEXTS    (8)               //number of concurrent method calls     (aj_introspect.c)
+#endif
+#if !defined(AJ_REPLY_HASH_SIZE)
+#define AJ_REPLY_HASH_SIZE       (8)               //reply context buckets, power of 2     (aj_introspect.c)
 #endif
 
 #if !(defined(AJ_MAX_OBJECT_LISTS))
 #define AJ_MAX_OBJECT_LISTS      (3)               //maximum number of object lists        (aj_introspect.c)
 #endif
 
+#if !(defined(AJ_XML_LEN_CACHE_SIZE))
+#define AJ_XML_LEN_CACHE_SIZE    (32)              //number of cached introspection XML lengths (aj_introspect.c)
+#endif
+
+#if !(defined(AJ_MSG_INDEX_SIZE))
+#define AJ_MSG_INDEX_SIZE        (256)             //slots in the message id index, power of 2 (aj_introspect.c)
+#endif
+
 /* Crypto */
 #define AJ_CCM_TRACE                0           //Enables fine-grained tracing for debugging new implementations.
+//#define AJ_AES_CONST_TIME                     //Software AES with a bitsliced S-box instead of table lookups (aj_sw_crypto.c)
 
 #define _SO_REUSEPORT               0       //Linux target
 
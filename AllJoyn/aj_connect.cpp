@@ -452,6 +452,10 @@ void AJ_Disconnect(AJ_BusAttachment* bus)
      * We won't be getting any more method replies.
      */
     AJ_ReleaseReplyContexts();
+    /*
+     * Send any messages held back by coalescing, the link may already be gone so the status is ignored
+     */
+    AJ_Flush(bus);
     /*
      * Disconnect the network closing sockets etc.
      */
@@ -28,6 +28,7 @@
 #include "aj_status.h"
 #include "aj_crypto.h"
 #include "aj_nvram.h"
+#include "aj_util.h"
 #include "aj_debug.h"
 #include "aj_config.h"
 
@@ -39,12 +40,120 @@
 uint8_t dbgCREDS = 0;
 #endif
 
+/*
+ * RAM table of the credentials in NVRAM so a peer can be found without reading every credential.
+ * Slot n describes data set AJ_REMOTE_CREDS_NV_ID_BEGIN + n, slots are chained in hash buckets
+ * by a digest of the peer GUID. The table is built the first time it is needed.
+ */
+#define CRED_NONE 0xFFFF
+
+typedef struct _CredSlot {
+    uint32_t digest;       /* Digest of the peer GUID */
+    uint32_t lastUse;      /* Value of credClock when the credential was last used */
+    uint16_t next;         /* Next slot in the hash bucket */
+    uint8_t inUse;         /* TRUE if the data set exists */
+} CredSlot;
+
+static CredSlot credSlot[AJ_MAX_CREDS];
+static uint16_t credBucket[AJ_CREDS_HASH_SIZE];
+static uint32_t credClock = 0;
+static uint8_t credsLoaded = FALSE;
+/*
+ * AJ_NVRAM_ClearCount() when the table was loaded, a clear of NVRAM empties every slot
+ */
+static uint16_t credsClearCount = 0;
+
+/*
+ * GUIDs are random so folding the words together is a good enough digest
+ */
+static uint32_t GUIDDigest(const AJ_GUID* guid)
+{
+    uint32_t words[sizeof(AJ_GUID) / sizeof(uint32_t)];
+    uint32_t digest = 0;
+    size_t i;
+
+    memcpy(words, guid, sizeof(AJ_GUID));
+    for (i = 0; i < ArraySize(words); ++i) {
+        digest = (digest * 31) ^ words[i];
+    }
+    return digest;
+}
+
+static void AddSlot(uint16_t slot, uint32_t digest)
+{
+    uint16_t bucket = digest & (AJ_CREDS_HASH_SIZE - 1);
+
+    credSlot[slot].digest = digest;
+    credSlot[slot].lastUse = ++credClock;
+    credSlot[slot].inUse = TRUE;
+    credSlot[slot].next = credBucket[bucket];
+    credBucket[bucket] = slot;
+}
+
+static void RemoveSlot(uint16_t slot)
+{
+    uint16_t* link = &credBucket[credSlot[slot].digest & (AJ_CREDS_HASH_SIZE - 1)];
+
+    while (*link != CRED_NONE) {
+        if (*link == slot) {
+            *link = credSlot[slot].next;
+            break;
+        }
+        link = &credSlot[*link].next;
+    }
+    memset(&credSlot[slot], 0, sizeof(CredSlot));
+}
+
+static AJ_Status ReadCredsGUID(uint16_t id, AJ_GUID* guid)
+{
+    AJ_NV_DATASET* handle = AJ_NVRAM_Open(id, "r", 0);
+
+    if (!handle) {
+        AJ_ErrPrintf(("ReadCredsGUID(): fail to open data set with id = %d\n", id));
+        return AJ_ERR_FAILURE;
+    }
+    if (sizeof(AJ_GUID) != AJ_NVRAM_Read(guid, sizeof(AJ_GUID), handle)) {
+        AJ_ErrPrintf(("ReadCredsGUID(): fail to %zu bytes from data set with id = %d\n", sizeof(AJ_GUID), id));
+        AJ_NVRAM_Close(handle);
+        return AJ_ERR_FAILURE;
+    }
+    AJ_NVRAM_Close(handle);
+    return AJ_OK;
+}
+
+static void ResetCredsTable(void)
+{
+    memset(credSlot, 0, sizeof(credSlot));
+    memset(credBucket, 0xFF, sizeof(credBucket));
+    credsLoaded = TRUE;
+    credsClearCount = AJ_NVRAM_ClearCount();
+}
+
+static void LoadCredsTable(void)
+{
+    uint16_t slot;
+    AJ_GUID guid;
+
+    if (credsLoaded && (credsClearCount == AJ_NVRAM_ClearCount())) {
+        return;
+    }
+    ResetCredsTable();
+    for (slot = 0; slot < AJ_MAX_CREDS; ++slot) {
+        uint16_t id = AJ_REMOTE_CREDS_NV_ID_BEGIN + slot;
+        if (AJ_NVRAM_Exist(id) && (ReadCredsGUID(id, &guid) == AJ_OK)) {
+            AddSlot(slot, GUIDDigest(&guid));
+        }
+    }
+}
+
 uint16_t FindCredsEmptySlot()
 {
-    uint16_t id = AJ_REMOTE_CREDS_NV_ID_BEGIN;
-    for (; id < AJ_REMOTE_CREDS_NV_ID_END; id++) {
-        if (!AJ_NVRAM_Exist(id)) {
-            return id;
+    uint16_t slot;
+
+    LoadCredsTable();
+    for (slot = 0; slot < AJ_MAX_CREDS; ++slot) {
+        if (!credSlot[slot].inUse) {
+            return AJ_REMOTE_CREDS_NV_ID_BEGIN + slot;
         }
     }
     return 0;
@@ -52,34 +161,56 @@ uint16_t FindCredsEmptySlot()
 
 uint16_t FindCredsByGUID(const AJ_GUID* peerGuid)
 {
-    uint16_t id = AJ_REMOTE_CREDS_NV_ID_BEGIN;
-    AJ_NV_DATASET* handle;
+    uint32_t digest = GUIDDigest(peerGuid);
+    uint16_t slot;
 
     AJ_InfoPrintf(("FindCredsByGUID()\n"));
 
-    for (; id < AJ_REMOTE_CREDS_NV_ID_END; id++) {
-        if (AJ_NVRAM_Exist(id)) {
-            handle = AJ_NVRAM_Open(id, "r", 0);
-            if (!handle) {
-                AJ_ErrPrintf(("FindCredsByGUID(): fail to open data set with id = %d\n", id));
-            } else {
-                AJ_GUID guid;
-                if (sizeof(AJ_GUID) != AJ_NVRAM_Read(&guid, sizeof(AJ_GUID), handle)) {
-                    AJ_ErrPrintf(("FindCredsByGUID(): fail to %zu bytes from data set with id = %d\n", sizeof(AJ_GUID), id));
-                    AJ_NVRAM_Close(handle);
-                    continue;
-                }
-                if (memcmp(peerGuid, &guid, sizeof(AJ_GUID)) == 0) {
-                    AJ_NVRAM_Close(handle);
-                    return id;
-                }
-                AJ_NVRAM_Close(handle);
+    LoadCredsTable();
+    slot = credBucket[digest & (AJ_CREDS_HASH_SIZE - 1)];
+    while (slot != CRED_NONE) {
+        uint16_t next = credSlot[slot].next;
+        if (credSlot[slot].digest == digest) {
+            uint16_t id = AJ_REMOTE_CREDS_NV_ID_BEGIN + slot;
+            AJ_GUID guid;
+            /*
+             * Digests can collide so check the GUID in NVRAM
+             */
+            if (ReadCredsGUID(id, &guid) != AJ_OK) {
+                RemoveSlot(slot);
+            } else if (memcmp(peerGuid, &guid, sizeof(AJ_GUID)) == 0) {
+                credSlot[slot].lastUse = ++credClock;
+                return id;
             }
         }
+        slot = next;
     }
     return 0;
 }
 
+/*
+ * Make room for a new credential by deleting the least recently used one. Use is only tracked
+ * since boot so after a restart the credential in the lowest slot goes first.
+ */
+static uint16_t EvictCredential(void)
+{
+    uint16_t victim = CRED_NONE;
+    uint16_t slot;
+
+    for (slot = 0; slot < AJ_MAX_CREDS; ++slot) {
+        if (credSlot[slot].inUse && ((victim == CRED_NONE) || (credSlot[slot].lastUse < credSlot[victim].lastUse))) {
+            victim = slot;
+        }
+    }
+    if (victim == CRED_NONE) {
+        return 0;
+    }
+    AJ_InfoPrintf(("EvictCredential(): id=%d.\n", AJ_REMOTE_CREDS_NV_ID_BEGIN + victim));
+    AJ_NVRAM_Delete(AJ_REMOTE_CREDS_NV_ID_BEGIN + victim);
+    RemoveSlot(victim);
+    return AJ_REMOTE_CREDS_NV_ID_BEGIN + victim;
+}
+
 AJ_Status UpdatePeerCreds(AJ_PeerCred* peerCred, uint16_t id)
 {
     AJ_Status status = AJ_OK;
@@ -104,7 +235,8 @@ AJ_Status UpdatePeerCreds(AJ_PeerCred* peerCred, uint16_t id)
 }
 
 /**
- * Write a credential to a free slot in NVRAM
+ * Write a credential to a free slot in NVRAM, if there are no free slots the least recently used
+ * credential is replaced
  */
 AJ_Status AJ_StoreCredential(AJ_PeerCred* peerCred)
 {
@@ -114,19 +246,22 @@ AJ_Status AJ_StoreCredential(AJ_PeerCred* peerCred)
     AJ_InfoPrintf(("UpdatePeerCreds(peerCred=0x%p)\n", peerCred));
 
     id = FindCredsByGUID(&peerCred->guid);
-    if (!id) {
-        id = FindCredsEmptySlot();
-        if (!id) {
-            AJ_ClearCredentials();
-            id = FindCredsEmptySlot();
-        }
-    }
-
     if (id) {
         status = UpdatePeerCreds(peerCred, id);
     } else {
-        status = AJ_ERR_FAILURE;
-        AJ_ErrPrintf(("AJ_StoreCredential(): AJ_ERR_FAILURE\n"));
+        id = FindCredsEmptySlot();
+        if (!id) {
+            id = EvictCredential();
+        }
+        if (id) {
+            status = UpdatePeerCreds(peerCred, id);
+            if (status == AJ_OK) {
+                AddSlot(id - AJ_REMOTE_CREDS_NV_ID_BEGIN, GUIDDigest(&peerCred->guid));
+            }
+        } else {
+            status = AJ_ERR_FAILURE;
+            AJ_ErrPrintf(("AJ_StoreCredential(): AJ_ERR_FAILURE\n"));
+        }
     }
     return status;
 }
@@ -139,6 +274,7 @@ AJ_Status AJ_DeleteCredential(const AJ_GUID* peerGuid)
 
     if (id > 0) {
         status = AJ_NVRAM_Delete(id);
+        RemoveSlot(id - AJ_REMOTE_CREDS_NV_ID_BEGIN);
     }
     return status;
 }
@@ -204,6 +340,7 @@ AJ_Status AJ_ClearCredentials(void)
     for (; id < AJ_REMOTE_CREDS_NV_ID_END; ++id) {
         AJ_NVRAM_Delete(id);
     }
+    ResetCredsTable();
 
     return status;
 }
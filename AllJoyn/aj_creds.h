@@ -34,7 +34,8 @@ typedef struct _AJ_PeerCred {
 } AJ_PeerCred;
 
 /**
- * Write a peer credential to NVRAM
+ * Write a peer credential to NVRAM. If AJ_MAX_CREDS credentials are already stored the least
+ * recently used credential is deleted to make room.
  *
  * @param peerCred  The credentials to write.
  *
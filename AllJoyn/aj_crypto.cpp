@@ -46,62 +46,72 @@ uint8_t dbgCRYPTO = 0;
 #define Trace(tag, data, len)
 #endif
 
-/*
- * Struct for a single AES data block
- */
-typedef struct _AES_Block {
-    uint8_t data[AJ_BLOCKSZ];
-} AES_Block;
-
-#define ZERO(b)  memset((b).data, 0, AJ_BLOCKSZ);
-
-/*
- * Struct holding CCM state information
- */
-typedef struct _CCM_Context {
-    AES_Block T;      /* authentication tag */
-    AES_Block ivec0;  /* ivec for CBC MAC */
-    AES_Block ivec;   /* ivec for CTR mode encrypt/decrypt */
-    union {
-        AES_Block A;   /* Working data for CBC MAC */
-        AES_Block B_0; /* Initial block for CBC MAC */
-    };
-} CCM_Context;
-
 /**
- * Compute the CBC MAC over some data
+ * Compute the CBC MAC over some data, a partial last block is zero padded
  */
-static void CBC_MAC(const uint8_t* key, const uint8_t* in, uint32_t len, CCM_Context* context)
+static void CBC_MAC(const AJ_AES_Key* key, const uint8_t* in, uint32_t len, uint8_t* T)
 {
-    while (len >= AJ_BLOCKSZ) {
-        AJ_AES_CBC_128_ENCRYPT(key, in, context->T.data, AJ_BLOCKSZ, context->ivec0.data);
-        Trace("After AES", context->T.data, AJ_BLOCKSZ);
-        in += AJ_BLOCKSZ;
-        len -= AJ_BLOCKSZ;
+    uint32_t whole = len & ~(AJ_BLOCKSZ - 1);
+
+    if (whole) {
+        AJ_AES_CBC_MAC_128(key, in, whole, T);
+        Trace("After AES", T, AJ_BLOCKSZ);
+        in += whole;
+        len -= whole;
     }
     if (len) {
-        ZERO(context->A);
-        memcpy(context->A.data, in, len);
-        AJ_AES_CBC_128_ENCRYPT(key, context->A.data, context->T.data, AJ_BLOCKSZ, context->ivec0.data);
-        Trace("After AES", context->T.data, AJ_BLOCKSZ);
+        uint8_t A[AJ_BLOCKSZ];
+        memset(A, 0, AJ_BLOCKSZ);
+        memcpy(A, in, len);
+        AJ_AES_CBC_MAC_128(key, A, AJ_BLOCKSZ, T);
+        Trace("After AES", T, AJ_BLOCKSZ);
     }
 }
 
-/**
- * Compute the AES-CCM authentication tag.
- */
-static void Compute_CCM_AuthTag(const uint8_t* key,
-                                CCM_Context* context,
-                                const uint8_t* msg,
-                                uint32_t mLen,
-                                uint32_t hdrLen)
+void AJ_CCM_Init(AJ_CCM_Context* context,
+                 const AJ_AES_Key* key,
+                 const uint8_t* nonce,
+                 uint32_t nLen,
+                 const uint8_t* hdr,
+                 uint32_t hdrLen,
+                 uint32_t bodyLen,
+                 uint8_t tagLen,
+                 uint8_t decrypt)
 {
+    int i;
+    uint32_t l;
+    uint8_t L  = 15 - max(nLen, 11);
+    uint8_t flags = ((hdrLen) ? 0x40 : 0) | (((tagLen - 2) / 2) << 3) | (L - 1);
+    uint8_t A[AJ_BLOCKSZ];
+
+    AJ_ASSERT(nLen <= 15);
+
+    memset(context, 0, sizeof(AJ_CCM_Context));
+    context->key = key;
+    context->remaining = bodyLen;
+    context->tagLen = tagLen;
+    context->decrypt = decrypt;
+    /*
+     * Set ivec and other initial args.
+     */
+    context->ivec[0] = L - 1;
+    memcpy(&context->ivec[1], nonce, nLen);
+    /*
+     * Compute the B_0 block. This encodes the flags, the nonce, and the message length.
+     */
+    memset(A, 0, AJ_BLOCKSZ);
+    A[0] = flags;
+    memcpy(&A[1], nonce, nLen);
+    for (i = 15, l = bodyLen; l != 0; i--) {
+        A[i] = (uint8_t)l;
+        l >>= 8;
+    }
     /*
      * Initialize CBC-MAC with B_0 initialization vector is 0.
      */
-    Trace("CBC IV in", context->B_0.data, AJ_BLOCKSZ);
-    AJ_AES_CBC_128_ENCRYPT(key, context->B_0.data, context->T.data, AJ_BLOCKSZ, context->ivec0.data);
-    Trace("CBC IV out", context->T.data, AJ_BLOCKSZ);
+    Trace("CBC IV in", A, AJ_BLOCKSZ);
+    AJ_AES_CBC_MAC_128(key, A, AJ_BLOCKSZ, context->T);
+    Trace("CBC IV out", context->T, AJ_BLOCKSZ);
     /*
      * Compute CBC-MAC for the add data.
      */
@@ -110,71 +120,145 @@ static void Compute_CCM_AuthTag(const uint8_t* key,
         /*
          * This encodes the header data length and the first few bytes of the header data
          */
-        ZERO(context->A);
-        context->A.data[0] = (uint8_t)(hdrLen >> 8);
-        context->A.data[1] = (uint8_t)(hdrLen >> 0);
+        memset(A, 0, AJ_BLOCKSZ);
+        A[0] = (uint8_t)(hdrLen >> 8);
+        A[1] = (uint8_t)(hdrLen >> 0);
         firstFew = min(hdrLen, 14);
-        memcpy(&context->A.data[2], msg, firstFew);
+        memcpy(&A[2], hdr, firstFew);
         /*
          * Adjust for the hdr data bytes that were encoded in the length block
          */
-        msg += firstFew;
+        hdr += firstFew;
         hdrLen -= firstFew;
         /*
          * Continue the MAC by encrypting the length block
          */
-        Trace("Before AES", context->A.data, AJ_BLOCKSZ);
-        AJ_AES_CBC_128_ENCRYPT(key, context->A.data, context->T.data, AJ_BLOCKSZ, context->ivec0.data);
-        Trace("After AES", context->T.data, AJ_BLOCKSZ);
+        Trace("Before AES", A, AJ_BLOCKSZ);
+        AJ_AES_CBC_MAC_128(key, A, AJ_BLOCKSZ, context->T);
+        Trace("After AES", context->T, AJ_BLOCKSZ);
         /*
          * Continue computing the CBC-MAC
          */
-        CBC_MAC(key, msg, hdrLen, context);
-        msg += hdrLen;
+        CBC_MAC(key, hdr, hdrLen, context->T);
     }
     /*
-     * Continue computing CBC-MAC over the message data.
+     * The first counter block is reserved for encrypting the tag
      */
-    if (mLen) {
-        CBC_MAC(key, msg, mLen, context);
+    AJ_AES_CTR_128_Expanded(key, context->S_0, context->S_0, AJ_BLOCKSZ, context->ivec);
+    Trace("CTR Start", context->ivec, AJ_BLOCKSZ);
+}
+
+/*
+ * Process bytes of a block that is not (yet) complete. The key stream for the
+ * block was generated when the block was started.
+ */
+static void PartialBlock(AJ_CCM_Context* context, const uint8_t* in, uint8_t* out, uint32_t len)
+{
+    while (len--) {
+        uint8_t c = *in++;
+        uint8_t x = c ^ context->ks[context->partial];
+        *out++ = x;
+        context->blk[context->partial] = context->decrypt ? x : c;
+        if (++context->partial == AJ_BLOCKSZ) {
+            AJ_AES_CBC_MAC_128(context->key, context->blk, AJ_BLOCKSZ, context->T);
+            context->partial = 0;
+        }
     }
-    Trace("CBC-MAC", context->T.data, context->M);
 }
 
-static CCM_Context* InitCCMContext(const uint8_t* nonce, uint32_t nLen, uint32_t hdrLen, uint32_t msgLen, uint8_t M)
+void AJ_CCM_Update(AJ_CCM_Context* context, const uint8_t* in, uint8_t* out, uint32_t len)
 {
-    int i;
-    int l;
-    uint8_t L  = 15 - max(nLen, 11);
-    uint8_t flags = ((hdrLen) ? 0x40 : 0) | (((M - 2) / 2) << 3) | (L - 1);
-    CCM_Context* context;
+    uint32_t n;
 
-    AJ_ASSERT(nLen <= 15);
+    AJ_ASSERT(len <= context->remaining);
+    context->remaining -= len;
+    /*
+     * Finish off a block left over from the previous call
+     */
+    if (context->partial) {
+        n = min(len, (uint32_t)(AJ_BLOCKSZ - context->partial));
+        PartialBlock(context, in, out, n);
+        in += n;
+        out += n;
+        len -= n;
+    }
+    /*
+     * Whole blocks go through CTR and the CBC-MAC in a single pass
+     */
+    n = len & ~(AJ_BLOCKSZ - 1);
+    if (n) {
+        AJ_AES_CCM_128(context->key, in, out, n, context->ivec, context->T, context->decrypt);
+        in += n;
+        out += n;
+        len -= n;
+    }
+    /*
+     * Start a new block with what is left
+     */
+    if (len) {
+        memset(context->ks, 0, AJ_BLOCKSZ);
+        memset(context->blk, 0, AJ_BLOCKSZ);
+        AJ_AES_CTR_128_Expanded(context->key, context->ks, context->ks, AJ_BLOCKSZ, context->ivec);
+        PartialBlock(context, in, out, len);
+    }
+}
 
-    context = (CCM_Context*)AJ_Malloc(sizeof(CCM_Context));
-    if (context) {
-        memset(context, 0, sizeof(CCM_Context));
+AJ_Status AJ_CCM_Final(AJ_CCM_Context* context, uint8_t* tag)
+{
+    AJ_Status status = AJ_OK;
+    uint8_t diff = 0;
+    uint32_t i;
+
+    AJ_ASSERT(context->remaining == 0);
+    /*
+     * The MAC of the last block is over the zero padded plain text
+     */
+    if (context->partial) {
+        AJ_AES_CBC_MAC_128(context->key, context->blk, AJ_BLOCKSZ, context->T);
+    }
+    Trace("CBC-MAC", context->T, context->tagLen);
+    if (context->decrypt) {
         /*
-         * Set ivec and other initial args.
+         * Verify the authentication tag without an early exit
          */
-        context->ivec.data[0] = L - 1;
-        memcpy(&context->ivec.data[1], nonce, nLen);
+        for (i = 0; i < context->tagLen; ++i) {
+            diff |= tag[i] ^ context->T[i] ^ context->S_0[i];
+        }
+        if (diff) {
+            AJ_ErrPrintf(("AJ_CCM_Final(): AJ_ERR_SECURITY\n"));
+            status = AJ_ERR_SECURITY;
+        }
+    } else {
         /*
-         * Compute the B_0 block. This encodes the flags, the nonce, and the message length.
+         * Encrypt the authentication tag
          */
-        context->B_0.data[0] = flags;
-        memcpy(&context->B_0.data[1], nonce, nLen);
-        for (i = 15, l = msgLen - hdrLen; l != 0; i--) {
-            context->B_0.data[i] = (uint8_t)l;
-            l >>= 8;
+        for (i = 0; i < context->tagLen; ++i) {
+            tag[i] = context->T[i] ^ context->S_0[i];
         }
     }
-    return context;
+    memset(context, 0, sizeof(AJ_CCM_Context));
+    return status;
 }
 
 /*
- * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610
+ * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610. The message body
+ * is authenticated and encrypted in a single pass.
  */
+AJ_Status AJ_Encrypt_CCM_Expanded(const AJ_AES_Key* key,
+                                  uint8_t* msg,
+                                  uint32_t msgLen,
+                                  uint32_t hdrLen,
+                                  uint8_t tagLen,
+                                  const uint8_t* nonce,
+                                  uint32_t nLen)
+{
+    AJ_CCM_Context context;
+
+    AJ_CCM_Init(&context, key, nonce, nLen, msg, hdrLen, msgLen - hdrLen, tagLen, FALSE);
+    AJ_CCM_Update(&context, msg + hdrLen, msg + hdrLen, msgLen - hdrLen);
+    return AJ_CCM_Final(&context, msg + msgLen);
+}
+
 AJ_Status AJ_Encrypt_CCM(const uint8_t* key,
                          uint8_t* msg,
                          uint32_t msgLen,
@@ -183,46 +267,43 @@ AJ_Status AJ_Encrypt_CCM(const uint8_t* key,
                          const uint8_t* nonce,
                          uint32_t nLen)
 {
-    AJ_Status status = AJ_OK;
-    CCM_Context* context;
+    AJ_Status status;
+    AJ_AES_Key ks;
 
-    if (!(context = InitCCMContext(nonce, nLen, hdrLen, msgLen, tagLen))) {
-        AJ_ErrPrintf(("AJ_Encrypt_CCM(): AJ_ERR_RESOURCES\n"));
-        return AJ_ERR_RESOURCES;
-    }
-    /*
-     * Do any platform specific operations to enable AES
-     */
-    AJ_AES_Enable(key);
-    /*
-     * Compute the authentication tag
-     */
-    Compute_CCM_AuthTag(key, context, msg, msgLen - hdrLen, hdrLen);
-    /*
-     * Encrypt the authentication tag
-     */
-    AJ_AES_CTR_128(key, context->T.data, msg + msgLen, tagLen, context->ivec.data);
-    Trace("CTR Start", context->ivec.data, AJ_BLOCKSZ);
-    /*
-     * Encrypt the message
-     */
-    if (msgLen != hdrLen) {
-        AJ_AES_CTR_128(key, msg + hdrLen, msg + hdrLen, msgLen - hdrLen, context->ivec.data);
-    }
-    /*
-     * Balance the enable call above
-     */
-    AJ_AES_Disable();
-    /*
-     * Done with the context
-     */
-    AJ_Free(context);
+    AJ_AES_ExpandKey(&ks, key);
+    status = AJ_Encrypt_CCM_Expanded(&ks, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    memset(&ks, 0, sizeof(ks));
     return status;
 }
 
 /*
- * Implements AES-CCM (Counter with CBC-MAC) decryption as described in RFC 3610
+ * Implements AES-CCM (Counter with CBC-MAC) decryption as described in RFC 3610. The message body
+ * is decrypted and authenticated in a single pass.
  */
+AJ_Status AJ_Decrypt_CCM_Expanded(const AJ_AES_Key* key,
+                                  uint8_t* msg,
+                                  uint32_t msgLen,
+                                  uint32_t hdrLen,
+                                  uint8_t tagLen,
+                                  const uint8_t* nonce,
+                                  uint32_t nLen)
+{
+    AJ_Status status;
+    AJ_CCM_Context context;
+
+    AJ_CCM_Init(&context, key, nonce, nLen, msg, hdrLen, msgLen - hdrLen, tagLen, TRUE);
+    AJ_CCM_Update(&context, msg + hdrLen, msg + hdrLen, msgLen - hdrLen);
+    status = AJ_CCM_Final(&context, msg + msgLen);
+    if (status != AJ_OK) {
+        /*
+         * Authentication failed Clear the decrypted data
+         */
+        memset(msg, 0, msgLen + tagLen);
+        AJ_ErrPrintf(("AJ_Decrypt_CCM(): AJ_ERR_SECURITY\n"));
+    }
+    return status;
+}
+
 AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
                          uint8_t* msg,
                          uint32_t msgLen,
@@ -231,47 +312,12 @@ AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
                          const uint8_t* nonce,
                          uint32_t nLen)
 {
-    AJ_Status status = AJ_OK;
-    CCM_Context* context;
+    AJ_Status status;
+    AJ_AES_Key ks;
 
-    if (!(context = InitCCMContext(nonce, nLen, hdrLen, msgLen, tagLen))) {
-        AJ_ErrPrintf(("AJ_Decrypt_CCM(): AJ_ERR_RESOURCES\n"));
-        return AJ_ERR_RESOURCES;
-    }
-    /*
-     * Do any platform specific operations to enable AES
-     */
-    AJ_AES_Enable(key);
-    /*
-     * Decrypt the authentication field
-     */
-    AJ_AES_CTR_128(key, msg + msgLen, msg + msgLen, tagLen, context->ivec.data);
-    /*
-     * Decrypt message.
-     */
-    if (msgLen != hdrLen) {
-        AJ_AES_CTR_128(key, msg + hdrLen, msg + hdrLen, msgLen - hdrLen, context->ivec.data);
-    }
-    /*
-     * Compute and verify the authentication tag T.
-     */
-    Compute_CCM_AuthTag(key, context, msg, msgLen - hdrLen, hdrLen);
-    /*
-     * Balance the enable call above
-     */
-    AJ_AES_Disable();
-    if (memcmp(context->T.data, msg + msgLen, tagLen) != 0) {
-        /*
-         * Authentication failed Clear the decrypted data
-         */
-        memset(msg, 0, msgLen + tagLen);
-        AJ_ErrPrintf(("AJ_Decrypt_CCM(): AJ_ERR_SECURITY\n"));
-        status = AJ_ERR_SECURITY;
-    }
-    /*
-     * Done with the context
-     */
-    AJ_Free(context);
+    AJ_AES_ExpandKey(&ks, key);
+    status = AJ_Decrypt_CCM_Expanded(&ks, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    memset(&ks, 0, sizeof(ks));
     return status;
 }
 
@@ -24,6 +24,20 @@
 #include "aj_target.h"
 #include "aj_status.h"
 
+/**
+ * Number of 32 bit words in an expanded AES-128 key schedule (11 round keys)
+ */
+#define AJ_AES_SCHEDULE_LEN 44
+
+/**
+ * An expanded AES-128 key schedule. Expanding a key costs about as much as encrypting a block so
+ * keys that are used for many messages (e.g. per-peer session keys) should be expanded once and
+ * the schedule kept alongside the key.
+ */
+typedef struct _AJ_AES_Key {
+    uint32_t fkey[AJ_AES_SCHEDULE_LEN];
+} AJ_AES_Key;
+
 /**
  * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610. The message in
  * encrypted in place.
@@ -73,6 +87,111 @@ AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
                          const uint8_t* nonce,
                          uint32_t nLen);
 
+/**
+ * Same as AJ_Encrypt_CCM() but uses a key schedule previously expanded by AJ_AES_ExpandKey().
+ *
+ * @param key     The expanded AES-128 encryption key
+ * @param msg     The buffer containing the entire message that is to be encrypted
+ * @param msgLen  The length of the entire message
+ * @param hdrLen  The length of the header portion that will be authenticated but not encrypted
+ * @param tagLen  The length of the authentication tag to be appended to the message
+ * @param nonce   The nonce
+ * @param nLen    The length of the nonce
+ *
+ * @return
+ */
+AJ_Status AJ_Encrypt_CCM_Expanded(const AJ_AES_Key* key,
+                                  uint8_t* msg,
+                                  uint32_t msgLen,
+                                  uint32_t hdrLen,
+                                  uint8_t tagLen,
+                                  const uint8_t* nonce,
+                                  uint32_t nLen);
+
+/**
+ * Same as AJ_Decrypt_CCM() but uses a key schedule previously expanded by AJ_AES_ExpandKey().
+ *
+ * @param key     The expanded AES-128 encryption key
+ * @param msg     The buffer containing the entire message to be decrypted.
+ * @param msgLen  The length of the entire message, excluding the tag.
+ * @param hdrLen  The length of the header portion that will be authenticated but not encrypted
+ * @param tagLen  The length of the authentication tag to be appended to the message
+ * @param nonce   The nonce
+ * @param nLen    The length of the nonce
+ *
+ * @return
+ */
+AJ_Status AJ_Decrypt_CCM_Expanded(const AJ_AES_Key* key,
+                                  uint8_t* msg,
+                                  uint32_t msgLen,
+                                  uint32_t hdrLen,
+                                  uint8_t tagLen,
+                                  const uint8_t* nonce,
+                                  uint32_t nLen);
+
+/**
+ * State for AES-CCM over a message that is encrypted or decrypted a piece at a time
+ */
+typedef struct _AJ_CCM_Context {
+    const AJ_AES_Key* key;  /**< The expanded key, must stay valid until AJ_CCM_Final() */
+    uint32_t remaining;     /**< Number of body bytes not yet processed */
+    uint8_t T[16];          /**< CBC-MAC chaining value */
+    uint8_t S_0[16];        /**< Key stream block for the authentication tag */
+    uint8_t ivec[16];       /**< Next counter block */
+    uint8_t ks[16];         /**< Key stream for a partially processed block */
+    uint8_t blk[16];        /**< Plain text of a partially processed block */
+    uint8_t partial;        /**< Number of bytes of the partially processed block */
+    uint8_t tagLen;         /**< The length of the authentication tag */
+    uint8_t decrypt;        /**< TRUE if decrypting */
+} AJ_CCM_Context;
+
+/**
+ * Start AES-CCM over a message. The header is authenticated now, the body length must be known
+ * up front because it is part of the first CBC-MAC block.
+ *
+ * @param context  The context to initialize
+ * @param key      The expanded AES-128 key
+ * @param nonce    The nonce
+ * @param nLen     The length of the nonce
+ * @param hdr      The header portion that is authenticated but not encrypted
+ * @param hdrLen   The length of the header portion
+ * @param bodyLen  The length of the body that will be passed to AJ_CCM_Update()
+ * @param tagLen   The length of the authentication tag
+ * @param decrypt  TRUE to decrypt, FALSE to encrypt
+ */
+void AJ_CCM_Init(AJ_CCM_Context* context,
+                 const AJ_AES_Key* key,
+                 const uint8_t* nonce,
+                 uint32_t nLen,
+                 const uint8_t* hdr,
+                 uint32_t hdrLen,
+                 uint32_t bodyLen,
+                 uint8_t tagLen,
+                 uint8_t decrypt);
+
+/**
+ * Encrypt or decrypt the next piece of the message body. Pieces can be any length.
+ *
+ * @param context  The CCM context
+ * @param in       The input data
+ * @param out      The output data, may be the same as in
+ * @param len      The length of the data
+ */
+void AJ_CCM_Update(AJ_CCM_Context* context, const uint8_t* in, uint8_t* out, uint32_t len);
+
+/**
+ * Finish AES-CCM over a message. When encrypting this writes the encrypted authentication tag,
+ * when decrypting it checks the tag. The context is cleared.
+ *
+ * @param context  The CCM context
+ * @param tag      Receives the tag (encrypt) or holds the received tag (decrypt)
+ *
+ * @return
+ *         - AJ_OK if the tag was written or verified
+ *         - AJ_ERR_SECURITY if the tag did not verify
+ */
+AJ_Status AJ_CCM_Final(AJ_CCM_Context* context, uint8_t* tag);
+
 /**
  * A pseudo-random function for generation of keying material. This function uses AES-CCM to
  * as the MAC function.
@@ -159,6 +278,64 @@ void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out,
  */
 void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out);
 
+/**
+ * Expand an AES-128 key into a key schedule for use with the functions below.
+ *
+ * @param ks   Returns the expanded key
+ * @param key  The 16 byte AES key
+ */
+void AJ_AES_ExpandKey(AJ_AES_Key* ks, const uint8_t* key);
+
+/**
+ * AES counter mode encryption/decryption using an expanded key. The counter is a 32 bit big-endian
+ * value in the last four bytes of the counter block.
+ *
+ * @param ks   The expanded AES encryption key
+ * @param in   The data to encrypt
+ * @param out  The encrypted data
+ * @param len  The length of the input data
+ * @param ctr  Pointer to a 16 byte counter block, returns the next counter value
+ */
+void AJ_AES_CTR_128_Expanded(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr);
+
+/**
+ * Continue a CBC-MAC over whole blocks using an expanded key. Only the chaining value is kept, the
+ * intermediate cipher text is not written anywhere.
+ *
+ * @param ks   The expanded AES encryption key
+ * @param in   The data to authenticate
+ * @param len  The length of the input data, must be multiple of 16
+ * @param mac  Pointer to the 16 byte chaining value, updated in place
+ */
+void AJ_AES_CBC_MAC_128(const AJ_AES_Key* ks, const uint8_t* in, uint32_t len, uint8_t* mac);
+
+/**
+ * The body phase of AES-CCM in a single pass: each block is run through CTR mode and the CBC-MAC
+ * together, with the two AES operations interleaved. The MAC is always computed over the plain
+ * text. A partial last block is zero padded for the MAC so this can only be called once per
+ * message unless len is a multiple of 16.
+ *
+ * @param ks       The expanded AES encryption key
+ * @param in       The plain text (encrypt) or cipher text (decrypt)
+ * @param out      The cipher text (encrypt) or plain text (decrypt), may be the same as in
+ * @param len      The length of the data
+ * @param ctr      Pointer to the 16 byte counter block, returns the next counter value
+ * @param mac      Pointer to the 16 byte CBC-MAC chaining value, updated in place
+ * @param decrypt  TRUE to decrypt, FALSE to encrypt
+ */
+void AJ_AES_CCM_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt);
+
+#ifdef AJ_AES_HW_ACCEL
+/*
+ * Host builds can use the AES instructions of the CPU (AES-NI or the ARMv8 crypto extensions). The
+ * software functions above call these when AJ_AES_HW_Supported() reports the CPU has them.
+ */
+uint8_t AJ_AES_HW_Supported(void);
+void AJ_AES_HW_CTR_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr);
+void AJ_AES_HW_CBC_MAC_128(const AJ_AES_Key* ks, const uint8_t* in, uint32_t len, uint8_t* mac);
+void AJ_AES_HW_CCM_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt);
+#endif
+
 /**
  * @}
  */
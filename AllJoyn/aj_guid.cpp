@@ -39,16 +39,58 @@ uint8_t dbgGUID = 0;
 
 typedef struct _NameToGUID {
     uint8_t keyRole;
-    char uniqueName[AJ_MAX_NAME_SIZE + 1];
+    uint16_t uniqueNext;      /* Next entry in the unique name bucket, 0 for none */
+    uint16_t serviceNext;     /* Next entry in the service name bucket, 0 for none */
+    uint32_t uniqueHash;
+    uint32_t serviceHash;
+    uint32_t lastUse;         /* Value of mapClock when the entry was last used */
+    uint16_t nameOffset;      /* Unique name in namePool */
+    uint8_t nameLen;          /* Unique name length, 0 for a free entry */
     const char* serviceName;
     AJ_GUID guid;
     uint8_t sessionKey[16];
     uint8_t groupKey[16];
+    AJ_AES_Key sessionSched;  /* sessionKey expanded when it is set */
 } NameToGUID;
 
+#if (AJ_NAME_MAP_HASH_SIZE & (AJ_NAME_MAP_HASH_SIZE - 1)) != 0
+#error AJ_NAME_MAP_HASH_SIZE must be a power of 2
+#endif
+
+#if AJ_MAX_NAME_SIZE > 255
+#error AJ_MAX_NAME_SIZE cannot be longer than a bus name
+#endif
+
+#if AJ_NAME_MAP_NAME_POOL <= AJ_MAX_NAME_SIZE
+#error AJ_NAME_MAP_NAME_POOL must hold a name of AJ_MAX_NAME_SIZE
+#endif
+
 static uint8_t localGroupKey[16];
+static AJ_AES_Key localGroupSched;
 
+/*
+ * Entries are hashed on both the unique name and the service name of the peer. Entries are
+ * referred to by index plus one so that a zeroed table is empty.
+ *
+ * The unique names are packed, NUL terminated, into namePool so that an entry does not reserve
+ * AJ_MAX_NAME_SIZE bytes. Removing a name closes the gap it leaves.
+ *
+ * Signals from a peer are decrypted with its group key. Only the session key schedule, used for
+ * every method call and reply, is kept per entry; the group key of the last peer a signal came
+ * from is expanded into groupSched.
+ */
 static NameToGUID nameMap[AJ_NAME_MAP_GUID_SIZE];
+static uint16_t uniqueBuckets[AJ_NAME_MAP_HASH_SIZE];
+static uint16_t serviceBuckets[AJ_NAME_MAP_HASH_SIZE];
+static uint32_t mapClock;
+static char namePool[AJ_NAME_MAP_NAME_POOL];
+static uint16_t namePoolUsed;
+static AJ_AES_Key groupSched;
+static uint16_t groupSchedEntry;   /* Entry whose group key is in groupSched, 0 for none */
+
+#define NAME_ENTRY(n)  (&nameMap[(n) - 1])
+#define ENTRY_NUM(m)   ((uint16_t)((m) - nameMap) + 1)
+#define ENTRY_NAME(m)  (&namePool[(m)->nameOffset])
 
 AJ_Status AJ_GUID_ToString(const AJ_GUID* guid, char* buffer, uint32_t bufLen)
 {
@@ -60,54 +102,204 @@ AJ_Status AJ_GUID_FromString(AJ_GUID* guid, const char* str)
     return AJ_HexToRaw(str, 32, guid->val, 16);
 }
 
-static NameToGUID* LookupName(const char* name)
+/*
+ * FNV-1a
+ */
+static uint32_t NameHash(const char* name)
 {
-    uint32_t i;
-    AJ_InfoPrintf(("LookupName(name=\"%s\")\n", name));
+    uint32_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static uint16_t* NameBucket(uint32_t hash, uint8_t service)
+{
+    uint16_t* buckets = service ? serviceBuckets : uniqueBuckets;
+    return &buckets[hash & (AJ_NAME_MAP_HASH_SIZE - 1)];
+}
+
+static uint16_t* NextName(uint16_t n, uint8_t service)
+{
+    return service ? &NAME_ENTRY(n)->serviceNext : &NAME_ENTRY(n)->uniqueNext;
+}
+
+static void LinkName(uint16_t n, uint8_t service)
+{
+    NameToGUID* mapping = NAME_ENTRY(n);
+    uint16_t* bucket = NameBucket(service ? mapping->serviceHash : mapping->uniqueHash, service);
+
+    *NextName(n, service) = *bucket;
+    *bucket = n;
+}
+
+static void UnlinkName(uint16_t n, uint8_t service)
+{
+    NameToGUID* mapping = NAME_ENTRY(n);
+    uint16_t* link = NameBucket(service ? mapping->serviceHash : mapping->uniqueHash, service);
 
+    while (*link && (*link != n)) {
+        link = NextName(*link, service);
+    }
+    if (*link) {
+        *link = *NextName(n, service);
+    }
+}
+
+static void RemoveName(uint16_t n)
+{
+    NameToGUID* mapping = NAME_ENTRY(n);
+    uint16_t size = mapping->nameLen + 1;
+    uint16_t end = mapping->nameOffset + size;
+    uint16_t i;
+
+    UnlinkName(n, FALSE);
+    if (mapping->serviceName) {
+        UnlinkName(n, TRUE);
+    }
+    memmove(&namePool[mapping->nameOffset], &namePool[end], namePoolUsed - end);
+    namePoolUsed -= size;
     for (i = 0; i < AJ_NAME_MAP_GUID_SIZE; ++i) {
-        if (strcmp(nameMap[i].uniqueName, name) == 0) {
-            return &nameMap[i];
+        if (nameMap[i].nameLen && (nameMap[i].nameOffset >= end)) {
+            nameMap[i].nameOffset -= size;
         }
-        if (nameMap[i].serviceName && (strcmp(nameMap[i].serviceName, name)) == 0) {
-            return &nameMap[i];
+    }
+    if (groupSchedEntry == n) {
+        groupSchedEntry = 0;
+    }
+    memset(mapping, 0, sizeof(NameToGUID));
+}
+
+static uint16_t FindName(const char* name, uint32_t hash, uint8_t service)
+{
+    uint16_t n = *NameBucket(hash, service);
+
+    while (n) {
+        NameToGUID* mapping = NAME_ENTRY(n);
+        if (service) {
+            if ((mapping->serviceHash == hash) && (strcmp(mapping->serviceName, name) == 0)) {
+                break;
+            }
+        } else if ((mapping->uniqueHash == hash) && (strcmp(ENTRY_NAME(mapping), name) == 0)) {
+            break;
         }
+        n = *NextName(n, service);
+    }
+    return n;
+}
+
+static NameToGUID* LookupName(const char* name)
+{
+    uint32_t hash = NameHash(name);
+    uint16_t n;
+
+    AJ_InfoPrintf(("LookupName(name=\"%s\")\n", name));
+
+    n = FindName(name, hash, FALSE);
+    if (!n) {
+        n = FindName(name, hash, TRUE);
+    }
+    if (n) {
+        NAME_ENTRY(n)->lastUse = ++mapClock;
+        return NAME_ENTRY(n);
     }
     AJ_ErrPrintf(("LookupName(): NULL\n"));
     return NULL;
 }
 
+static uint16_t EvictName(void)
+{
+    uint16_t victim = 0;
+    uint16_t n;
+
+    for (n = 1; n <= AJ_NAME_MAP_GUID_SIZE; ++n) {
+        if (NAME_ENTRY(n)->nameLen && (!victim || (NAME_ENTRY(n)->lastUse < NAME_ENTRY(victim)->lastUse))) {
+            victim = n;
+        }
+    }
+    AJ_InfoPrintf(("EvictName(): evicting \"%s\"\n", ENTRY_NAME(NAME_ENTRY(victim))));
+    RemoveName(victim);
+    return victim;
+}
+
+/*
+ * Returns a free entry with room for a name of len in the pool, evicting least recently used
+ * peers if the table or the pool is full
+ */
+static uint16_t AllocName(size_t len)
+{
+    uint16_t n;
+
+    for (n = 1; n <= AJ_NAME_MAP_GUID_SIZE; ++n) {
+        if (!NAME_ENTRY(n)->nameLen) {
+            break;
+        }
+    }
+    if (n > AJ_NAME_MAP_GUID_SIZE) {
+        n = EvictName();
+    }
+    while ((namePoolUsed + len + 1) > AJ_NAME_MAP_NAME_POOL) {
+        EvictName();
+    }
+    return n;
+}
+
 AJ_Status AJ_GUID_AddNameMapping(const AJ_GUID* guid, const char* uniqueName, const char* serviceName)
 {
     size_t len = strlen(uniqueName);
+    uint32_t hash = NameHash(uniqueName);
     NameToGUID* mapping;
+    uint16_t n;
 
     AJ_InfoPrintf(("AJ_GUID_AddNameMapping(guid=0x%p, uniqueName=\"%s\", serviceName=\"%s\")\n", guid, uniqueName, serviceName));
 
-    mapping = LookupName(uniqueName);
-    if (!mapping) {
-        mapping = LookupName("");
-    }
-    if (mapping && (len <= AJ_MAX_NAME_SIZE)) {
-        memcpy(&mapping->guid, guid, sizeof(AJ_GUID));
-        memcpy(&mapping->uniqueName, uniqueName, len + 1);
-        mapping->serviceName = serviceName;
-        return AJ_OK;
-    } else {
+    if (!len || (len > AJ_MAX_NAME_SIZE)) {
         AJ_ErrPrintf(("AJ_GUID_AddNameMapping(): AJ_ERR_RESOURCES\n"));
         return AJ_ERR_RESOURCES;
     }
+    /*
+     * An existing peer keeps its keys but may have a new service name
+     */
+    n = FindName(uniqueName, hash, FALSE);
+    if (n) {
+        UnlinkName(n, FALSE);
+        if (NAME_ENTRY(n)->serviceName) {
+            UnlinkName(n, TRUE);
+        }
+    } else {
+        n = AllocName(len);
+    }
+    mapping = NAME_ENTRY(n);
+    if (!mapping->nameLen) {
+        mapping->nameOffset = namePoolUsed;
+        mapping->nameLen = (uint8_t)len;
+        memcpy(ENTRY_NAME(mapping), uniqueName, len + 1);
+        namePoolUsed += len + 1;
+    }
+    memcpy(&mapping->guid, guid, sizeof(AJ_GUID));
+    mapping->uniqueHash = hash;
+    mapping->serviceName = serviceName;
+    mapping->lastUse = ++mapClock;
+    LinkName(n, FALSE);
+    if (serviceName) {
+        mapping->serviceHash = NameHash(serviceName);
+        LinkName(n, TRUE);
+    }
+    return AJ_OK;
 }
 
 void AJ_GUID_DeleteNameMapping(const char* uniqueName)
 {
-    NameToGUID* mapping;
+    uint16_t n;
 
-    AJ_InfoPrintf(("AJ_GUID_AddNameMapping(uniqueName=\"%s\")\n", uniqueName));
+    AJ_InfoPrintf(("AJ_GUID_DeleteNameMapping(uniqueName=\"%s\")\n", uniqueName));
 
-    mapping = LookupName(uniqueName);
-    if (mapping) {
-        memset(mapping, 0, sizeof(NameToGUID));
+    n = FindName(uniqueName, NameHash(uniqueName), FALSE);
+    if (n) {
+        RemoveName(n);
     }
 }
 
@@ -124,6 +316,11 @@ void AJ_GUID_ClearNameMap(void)
 {
     AJ_InfoPrintf(("AJ_GUID_ClearNameMap()\n"));
     memset(nameMap, 0, sizeof(nameMap));
+    memset(uniqueBuckets, 0, sizeof(uniqueBuckets));
+    memset(serviceBuckets, 0, sizeof(serviceBuckets));
+    mapClock = 0;
+    namePoolUsed = 0;
+    groupSchedEntry = 0;
 }
 
 AJ_Status AJ_SetGroupKey(const char* uniqueName, const uint8_t* key)
@@ -135,6 +332,9 @@ AJ_Status AJ_SetGroupKey(const char* uniqueName, const uint8_t* key)
     mapping = LookupName(uniqueName);
     if (mapping) {
         memcpy(mapping->groupKey, key, 16);
+        if (groupSchedEntry == ENTRY_NUM(mapping)) {
+            groupSchedEntry = 0;
+        }
         return AJ_OK;
     } else {
         AJ_ErrPrintf(("AJ_SetGroupKey(): AJ_ERR_NO_MATCH\n"));
@@ -152,6 +352,7 @@ AJ_Status AJ_SetSessionKey(const char* uniqueName, const uint8_t* key, uint8_t r
     if (mapping) {
         mapping->keyRole = role;
         memcpy(mapping->sessionKey, key, 16);
+        AJ_AES_ExpandKey(&mapping->sessionSched, key);
         return AJ_OK;
     } else {
         AJ_ErrPrintf(("AJ_SetSessionKey(): AJ_ERR_NO_MATCH\n"));
@@ -176,6 +377,20 @@ AJ_Status AJ_GetSessionKey(const char* name, uint8_t* key, uint8_t* role)
     }
 }
 
+/*
+ * The local group key is generated on first use
+ */
+static void InitLocalGroupKey(void)
+{
+    uint8_t zero[16];
+
+    memset(zero, 0, sizeof(zero));
+    if (memcmp(localGroupKey, zero, 16) == 0) {
+        AJ_RandBytes(localGroupKey, 16);
+        AJ_AES_ExpandKey(&localGroupSched, localGroupKey);
+    }
+}
+
 AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key)
 {
     AJ_InfoPrintf(("AJ_GetGroupKey(name=\"%s\", key=0x%p)\n", name, key));
@@ -187,14 +402,46 @@ AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key)
         }
         memcpy(key, mapping->groupKey, 16);
     } else {
-        /*
-         * Check if the group key needs to be initialized
-         */
-        memset(key, 0, 16);
-        if (memcmp(localGroupKey, key, 16) == 0) {
-            AJ_RandBytes(localGroupKey, 16);
-        }
+        InitLocalGroupKey();
         memcpy(key, localGroupKey, 16);
     }
     return AJ_OK;
 }
+
+AJ_Status AJ_GetSessionKeySchedule(const char* name, const AJ_AES_Key** key, uint8_t* role)
+{
+    NameToGUID* mapping;
+
+    AJ_InfoPrintf(("AJ_GetSessionKeySchedule(name=\"%s\", key=0x%p, role=0x%p)\n", name, key, role));
+
+    mapping = LookupName(name);
+    if (mapping) {
+        *role = mapping->keyRole;
+        *key = &mapping->sessionSched;
+        return AJ_OK;
+    } else {
+        AJ_ErrPrintf(("AJ_GetSessionKeySchedule(): AJ_ERR_NO_MATCH\n"));
+        return AJ_ERR_NO_MATCH;
+    }
+}
+
+AJ_Status AJ_GetGroupKeySchedule(const char* name, const AJ_AES_Key** key)
+{
+    AJ_InfoPrintf(("AJ_GetGroupKeySchedule(name=\"%s\", key=0x%p)\n", name, key));
+    if (name) {
+        NameToGUID* mapping = LookupName(name);
+        if (!mapping) {
+            AJ_ErrPrintf(("AJ_GetGroupKeySchedule(): AJ_ERR_NO_MATCH\n"));
+            return AJ_ERR_NO_MATCH;
+        }
+        if (groupSchedEntry != ENTRY_NUM(mapping)) {
+            AJ_AES_ExpandKey(&groupSched, mapping->groupKey);
+            groupSchedEntry = ENTRY_NUM(mapping);
+        }
+        *key = &groupSched;
+    } else {
+        InitLocalGroupKey();
+        *key = &localGroupSched;
+    }
+    return AJ_OK;
+}
@@ -24,6 +24,7 @@
 
 #include "aj_target.h"
 #include "aj_status.h"
+#include "aj_crypto.h"
 
 /**
  * Type for a GUID
@@ -64,15 +65,16 @@ AJ_Status AJ_GUID_FromString(AJ_GUID* guid, const char* str);
 void AJ_GUID_ClearNameMap(void);
 
 /**
- * Adds a unique name to the GUID map.
+ * Adds a unique name to the GUID map. If the map, or the pool the unique names are kept in, is full
+ * the least recently used peers are evicted and will have to authenticate again.
  *
  * @param guid        The GUID to add
  * @param uniqueName  A unique name that maps to the GUID
- * @param serviceName A service name that maps to the GUID
+ * @param serviceName A service name that maps to the GUID, this string is not copied
  *
  * @return  Return AJ_Status
  *          - AJ_OK if the mapping was added
- *          - AJ_ERR_RESOURCES if there is no room to the mapping
+ *          - AJ_ERR_RESOURCES if the unique name is longer than AJ_MAX_NAME_SIZE
  */
 AJ_Status AJ_GUID_AddNameMapping(const AJ_GUID* guid, const char* uniqueName, const char* serviceName);
 
@@ -146,6 +148,32 @@ AJ_Status AJ_GetSessionKey(const char* name, uint8_t* key, uint8_t* role);
  */
 AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key);
 
+/**
+ * Gets the expanded session key for an entry from the GUID map. The key schedule is computed
+ * once when the session key is set so encrypting a message does not have to expand the key.
+ *
+ * @param name  The unique or well-known name for a remote peer
+ * @param key   Returns a pointer to the expanded session key, valid until the entry changes
+ * @param role  Indicates which peer initiated the session key
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the key was obtained
+ *          - AJ_ERR_NO_MATCH if there is no entry to the peer
+ */
+AJ_Status AJ_GetSessionKeySchedule(const char* name, const AJ_AES_Key** key, uint8_t* role);
+
+/**
+ * Gets the expanded group key for an entry from the GUID map
+ *
+ * @param name  The unique or well-known name for a remote peer or NULL to get the local group key.
+ * @param key   Returns a pointer to the expanded group key, valid until the entry changes
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the key was obtained
+ *          - AJ_ERR_NO_MATCH if there is no entry to the peer
+ */
+AJ_Status AJ_GetGroupKeySchedule(const char* name, const AJ_AES_Key** key);
+
 /**
  * @}
  */
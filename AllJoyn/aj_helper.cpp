@@ -34,77 +34,293 @@
 uint8_t dbgHELPER = 0;
 #endif
 
+/**
+ * Link used to chain timers into a wheel bucket, the expired list or the free list
+ */
+typedef struct _TimerLink {
+    struct _TimerLink* next;
+    struct _TimerLink* prev;
+} TimerLink;
+
 /**
  *  Type to describe pending timers
  */
 typedef struct {
-    TimeoutHandler handler; /**< The callback handler */
+    TimerLink link;         /**< Position in the bucket list, must be first */
+    TimeoutHandler handler; /**< The callback handler, NULL if the timer is free */
     void* context;          /**< A context pointer passed in by the user */
     uint32_t abs_time;      /**< The absolute time when this timer will fire */
     uint32_t repeat;        /**< The amount of time between timer events */
 } Timer;
 
-static Timer Timers[AJ_MAX_TIMERS] = {
-    { NULL }
-};
+#if (AJ_TIMER_WHEEL_SIZE & (AJ_TIMER_WHEEL_SIZE - 1)) != 0
+#error AJ_TIMER_WHEEL_SIZE must be a power of 2
+#endif
 
-static uint32_t RunExpiredTimers(uint32_t now)
+#define TIMER_TICK(t)    ((uint32_t)(t) >> AJ_TIMER_TICK_SHIFT)
+#define TIMER_BUCKET(k)  (Wheel + ((k) & (AJ_TIMER_WHEEL_SIZE - 1)))
+#define TIMER_DUE(t, n)  ((int32_t)((t) - (n)) <= 0)
+
+static Timer Timers[AJ_MAX_TIMERS];
+
+/*
+ * Pending timers are hashed into the bucket for the tick they expire in. A bucket holds timers
+ * for every lap of the wheel so each one is checked against the current time as it is visited.
+ */
+static TimerLink Wheel[AJ_TIMER_WHEEL_SIZE];
+static TimerLink Expired;
+static TimerLink* FreeTimers;
+static uint8_t timersInit = FALSE;
+/*
+ * The earliest tick that has not been fully run
+ */
+static uint32_t wheelTick;
+/*
+ * Cached earliest deadline, recomputed when the timer holding it goes away
+ */
+static uint32_t nextDeadline;
+static uint8_t nextValid;
+static uint32_t pendingTimers;
+/*
+ * Timer whose handler is running, cleared if the handler cancels it
+ */
+static Timer* firing;
+
+static uint32_t TimerNow()
+{
+    AJ_Time start = { 0, 0 };
+    return AJ_GetElapsedTime(&start, FALSE);
+}
+
+static void InitTimers(uint32_t now)
+{
+    size_t i;
+
+    for (i = 0; i < AJ_TIMER_WHEEL_SIZE; ++i) {
+        Wheel[i].next = Wheel[i].prev = &Wheel[i];
+    }
+    Expired.next = Expired.prev = &Expired;
+    FreeTimers = NULL;
+    for (i = AJ_MAX_TIMERS; i > 0; --i) {
+        Timers[i - 1].link.next = FreeTimers;
+        FreeTimers = &Timers[i - 1].link;
+    }
+    wheelTick = TIMER_TICK(now);
+    nextValid = TRUE;
+    pendingTimers = 0;
+    firing = NULL;
+    timersInit = TRUE;
+}
+
+static void LinkTimer(TimerLink* head, Timer* timer)
+{
+    timer->link.prev = head->prev;
+    timer->link.next = head;
+    head->prev->next = &timer->link;
+    head->prev = &timer->link;
+}
+
+static void UnlinkTimer(Timer* timer)
+{
+    timer->link.prev->next = timer->link.next;
+    timer->link.next->prev = timer->link.prev;
+    timer->link.next = timer->link.prev = &timer->link;
+}
+
+static void ScheduleTimer(Timer* timer)
+{
+    uint32_t tick = TIMER_TICK(timer->abs_time);
+
+    /*
+     * A timer that is already due goes in the bucket that will be run next
+     */
+    if ((int32_t)(tick - wheelTick) < 0) {
+        tick = wheelTick;
+    }
+    LinkTimer(TIMER_BUCKET(tick), timer);
+    if (nextValid && (!pendingTimers || TIMER_DUE(timer->abs_time, nextDeadline))) {
+        nextDeadline = timer->abs_time;
+    }
+    ++pendingTimers;
+}
+
+static void DescheduleTimer(Timer* timer)
+{
+    UnlinkTimer(timer);
+    --pendingTimers;
+    if (timer->abs_time == nextDeadline) {
+        nextValid = FALSE;
+    }
+}
+
+static void FreeTimer(Timer* timer)
+{
+    timer->handler = NULL;
+    timer->link.next = FreeTimers;
+    FreeTimers = &timer->link;
+}
+
+/*
+ * Walk the wheel from the current tick. The first bucket holding a timer that expires in the
+ * lap being walked has the earliest deadline, otherwise every timer is more than a lap away.
+ */
+static uint32_t FindNextDeadline()
 {
-    uint32_t i = 0;
-    uint32_t next = (uint32_t) -1;
+    uint32_t i;
+    uint32_t earliest = 0;
+    uint8_t found = FALSE;
+    TimerLink* link;
+
+    for (link = Expired.next; link != &Expired; link = link->next) {
+        Timer* timer = (Timer*)link;
+        if (!found || TIMER_DUE(timer->abs_time, earliest)) {
+            earliest = timer->abs_time;
+            found = TRUE;
+        }
+    }
+    for (i = 0; i < AJ_TIMER_WHEEL_SIZE; ++i) {
+        uint32_t tick = wheelTick + i;
+        TimerLink* head = TIMER_BUCKET(tick);
+        uint8_t inLap = FALSE;
+
+        for (link = head->next; link != head; link = link->next) {
+            Timer* timer = (Timer*)link;
+            if (!found || TIMER_DUE(timer->abs_time, earliest)) {
+                earliest = timer->abs_time;
+                found = TRUE;
+            }
+            if ((int32_t)(TIMER_TICK(timer->abs_time) - tick) <= 0) {
+                inLap = TRUE;
+            }
+        }
+        if (inLap) {
+            break;
+        }
+    }
+    return earliest;
+}
 
-    for (; i < AJ_MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        if (timer->handler != NULL && timer->abs_time <= now) {
-            (timer->handler)(timer->context);
+static uint32_t NextTimeout(uint32_t now)
+{
+    if (!pendingTimers) {
+        return (uint32_t) -1;
+    }
+    if (!nextValid) {
+        nextDeadline = FindNextDeadline();
+        nextValid = TRUE;
+    }
+    return TIMER_DUE(nextDeadline, now) ? 0 : nextDeadline - now;
+}
+
+static uint32_t RunExpiredTimers(uint32_t now)
+{
+    uint32_t ticks;
+    uint32_t nowTick = TIMER_TICK(now);
 
+    if (!timersInit) {
+        InitTimers(now);
+    }
+    /*
+     * Move every expired timer from the buckets we have passed onto the expired list. The
+     * bucket for the current tick is left in place for timers later in this tick.
+     */
+    ticks = nowTick - wheelTick + 1;
+    if ((int32_t)ticks > 0) {
+        if (ticks > AJ_TIMER_WHEEL_SIZE) {
+            ticks = AJ_TIMER_WHEEL_SIZE;
+        }
+        while (ticks--) {
+            TimerLink* head = TIMER_BUCKET(nowTick - ticks);
+            TimerLink* link = head->next;
+            while (link != head) {
+                Timer* timer = (Timer*)link;
+                link = link->next;
+                if (TIMER_DUE(timer->abs_time, now)) {
+                    UnlinkTimer(timer);
+                    LinkTimer(&Expired, timer);
+                }
+            }
+        }
+        wheelTick = nowTick;
+    }
+    /*
+     * Handlers may set or cancel any timer, including the one being run
+     */
+    while (Expired.next != &Expired) {
+        Timer* timer = (Timer*)Expired.next;
+        DescheduleTimer(timer);
+        firing = timer;
+        (timer->handler)(timer->context);
+        if (firing == timer) {
             if (timer->repeat) {
                 timer->abs_time += timer->repeat;
+                ScheduleTimer(timer);
             } else {
-                memset(timer, 0, sizeof(Timer));
+                FreeTimer(timer);
             }
         }
-
-        // track the next time we need to run
-        if (timer->handler != NULL && next > timer->abs_time) {
-            next = timer->abs_time;
-        }
+        firing = NULL;
     }
+    // return how long until the next timer will run
+    return NextTimeout(now);
+}
 
-    // return the next timeout that will run
-    return next;
+uint32_t AJ_RunExpiredTimers()
+{
+    return RunExpiredTimers(TimerNow());
 }
 
-uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat)
+uint32_t AJ_GetNextTimeout()
 {
-    uint32_t i;
-    for (i = 0; i < AJ_MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        // need to find an available timer slot
-        if (timer->handler == NULL) {
-            AJ_Time start = { 0, 0 };
-            uint32_t now = AJ_GetElapsedTime(&start, FALSE);
-            timer->handler = handler;
-            timer->context = context;
-            timer->repeat = repeat;
-            timer->abs_time = now + relative_time;
-            return i + 1;
-        }
+    uint32_t now = TimerNow();
+
+    if (!timersInit) {
+        InitTimers(now);
     }
+    return NextTimeout(now);
+}
 
-    // available slot not found!
-    AJ_ErrPrintf(("AJ_SetTimer(): Slot not found\n"));
-    return 0;
+uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat)
+{
+    uint32_t now = TimerNow();
+    Timer* timer;
+
+    if (!timersInit) {
+        InitTimers(now);
+    }
+    // need to find an available timer slot
+    if (!FreeTimers) {
+        // available slot not found!
+        AJ_ErrPrintf(("AJ_SetTimer(): Slot not found\n"));
+        return 0;
+    }
+    timer = (Timer*)FreeTimers;
+    FreeTimers = FreeTimers->next;
+    timer->handler = handler;
+    timer->context = context;
+    timer->repeat = repeat;
+    timer->abs_time = now + relative_time;
+    timer->link.next = timer->link.prev = &timer->link;
+    ScheduleTimer(timer);
+    return (uint32_t)(timer - Timers) + 1;
 }
 
 void AJ_CancelTimer(uint32_t id)
 {
     Timer* timer = Timers + (id - 1);
     AJ_ASSERT(id > 0 && id <= AJ_MAX_TIMERS);
-    memset(timer, 0, sizeof(Timer));
+    if (timer->handler == NULL) {
+        return;
+    }
+    if (timer == firing) {
+        // the handler is running so the timer is not scheduled
+        firing = NULL;
+    } else {
+        DescheduleTimer(timer);
+    }
+    FreeTimer(timer);
 }
 
-
 AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* config)
 {
     uint8_t connected = FALSE;
@@ -154,6 +370,7 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
             timeout = next;
         }
 
+        // wait no longer than it takes for the next timer to expire
         status = AJ_UnmarshalMsg(bus, &msg, min(500, timeout));
         if (AJ_ERR_TIMEOUT == status && AJ_ERR_LINK_TIMEOUT == AJ_BusLinkStateProc(bus)) {
             AJ_ErrPrintf(("AJ_RunAllJoynService(): AJ_ERR_READ\n"));
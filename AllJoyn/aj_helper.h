@@ -142,6 +142,24 @@ uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* conte
  */
 void AJ_CancelTimer(uint32_t id);
 
+/**
+ *  Run the handlers of all timers that have expired. Applications that do not use
+ *  AJ_RunAllJoynService should call this from their message loop.
+ *
+ * @return The number of milliseconds until the next timer expires,
+ *          (uint32_t)-1 if there are no timers set.
+ */
+uint32_t AJ_RunExpiredTimers();
+
+/**
+ *  Get the time remaining until the next timer expires. This is the longest an application can
+ *  wait for a message without delaying a timer.
+ *
+ * @return The number of milliseconds until the next timer expires, 0 if a timer has expired,
+ *          (uint32_t)-1 if there are no timers set.
+ */
+uint32_t AJ_GetNextTimeout();
+
 /**
  * Helper function that connects to a bus initializes an AllJoyn service.
  *
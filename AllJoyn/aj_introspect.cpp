@@ -50,13 +50,38 @@ const AJ_Object* objectLists[AJ_MAX_OBJECT_LISTS] = { AJ_StandardObjects, NULL,
  * Struct for a reply context for a method call
  */
 typedef struct _ReplyContext {
-    AJ_Time callTime;    /**< Time the method call was made - used for timeouts */
-    uint32_t timeout;    /**< How long to wait for a reply */
-    uint32_t serial;     /**< Serial number for the reply message */
-    uint32_t messageId;  /**< The unique message id for the call */
+    uint32_t deadline;        /**< Absolute time when the call times out */
+    uint32_t serial;          /**< Serial number for the reply message */
+    uint32_t messageId;       /**< The unique message id for the call */
+    AJ_ReplyHandler handler;  /**< Optional completion callback for the call */
+    void* context;            /**< Context pointer passed to the completion callback */
+    uint16_t next;            /**< Next context in the hash bucket or free list, 0 for none */
+    uint16_t heapPos;         /**< Position of this context in the deadline heap */
 } ReplyContext;
 
+#if (AJ_REPLY_HASH_SIZE & (AJ_REPLY_HASH_SIZE - 1)) != 0
+#error AJ_REPLY_HASH_SIZE must be a power of 2
+#endif
+
+/*
+ * Reply contexts are hashed on the serial number of the call and are also kept in a heap ordered
+ * by deadline so the next call to time out is always at the top. Contexts are referred to by index
+ * plus one so that a zeroed table is empty.
+ */
 static ReplyContext replyContexts[AJ_NUM_REPLY_CONTEXTS];
+static uint16_t replyBuckets[AJ_REPLY_HASH_SIZE];
+static uint16_t replyHeap[AJ_NUM_REPLY_CONTEXTS];
+static uint16_t replyCount;
+static uint16_t replyFree;
+static uint16_t replyHighWater;
+/*
+ * Completion callback for the reply most recently identified or timed out
+ */
+static ReplyContext completedReply;
+
+#define REPLY_CONTEXT(n)    (&replyContexts[(n) - 1])
+#define REPLY_BUCKET(s)     (&replyBuckets[(s) & (AJ_REPLY_HASH_SIZE - 1)])
+#define REPLY_BEFORE(a, b)  ((int32_t)(REPLY_CONTEXT(a)->deadline - REPLY_CONTEXT(b)->deadline) < 0)
 
 /**
  * Function used by XML generator to push generated XML
@@ -384,6 +409,23 @@ void SizeXML(void* context, const char* str, uint32_t len)
     *((uint32_t*)context) += len;
 }
 
+/*
+ * Cache of the XML length for recently introspected objects so an introspect reply only has to
+ * generate the XML once. Entries are keyed by the object and are all thrown away when the
+ * registered objects or their flags change.
+ */
+typedef struct _XMLLenEntry {
+    const AJ_Object* obj;  /**< The object the length was computed for */
+    uint32_t len;          /**< Length of the XML for the object */
+} XMLLenEntry;
+
+static XMLLenEntry xmlLenCache[AJ_XML_LEN_CACHE_SIZE];
+
+static XMLLenEntry* XMLLenSlot(const AJ_Object* obj)
+{
+    return &xmlLenCache[((uintptr_t)obj / sizeof(AJ_Object)) % AJ_XML_LEN_CACHE_SIZE];
+}
+
 typedef struct _WriteContext {
     AJ_Message* reply;
     uint32_t len;
@@ -407,6 +449,7 @@ AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
     const AJ_Object* obj = NULL;
     AJ_Object parent;
     WriteContext context;
+    XMLLenEntry* cached = NULL;
     size_t list;
 
     for (list = AJ_APP_ID_FLAG; list < ArraySize(objectLists); ++list) {
@@ -467,13 +510,25 @@ AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
      */
     if (obj && obj->path && !(obj->flags & (AJ_OBJ_FLAG_HIDDEN | AJ_OBJ_FLAG_DISABLED))) {
         /*
-         * First pass computes the size of the XML string
+         * The size of the XML string comes from the cache or from a sizing pass. Placeholder
+         * parents are temporary so are never cached.
          */
-        context.len = 0;
-        status = GenXML(SizeXML, &context.len, obj, objectLists[list]);
-        if (status != AJ_OK) {
-            AJ_ErrPrintf(("AJ_HandleIntrospectRequest(): Failed to generate XML. status=%s", AJ_StatusText(status)));
-            return status;
+        if (obj != &parent) {
+            cached = XMLLenSlot(obj);
+        }
+        if (cached && (cached->obj == obj)) {
+            context.len = cached->len;
+        } else {
+            context.len = 0;
+            status = GenXML(SizeXML, &context.len, obj, objectLists[list]);
+            if (status != AJ_OK) {
+                AJ_ErrPrintf(("AJ_HandleIntrospectRequest(): Failed to generate XML. status=%s", AJ_StatusText(status)));
+                return status;
+            }
+            if (cached) {
+                cached->obj = obj;
+                cached->len = context.len;
+            }
         }
         /*
          * Second pass marshals the XML
@@ -660,7 +715,180 @@ static uint8_t inline MatchPath(const char* path, AJ_Message* msg) {
     return strcmp(path, msg->objPath) == 0;
 }
 
-AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure)
+/*
+ * Index of the method and signal members of the registered object lists. Each slot holds a hash
+ * of the object path, interface and member name and the message id it maps to. The index is
+ * open-addressed with linear probing and is rebuilt lazily whenever the registered object lists
+ * change. Wildcard object paths are hashed as the single character '?' or '!' which is also the
+ * member type character so a lookup probes once for the exact path and once for the wildcard.
+ */
+typedef struct _MsgIndexEntry {
+    uint32_t hash;       /**< Hash of the path, interface and member */
+    uint32_t msgId;      /**< The message id, AJ_INVALID_MSG_ID for an empty slot */
+} MsgIndexEntry;
+
+static MsgIndexEntry msgIndex[AJ_MSG_INDEX_SIZE];
+static const AJ_Object* msgIndexLists[ArraySize(objectLists)];
+
+#define MSG_INDEX_STALE    0
+#define MSG_INDEX_VALID    1
+#define MSG_INDEX_OVERFLOW 2
+
+static uint8_t msgIndexState = MSG_INDEX_STALE;
+
+/*
+ * FNV-1a, the string is terminated by a NUL or a space (for member encodings)
+ */
+static uint32_t HashStr(uint32_t hash, const char* str)
+{
+    while (*str && (*str != ' ')) {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619;
+    }
+    /*
+     * Hash the terminator too so "ab" + "c" differs from "a" + "bc"
+     */
+    hash ^= 0xFF;
+    hash *= 16777619;
+    return hash;
+}
+
+/*
+ * Object paths and interface names tend to share long prefixes and differ near the end so only
+ * the length and the last few characters are hashed. Collisions just cost a confirming compare.
+ */
+#define HASH_TAIL_LEN 12
+
+static uint32_t HashTail(uint32_t hash, const char* str)
+{
+    size_t len = strlen(str);
+
+    hash ^= (uint32_t)len;
+    hash *= 16777619;
+    return HashStr(hash, (len > HASH_TAIL_LEN) ? (str + len - HASH_TAIL_LEN) : str);
+}
+
+/*
+ * The path is hashed last so the interface and member part can be shared by the exact and the
+ * wildcard probes
+ */
+static uint32_t HashMember(const char* iface, const char* member, char mtype)
+{
+    uint32_t hash = 2166136261u;
+
+    hash ^= (uint8_t)mtype;
+    hash *= 16777619;
+    hash = HashTail(hash, iface);
+    return HashStr(hash, member);
+}
+
+static void BuildMsgIndex(void)
+{
+    uint8_t oIndex;
+    uint32_t count = 0;
+
+    memset(msgIndex, 0xFF, sizeof(msgIndex));
+    memcpy(msgIndexLists, objectLists, sizeof(msgIndexLists));
+    msgIndexState = MSG_INDEX_VALID;
+
+    for (oIndex = 0; oIndex < ArraySize(objectLists); ++oIndex) {
+        uint8_t pIndex = 0;
+        const AJ_Object* obj = objectLists[oIndex];
+        if (!obj) {
+            continue;
+        }
+        for (; obj->path; ++pIndex, ++obj) {
+            const AJ_InterfaceDescription* interfaces = obj->interfaces;
+            char wildcard[2] = { 0, 0 };
+            const char* path = obj->path;
+            uint8_t iIndex;
+
+            if ((*path == '?') || (*path == '!')) {
+                wildcard[0] = *path;
+                path = wildcard;
+            }
+            for (iIndex = 0; interfaces && interfaces[iIndex]; ++iIndex) {
+                AJ_InterfaceDescription desc = interfaces[iIndex];
+                const char* intfName = *desc;
+                uint8_t mIndex;
+
+                if ((*intfName == SECURE_TRUE) || (*intfName == SECURE_OFF)) {
+                    ++intfName;
+                }
+                for (mIndex = 0; desc[mIndex + 1]; ++mIndex) {
+                    const char* member = desc[mIndex + 1];
+                    uint32_t hash;
+                    uint32_t slot;
+
+                    if ((*member != '?') && (*member != '!')) {
+                        continue;
+                    }
+                    /*
+                     * Keep the load factor at or below 3/4
+                     */
+                    if (++count > ((AJ_MSG_INDEX_SIZE * 3) / 4)) {
+                        AJ_WarnPrintf(("BuildMsgIndex(): more than %d members, using linear lookup\n", (AJ_MSG_INDEX_SIZE * 3) / 4));
+                        msgIndexState = MSG_INDEX_OVERFLOW;
+                        return;
+                    }
+                    hash = HashTail(HashMember(intfName, member + 1, *member), path);
+                    slot = hash & (AJ_MSG_INDEX_SIZE - 1);
+                    while (msgIndex[slot].msgId != AJ_INVALID_MSG_ID) {
+                        slot = (slot + 1) & (AJ_MSG_INDEX_SIZE - 1);
+                    }
+                    msgIndex[slot].hash = hash;
+                    msgIndex[slot].msgId = (oIndex << 24) | (pIndex << 16) | (iIndex << 8) | mIndex;
+                }
+            }
+        }
+    }
+    AJ_InfoPrintf(("BuildMsgIndex(): indexed %d members\n", count));
+}
+
+/*
+ * Confirms a candidate from the index against the message and returns the member encoding
+ */
+static const char* ConfirmMsgId(uint32_t msgId, AJ_Message* msg)
+{
+    const AJ_Object* obj = &objectLists[msgId >> 24][(uint8_t)(msgId >> 16)];
+    AJ_InterfaceDescription desc = obj->interfaces[(uint8_t)(msgId >> 8)];
+    const char* intfName = *desc;
+
+    if (obj->flags & AJ_OBJ_FLAG_DISABLED) {
+        return NULL;
+    }
+    if ((*intfName == SECURE_TRUE) || (*intfName == SECURE_OFF)) {
+        ++intfName;
+    }
+    if (!MatchPath(obj->path, msg) || (strcmp(intfName, msg->iface) != 0)) {
+        return NULL;
+    }
+    desc += 1 + (uint8_t)msgId;
+    return MatchMember(*desc, msg) ? *desc : NULL;
+}
+
+/*
+ * Probes the index for a hash and returns the lowest matching message id. The object lists are
+ * scanned in message id order so the lowest id is the one a linear scan would have found first.
+ */
+static uint32_t ProbeMsgIndex(uint32_t hash, AJ_Message* msg, uint32_t best, const char** encoding)
+{
+    uint32_t slot = hash & (AJ_MSG_INDEX_SIZE - 1);
+
+    while (msgIndex[slot].msgId != AJ_INVALID_MSG_ID) {
+        if ((msgIndex[slot].hash == hash) && (msgIndex[slot].msgId < best)) {
+            const char* member = ConfirmMsgId(msgIndex[slot].msgId, msg);
+            if (member) {
+                best = msgIndex[slot].msgId;
+                *encoding = member;
+            }
+        }
+        slot = (slot + 1) & (AJ_MSG_INDEX_SIZE - 1);
+    }
+    return best;
+}
+
+static AJ_Status ScanMessageId(AJ_Message* msg, uint8_t* secure)
 {
     uint8_t oIndex = 0;
 
@@ -702,6 +930,36 @@ AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure)
     return AJ_ERR_NO_MATCH;
 }
 
+AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure)
+{
+    uint32_t hash;
+    uint32_t msgId;
+    const char* encoding = NULL;
+    char mtype = (msg->hdr->msgType == AJ_MSG_METHOD_CALL) ? '?' : '!';
+    const char wildcard[2] = { mtype, 0 };
+
+    if ((msgIndexState == MSG_INDEX_STALE) || (memcmp(msgIndexLists, objectLists, sizeof(msgIndexLists)) != 0)) {
+        BuildMsgIndex();
+    }
+    if (msgIndexState == MSG_INDEX_VALID) {
+        hash = HashMember(msg->iface, msg->member, mtype);
+        msgId = ProbeMsgIndex(HashTail(hash, msg->objPath), msg, AJ_INVALID_MSG_ID, &encoding);
+        msgId = ProbeMsgIndex(HashTail(hash, wildcard), msg, msgId, &encoding);
+        if (msgId != AJ_INVALID_MSG_ID) {
+            const AJ_Object* obj = &objectLists[msgId >> 24][(uint8_t)(msgId >> 16)];
+
+            *secure = SecurityApplies(*obj->interfaces[(uint8_t)(msgId >> 8)], obj, objectLists[msgId >> 24]);
+            msg->msgId = msgId;
+            AJ_InfoPrintf(("Identified message %x\n", msg->msgId));
+            return CheckSignature(encoding, msg);
+        }
+    }
+    /*
+     * Object paths can be changed in place by the application so a miss falls back to a full scan
+     */
+    return ScanMessageId(msg, secure);
+}
+
 #ifndef NDEBUG
 /*
  * Validates an index into a NULL terminated array
@@ -903,6 +1161,11 @@ static AJ_Status CheckReturnSignature(AJ_Message* msg, uint32_t msgId)
         AJ_ErrPrintf(("CheckReturnSignature(): status=%s\n", AJ_StatusText(status)));
         return status;
     }
+    /*
+     * The reply id is set even if the reply is rejected so a completion callback can be told
+     * which call failed
+     */
+    msg->msgId = AJ_REPLY_ID(msgId);
     /*
      * Check that if the interface was flagged secure that the reply was encrypted
      */
@@ -915,20 +1178,82 @@ static AJ_Status CheckReturnSignature(AJ_Message* msg, uint32_t msgId)
     if (msg->hdr->msgType != AJ_MSG_ERROR) {
         status = CheckSignature(member, msg);
     }
-    if (status == AJ_OK) {
-        msg->msgId = AJ_REPLY_ID(msgId);
-    }
     return status;
 }
 
-static ReplyContext* FindReplyContext(uint32_t serial) {
-    size_t i;
-    for (i = 0; i < ArraySize(replyContexts); ++i) {
-        if (replyContexts[i].serial == serial) {
-            return &replyContexts[i];
+static uint32_t ReplyNow()
+{
+    AJ_Time start = { 0, 0 };
+    return AJ_GetElapsedTime(&start, FALSE);
+}
+
+static void PlaceReplyContext(uint16_t pos, uint16_t n)
+{
+    replyHeap[pos] = n;
+    REPLY_CONTEXT(n)->heapPos = pos;
+}
+
+static void SiftReplyContext(uint16_t pos)
+{
+    uint16_t n = replyHeap[pos];
+
+    while (pos && REPLY_BEFORE(n, replyHeap[(pos - 1) / 2])) {
+        PlaceReplyContext(pos, replyHeap[(pos - 1) / 2]);
+        pos = (pos - 1) / 2;
+    }
+    while ((2 * pos + 1) < replyCount) {
+        uint16_t child = 2 * pos + 1;
+        if (((child + 1) < replyCount) && REPLY_BEFORE(replyHeap[child + 1], replyHeap[child])) {
+            ++child;
+        }
+        if (!REPLY_BEFORE(replyHeap[child], n)) {
+            break;
         }
+        PlaceReplyContext(pos, replyHeap[child]);
+        pos = child;
     }
-    return NULL;
+    PlaceReplyContext(pos, n);
+}
+
+static uint16_t FindReplyContext(uint32_t serial)
+{
+    uint16_t n = *REPLY_BUCKET(serial);
+
+    while (n && (REPLY_CONTEXT(n)->serial != serial)) {
+        n = REPLY_CONTEXT(n)->next;
+    }
+    return n;
+}
+
+static void FreeReplyContext(uint16_t n)
+{
+    ReplyContext* repCtx = REPLY_CONTEXT(n);
+    uint16_t* link = REPLY_BUCKET(repCtx->serial);
+    uint16_t pos = repCtx->heapPos;
+
+    while (*link != n) {
+        link = &REPLY_CONTEXT(*link)->next;
+    }
+    *link = repCtx->next;
+    /*
+     * Fill the hole in the heap with the last entry
+     */
+    if (pos != --replyCount) {
+        PlaceReplyContext(pos, replyHeap[replyCount]);
+        SiftReplyContext(pos);
+    }
+    memset(repCtx, 0, sizeof(ReplyContext));
+    repCtx->next = replyFree;
+    replyFree = n;
+}
+
+/*
+ * Frees the reply context remembering its completion callback for AJ_TakeReplyHandler()
+ */
+static void CompleteReplyContext(uint16_t n)
+{
+    completedReply = *REPLY_CONTEXT(n);
+    FreeReplyContext(n);
 }
 
 AJ_Status AJ_IdentifyProperty(AJ_Message* msg, const char* iface, const char* prop, uint32_t* propId, const char** sigPtr, uint8_t* secure)
@@ -1031,23 +1356,34 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
             AJ_CloseMsg(msg);
         }
     } else {
-        ReplyContext* repCtx = FindReplyContext(msg->replySerial);
-        if (repCtx) {
-            status = CheckReturnSignature(msg, repCtx->messageId);
+        uint16_t n = FindReplyContext(msg->replySerial);
+        if (n) {
+            status = CheckReturnSignature(msg, REPLY_CONTEXT(n)->messageId);
             /*
              * Release the reply context
              */
-            repCtx->serial = 0;
+            CompleteReplyContext(n);
         }
     }
     return status;
 }
 
+/*
+ * Called whenever the registered objects change in a way that affects the message index or the
+ * generated XML
+ */
+static void InvalidateObjectCaches(void)
+{
+    msgIndexState = MSG_INDEX_STALE;
+    memset(xmlLenCache, 0, sizeof(xmlLenCache));
+}
+
 void AJ_RegisterObjects(const AJ_Object* localObjects, const AJ_Object* proxyObjects)
 {
     AJ_ASSERT(AJ_PRX_ID_FLAG < ArraySize(objectLists));
     objectLists[AJ_APP_ID_FLAG] = localObjects;
     objectLists[AJ_PRX_ID_FLAG] = proxyObjects;
+    InvalidateObjectCaches();
 }
 
 AJ_Status AJ_RegisterObjectList(const AJ_Object* objList, uint8_t index)
@@ -1059,6 +1395,7 @@ AJ_Status AJ_RegisterObjectList(const AJ_Object* objList, uint8_t index)
         return AJ_ERR_RANGE;
     }
     objectLists[index] = objList;
+    InvalidateObjectCaches();
     return AJ_OK;
 }
 
@@ -1079,6 +1416,7 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
         }
     }
     proxyObjects[pIndex].path = objPath;
+    InvalidateObjectCaches();
     return AJ_OK;
 }
 
@@ -1090,15 +1428,28 @@ AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
          */
         return AJ_OK;
     } else {
-        ReplyContext* repCtx = FindReplyContext(0);
+        uint16_t n = replyFree;
 
         AJ_ASSERT(msg->hdr->msgType == AJ_MSG_METHOD_CALL);
 
-        if (repCtx) {
+        if (n) {
+            replyFree = REPLY_CONTEXT(n)->next;
+        } else if (replyHighWater < AJ_NUM_REPLY_CONTEXTS) {
+            n = ++replyHighWater;
+        }
+        if (n) {
+            ReplyContext* repCtx = REPLY_CONTEXT(n);
+            uint16_t* bucket = REPLY_BUCKET(msg->hdr->serialNum);
+
             repCtx->serial = msg->hdr->serialNum;
             repCtx->messageId = msg->msgId;
-            repCtx->timeout = timeout ? timeout : AJ_DEFAULT_REPLY_TIMEOUT;
-            AJ_InitTimer(&repCtx->callTime);
+            repCtx->deadline = ReplyNow() + (timeout ? timeout : AJ_DEFAULT_REPLY_TIMEOUT);
+            repCtx->handler = NULL;
+            repCtx->context = NULL;
+            repCtx->next = *bucket;
+            *bucket = n;
+            replyHeap[replyCount] = n;
+            SiftReplyContext(replyCount++);
             return AJ_OK;
         } else {
             AJ_ErrPrintf(("AJ_AllocReplyContext(): Failed to allocate reply context.  status=AJ_ERR_RESOURCES\n"));
@@ -1107,40 +1458,86 @@ AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
     }
 }
 
+AJ_Status AJ_SetReplyHandler(AJ_Message* msg, AJ_ReplyHandler handler, void* context)
+{
+    uint16_t n = 0;
+
+    if (msg->hdr && (msg->hdr->msgType == AJ_MSG_METHOD_CALL)) {
+        n = FindReplyContext(msg->hdr->serialNum);
+    }
+    if (!n) {
+        AJ_ErrPrintf(("AJ_SetReplyHandler(): No reply context.  status=AJ_ERR_NO_MATCH\n"));
+        return AJ_ERR_NO_MATCH;
+    }
+    REPLY_CONTEXT(n)->handler = handler;
+    REPLY_CONTEXT(n)->context = context;
+    return AJ_OK;
+}
+
+uint8_t AJ_TakeReplyHandler(AJ_Message* msg, AJ_ReplyHandler* handler, void** context)
+{
+    uint8_t found = completedReply.handler && (completedReply.serial == msg->replySerial);
+
+    if (found) {
+        *handler = completedReply.handler;
+        *context = completedReply.context;
+    }
+    memset(&completedReply, 0, sizeof(ReplyContext));
+    return found;
+}
+
 void AJ_ReleaseReplyContext(AJ_Message* msg)
 {
     if (msg->hdr->msgType == AJ_MSG_METHOD_CALL) {
-        ReplyContext* repCtx = FindReplyContext(msg->hdr->serialNum);
-        if (repCtx) {
-            repCtx->serial = 0;
+        uint16_t n = FindReplyContext(msg->hdr->serialNum);
+        if (n) {
+            FreeReplyContext(n);
         }
     }
 }
 
 uint8_t AJ_TimedOutMethodCall(AJ_Message* msg)
 {
-    ReplyContext* repCtx = replyContexts;
-    size_t i;
-    for (i = 0; i < ArraySize(replyContexts); ++i, ++repCtx) {
-        if (repCtx->serial && (AJ_GetElapsedTime(&repCtx->callTime, TRUE) > repCtx->timeout)) {
-            /*
-             * Set the reply serial and message id for the timeout error
-             */
-            msg->replySerial = repCtx->serial;
-            msg->msgId = AJ_REPLY_ID(repCtx->messageId);
-            /*
-             * Release the reply context
-             */
-            repCtx->serial = 0;
-            return TRUE;
-        }
+    ReplyContext* repCtx;
+
+    if (!replyCount) {
+        return FALSE;
     }
-    return FALSE;
+    repCtx = REPLY_CONTEXT(replyHeap[0]);
+    if ((int32_t)(ReplyNow() - repCtx->deadline) < 0) {
+        return FALSE;
+    }
+    /*
+     * Set the reply serial and message id for the timeout error
+     */
+    msg->replySerial = repCtx->serial;
+    msg->msgId = AJ_REPLY_ID(repCtx->messageId);
+    /*
+     * Release the reply context
+     */
+    CompleteReplyContext(replyHeap[0]);
+    return TRUE;
+}
+
+uint32_t AJ_NextReplyTimeout(void)
+{
+    int32_t remain;
+
+    if (!replyCount) {
+        return (uint32_t) -1;
+    }
+    remain = (int32_t)(REPLY_CONTEXT(replyHeap[0])->deadline - ReplyNow());
+    return (remain > 0) ? (uint32_t)remain : 0;
 }
 
 void AJ_ReleaseReplyContexts(void)
 {
     memset(replyContexts, 0, sizeof(replyContexts));
+    memset(replyBuckets, 0, sizeof(replyBuckets));
+    memset(&completedReply, 0, sizeof(completedReply));
+    replyCount = 0;
+    replyFree = 0;
+    replyHighWater = 0;
 }
 
 AJ_Status AJ_SetObjectFlags(const char* objPath, uint8_t setFlags, uint8_t clearFlags)
@@ -1162,6 +1559,9 @@ AJ_Status AJ_SetObjectFlags(const char* objPath, uint8_t setFlags, uint8_t clear
             ++list;
         }
     }
+    if (status == AJ_OK) {
+        InvalidateObjectCaches();
+    }
     return status;
 }
 
@@ -338,6 +338,52 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
  */
 AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout);
 
+/**
+ * Callback function prototype for a method call completion callback. The reply is closed when the
+ * callback returns.
+ *
+ * @param reply    The method reply or error message. If the call timed out, or the reply was
+ *                 rejected, this is an internal error message with no body.
+ * @param context  The context pointer passed to AJ_SetReplyHandler()
+ * @param status   Why the call completed
+ *                 - AJ_OK if the reply was received
+ *                 - AJ_ERR_TIMEOUT if the call timed out, the error name is org.alljoyn.Bus.Timeout
+ *                 - AJ_ERR_SIGNATURE or another error that made AJ_UnmarshalMsg() discard the
+ *                   reply, the error name is org.alljoyn.Bus.Rejected
+ *                 - AJ_ERR_SECURITY if the reply should have been encrypted, the error name is
+ *                   org.alljoyn.Bus.SecurityViolation
+ */
+typedef void (*AJ_ReplyHandler)(AJ_Message* reply, void* context, AJ_Status status);
+
+/**
+ * Set a completion callback for a method call. Replies to a call with a completion callback are
+ * passed to the callback from inside AJ_UnmarshalMsg() and are not returned to the application,
+ * so many calls can be kept in flight without the application matching each reply. Call this
+ * after AJ_MarshalMethodCall() and before the message is delivered.
+ *
+ * @param msg      The method call message
+ * @param handler  The callback to run when the reply arrives or the call times out
+ * @param context  A context pointer passed to the callback
+ *
+ * @return   Return AJ_Status
+ *         - AJ_OK if the completion callback was set
+ *         - AJ_ERR_NO_MATCH if the message is not a method call expecting a reply
+ */
+AJ_EXPORT
+AJ_Status AJ_SetReplyHandler(AJ_Message* msg, AJ_ReplyHandler handler, void* context);
+
+/**
+ * Internal function to get the completion callback for a reply that has just been unmarshaled or
+ * a method call that has just timed out. The callback is only returned once.
+ *
+ * @param msg      The reply message
+ * @param handler  Returns the completion callback
+ * @param context  Returns the context pointer for the completion callback
+ *
+ * @return  Returns TRUE if there is a completion callback for the reply, FALSE otherwise.
+ */
+uint8_t AJ_TakeReplyHandler(AJ_Message* msg, AJ_ReplyHandler* handler, void** context);
+
 /**
  * Internal function to release all reply contexts. Called when disconnecting from the bus.
  */
@@ -354,6 +400,14 @@ void AJ_ReleaseReplyContexts(void);
  */
 uint8_t AJ_TimedOutMethodCall(AJ_Message* msg);
 
+/**
+ * Internal function to get the time until the next method call times out.
+ *
+ * @return  The number of milliseconds until the next method call times out, 0 if a method call has
+ *          timed out, (uint32_t)-1 if no method calls are waiting for a reply.
+ */
+uint32_t AJ_NextReplyTimeout(void);
+
 /**
  * Internal function called to release a reply context in the case that a message could not be marshaled.
  *
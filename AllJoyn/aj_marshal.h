@@ -0,0 +1,566 @@
+#ifndef _AJ_MARSHAL_H
+#define _AJ_MARSHAL_H
+/**
+ * @file aj_marshal.h
+ * @defgroup aj_marshal Typed Message Marshalling
+ * @{
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Marshals message arguments from their C++ types. The signature and the wire layout of each
+ * argument come from its type at compile time so nothing is parsed at run time: the types are
+ * checked against the message signature, the exact number of bytes including padding is worked
+ * out, and the arguments are then written straight into the TX buffer. Structs, dictionary entries,
+ * arrays and variants can be nested to any depth.
+ *
+ * Argument types and the signature they marshal as:
+ *
+ *   uint8_t 'y', bool 'b', int16_t 'n', uint16_t 'q', int32_t 'i', uint32_t 'u', int64_t 'x',
+ *   uint64_t 't', double 'd', const char* 's', AJ_ObjPathArg 'o', AJ_SignatureArg 'g',
+ *   AJ_ArrayOf<T> 'a', AJ_StructOf<...> '(...)', AJ_DictEntryOf<K, V> '{KV}', AJ_VariantOf<T> 'v'
+ *
+ * For example to marshal the arguments of a method with signature "qsa{sv}"
+ * @code
+ *   AJ_DictEntryOf<const char*, AJ_VariantOf<uint32_t> > props[] = { { "Rate", { 9600 } }, { "Bits", { 8 } } };
+ *   AJ_ArrayOf<AJ_DictEntryOf<const char*, AJ_VariantOf<uint32_t> > > propArray = { props, ArraySize(props) };
+ *   status = AJ_Marshal(&msg, (uint16_t)1, "serial", propArray);
+ * @endcode
+ *
+ * The arguments must all fit in the TX buffer and can be marshalled into a message before or
+ * after arguments marshalled with AJ_MarshalArgs() but not inside a container opened with
+ * AJ_MarshalContainer(). Strings must not be NULL.
+ *
+ * Other types can be marshalled by specializing AJ_MarshalTraits.
+ */
+
+#include "aj_target.h"
+#include "aj_status.h"
+#include "aj_debug.h"
+#include "aj_msg.h"
+#include "aj_bufio.h"
+#include "aj_introspect.h"
+
+/**
+ * An object path argument
+ */
+typedef struct _AJ_ObjPathArg {
+    const char* path;   /**< The object path */
+} AJ_ObjPathArg;
+
+/**
+ * A signature argument
+ */
+typedef struct _AJ_SignatureArg {
+    const char* sig;    /**< The signature */
+} AJ_SignatureArg;
+
+/**
+ * An array argument
+ */
+template <typename T>
+struct AJ_ArrayOf {
+    const T* elems;     /**< The array elements */
+    size_t count;       /**< The number of elements */
+};
+
+/**
+ * A variant argument
+ */
+template <typename T>
+struct AJ_VariantOf {
+    T val;              /**< The value in the variant */
+};
+
+/**
+ * A dictionary entry argument
+ */
+template <typename K, typename V>
+struct AJ_DictEntryOf {
+    K key;              /**< The key, must be a basic type */
+    V val;              /**< The value */
+};
+
+/**
+ * Placeholder for unused struct members
+ */
+typedef struct _AJ_NoArg {
+} AJ_NoArg;
+
+/**
+ * A struct argument with up to eight members
+ */
+template <typename A, typename B = AJ_NoArg, typename C = AJ_NoArg, typename D = AJ_NoArg,
+          typename E = AJ_NoArg, typename F = AJ_NoArg, typename G = AJ_NoArg, typename H = AJ_NoArg>
+struct AJ_StructOf {
+    A m1;               /**< First member */
+    B m2;               /**< Second member */
+    C m3;               /**< Third member */
+    D m4;               /**< Fourth member */
+    E m5;               /**< Fifth member */
+    F m6;               /**< Sixth member */
+    G m7;               /**< Seventh member */
+    H m8;               /**< Eighth member */
+};
+
+/**
+ * Offset after padding offset to a multiple of align
+ */
+#define AJ_MARSHAL_ALIGN(offset, align) (((offset) + (align) - 1) & ~((size_t)(align) - 1))
+
+/**
+ * Writes the pad bytes to align p, base is the start of the buffer
+ */
+inline uint8_t* AJ_MarshalPad(uint8_t* base, uint8_t* p, size_t align)
+{
+    uint8_t* aligned = base + AJ_MARSHAL_ALIGN((size_t)(p - base), align);
+    while (p < aligned) {
+        *p++ = 0;
+    }
+    return p;
+}
+
+/**
+ * Describes how a type is marshalled. Specializations provide:
+ *
+ *   sigLen                     Length of the signature for the type
+ *   Sig(s)                     Writes the signature to s returning the end
+ *   Match(s)                   Returns s advanced past the signature for the type, NULL if s does not match
+ *   Size(offset, v)            Returns the offset after marshalling v at offset
+ *   Write(base, p, v)          Writes v at p returning the end, space has already been checked
+ */
+template <typename T>
+struct AJ_MarshalTraits;
+
+/**
+ * Traits for scalar types
+ */
+template <typename T, char TypeId>
+struct AJ_ScalarTraits {
+    enum { sigLen = 1 };
+    static char* Sig(char* s) { *s = TypeId; return s + 1; }
+    static const char* Match(const char* s) { return (*s == TypeId) ? s + 1 : NULL; }
+    static size_t Size(size_t offset, const T&) { return AJ_MARSHAL_ALIGN(offset, sizeof(T)) + sizeof(T); }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const T& v)
+    {
+        p = AJ_MarshalPad(base, p, sizeof(T));
+        memcpy(p, &v, sizeof(T));
+        return p + sizeof(T);
+    }
+    /*
+     * Arrays of scalars are copied in one go
+     */
+    static size_t SizeArray(size_t offset, const T*, size_t count) { return offset + count * sizeof(T); }
+    static uint8_t* WriteArray(uint8_t*, uint8_t* p, const T* elems, size_t count)
+    {
+        memcpy(p, elems, count * sizeof(T));
+        return p + count * sizeof(T);
+    }
+    enum { elemAlign = sizeof(T) };
+};
+
+template <> struct AJ_MarshalTraits<uint8_t> : AJ_ScalarTraits<uint8_t, AJ_ARG_BYTE> { };
+template <> struct AJ_MarshalTraits<int16_t> : AJ_ScalarTraits<int16_t, AJ_ARG_INT16> { };
+template <> struct AJ_MarshalTraits<uint16_t> : AJ_ScalarTraits<uint16_t, AJ_ARG_UINT16> { };
+template <> struct AJ_MarshalTraits<int32_t> : AJ_ScalarTraits<int32_t, AJ_ARG_INT32> { };
+template <> struct AJ_MarshalTraits<uint32_t> : AJ_ScalarTraits<uint32_t, AJ_ARG_UINT32> { };
+template <> struct AJ_MarshalTraits<int64_t> : AJ_ScalarTraits<int64_t, AJ_ARG_INT64> { };
+template <> struct AJ_MarshalTraits<uint64_t> : AJ_ScalarTraits<uint64_t, AJ_ARG_UINT64> { };
+template <> struct AJ_MarshalTraits<double> : AJ_ScalarTraits<double, AJ_ARG_DOUBLE> { };
+
+/**
+ * A boolean is 4 bytes on the wire
+ */
+template <>
+struct AJ_MarshalTraits<bool> {
+    enum { sigLen = 1, elemAlign = 0 };
+    static char* Sig(char* s) { *s = AJ_ARG_BOOLEAN; return s + 1; }
+    static const char* Match(const char* s) { return (*s == AJ_ARG_BOOLEAN) ? s + 1 : NULL; }
+    static size_t Size(size_t offset, const bool&) { return AJ_MARSHAL_ALIGN(offset, 4) + 4; }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const bool& v)
+    {
+        uint32_t b = v ? 1 : 0;
+        p = AJ_MarshalPad(base, p, 4);
+        memcpy(p, &b, 4);
+        return p + 4;
+    }
+};
+
+/**
+ * Traits for strings and object paths which have a 4 byte length, and signatures which have a 1 byte
+ * length
+ */
+template <char TypeId, size_t LenSize>
+struct AJ_StringTraits {
+    enum { sigLen = 1, elemAlign = 0 };
+    static char* Sig(char* s) { *s = TypeId; return s + 1; }
+    static const char* Match(const char* s) { return (*s == TypeId) ? s + 1 : NULL; }
+    static size_t Size(size_t offset, const char* str) { return AJ_MARSHAL_ALIGN(offset, LenSize) + LenSize + strlen(str) + 1; }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const char* str)
+    {
+        uint32_t len = (uint32_t)strlen(str);
+        p = AJ_MarshalPad(base, p, LenSize);
+        if (LenSize == 1) {
+            *p = (uint8_t)len;
+        } else {
+            memcpy(p, &len, 4);
+        }
+        p += LenSize;
+        memcpy(p, str, len + 1);
+        return p + len + 1;
+    }
+};
+
+template <> struct AJ_MarshalTraits<const char*> : AJ_StringTraits<AJ_ARG_STRING, 4> { };
+template <> struct AJ_MarshalTraits<char*> : AJ_StringTraits<AJ_ARG_STRING, 4> { };
+
+template <>
+struct AJ_MarshalTraits<AJ_ObjPathArg> {
+    typedef AJ_StringTraits<AJ_ARG_OBJ_PATH, 4> Str;
+    enum { sigLen = 1, elemAlign = 0 };
+    static char* Sig(char* s) { return Str::Sig(s); }
+    static const char* Match(const char* s) { return Str::Match(s); }
+    static size_t Size(size_t offset, const AJ_ObjPathArg& v) { return Str::Size(offset, v.path); }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const AJ_ObjPathArg& v) { return Str::Write(base, p, v.path); }
+};
+
+template <>
+struct AJ_MarshalTraits<AJ_SignatureArg> {
+    typedef AJ_StringTraits<AJ_ARG_SIGNATURE, 1> Str;
+    enum { sigLen = 1, elemAlign = 0 };
+    static char* Sig(char* s) { return Str::Sig(s); }
+    static const char* Match(const char* s) { return Str::Match(s); }
+    static size_t Size(size_t offset, const AJ_SignatureArg& v) { return Str::Size(offset, v.sig); }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const AJ_SignatureArg& v) { return Str::Write(base, p, v.sig); }
+};
+
+/**
+ * Unused struct members marshal to nothing
+ */
+template <>
+struct AJ_MarshalTraits<AJ_NoArg> {
+    enum { sigLen = 0, elemAlign = 0 };
+    static char* Sig(char* s) { return s; }
+    static const char* Match(const char* s) { return s; }
+    static size_t Size(size_t offset, const AJ_NoArg&) { return offset; }
+    static uint8_t* Write(uint8_t*, uint8_t* p, const AJ_NoArg&) { return p; }
+};
+
+/**
+ * Array elements that are not scalars are marshalled one at a time
+ */
+template <typename T, bool Scalar>
+struct AJ_ArrayElems {
+    static size_t Size(size_t offset, const T* elems, size_t count)
+    {
+        while (count--) {
+            offset = AJ_MarshalTraits<T>::Size(offset, *elems++);
+        }
+        return offset;
+    }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const T* elems, size_t count)
+    {
+        while (count--) {
+            p = AJ_MarshalTraits<T>::Write(base, p, *elems++);
+        }
+        return p;
+    }
+};
+
+template <typename T>
+struct AJ_ArrayElems<T, true> {
+    static size_t Size(size_t offset, const T* elems, size_t count) { return AJ_MarshalTraits<T>::SizeArray(offset, elems, count); }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const T* elems, size_t count) { return AJ_MarshalTraits<T>::WriteArray(base, p, elems, count); }
+};
+
+/**
+ * Alignment of the first element of a type, arrays are padded to this after the length
+ */
+template <typename T>
+struct AJ_MarshalAlign {
+    enum { align = ((AJ_MarshalTraits<T>::elemAlign != 0) ? AJ_MarshalTraits<T>::elemAlign : 1) };
+};
+
+template <> struct AJ_MarshalAlign<bool> { enum { align = 4 }; };
+template <> struct AJ_MarshalAlign<const char*> { enum { align = 4 }; };
+template <> struct AJ_MarshalAlign<char*> { enum { align = 4 }; };
+template <> struct AJ_MarshalAlign<AJ_ObjPathArg> { enum { align = 4 }; };
+template <typename T> struct AJ_MarshalAlign<AJ_ArrayOf<T> > { enum { align = 4 }; };
+template <typename K, typename V> struct AJ_MarshalAlign<AJ_DictEntryOf<K, V> > { enum { align = 8 }; };
+template <typename A, typename B, typename C, typename D, typename E, typename F, typename G, typename H>
+struct AJ_MarshalAlign<AJ_StructOf<A, B, C, D, E, F, G, H> > { enum { align = 8 }; };
+
+template <typename T>
+struct AJ_MarshalTraits<AJ_ArrayOf<T> > {
+    typedef AJ_ArrayElems<T, (AJ_MarshalTraits<T>::elemAlign != 0)> Elems;
+    enum { sigLen = 1 + AJ_MarshalTraits<T>::sigLen, elemAlign = 0 };
+    static char* Sig(char* s) { *s = AJ_ARG_ARRAY; return AJ_MarshalTraits<T>::Sig(s + 1); }
+    static const char* Match(const char* s) { return (*s == AJ_ARG_ARRAY) ? AJ_MarshalTraits<T>::Match(s + 1) : NULL; }
+    static size_t Size(size_t offset, const AJ_ArrayOf<T>& v)
+    {
+        offset = AJ_MARSHAL_ALIGN(offset, 4) + 4;
+        offset = AJ_MARSHAL_ALIGN(offset, AJ_MarshalAlign<T>::align);
+        return Elems::Size(offset, v.elems, v.count);
+    }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const AJ_ArrayOf<T>& v)
+    {
+        uint8_t* lenPtr = AJ_MarshalPad(base, p, 4);
+        uint8_t* elems = AJ_MarshalPad(base, lenPtr + 4, AJ_MarshalAlign<T>::align);
+        /*
+         * The length does not include the padding between the length and the first element
+         */
+        uint32_t len;
+        p = Elems::Write(base, elems, v.elems, v.count);
+        len = (uint32_t)(p - elems);
+        memcpy(lenPtr, &len, 4);
+        return p;
+    }
+};
+
+template <typename T>
+struct AJ_MarshalTraits<AJ_VariantOf<T> > {
+    enum { sigLen = 1, elemAlign = 0 };
+    static char* Sig(char* s) { *s = AJ_ARG_VARIANT; return s + 1; }
+    static const char* Match(const char* s) { return (*s == AJ_ARG_VARIANT) ? s + 1 : NULL; }
+    static size_t Size(size_t offset, const AJ_VariantOf<T>& v)
+    {
+        return AJ_MarshalTraits<T>::Size(offset + AJ_MarshalTraits<T>::sigLen + 2, v.val);
+    }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const AJ_VariantOf<T>& v)
+    {
+        *p++ = (uint8_t)AJ_MarshalTraits<T>::sigLen;
+        p = (uint8_t*)AJ_MarshalTraits<T>::Sig((char*)p);
+        *p++ = 0;
+        return AJ_MarshalTraits<T>::Write(base, p, v.val);
+    }
+};
+
+template <typename K, typename V>
+struct AJ_MarshalTraits<AJ_DictEntryOf<K, V> > {
+    enum { sigLen = 2 + AJ_MarshalTraits<K>::sigLen + AJ_MarshalTraits<V>::sigLen, elemAlign = 0 };
+    static char* Sig(char* s)
+    {
+        *s = AJ_ARG_DICT_ENTRY;
+        s = AJ_MarshalTraits<V>::Sig(AJ_MarshalTraits<K>::Sig(s + 1));
+        *s = AJ_DICT_ENTRY_CLOSE;
+        return s + 1;
+    }
+    static const char* Match(const char* s)
+    {
+        if (*s++ != AJ_ARG_DICT_ENTRY) {
+            return NULL;
+        }
+        s = AJ_MarshalTraits<K>::Match(s);
+        s = s ? AJ_MarshalTraits<V>::Match(s) : NULL;
+        return (s && (*s == AJ_DICT_ENTRY_CLOSE)) ? s + 1 : NULL;
+    }
+    static size_t Size(size_t offset, const AJ_DictEntryOf<K, V>& v)
+    {
+        offset = AJ_MarshalTraits<K>::Size(AJ_MARSHAL_ALIGN(offset, 8), v.key);
+        return AJ_MarshalTraits<V>::Size(offset, v.val);
+    }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const AJ_DictEntryOf<K, V>& v)
+    {
+        p = AJ_MarshalTraits<K>::Write(base, AJ_MarshalPad(base, p, 8), v.key);
+        return AJ_MarshalTraits<V>::Write(base, p, v.val);
+    }
+};
+
+template <typename A, typename B, typename C, typename D, typename E, typename F, typename G, typename H>
+struct AJ_MarshalTraits<AJ_StructOf<A, B, C, D, E, F, G, H> > {
+    typedef AJ_StructOf<A, B, C, D, E, F, G, H> Struct;
+    enum { membersLen = AJ_MarshalTraits<A>::sigLen + AJ_MarshalTraits<B>::sigLen + AJ_MarshalTraits<C>::sigLen +
+                        AJ_MarshalTraits<D>::sigLen + AJ_MarshalTraits<E>::sigLen + AJ_MarshalTraits<F>::sigLen +
+                        AJ_MarshalTraits<G>::sigLen + AJ_MarshalTraits<H>::sigLen };
+    enum { sigLen = 2 + membersLen, elemAlign = 0 };
+    static char* Sig(char* s)
+    {
+        *s++ = AJ_ARG_STRUCT;
+        s = AJ_MarshalTraits<A>::Sig(s);
+        s = AJ_MarshalTraits<B>::Sig(s);
+        s = AJ_MarshalTraits<C>::Sig(s);
+        s = AJ_MarshalTraits<D>::Sig(s);
+        s = AJ_MarshalTraits<E>::Sig(s);
+        s = AJ_MarshalTraits<F>::Sig(s);
+        s = AJ_MarshalTraits<G>::Sig(s);
+        s = AJ_MarshalTraits<H>::Sig(s);
+        *s = AJ_STRUCT_CLOSE;
+        return s + 1;
+    }
+    static const char* MatchMembers(const char* s)
+    {
+        s = AJ_MarshalTraits<A>::Match(s);
+        s = s ? AJ_MarshalTraits<B>::Match(s) : NULL;
+        s = s ? AJ_MarshalTraits<C>::Match(s) : NULL;
+        s = s ? AJ_MarshalTraits<D>::Match(s) : NULL;
+        s = s ? AJ_MarshalTraits<E>::Match(s) : NULL;
+        s = s ? AJ_MarshalTraits<F>::Match(s) : NULL;
+        s = s ? AJ_MarshalTraits<G>::Match(s) : NULL;
+        return s ? AJ_MarshalTraits<H>::Match(s) : NULL;
+    }
+    static const char* Match(const char* s)
+    {
+        if (*s != AJ_ARG_STRUCT) {
+            return NULL;
+        }
+        s = MatchMembers(s + 1);
+        return (s && (*s == AJ_STRUCT_CLOSE)) ? s + 1 : NULL;
+    }
+    static size_t SizeMembers(size_t offset, const Struct& v)
+    {
+        offset = AJ_MarshalTraits<A>::Size(offset, v.m1);
+        offset = AJ_MarshalTraits<B>::Size(offset, v.m2);
+        offset = AJ_MarshalTraits<C>::Size(offset, v.m3);
+        offset = AJ_MarshalTraits<D>::Size(offset, v.m4);
+        offset = AJ_MarshalTraits<E>::Size(offset, v.m5);
+        offset = AJ_MarshalTraits<F>::Size(offset, v.m6);
+        offset = AJ_MarshalTraits<G>::Size(offset, v.m7);
+        return AJ_MarshalTraits<H>::Size(offset, v.m8);
+    }
+    static size_t Size(size_t offset, const Struct& v)
+    {
+        return SizeMembers(AJ_MARSHAL_ALIGN(offset, 8), v);
+    }
+    static uint8_t* WriteMembers(uint8_t* base, uint8_t* p, const Struct& v)
+    {
+        p = AJ_MarshalTraits<A>::Write(base, p, v.m1);
+        p = AJ_MarshalTraits<B>::Write(base, p, v.m2);
+        p = AJ_MarshalTraits<C>::Write(base, p, v.m3);
+        p = AJ_MarshalTraits<D>::Write(base, p, v.m4);
+        p = AJ_MarshalTraits<E>::Write(base, p, v.m5);
+        p = AJ_MarshalTraits<F>::Write(base, p, v.m6);
+        p = AJ_MarshalTraits<G>::Write(base, p, v.m7);
+        return AJ_MarshalTraits<H>::Write(base, p, v.m8);
+    }
+    static uint8_t* Write(uint8_t* base, uint8_t* p, const Struct& v)
+    {
+        return WriteMembers(base, AJ_MarshalPad(base, p, 8), v);
+    }
+};
+
+/**
+ * Marshals the members of a struct as top level message arguments, that is without the struct
+ * alignment or delimiters.
+ *
+ * @param msg   The message being marshalled
+ * @param args  The arguments
+ *
+ * @return  - AJ_OK if the arguments were marshalled
+ *          - AJ_ERR_UNEXPECTED if a container or variant is open or the message is being delivered in parts
+ *          - AJ_ERR_SIGNATURE if the arguments do not match the message signature
+ *          - AJ_ERR_RESOURCES if the arguments do not fit in the TX buffer
+ */
+template <typename S>
+AJ_Status AJ_MarshalMembers(AJ_Message* msg, const S& args)
+{
+    typedef AJ_MarshalTraits<S> Traits;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    uint8_t* argStart = ioBuf->writePtr;
+    size_t end;
+
+    if (!msg->hdr || msg->outer || msg->varOffset) {
+        AJ_ErrPrintf(("AJ_MarshalMembers(): AJ_ERR_UNEXPECTED\n"));
+        AJ_ReleaseReplyContext(msg);
+        return AJ_ERR_UNEXPECTED;
+    }
+    if (!Traits::MatchMembers(msg->signature + msg->sigOffset)) {
+        AJ_ErrPrintf(("AJ_MarshalMembers(): AJ_ERR_SIGNATURE\n"));
+        AJ_ReleaseReplyContext(msg);
+        return AJ_ERR_SIGNATURE;
+    }
+    end = Traits::SizeMembers((size_t)(argStart - ioBuf->bufStart), args);
+    if (end > ioBuf->bufSize) {
+        AJ_ErrPrintf(("AJ_MarshalMembers(): AJ_ERR_RESOURCES\n"));
+        AJ_ReleaseReplyContext(msg);
+        return AJ_ERR_RESOURCES;
+    }
+    ioBuf->writePtr = Traits::WriteMembers(ioBuf->bufStart, argStart, args);
+    msg->bodyBytes += (uint16_t)(ioBuf->writePtr - argStart);
+    msg->sigOffset += (uint8_t)Traits::membersLen;
+    return AJ_OK;
+}
+
+/**
+ * String literals are marshalled as strings
+ */
+template <typename T> struct AJ_MarshalArgType { typedef T Type; };
+template <size_t N> struct AJ_MarshalArgType<char[N]> { typedef const char* Type; };
+template <size_t N> struct AJ_MarshalArgType<const char[N]> { typedef const char* Type; };
+
+/**
+ * Marshals one or more arguments, see AJ_MarshalMembers() for the return values.
+ */
+template <typename A>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type> args = { a, {}, {}, {}, {}, {}, {}, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type> args = { a, b, {}, {}, {}, {}, {}, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B, typename C>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b, const C& c)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type, typename AJ_MarshalArgType<C>::Type> args = { a, b, c, {}, {}, {}, {}, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B, typename C, typename D>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b, const C& c, const D& d)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type, typename AJ_MarshalArgType<C>::Type, typename AJ_MarshalArgType<D>::Type> args = { a, b, c, d, {}, {}, {}, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B, typename C, typename D, typename E>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b, const C& c, const D& d, const E& e)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type, typename AJ_MarshalArgType<C>::Type, typename AJ_MarshalArgType<D>::Type, typename AJ_MarshalArgType<E>::Type> args = { a, b, c, d, e, {}, {}, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B, typename C, typename D, typename E, typename F>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b, const C& c, const D& d, const E& e, const F& f)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type, typename AJ_MarshalArgType<C>::Type, typename AJ_MarshalArgType<D>::Type, typename AJ_MarshalArgType<E>::Type, typename AJ_MarshalArgType<F>::Type> args = { a, b, c, d, e, f, {}, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B, typename C, typename D, typename E, typename F, typename G>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b, const C& c, const D& d, const E& e, const F& f, const G& g)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type, typename AJ_MarshalArgType<C>::Type, typename AJ_MarshalArgType<D>::Type, typename AJ_MarshalArgType<E>::Type, typename AJ_MarshalArgType<F>::Type, typename AJ_MarshalArgType<G>::Type> args = { a, b, c, d, e, f, g, {} };
+    return AJ_MarshalMembers(msg, args);
+}
+
+template <typename A, typename B, typename C, typename D, typename E, typename F, typename G, typename H>
+AJ_Status AJ_Marshal(AJ_Message* msg, const A& a, const B& b, const C& c, const D& d, const E& e, const F& f, const G& g, const H& h)
+{
+    AJ_StructOf<typename AJ_MarshalArgType<A>::Type, typename AJ_MarshalArgType<B>::Type, typename AJ_MarshalArgType<C>::Type, typename AJ_MarshalArgType<D>::Type, typename AJ_MarshalArgType<E>::Type, typename AJ_MarshalArgType<F>::Type, typename AJ_MarshalArgType<G>::Type, typename AJ_MarshalArgType<H>::Type> args = { a, b, c, d, e, f, g, h };
+    return AJ_MarshalMembers(msg, args);
+}
+
+/**
+ * @}
+ */
+#endif
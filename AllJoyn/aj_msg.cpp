@@ -48,9 +48,6 @@
 uint8_t dbgMSG = 0;
 #endif
 
-#define AJ_STRUCT_CLOSE          ')'
-#define AJ_DICT_ENTRY_CLOSE      '}'
-
 /*
  * The size of the MAC for encrypted messages
  */
@@ -282,35 +279,72 @@ static void InitNonce(AJ_Message* msg, uint8_t role, uint8_t* nonce)
     nonce[4] = (uint8_t)(serial);
 }
 
-static AJ_Status DecryptMessage(AJ_Message* msg)
+/*
+ * Looks up the key schedule and builds the nonce for decrypting a received message
+ */
+static AJ_Status GetRxKey(AJ_Message* msg, const AJ_AES_Key** key, uint8_t* nonce)
 {
-    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
     AJ_Status status;
-    uint8_t key[16];
-    uint8_t nonce[5];
     uint8_t role = AJ_ROLE_KEY_UNDEFINED;
-    uint32_t mlen = MessageLen(msg);
-    uint32_t hLen = mlen - msg->hdr->bodyLen;
 
     /*
      * Use the group key for multicast and broadcast signals the session key otherwise.
      */
     if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
-        status = AJ_GetGroupKey(msg->sender, key);
+        status = AJ_GetGroupKeySchedule(msg->sender, key);
     } else {
-        status = AJ_GetSessionKey(msg->sender, key, &role);
+        status = AJ_GetSessionKeySchedule(msg->sender, key, &role);
         /*
          * We use the oppsite role when decrypting.
          */
         role ^= 3;
     }
     if (status != AJ_OK) {
-        AJ_ErrPrintf(("DecryptMessage(): AJ_ERR_SECURITY\n"));
-        status = AJ_ERR_SECURITY;
+        AJ_ErrPrintf(("GetRxKey(): AJ_ERR_SECURITY\n"));
+        return AJ_ERR_SECURITY;
+    }
+    InitNonce(msg, role, nonce);
+    return AJ_OK;
+}
+
+/*
+ * Looks up the key schedule and builds the nonce for encrypting a message to send
+ */
+static AJ_Status GetTxKey(AJ_Message* msg, const AJ_AES_Key** key, uint8_t* nonce)
+{
+    AJ_Status status;
+    uint8_t role = AJ_ROLE_KEY_UNDEFINED;
+
+    /*
+     * Use the group key for multicast and broadcast signals the session key otherwise.
+     */
+    if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
+        status = AJ_GetGroupKeySchedule(NULL, key);
     } else {
-        InitNonce(msg, role, nonce);
+        status = AJ_GetSessionKeySchedule(msg->destination, key, &role);
+    }
+    if (status != AJ_OK) {
+        AJ_ErrPrintf(("GetTxKey(): peer %s not authenticated", msg->destination));
+        AJ_ErrPrintf(("GetTxKey(): AJ_ERR_SECURITY\n"));
+        return AJ_ERR_SECURITY;
+    }
+    InitNonce(msg, role, nonce);
+    return AJ_OK;
+}
+
+static AJ_Status DecryptMessage(AJ_Message* msg)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    AJ_Status status;
+    const AJ_AES_Key* key;
+    uint8_t nonce[5];
+    uint32_t mlen = MessageLen(msg);
+    uint32_t hLen = mlen - msg->hdr->bodyLen;
+
+    status = GetRxKey(msg, &key, nonce);
+    if (status == AJ_OK) {
         EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
-        status = AJ_Decrypt_CCM(key, ioBuf->bufStart, mlen - MAC_LENGTH, hLen, MAC_LENGTH, nonce, sizeof(nonce));
+        status = AJ_Decrypt_CCM_Expanded(key, ioBuf->bufStart, mlen - MAC_LENGTH, hLen, MAC_LENGTH, nonce, sizeof(nonce));
         EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
     }
     return status;
@@ -320,9 +354,8 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
 {
     AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
     AJ_Status status;
-    uint8_t key[16];
+    const AJ_AES_Key* key;
     uint8_t nonce[5];
-    uint8_t role = AJ_ROLE_KEY_UNDEFINED;
     uint32_t mlen = MessageLen(msg);
     uint32_t hlen = mlen - msg->hdr->bodyLen;
 
@@ -335,21 +368,65 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
     }
     msg->hdr->bodyLen += MAC_LENGTH;
     ioBuf->writePtr += MAC_LENGTH;
-    /*
-     * Use the group key for multicast and broadcast signals the session key otherwise.
-     */
-    if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
-        status = AJ_GetGroupKey(NULL, key);
-    } else {
-        status = AJ_GetSessionKey(msg->destination, key, &role);
+    status = GetTxKey(msg, &key, nonce);
+    if (status == AJ_OK) {
+        status = AJ_Encrypt_CCM_Expanded(key, ioBuf->bufStart, mlen, hlen, MAC_LENGTH, nonce, sizeof(nonce));
     }
-    if (status != AJ_OK) {
-        AJ_ErrPrintf(("EncryptMesssage(): peer %s not authenticated", msg->destination));
-        AJ_ErrPrintf(("EncryptMessage(): AJ_ERR_SECURITY\n"));
-        status = AJ_ERR_SECURITY;
-    } else {
-        InitNonce(msg, role, nonce);
-        status = AJ_Encrypt_CCM(key, ioBuf->bufStart, mlen, hlen, MAC_LENGTH, nonce, sizeof(nonce));
+    return status;
+}
+
+/*
+ * State for encrypting a message that is being delivered in several pieces. Bytes in the tx
+ * buffer before txPlain have already been encrypted.
+ */
+static AJ_CCM_Context txCCM;
+static uint8_t* txPlain = NULL;
+
+static void EncryptTx(AJ_IOBuffer* ioBuf)
+{
+    if (txPlain && (ioBuf->writePtr > txPlain)) {
+        AJ_CCM_Update(&txCCM, txPlain, txPlain, (uint32_t)(ioBuf->writePtr - txPlain));
+        txPlain = ioBuf->writePtr;
+    }
+}
+
+/*
+ * Messages held back by coalescing stay in the tx buffer between readPtr and bufStart. The start
+ * of the buffer is moved past them so the next message is marshalled and encrypted exactly as if
+ * it was at the start of an empty buffer.
+ */
+#define TX_HELD(ioBuf) ((ioBuf)->readPtr < (ioBuf)->bufStart)
+
+static void HoldTx(AJ_IOBuffer* ioBuf)
+{
+    ioBuf->bufSize -= (uint16_t)(ioBuf->writePtr - ioBuf->bufStart);
+    ioBuf->bufStart = ioBuf->writePtr;
+}
+
+/*
+ * Moves the start of the buffer back so the held back messages are sent with the rest
+ */
+static void ReleaseTx(AJ_IOBuffer* ioBuf)
+{
+    ioBuf->bufSize += (uint16_t)(ioBuf->bufStart - ioBuf->readPtr);
+    ioBuf->bufStart = ioBuf->readPtr;
+}
+
+/*
+ * Send the contents of the tx buffer encrypting them first if required
+ */
+static AJ_Status SendTx(AJ_IOBuffer* ioBuf)
+{
+    AJ_Status status;
+
+    EncryptTx(ioBuf);
+    if (TX_HELD(ioBuf)) {
+        ReleaseTx(ioBuf);
+    }
+    //#pragma calls = AJ_Net_Send
+    status = ioBuf->send(ioBuf);
+    if (txPlain) {
+        txPlain = ioBuf->writePtr;
     }
     return status;
 }
@@ -357,7 +434,9 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
 AJ_Status AJ_DeliverMsg(AJ_Message* msg)
 {
     AJ_Status status = AJ_OK;
-    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    AJ_BusAttachment* bus = msg->bus;
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+    uint8_t hold = FALSE;
 
     /*
      * If the header has already been marshaled (due to partial delivery) it will be NULL
@@ -371,6 +450,12 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
         if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
             status = EncryptMessage(msg);
         }
+        /*
+         * The caller is going to wait for the reply so method calls are not held back
+         */
+        if (bus->txCoalesceBytes) {
+            hold = (msg->hdr->msgType != AJ_MSG_METHOD_CALL) || (msg->hdr->flags & AJ_FLAG_NO_REPLY_EXPECTED);
+        }
     } else {
         /*
          * Check that the entire body was written
@@ -378,16 +463,81 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
         if (msg->bodyBytes) {
             AJ_ErrPrintf(("AJ_DeliverMsg(): AJ_ERR_MARSHAL\n"));
             status = AJ_ERR_MARSHAL;
+        } else if (txPlain) {
+            /*
+             * Encrypt the tail of the body and append the MAC
+             */
+            EncryptTx(ioBuf);
+            if (AJ_IO_BUF_SPACE(ioBuf) < MAC_LENGTH) {
+                status = SendTx(ioBuf);
+            }
+            if (status == AJ_OK) {
+                status = AJ_CCM_Final(&txCCM, ioBuf->writePtr);
+                ioBuf->writePtr += MAC_LENGTH;
+            }
         }
     }
+    if (txPlain) {
+        memset(&txCCM, 0, sizeof(txCCM));
+        txPlain = NULL;
+    }
     if (status == AJ_OK) {
-        //#pragma calls = AJ_Net_Send
-        status = ioBuf->send(ioBuf);
+        if (hold && !TX_HELD(ioBuf)) {
+            AJ_InitTimer(&bus->txCoalesceTimer);
+        }
+        if (hold && (AJ_IO_BUF_AVAIL(ioBuf) < bus->txCoalesceBytes) && (AJ_GetElapsedTime(&bus->txCoalesceTimer, TRUE) < bus->txCoalesceDelay)) {
+            HoldTx(ioBuf);
+        } else {
+            if (TX_HELD(ioBuf)) {
+                ReleaseTx(ioBuf);
+            }
+            //#pragma calls = AJ_Net_Send
+            status = ioBuf->send(ioBuf);
+        }
     }
     memset(msg, 0, sizeof(AJ_Message));
     return status;
 }
 
+AJ_Status AJ_SetTxCoalescing(AJ_BusAttachment* bus, uint16_t bytes, uint16_t delay)
+{
+    bus->txCoalesceBytes = bytes;
+    bus->txCoalesceDelay = delay;
+    return bytes ? AJ_OK : AJ_Flush(bus);
+}
+
+AJ_Status AJ_Flush(AJ_BusAttachment* bus)
+{
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+
+    if (!TX_HELD(ioBuf)) {
+        return AJ_OK;
+    }
+    /*
+     * Anything after the held back messages has not been delivered
+     */
+    ioBuf->writePtr = ioBuf->bufStart;
+    ReleaseTx(ioBuf);
+    //#pragma calls = AJ_Net_Send
+    return ioBuf->send(ioBuf);
+}
+
+/*
+ * Sends the held back messages if they are due, otherwise shortens wait so they are not held
+ * back for longer than the coalescing delay
+ */
+static AJ_Status FlushDue(AJ_BusAttachment* bus, uint32_t* wait)
+{
+    if (TX_HELD(&bus->sock.tx)) {
+        uint32_t held = AJ_GetElapsedTime(&bus->txCoalesceTimer, TRUE);
+        if (held >= bus->txCoalesceDelay) {
+            return AJ_Flush(bus);
+        }
+        *wait = min(*wait, bus->txCoalesceDelay - held);
+    }
+    return AJ_OK;
+}
+
 /*
  * Timeout after we have started to unmarshal a message
  */
@@ -456,8 +606,7 @@ static AJ_Status WriteBytes(AJ_Message* msg, const void* data, size_t numBytes,
                 AJ_ErrPrintf(("WriteBytes(): AJ_ERR_RESOURCES\n"));
                 status = AJ_ERR_RESOURCES;
             } else {
-                //#pragma calls = AJ_Net_Send
-                status = ioBuf->send(ioBuf);
+                status = SendTx(ioBuf);
             }
             if (status != AJ_OK) {
                 break;
@@ -816,7 +965,7 @@ AJ_Status AJ_ResetArgs(AJ_Message* msg)
     return status;
 }
 
-AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
+static AJ_Status UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
 {
     AJ_Status status;
     AJ_IOBuffer* ioBuf = &bus->sock.rx;
@@ -847,19 +996,13 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
      * Load the message header
      */
     while (AJ_IO_BUF_AVAIL(ioBuf) < sizeof(AJ_MsgHeader)) {
+        /*
+         * Don't wait past the point where a method call times out
+         */
+        uint32_t wait = min(timeout, AJ_NextReplyTimeout());
         //#pragma calls = AJ_Net_Recv
-        status = ioBuf->recv(ioBuf, sizeof(AJ_MsgHeader) - AJ_IO_BUF_AVAIL(ioBuf), timeout);
+        status = ioBuf->recv(ioBuf, sizeof(AJ_MsgHeader) - AJ_IO_BUF_AVAIL(ioBuf), wait);
         if (status != AJ_OK) {
-            if (status == AJ_ERR_TIMEOUT) {
-                /*
-                 * Work around recv imlpementations that return too soon.
-                 */
-                uint32_t elapsed = AJ_GetElapsedTime(&msgTimer, FALSE);
-                if (timeout > elapsed) {
-                    timeout -= elapsed;
-                    continue;
-                }
-            }
             /*
              * If there were no messages to receive check if we have any methods call that have
              * timed-out and if so generate an internal error message to allow the application to
@@ -870,9 +1013,18 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
                 msg->error = AJ_ErrTimeout;
                 msg->sender = AJ_GetUniqueName(msg->bus);
                 msg->destination = msg->sender;
-                status = AJ_OK;
+                return AJ_OK;
+            }
+            if (status == AJ_ERR_TIMEOUT) {
+                /*
+                 * Work around recv imlpementations that return too soon.
+                 */
+                uint32_t elapsed = AJ_GetElapsedTime(&msgTimer, FALSE);
+                if (timeout > elapsed) {
+                    timeout -= elapsed;
+                    continue;
+                }
             }
-
             return status;
         }
     }
@@ -1052,7 +1204,9 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
          */
         ioBuf->readPtr += hdrPad;
         /*
-         * If the message is encrypted load the entire message body and decrypt it.
+         * If the message is encrypted load the entire message body and decrypt it. The MAC must be
+         * checked before any of the body is handed out so a body that does not fit in the buffer is
+         * rejected.
          */
         if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
             status = LoadBytes(ioBuf, msg->hdr->bodyLen, 0);
@@ -1081,16 +1235,70 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     if (status == AJ_OK) {
         AJ_DumpMsg("RECEIVED", msg, FALSE);
     } else {
+        uint32_t replySerial = msg->replySerial;
+        uint32_t msgId = msg->msgId;
         /*
          * Silently discard message unless in debug mode
          */
         AJ_ErrPrintf(("Discarding bad message %s\n", AJ_StatusText(status)));
         AJ_DumpMsg("DISCARDING", msg, FALSE);
         AJ_CloseMsg(msg);
+        /*
+         * Keep what AJ_UnmarshalMsg() needs to complete a call with a completion callback
+         */
+        msg->replySerial = replySerial;
+        msg->msgId = msgId;
     }
     return status;
 }
 
+AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
+{
+    AJ_Time timer;
+
+    AJ_InitTimer(&timer);
+    while (TRUE) {
+        AJ_ReplyHandler handler;
+        void* context;
+        uint32_t elapsed;
+        uint32_t wait = timeout;
+        AJ_Status status = FlushDue(bus, &wait);
+        uint8_t cut = (wait < timeout);
+
+        if (status == AJ_OK) {
+            status = UnmarshalMsg(bus, msg, wait);
+        }
+        elapsed = AJ_GetElapsedTime(&timer, FALSE);
+        timeout = (timeout > elapsed) ? timeout - elapsed : 0;
+        /*
+         * Keep waiting if the wait was cut short to send held back messages
+         */
+        if ((status == AJ_ERR_TIMEOUT) && cut && timeout) {
+            continue;
+        }
+        /*
+         * Replies with a completion callback are not returned to the application
+         */
+        if ((status == AJ_ERR_TIMEOUT) || !AJ_TakeReplyHandler(msg, &handler, &context)) {
+            return status;
+        }
+        if (status == AJ_OK) {
+            (handler)(msg, context, (msg->hdr == &internalErrorHdr) ? AJ_ERR_TIMEOUT : AJ_OK);
+        } else {
+            /*
+             * The reply was rejected, complete the call with an internal error
+             */
+            msg->bus = bus;
+            msg->hdr = (AJ_MsgHeader*)&internalErrorHdr;
+            msg->error = (status == AJ_ERR_SECURITY) ? AJ_ErrSecurityViolation : AJ_ErrRejected;
+            msg->sender = AJ_GetUniqueName(bus);
+            msg->destination = msg->sender;
+            (handler)(msg, context, status);
+        }
+        AJ_CloseMsg(msg);
+    }
+}
+
 AJ_Status AJ_SkipArg(AJ_Message* msg)
 {
     AJ_Status status;
@@ -1601,7 +1809,15 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
         return status;
     }
 
-    AJ_IO_BUF_RESET(ioBuf);
+    /*
+     * Discard any message that was not delivered keeping messages held back by coalescing
+     */
+    if (TX_HELD(ioBuf)) {
+        ioBuf->writePtr = ioBuf->bufStart;
+    } else {
+        AJ_IO_BUF_RESET(ioBuf);
+    }
+    txPlain = NULL;
 
     msg->hdr = (AJ_MsgHeader*)ioBuf->bufStart;
     memset(msg->hdr, 0, sizeof(AJ_MsgHeader));
@@ -1915,13 +2131,6 @@ AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining)
         AJ_ErrPrintf(("AJ_DeliverMsgPartial(): AJ_ERR_UNEXPECTED\n"));
         return AJ_ERR_UNEXPECTED;
     }
-    /*
-     * Partial delivery not currently supported for messages that must be encrypted.
-     */
-    if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
-        AJ_ErrPrintf(("AJ_DeliverMsgPartial(): AJ_ERR_SECURITY\n"));
-        return AJ_ERR_SECURITY;
-    }
     /*
      * There must be arguments to marshal
      */
@@ -1945,6 +2154,24 @@ AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining)
      */
     msg->hdr->bodyLen = (uint32_t)(msg->bodyBytes + pad + bytesRemaining);
     AJ_DumpMsg("SENDING(partial)", msg, FALSE);
+    /*
+     * Encrypted messages are encrypted a buffer at a time as they are sent. The body length
+     * is known so the header can be authenticated before it is overwritten.
+     */
+    if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
+        const AJ_AES_Key* key;
+        uint8_t nonce[5];
+        uint32_t hlen;
+        AJ_Status status = GetTxKey(msg, &key, nonce);
+        if (status != AJ_OK) {
+            AJ_ErrPrintf(("AJ_DeliverMsgPartial(): status=%s\n", AJ_StatusText(status)));
+            return status;
+        }
+        msg->hdr->bodyLen += MAC_LENGTH;
+        hlen = MessageLen(msg) - msg->hdr->bodyLen;
+        AJ_CCM_Init(&txCCM, key, nonce, sizeof(nonce), ioBuf->bufStart, hlen, msg->hdr->bodyLen - MAC_LENGTH, MAC_LENGTH, FALSE);
+        txPlain = ioBuf->bufStart + hlen;
+    }
     /*
      * The buffer space occupied by the header is going to be overwritten
      * so the header is going to become invalid.
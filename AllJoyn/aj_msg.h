@@ -47,6 +47,8 @@
 #define AJ_ARG_BYTE              'y'    /**< AllJoyn 8-bit unsigned integer basic type */
 #define AJ_ARG_STRUCT            '('    /**< AllJoyn struct container type */
 #define AJ_ARG_DICT_ENTRY        '{'    /**< AllJoyn dictionary or map container type - an array of key-value pairs */
+#define AJ_STRUCT_CLOSE          ')'    /**< AllJoyn struct container close */
+#define AJ_DICT_ENTRY_CLOSE      '}'    /**< AllJoyn dictionary entry container close */
 
 /*
  * Message argument flags
@@ -192,7 +194,9 @@ struct _AJ_Message {
 /**
  * Unmarshals a message returning a message structure. Note that if a message is received but is not
  * recognized this function will return an uninitialized msg with msgId == 0. The application must
- * be prepared to handle this case.
+ * be prepared to handle this case. Replies to method calls that have a completion callback (see
+ * AJ_SetReplyHandler()) are passed to the callback, along with the error if the reply was rejected,
+ * and this function carries on waiting for a message for whatever is left of the timeout.
  *
  * @param bus     The bus attachment
  * @param msg     Pointer to a structure to receive the unmarshalled message
@@ -202,7 +206,8 @@ struct _AJ_Message {
  *          - AJ_OK if a message header was succesfully unmarshaled. Note that the message may have
  *            been consumed or rejected internally in which case the msgId will be zero.
  *          - AJ_ERR_UNMARSHAL if the message was badly formed
- *          - AJ_ERR_RESOURCES if the message header is too big to unmarshal into the attached buffer
+ *          - AJ_ERR_RESOURCES if the message header, or the body of an encrypted message, is too big
+ *            to unmarshal into the attached buffer
  *          - AJ_ERR_TIMEOUT if there was no message to unmarshal within the timeout period
  *          - AJ_ERR_READ if there was a read failure
  */
@@ -427,7 +432,8 @@ AJ_EXPORT
 AJ_Status AJ_MarshalStatusMsg(const AJ_Message* methodCall, AJ_Message* reply, AJ_Status status);
 
 /**
- * Delivers a marshalled message to the network.
+ * Delivers a marshalled message to the network. If coalescing is enabled with AJ_SetTxCoalescing()
+ * the message may be held back in the transmit buffer and sent later with other messages.
  *
  * @param msg     The message to deliver.
  *
@@ -438,6 +444,43 @@ AJ_Status AJ_MarshalStatusMsg(const AJ_Message* methodCall, AJ_Message* reply, A
 AJ_EXPORT
 AJ_Status AJ_DeliverMsg(AJ_Message* msg);
 
+/**
+ * Enables or disables coalescing of outgoing messages. While coalescing is enabled delivered
+ * messages are held back in the transmit buffer and sent together in one write when:
+ *
+ *   - bytes or more are queued,
+ *   - a method call that expects a reply is delivered,
+ *   - a message is delivered or AJ_UnmarshalMsg() is called more than delay ms after the first
+ *     held back message was delivered,
+ *   - AJ_Flush() is called.
+ *
+ * A message marshalled while other messages are held back has less than the full transmit buffer,
+ * at least the buffer size less bytes, so bytes should leave room for the largest message.
+ *
+ * @param bus     The bus attachment
+ * @param bytes   Number of bytes to queue before sending, zero disables coalescing
+ * @param delay   Maximum time in milliseconds a message is held back
+ *
+ * @return
+ *          - AJ_OK if the coalescing was set
+ *          - An error status if disabling coalescing failed to send held back messages
+ */
+AJ_EXPORT
+AJ_Status AJ_SetTxCoalescing(AJ_BusAttachment* bus, uint16_t bytes, uint16_t delay);
+
+/**
+ * Sends any messages held back by coalescing. A message that is being marshalled and has not
+ * been delivered is discarded.
+ *
+ * @param bus     The bus attachment
+ *
+ * @return
+ *          - AJ_OK if there was nothing to send or the held back messages were sent
+ *          - An error status if the messages could not be sent
+ */
+AJ_EXPORT
+AJ_Status AJ_Flush(AJ_BusAttachment* bus);
+
 /**
  * This function does partial delivery of a marshalled message. This allow an application to send
  * messages that are larger (much larger) than the transmit buffer. The remaining data must be
@@ -445,6 +488,8 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg);
  * marshaled the applicatiom must call AJ_DeliverMsg() to complete the delivery of the message to
  * the network.
  *
+ * Encrypted messages are encrypted one transmit buffer at a time as they are sent and the MAC is
+ * appended by AJ_DeliverMsg().
  *
  * @param msg            The message to deliver.
  * @param bytesRemaining The bytes yet to be marshaled. This cannot be zero.
@@ -452,6 +497,7 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg);
  * @return
  *          - AJ_OK if the message partial delivery was successful
  *          - AJ_ERR_SIGNATURE if there are no arguments left to marshal
+ *          - AJ_ERR_SECURITY if the message must be encrypted and there is no key for the peer
  *
  */
 AJ_EXPORT
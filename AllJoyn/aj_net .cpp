@@ -25,6 +25,8 @@
 #include "aj_util.h"
 #include "aj_debug.h"
 
+#if !defined(AJ_TARGET_POSIX) || defined(AJ_NET_CC3000)
+
 /*
 #ifdef WIFI_UDP_WORKING
 #include <SPI.h>
@@ -41,8 +43,18 @@
 #include <Triton_WiFi.h>
 
 
-static uint8_t rxDataStash[256];
-static uint16_t rxLeftover = 0;
+/*
+ * Bytes read from the CC3000 ahead of what the unmarshaller has asked for. Keeping these out of
+ * the I/O buffer means AJ_IOBufRebase() has nothing to move between messages.
+ */
+#define AJ_RX_RING_SIZE 512
+static uint8_t rxRingData[AJ_RX_RING_SIZE];
+static AJ_RingBuffer rxRing;
+
+/*
+ * Reads at least this big bypass the ring and land directly in the I/O buffer
+ */
+#define AJ_RX_DIRECT_READ (AJ_RX_RING_SIZE / 2)
 
 /*
  * IANA assigned IPv4 multicast group for AllJoyn.
@@ -79,7 +91,9 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
     AJ_InfoPrintf(("AJ_Net_Send(buf=0x%p)\n", buf));
 
     if (tx > 0) {
-        ret = g_client.write(buf->readPtr, tx);
+        // the bytes in front of readPtr are headroom or already sent so the
+        // CC3000 packet headers can be built there and the data sent in place
+        ret = g_client.writeInPlace(buf->readPtr, tx);
         if (ret == 0) {
             AJ_ErrPrintf(("AJ_Net_Send(): send() failed. error=%d, status=AJ_ERR_WRITE\n", g_client.getWriteError()));
             return AJ_ERR_WRITE;
@@ -96,86 +110,51 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
 
 AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
 {
-    AJ_Status status = AJ_ERR_READ;
-    uint32_t ret;
-    uint32_t rx = AJ_IO_BUF_SPACE(buf);
-    uint32_t recvd = 0;
-    unsigned long Recv_lastCall = millis();
+    int32_t ret;
+    uint16_t contig;
+    uint8_t* ringPtr;
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), len);
 
-    // first we need to clear out our buffer
-    uint32_t M = 0;
     Serial.println(F("AJ_Net_Recv!\r\n"));
     AJ_InfoPrintf(("AJ_Net_Recv(buf=0x%p, len=%d., timeout=%d.)\n", buf, len, timeout));
 
-    if (rxLeftover != 0) {
-        // there was something leftover from before,
-        AJ_InfoPrintf(("AJ_NetRecv(): leftover was: %d\n", rxLeftover));
-        M = min(rx, rxLeftover);
-        memcpy(buf->writePtr, rxDataStash, M);  // copy leftover into buffer.
-        buf->writePtr += M;  // move the data pointer over
-        memmove(rxDataStash, rxDataStash + M, rxLeftover - M); // shift left-overs toward the start.
-        rxLeftover -= M;
-        recvd += M;
-
-        // we have read as many bytes as we can
-        // higher level isn't requesting any more
-        if (recvd == rx) {
-            AJ_InfoPrintf(("AJ_Net_Recv(): status=AJ_OK\n"));
-            return AJ_OK;
+    if (AJ_RING_BUF_AVAIL(&rxRing) == 0) {
+        // block until the CC3000 reports data (or a close), time out if nothing arrives
+        if (!g_client.waitAvailable(timeout)) {
+            if (g_client.connected()) {
+                AJ_InfoPrintf(("AJ_Net_Recv(): timeout. status=AJ_ERR_TIMEOUT\n"));
+                return AJ_ERR_TIMEOUT;
+            }
+            AJ_ErrPrintf(("AJ_Net_Recv(): connection closed. status=AJ_ERR_READ\n"));
+            return AJ_ERR_READ;
         }
-    }
-
-    if ((M != 0) && (rxLeftover != 0)) {
-        AJ_InfoPrintf(("AJ_Net_REcv(): M was: %d, rxLeftover was: %d\n", M, rxLeftover));
-    }
-
-    // wait for data to become available
-    // time out if nothing arrives
-    while (g_client.connected() &&
-           g_client.available() == 0 &&
-           (millis() - Recv_lastCall < timeout)) {
-        delay(50); // wait for data or timeout
-    }
-
-    // return timeout if nothing is available
-    AJ_InfoPrintf(("AJ_Net_Recv(): millis %d, Last_call %d timeout %d Avail: %d\n", millis(), Recv_lastCall, timeout, g_client.available()));
-    if (g_client.connected() && (millis() - Recv_lastCall >= timeout) && (g_client.available() == 0)) {
-        AJ_InfoPrintf(("AJ_Net_Recv(): timeout. status=AJ_ERR_TIMEOUT\n"));
-        return AJ_ERR_TIMEOUT;
-    }
-
-    if (g_client.connected()) {
-        uint32_t askFor = rx;
-        askFor -= M;
-        AJ_InfoPrintf(("AJ_Net_Recv(): ask for: %d\n", askFor));
-        ret = g_client.read(buf->writePtr, askFor);
-        AJ_InfoPrintf(("AJ_Net_Recv(): read(): ret %d  askfor %d\n", ret, askFor));
-
-        if (askFor < ret) {
-            AJ_InfoPrintf(("AJ_Net_Recv(): BUFFER OVERRUN: askFor=%u, ret=%u\n", askFor, ret));
+        if (rx >= AJ_RX_DIRECT_READ) {
+            // large reads (message bodies) go straight into the I/O buffer
+            ret = g_client.read(buf->writePtr, rx);
+            if (ret < 0) {
+                AJ_ErrPrintf(("AJ_Net_Recv(): read() failed. status=AJ_ERR_READ\n"));
+                return AJ_ERR_READ;
+            }
+            AJ_DumpBytes("Recv", buf->writePtr, ret);
+            buf->writePtr += ret;
+            return AJ_OK;
         }
-
-        if (ret == -1) {
+        // the ring is empty so the whole of it is free for reading ahead
+        rxRing.head = rxRing.tail = 0;
+        ringPtr = AJ_RingBufWritePtr(&rxRing, &contig);
+        ret = g_client.read(ringPtr, (size_t)contig);
+        if (ret < 0) {
             AJ_ErrPrintf(("AJ_Net_Recv(): read() failed. status=AJ_ERR_READ\n"));
-            status = AJ_ERR_READ;
-        } else {
-            AJ_InfoPrintf(("AJ_Net_Recv(): ret now %d\n", ret));
-            AJ_DumpBytes("Recv", buf->writePtr, ret);
-
-            if (ret > askFor) {
-                AJ_InfoPrintf(("AJ_Net_Recv(): new leftover %d\n", ret - askFor));
-                // now shove the extra into the stash
-                memcpy(rxDataStash + rxLeftover, buf->writePtr + askFor, ret - askFor);
-                rxLeftover += (ret - askFor);
-                buf->writePtr += rx;
-            } else {
-                buf->writePtr += ret;
-            }
-            status = AJ_OK;
+            return AJ_ERR_READ;
         }
+        AJ_DumpBytes("Recv", ringPtr, ret);
+        AJ_RingBufCommit(&rxRing, (uint16_t)min((uint32_t)ret, contig));
     }
+    // only hand over what was asked for, read-ahead stays in the ring
+    buf->writePtr += AJ_RingBufRead(&rxRing, buf->writePtr, (uint16_t)rx);
 
-    return status;
+    AJ_InfoPrintf(("AJ_Net_Recv(): status=AJ_OK\n"));
+    return AJ_OK;
 }
 
 /*
@@ -183,10 +162,18 @@ AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
  * used in UDP mode.  NS expects MTU of 1500 subtracts UDP, IP and Ethernet
  * Type II overhead.  1500 - 8 -20 - 18 = 1454.  txData buffer size needs to
  * be big enough to hold a NS WHO-HAS for one name (4 + 2 + 256 = 262) in UDP
- * mode.  TCP buffer size dominates in that case.
+ * mode.  TCP buffer size dominates in that case.  The TX I/O buffer is framed
+ * by the CC3000 header room and pad byte so AJ_Net_Send() can send in place.
+ * Message headers are accessed as structs so both I/O buffers start on a word
+ * boundary, the TX one is padded in front of the header room for that.
  */
-static uint8_t rxData[1454];
-static uint8_t txData[1024];
+#define AJ_RX_DATA_SIZE 1454
+#define AJ_TX_DATA_SIZE 1024
+#define AJ_TX_PAD       ((4 - (TXHEADROOM & 3)) & 3)
+static uint32_t rxData[(AJ_RX_DATA_SIZE + 3) / 4];
+static uint32_t txData[(AJ_TX_PAD + TXHEADROOM + AJ_TX_DATA_SIZE + TXTAILROOM + 3) / 4];
+#define AJ_RX_DATA      ((uint8_t*)rxData)
+#define AJ_TX_DATA      ((uint8_t*)txData + AJ_TX_PAD + TXHEADROOM)
 
 //add by lian 20140712
 uint32_t IP_Rereverse_Order(const uint32_t addr)
@@ -229,9 +216,10 @@ AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType,
         AJ_ErrPrintf(("AJ_Net_Connect(): connect() failed: %d: status=AJ_ERR_CONNECT\n", ret));
         return AJ_ERR_CONNECT;
     } else {
-        AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)&g_client);
+        AJ_RingBufInit(&rxRing, rxRingData, sizeof(rxRingData));
+        AJ_IOBufInit(&netSock->rx, AJ_RX_DATA, AJ_RX_DATA_SIZE, AJ_IO_BUF_RX, (void*)&g_client);
         netSock->rx.recv = AJ_Net_Recv;
-        AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)&g_client);
+        AJ_IOBufInit(&netSock->tx, AJ_TX_DATA, AJ_TX_DATA_SIZE, AJ_IO_BUF_TX, (void*)&g_client);
         netSock->tx.send = AJ_Net_Send;
         AJ_ErrPrintf(("AJ_Net_Connect(): connect() success: status=AJ_OK\n"));
         return AJ_OK;
@@ -289,7 +277,6 @@ AJ_Status AJ_Net_RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     AJ_Status status = AJ_OK;
     int ret;
     uint32_t rx = AJ_IO_BUF_SPACE(buf);
-    unsigned long Recv_lastCall = millis();
     Serial.println(F("AJ_Net_RecvFrom!\r\n"));
     AJ_InfoPrintf(("AJ_Net_RecvFrom(): len %d, rx %d, timeout %d\n", len, rx, timeout));
 
@@ -299,12 +286,12 @@ AJ_Status AJ_Net_RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     //    delay(10); // wait for data or timeout
     //}
 
-	//wait for data or timeout
-	 while ((!g_clientUDP.available() ) && (millis() - Recv_lastCall < timeout)) {
-        delay(10); // wait for data or timeout
+    //wait for data or timeout
+    if (!g_clientUDP.waitAvailable(timeout)) {
+        AJ_InfoPrintf(("AJ_Net_RecvFrom(): timeout. status=AJ_ERR_TIMEOUT\n"));
+        return AJ_ERR_TIMEOUT;
     }
-	
-    AJ_InfoPrintf(("AJ_Net_RecvFrom(): millis %d, Last_call %d, timeout %d, Avail %d\n", millis(), Recv_lastCall, timeout, g_clientUDP.available()));
+
     ret = g_clientUDP.read(buf->writePtr, rx);
     AJ_InfoPrintf(("AJ_Net_RecvFrom(): read() returns %d, rx %d\n", ret, rx));
 
@@ -376,9 +363,9 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
         AJ_ErrPrintf(("AJ_Net_MCastUp(): begin() fails. status=AJ_ERR_READ\n"));
         return AJ_ERR_READ;
     } else {
-        AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)&g_clientUDP);
+        AJ_IOBufInit(&netSock->rx, AJ_RX_DATA, AJ_RX_DATA_SIZE, AJ_IO_BUF_RX, (void*)&g_clientUDP);
         netSock->rx.recv = AJ_Net_RecvFrom;
-        AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)&g_clientUDP);
+        AJ_IOBufInit(&netSock->tx, AJ_TX_DATA, AJ_TX_DATA_SIZE, AJ_IO_BUF_TX, (void*)&g_clientUDP);
         netSock->tx.send = AJ_Net_SendTo;
     }
 
@@ -393,3 +380,5 @@ void AJ_Net_MCastDown(AJ_NetSocket* netSock)
     //g_clientUDP.stop();
 	g_clientUDP.close();
 }
+
+#endif // !AJ_TARGET_POSIX || AJ_NET_CC3000
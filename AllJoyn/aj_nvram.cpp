@@ -25,6 +25,7 @@
 
 #include "aj_nvram.h"
 #include "aj_target_nvram.h"
+#include "aj_crc16.h"
 #include "aj_debug.h"
 
 /**
@@ -37,26 +38,491 @@ uint8_t dbgNVRAM = 0;
 
 extern uint8_t* AJ_NVRAM_BASE_ADDRESS;
 
-#define AJ_NVRAM_END_ADDRESS (AJ_NVRAM_BASE_ADDRESS + AJ_NVRAM_SIZE)
+/*
+ * The NVRAM after the sentinel is a circular log. Writing a data set appends a new record at the
+ * head of the log, the record is committed by writing its trailer when the data set is closed so
+ * a power failure part way through leaves the previous version intact. Deleting a data set appends
+ * a record with zero capacity. Space is reclaimed a record at a time from the tail of the log, live
+ * records found there are copied to the head before the tail is erased. A RAM index maps data set
+ * ids to their newest record and is rebuilt from the log by AJ_NVRAM_Init().
+ */
+#define NV_LOG_START SENTINEL_OFFSET
+#define NV_LOG_END   AJ_NVRAM_SIZE
+
+#define NV_PTR(offset) (AJ_NVRAM_BASE_ADDRESS + (offset))
+
+#define NV_RECORD_SIZE(capacity) ((uint16_t)(ENTRY_HEADER_SIZE + WORD_ALIGN(capacity) + ENTRY_TRAILER_SIZE))
+
+#define NV_CRC_INIT 0xFFFF
+
+#define NV_ERASED_WORD 0xFFFFFFFF
+
+/*
+ * Sequence numbers wrap so they are compared as a signed distance
+ */
+#define NV_SEQ_NEWER(a, b) ((int16_t)((uint16_t)((a) - (b))) > 0)
+
+#define NV_HASH(id) ((id) & (AJ_NVRAM_INDEX_SIZE - 1))
+
+/*
+ * States of a location in the log
+ */
+#define NV_ERASED 0   /* Erased word */
+#define NV_TORN   1   /* Not erased but not a record header either */
+#define NV_VALID  2   /* Committed record */
+#define NV_DEAD   3   /* Record that was never committed or failed its CRC check */
+
+typedef struct _NV_IndexEntry {
+    uint16_t id;           /* Data set id, INVALID_ID for an empty slot */
+    uint16_t offset;       /* Offset of the newest record for the data set */
+} NV_IndexEntry;
+
+static NV_IndexEntry nvIndex[AJ_NVRAM_INDEX_SIZE];
+static uint16_t nvEntries;  /* Number of slots in use in the index */
+static uint16_t nvHead;     /* Offset where the next record is appended */
+static uint16_t nvTail;     /* Offset of the oldest record */
+static uint16_t nvRecords;  /* Number of records between the tail and the head */
+static uint16_t nvSeq;      /* Sequence number for the next record */
+static uint8_t nvWriters;   /* Number of data sets open for writing */
+static uint16_t nvClears;   /* Number of AJ_NVRAM_Clear() calls */
+
+static NV_IndexEntry* IndexFind(uint16_t id)
+{
+    uint16_t i = NV_HASH(id);
+
+    while (nvIndex[i].id != INVALID_ID) {
+        if (nvIndex[i].id == id) {
+            return &nvIndex[i];
+        }
+        i = NV_HASH(i + 1);
+    }
+    return NULL;
+}
+
+static AJ_Status IndexSet(uint16_t id, uint16_t offset)
+{
+    uint16_t i = NV_HASH(id);
+
+    while (nvIndex[i].id != INVALID_ID) {
+        if (nvIndex[i].id == id) {
+            nvIndex[i].offset = offset;
+            return AJ_OK;
+        }
+        i = NV_HASH(i + 1);
+    }
+    /*
+     * There must always be an empty slot to terminate a probe
+     */
+    if (nvEntries >= (AJ_NVRAM_INDEX_SIZE - 1)) {
+        AJ_ErrPrintf(("IndexSet(): AJ_ERR_RESOURCES\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    nvIndex[i].id = id;
+    nvIndex[i].offset = offset;
+    ++nvEntries;
+    return AJ_OK;
+}
+
+static void IndexRemove(uint16_t id)
+{
+    NV_IndexEntry* entry = IndexFind(id);
+    uint16_t i;
+    uint16_t j;
+
+    if (!entry) {
+        return;
+    }
+    /*
+     * Shift later entries in the probe sequence back so lookups do not stop early
+     */
+    i = (uint16_t)(entry - nvIndex);
+    j = i;
+    while (TRUE) {
+        uint16_t home;
+        j = NV_HASH(j + 1);
+        if (nvIndex[j].id == INVALID_ID) {
+            break;
+        }
+        home = NV_HASH(nvIndex[j].id);
+        if ((i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j))) {
+            nvIndex[i] = nvIndex[j];
+            i = j;
+        }
+    }
+    nvIndex[i].id = INVALID_ID;
+    --nvEntries;
+}
+
+static void ResetIndex()
+{
+    memset(nvIndex, 0, sizeof(nvIndex));
+    nvEntries = 0;
+    nvHead = NV_LOG_START;
+    nvTail = NV_LOG_START;
+    nvRecords = 0;
+    nvSeq = 0;
+    nvWriters = 0;
+}
+
+static uint16_t HeaderCheck(const NV_EntryHeader* hdr)
+{
+    uint16_t crc = NV_CRC_INIT;
+    AJ_CRC16_Compute((const uint8_t*)hdr, offsetof(NV_EntryHeader, check), &crc);
+    return crc;
+}
+
+/*
+ * The record CRC covers the header fields and the data
+ */
+static uint16_t RecordCRC(uint16_t offset, const NV_EntryHeader* hdr)
+{
+    uint8_t buf[32];
+    uint8_t* data = NV_PTR(offset + ENTRY_HEADER_SIZE);
+    uint16_t len = hdr->capacity;
+    uint16_t crc = NV_CRC_INIT;
+
+    AJ_CRC16_Compute((const uint8_t*)hdr, offsetof(NV_EntryHeader, check), &crc);
+    while (len) {
+        uint16_t sz = min(len, (uint16_t)sizeof(buf));
+        _AJ_NV_Read(data, buf, sz);
+        AJ_CRC16_Compute(buf, sz, &crc);
+        data += sz;
+        len -= sz;
+    }
+    return crc;
+}
+
+static uint8_t ParseRecord(uint16_t offset, NV_EntryHeader* hdr)
+{
+    NV_EntryTrailer trailer;
+    uint32_t word;
+
+    _AJ_NV_Read(NV_PTR(offset), &word, sizeof(word));
+    if (word == NV_ERASED_WORD) {
+        return NV_ERASED;
+    }
+    if ((offset + ENTRY_HEADER_SIZE) > NV_LOG_END) {
+        return NV_TORN;
+    }
+    _AJ_NV_Read(NV_PTR(offset), hdr, ENTRY_HEADER_SIZE);
+    if ((hdr->id == INVALID_DATA) || (hdr->check != HeaderCheck(hdr)) || ((uint32_t)offset + NV_RECORD_SIZE(hdr->capacity) > NV_LOG_END)) {
+        return NV_TORN;
+    }
+    _AJ_NV_Read(NV_PTR(offset + NV_RECORD_SIZE(hdr->capacity) - ENTRY_TRAILER_SIZE), &trailer, ENTRY_TRAILER_SIZE);
+    if ((trailer.commit != NV_COMMIT_MARK) || (trailer.crc != RecordCRC(offset, hdr))) {
+        return NV_DEAD;
+    }
+    return NV_VALID;
+}
+
+/*
+ * Returns the offset of the first record at or after offset
+ */
+static uint16_t NextRecord(uint16_t offset)
+{
+    uint32_t word;
+
+    while (TRUE) {
+        if ((offset + ENTRY_HEADER_SIZE) > NV_LOG_END) {
+            offset = NV_LOG_START;
+        }
+        _AJ_NV_Read(NV_PTR(offset), &word, sizeof(word));
+        if (word != NV_ERASED_WORD) {
+            return offset;
+        }
+        offset += sizeof(word);
+    }
+}
+
+static uint16_t FreeBytes()
+{
+    if (!nvRecords) {
+        return NV_LOG_END - NV_LOG_START;
+    }
+    if (nvHead > nvTail) {
+        return (NV_LOG_END - nvHead) + (nvTail - NV_LOG_START);
+    }
+    return nvTail - nvHead;
+}
+
+/*
+ * Find contiguous erased space at the head of the log. A record never wraps, if it does not fit
+ * at the end of the log it goes at the start and the space at the end is skipped.
+ */
+static uint8_t FindSpace(uint16_t size, uint16_t* offset)
+{
+    if (!nvRecords) {
+        nvHead = NV_LOG_START;
+        nvTail = NV_LOG_START;
+        *offset = NV_LOG_START;
+        return size <= (NV_LOG_END - NV_LOG_START);
+    }
+    if (nvHead > nvTail) {
+        if (((uint32_t)nvHead + size) <= NV_LOG_END) {
+            *offset = nvHead;
+            return TRUE;
+        }
+        if ((NV_LOG_START + size) <= nvTail) {
+            *offset = NV_LOG_START;
+            return TRUE;
+        }
+        return FALSE;
+    }
+    if (((uint32_t)nvHead + size) <= nvTail) {
+        *offset = nvHead;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void AppendHeader(uint16_t offset, NV_EntryHeader* hdr, uint16_t id, uint16_t capacity)
+{
+    hdr->id = id;
+    hdr->capacity = capacity;
+    hdr->seq = nvSeq++;
+    hdr->check = HeaderCheck(hdr);
+    _AJ_NV_Write(NV_PTR(offset), hdr, ENTRY_HEADER_SIZE);
+    if (!nvRecords) {
+        nvTail = offset;
+    }
+    nvHead = offset + NV_RECORD_SIZE(capacity);
+    ++nvRecords;
+}
+
+static void Commit(uint16_t offset, const NV_EntryHeader* hdr)
+{
+    NV_EntryTrailer trailer;
+
+    trailer.crc = RecordCRC(offset, hdr);
+    trailer.commit = NV_COMMIT_MARK;
+    _AJ_NV_Write(NV_PTR(offset + NV_RECORD_SIZE(hdr->capacity) - ENTRY_TRAILER_SIZE), &trailer, ENTRY_TRAILER_SIZE);
+}
+
+/*
+ * Reclaim the record at the tail of the log
+ */
+static AJ_Status CollectTail()
+{
+    NV_EntryHeader hdr;
+    NV_IndexEntry* entry;
+    uint16_t tail = nvTail;
+    uint16_t size;
+
+    if (!nvRecords) {
+        return AJ_ERR_RESOURCES;
+    }
+    _AJ_NV_Read(NV_PTR(tail), &hdr, ENTRY_HEADER_SIZE);
+    size = NV_RECORD_SIZE(hdr.capacity);
+    entry = IndexFind(hdr.id);
+    if (entry && (entry->offset == tail)) {
+        NV_EntryHeader copy;
+        uint16_t offset;
+        /*
+         * The record is live so copy it to the head, the copy is committed before the
+         * original is erased.
+         */
+        if (!FindSpace(size, &offset)) {
+            return AJ_ERR_RESOURCES;
+        }
+        AppendHeader(offset, &copy, hdr.id, hdr.capacity);
+        _AJ_NV_Write(NV_PTR(offset + ENTRY_HEADER_SIZE), NV_PTR(tail + ENTRY_HEADER_SIZE), hdr.capacity);
+        Commit(offset, &copy);
+        entry->offset = offset;
+    } else if (nvWriters) {
+        NV_EntryTrailer trailer;
+        /*
+         * An uncommitted record may belong to a data set that is still open
+         */
+        _AJ_NV_Read(NV_PTR(tail + size - ENTRY_TRAILER_SIZE), &trailer, ENTRY_TRAILER_SIZE);
+        if (trailer.commit != NV_COMMIT_MARK) {
+            return AJ_ERR_RESOURCES;
+        }
+    }
+    /*
+     * Erase the header last so an interrupted erase leaves a record that fails its CRC check
+     */
+    _AJ_NV_Erase(NV_PTR(tail + ENTRY_HEADER_SIZE), size - ENTRY_HEADER_SIZE);
+    _AJ_NV_Erase(NV_PTR(tail), ENTRY_HEADER_SIZE);
+    if (--nvRecords) {
+        nvTail = NextRecord(tail + size);
+    }
+    return AJ_OK;
+}
+
+static uint16_t LargestRecord()
+{
+    NV_EntryHeader hdr;
+    uint16_t largest = 0;
+    uint16_t i;
+
+    for (i = 0; i < AJ_NVRAM_INDEX_SIZE; ++i) {
+        if (nvIndex[i].id != INVALID_ID) {
+            _AJ_NV_Read(NV_PTR(nvIndex[i].offset), &hdr, ENTRY_HEADER_SIZE);
+            largest = max(largest, NV_RECORD_SIZE(hdr.capacity));
+        }
+    }
+    return largest;
+}
+
+/*
+ * Make room for a new record collecting from the tail only as far as needed. Enough free space is
+ * kept back to copy the largest record so collection can always make progress.
+ */
+static AJ_Status Allocate(uint16_t size, uint16_t* offset)
+{
+    uint32_t reserve = max(LargestRecord(), size);
+    uint16_t budget = nvRecords;
+
+    while (((FreeBytes() < (size + reserve)) || !FindSpace(size, offset))) {
+        /*
+         * A full pass over the log did not free enough space
+         */
+        if (!budget--) {
+            AJ_ErrPrintf(("Allocate(): AJ_ERR_RESOURCES\n"));
+            return AJ_ERR_RESOURCES;
+        }
+        if (CollectTail() != AJ_OK) {
+            AJ_ErrPrintf(("Allocate(): AJ_ERR_RESOURCES\n"));
+            return AJ_ERR_RESOURCES;
+        }
+    }
+    return AJ_OK;
+}
+
+static AJ_Status NewRecord(uint16_t id, uint16_t capacity, uint16_t* offset, NV_EntryHeader* hdr)
+{
+    AJ_Status status;
+
+    if (!IndexFind(id) && (nvEntries >= (AJ_NVRAM_INDEX_SIZE - 1))) {
+        AJ_ErrPrintf(("NewRecord(): index full\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    status = Allocate(NV_RECORD_SIZE(capacity), offset);
+    if (status == AJ_OK) {
+        AppendHeader(*offset, hdr, id, capacity);
+    }
+    return status;
+}
+
+/*
+ * Rebuild the index and find the ends of the log. Anything in the erased part of the log that is
+ * not erased was left by a power failure and is erased now.
+ */
+static void BuildIndex()
+{
+    NV_EntryHeader hdr;
+    NV_IndexEntry* entry;
+    uint16_t offset = NV_LOG_START;
+    uint16_t newestSeq = 0;
+    uint16_t oldestSeq = 0;
+    uint16_t i;
+
+    ResetIndex();
+    while ((offset + sizeof(uint32_t)) <= NV_LOG_END) {
+        uint8_t state = ParseRecord(offset, &hdr);
+        if ((state == NV_ERASED) || (state == NV_TORN)) {
+            offset += sizeof(uint32_t);
+            continue;
+        }
+        if (!nvRecords || NV_SEQ_NEWER(hdr.seq, newestSeq)) {
+            newestSeq = hdr.seq;
+            nvHead = offset + NV_RECORD_SIZE(hdr.capacity);
+        }
+        if (!nvRecords || NV_SEQ_NEWER(oldestSeq, hdr.seq)) {
+            oldestSeq = hdr.seq;
+            nvTail = offset;
+        }
+        ++nvRecords;
+        if (state == NV_VALID) {
+            entry = IndexFind(hdr.id);
+            if (entry) {
+                NV_EntryHeader prev;
+                _AJ_NV_Read(NV_PTR(entry->offset), &prev, ENTRY_HEADER_SIZE);
+                if (NV_SEQ_NEWER(hdr.seq, prev.seq)) {
+                    entry->offset = offset;
+                }
+            } else {
+                IndexSet(hdr.id, offset);
+            }
+        }
+        offset += NV_RECORD_SIZE(hdr.capacity);
+    }
+    if (nvRecords) {
+        nvSeq = newestSeq + 1;
+    }
+    /*
+     * Deleted data sets were only needed to hide older records
+     */
+    for (i = 0; i < AJ_NVRAM_INDEX_SIZE;) {
+        if (nvIndex[i].id != INVALID_ID) {
+            _AJ_NV_Read(NV_PTR(nvIndex[i].offset), &hdr, ENTRY_HEADER_SIZE);
+            if (!hdr.capacity) {
+                IndexRemove(hdr.id);
+                continue;
+            }
+        }
+        ++i;
+    }
+    /*
+     * Erase any debris between the head and the tail
+     */
+    offset = nvRecords ? nvHead : NV_LOG_START;
+    while (TRUE) {
+        uint32_t word;
+        if ((offset + sizeof(word)) > NV_LOG_END) {
+            if (!nvRecords) {
+                break;
+            }
+            offset = NV_LOG_START;
+        }
+        if (nvRecords && (offset == nvTail)) {
+            break;
+        }
+        _AJ_NV_Read(NV_PTR(offset), &word, sizeof(word));
+        if (word != NV_ERASED_WORD) {
+            _AJ_NV_Erase(NV_PTR(offset), sizeof(word));
+        }
+        offset += sizeof(word);
+    }
+    AJ_InfoPrintf(("BuildIndex(): %d. records %d. data sets\n", nvRecords, nvEntries));
+}
+
+void AJ_NVRAM_Init()
+{
+    static uint8_t inited = FALSE;
+    if (!inited) {
+        inited = TRUE;
+        if (!_AJ_NVRAM_Init()) {
+            _AJ_NVRAM_Clear();
+        }
+        BuildIndex();
+    }
+}
 
 void AJ_NVRAM_Layout_Print()
 {
     int i = 0;
-    uint16_t* data = (uint16_t*)(AJ_NVRAM_BASE_ADDRESS + SENTINEL_OFFSET);
-    uint16_t entryId = 0;
-    uint16_t capacity = 0;
+    NV_EntryHeader hdr;
+    NV_IndexEntry* entry;
+    uint16_t offset = nvTail;
+    uint16_t records = nvRecords;
+
     AJ_Printf("============ AJ NVRAM Map ===========\n");
     for (i = 0; i < SENTINEL_OFFSET; i++) {
         AJ_Printf("%c", *((uint8_t*)(AJ_NVRAM_BASE_ADDRESS + i)));
     }
     AJ_Printf("\n");
 
-    while ((uint8_t*)data < (uint8_t*)AJ_NVRAM_END_ADDRESS && *data != INVALID_DATA) {
-        entryId = *data;
-        capacity = *(data + 1);
-        AJ_Printf("ID = %d, capacity = %d\n", entryId, capacity);
-        data += (ENTRY_HEADER_SIZE + capacity) >> 1;
+    while (records--) {
+        _AJ_NV_Read(NV_PTR(offset), &hdr, ENTRY_HEADER_SIZE);
+        entry = IndexFind(hdr.id);
+        AJ_Printf("ID = %d, capacity = %d, seq = %d%s\n", hdr.id, hdr.capacity, hdr.seq, (entry && (entry->offset == offset)) ? "" : " (stale)");
+        offset += NV_RECORD_SIZE(hdr.capacity);
+        if (records) {
+            offset = NextRecord(offset);
+        }
     }
+    AJ_Printf("Free = %d\n", FreeBytes());
     AJ_Printf("============ End ===========\n");
 }
 
@@ -68,33 +534,23 @@ void AJ_NVRAM_Layout_Print()
  */
 uint8_t* AJ_FindNVEntry(uint16_t id)
 {
-    uint16_t capacity = 0;
-    uint16_t* data = (uint16_t*)(AJ_NVRAM_BASE_ADDRESS + SENTINEL_OFFSET);
+    NV_IndexEntry* entry = IndexFind(id);
 
     AJ_InfoPrintf(("AJ_FindNVEntry(id=%d.)\n", id));
 
-    while ((uint8_t*)data < (uint8_t*)AJ_NVRAM_END_ADDRESS) {
-        if (*data != id) {
-            capacity = *(data + 1);
-            if (*data == INVALID_DATA) {
-                break;
-            }
-            data += (ENTRY_HEADER_SIZE + capacity) >> 1;
-        } else {
-            AJ_InfoPrintf(("AJ_FindNVEntry(): data=0x%p\n", data));
-            return (uint8_t*)data;
-        }
+    if (entry) {
+        AJ_InfoPrintf(("AJ_FindNVEntry(): data=0x%p\n", NV_PTR(entry->offset)));
+        return NV_PTR(entry->offset);
     }
     AJ_InfoPrintf(("AJ_FindNVEntry(): data=NULL\n"));
     return NULL;
 }
 
-extern AJ_Status _AJ_CompactNVStorage();
-
 AJ_Status AJ_NVRAM_Create(uint16_t id, uint16_t capacity)
 {
-    uint8_t* ptr;
+    AJ_Status status;
     NV_EntryHeader header;
+    uint16_t offset;
 
     AJ_InfoPrintf(("AJ_NVRAM_Create(id=%d., capacity=%d.)\n", id, capacity));
 
@@ -104,39 +560,37 @@ AJ_Status AJ_NVRAM_Create(uint16_t id, uint16_t capacity)
     }
 
     capacity = WORD_ALIGN(capacity); // 4-byte alignment
-    ptr = AJ_FindNVEntry(INVALID_DATA);
-    if (!ptr || (ptr + ENTRY_HEADER_SIZE + capacity > AJ_NVRAM_END_ADDRESS)) {
-        AJ_InfoPrintf(("AJ_NVRAM_Create(): _AJ_CompactNVStorage()\n"));
-        _AJ_CompactNVStorage();
-        ptr = AJ_FindNVEntry(INVALID_DATA);
-        if (!ptr || ptr + ENTRY_HEADER_SIZE + capacity > AJ_NVRAM_END_ADDRESS) {
-            AJ_InfoPrintf(("AJ_NVRAM_Create(): AJ_ERR_FAILURE\n"));
-            return AJ_ERR_FAILURE;
-        }
+    status = NewRecord(id, capacity, &offset, &header);
+    if (status != AJ_OK) {
+        AJ_ErrPrintf(("AJ_NVRAM_Create(): AJ_ERR_FAILURE\n"));
+        return AJ_ERR_FAILURE;
     }
-    header.id = id;
-    header.capacity = capacity;
-    _AJ_NV_Write(ptr, &header, ENTRY_HEADER_SIZE);
-    return AJ_OK;
+    Commit(offset, &header);
+    return IndexSet(id, offset);
 }
 
 AJ_Status AJ_NVRAM_Delete(uint16_t id)
 {
-    NV_EntryHeader newHeader;
-    uint8_t* ptr;
+    AJ_Status status;
+    NV_EntryHeader header;
+    uint16_t offset;
 
     AJ_InfoPrintf(("AJ_NVRAM_Delete(id=%d.)\n", id));
 
-    ptr = AJ_FindNVEntry(id);
-
-    if (!ptr) {
+    if (!AJ_FindNVEntry(id)) {
         AJ_ErrPrintf(("AJ_NVRAM_Delete(): AJ_ERR_FAILURE\n"));
         return AJ_ERR_FAILURE;
     }
-
-    memcpy(&newHeader, ptr, ENTRY_HEADER_SIZE);
-    newHeader.id = 0;
-    _AJ_NV_Write(ptr, &newHeader, ENTRY_HEADER_SIZE);
+    /*
+     * A record with no data hides the older records until they are collected
+     */
+    status = NewRecord(id, 0, &offset, &header);
+    if (status != AJ_OK) {
+        AJ_ErrPrintf(("AJ_NVRAM_Delete(): AJ_ERR_FAILURE\n"));
+        return AJ_ERR_FAILURE;
+    }
+    Commit(offset, &header);
+    IndexRemove(id);
     return AJ_OK;
 }
 
@@ -156,30 +610,30 @@ AJ_NV_DATASET* AJ_NVRAM_Open(uint16_t id, char* mode, uint16_t capacity)
         AJ_ErrPrintf(("AJ_NVRAM_Open(): invalid access mode\n"));
         goto OPEN_ERR_EXIT;
     }
+    handle = (AJ_NV_DATASET*)AJ_Malloc(sizeof(AJ_NV_DATASET));
+    if (!handle) {
+        AJ_ErrPrintf(("AJ_NVRAM_Open(): AJ_Malloc() failure\n"));
+        goto OPEN_ERR_EXIT;
+    }
+
     if (*mode == AJ_NV_DATASET_MODE_WRITE) {
+        NV_EntryHeader header;
+        uint16_t offset;
+
         if (capacity == 0) {
             AJ_ErrPrintf(("AJ_NVRAM_Open(): invalid capacity\n"));
             goto OPEN_ERR_EXIT;
         }
-
-        if (AJ_NVRAM_Exist(id)) {
-            status = AJ_NVRAM_Delete(id);
-        }
+        /*
+         * The new record replaces any existing data set when it is committed by AJ_NVRAM_Close()
+         */
+        status = NewRecord(id, WORD_ALIGN(capacity), &offset, &header);
         if (status != AJ_OK) {
-            AJ_ErrPrintf(("AJ_NVRAM_Open(): AJ_NVRAM_Delete() failure: status=%s\n", AJ_StatusText(status)));
-            goto OPEN_ERR_EXIT;
-        }
-
-        status = AJ_NVRAM_Create(id, capacity);
-        if (status != AJ_OK) {
-            AJ_ErrPrintf(("AJ_NVRAM_Open(): AJ_NVRAM_Create() failure: status=%s\n", AJ_StatusText(status)));
-            goto OPEN_ERR_EXIT;
-        }
-        entry = AJ_FindNVEntry(id);
-        if (!entry) {
-            AJ_ErrPrintf(("AJ_NVRAM_Open(): Data set %d. does not exist\n", id));
+            AJ_ErrPrintf(("AJ_NVRAM_Open(): NewRecord() failure: status=%s\n", AJ_StatusText(status)));
             goto OPEN_ERR_EXIT;
         }
+        entry = NV_PTR(offset);
+        ++nvWriters;
     } else {
         entry = AJ_FindNVEntry(id);
         if (!entry) {
@@ -188,12 +642,6 @@ AJ_NV_DATASET* AJ_NVRAM_Open(uint16_t id, char* mode, uint16_t capacity)
         }
     }
 
-    handle = (AJ_NV_DATASET*)AJ_Malloc(sizeof(AJ_NV_DATASET));
-    if (!handle) {
-        AJ_ErrPrintf(("AJ_NVRAM_Open(): AJ_Malloc() failure\n"));
-        goto OPEN_ERR_EXIT;
-    }
-
     handle->id = id;
     handle->curPos = 0;
     handle->mode = *mode;
@@ -281,6 +729,8 @@ size_t AJ_NVRAM_Read(void* ptr, uint16_t size, AJ_NV_DATASET* handle)
 
 AJ_Status AJ_NVRAM_Close(AJ_NV_DATASET* handle)
 {
+    AJ_Status status = AJ_OK;
+
     AJ_InfoPrintf(("AJ_NVRAM_Close(handle=0x%p)\n", handle));
 
     if (!handle) {
@@ -288,9 +738,17 @@ AJ_Status AJ_NVRAM_Close(AJ_NV_DATASET* handle)
         return AJ_ERR_INVALID;
     }
 
+    if (handle->mode == AJ_NV_DATASET_MODE_WRITE) {
+        NV_EntryHeader header;
+        uint16_t offset = (uint16_t)(handle->inode - AJ_NVRAM_BASE_ADDRESS);
+        _AJ_NV_Read(handle->inode, &header, ENTRY_HEADER_SIZE);
+        Commit(offset, &header);
+        status = IndexSet(header.id, offset);
+        --nvWriters;
+    }
     AJ_Free(handle);
     handle = NULL;
-    return AJ_OK;
+    return status;
 }
 
 uint8_t AJ_NVRAM_Exist(uint16_t id)
@@ -307,5 +765,12 @@ uint8_t AJ_NVRAM_Exist(uint16_t id)
 void AJ_NVRAM_Clear()
 {
     _AJ_NVRAM_Clear();
+    ResetIndex();
+    ++nvClears;
+}
+
+uint16_t AJ_NVRAM_ClearCount()
+{
+    return nvClears;
 }
 
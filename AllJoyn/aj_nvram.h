@@ -53,6 +53,14 @@ void AJ_NVRAM_Init();
  */
 void AJ_NVRAM_Clear();
 
+/**
+ * Count of AJ_NVRAM_Clear() calls, lets a module that caches what is in NVRAM notice that the
+ * cache is stale
+ *
+ * @return  The number of times NVRAM has been cleared since boot
+ */
+uint16_t AJ_NVRAM_ClearCount();
+
 /**
  * Open a data set
  *
@@ -0,0 +1,400 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include "aj_target.h"
+
+#ifdef AJ_TARGET_POSIX
+
+#include <stdlib.h>
+#include "aj_crypto.h"
+
+void AJ_RandBytes(uint8_t* rand, uint32_t len)
+{
+    static FILE* urandom = NULL;
+
+    if (!urandom) {
+        urandom = fopen("/dev/urandom", "rb");
+    }
+    if (!urandom || (fread(rand, 1, len, urandom) != len)) {
+        /*
+         * Not expected on a POSIX host but never hand back uninitialized bytes
+         */
+        while (len--) {
+            *rand++ = (uint8_t)random();
+        }
+    }
+}
+
+#ifdef AJ_AES_HW_ACCEL
+
+/*
+ * CTR mode runs this many independent blocks through the pipeline at once
+ */
+#define HW_CTR_BLOCKS 4
+
+static void IncrementCounter(uint8_t* ctr)
+{
+    int i;
+    for (i = 15; i >= 12; --i) {
+        if (++ctr[i]) {
+            break;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <wmmintrin.h>
+
+uint8_t AJ_AES_HW_Supported(void)
+{
+    static int8_t supported = -1;
+
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("aes") ? 1 : 0;
+    }
+    return (uint8_t)supported;
+}
+
+/*
+ * The software key schedule is the FIPS-197 byte order packed little-endian so
+ * it loads directly as AES-NI round keys.
+ */
+__attribute__((target("aes,sse2")))
+static void LoadSchedule(__m128i* rk, const AJ_AES_Key* ks)
+{
+    int i;
+    for (i = 0; i < 11; ++i) {
+        rk[i] = _mm_loadu_si128((const __m128i*)&ks->fkey[4 * i]);
+    }
+}
+
+__attribute__((target("aes,sse2")))
+static __m128i EncryptHW(const __m128i* rk, __m128i b)
+{
+    int i;
+    b = _mm_xor_si128(b, rk[0]);
+    for (i = 1; i < 10; ++i) {
+        b = _mm_aesenc_si128(b, rk[i]);
+    }
+    return _mm_aesenclast_si128(b, rk[10]);
+}
+
+__attribute__((target("aes,sse2")))
+void AJ_AES_HW_CTR_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    __m128i rk[11];
+    __m128i b[HW_CTR_BLOCKS];
+    uint8_t pad[16];
+    int i;
+    int j;
+
+    LoadSchedule(rk, ks);
+    while (len >= (16 * HW_CTR_BLOCKS)) {
+        for (j = 0; j < HW_CTR_BLOCKS; ++j) {
+            b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)ctr), rk[0]);
+            IncrementCounter(ctr);
+        }
+        for (i = 1; i < 10; ++i) {
+            for (j = 0; j < HW_CTR_BLOCKS; ++j) {
+                b[j] = _mm_aesenc_si128(b[j], rk[i]);
+            }
+        }
+        for (j = 0; j < HW_CTR_BLOCKS; ++j) {
+            b[j] = _mm_aesenclast_si128(b[j], rk[10]);
+            _mm_storeu_si128((__m128i*)out, _mm_xor_si128(b[j], _mm_loadu_si128((const __m128i*)in)));
+            in += 16;
+            out += 16;
+        }
+        len -= 16 * HW_CTR_BLOCKS;
+    }
+    while (len) {
+        uint32_t n = (len < 16) ? len : 16;
+        _mm_storeu_si128((__m128i*)pad, EncryptHW(rk, _mm_loadu_si128((const __m128i*)ctr)));
+        IncrementCounter(ctr);
+        len -= n;
+        for (i = 0; i < (int)n; ++i) {
+            *out++ = pad[i] ^ *in++;
+        }
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void AJ_AES_HW_CBC_MAC_128(const AJ_AES_Key* ks, const uint8_t* in, uint32_t len, uint8_t* mac)
+{
+    __m128i rk[11];
+    __m128i t;
+
+    LoadSchedule(rk, ks);
+    t = _mm_loadu_si128((const __m128i*)mac);
+    while (len) {
+        t = EncryptHW(rk, _mm_xor_si128(t, _mm_loadu_si128((const __m128i*)in)));
+        in += 16;
+        len -= 16;
+    }
+    _mm_storeu_si128((__m128i*)mac, t);
+}
+
+__attribute__((target("aes,sse2")))
+static void EncryptHW2(const __m128i* rk, __m128i* a, __m128i* b)
+{
+    int i;
+    __m128i x = _mm_xor_si128(*a, rk[0]);
+    __m128i y = _mm_xor_si128(*b, rk[0]);
+
+    for (i = 1; i < 10; ++i) {
+        x = _mm_aesenc_si128(x, rk[i]);
+        y = _mm_aesenc_si128(y, rk[i]);
+    }
+    *a = _mm_aesenclast_si128(x, rk[10]);
+    *b = _mm_aesenclast_si128(y, rk[10]);
+}
+
+__attribute__((target("aes,sse2")))
+void AJ_AES_HW_CCM_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt)
+{
+    __m128i rk[11];
+    __m128i t;
+    __m128i k = _mm_setzero_si128();
+    __m128i x;
+    __m128i c;
+    uint8_t block[16];
+
+    LoadSchedule(rk, ks);
+    t = _mm_loadu_si128((const __m128i*)mac);
+    if (decrypt && len) {
+        k = EncryptHW(rk, _mm_loadu_si128((const __m128i*)ctr));
+        IncrementCounter(ctr);
+    }
+    while (len) {
+        uint32_t n = (len < 16) ? len : 16;
+
+        len -= n;
+        if (n < 16) {
+            memset(block, 0, sizeof(block));
+            memcpy(block, in, n);
+            x = _mm_loadu_si128((const __m128i*)block);
+        } else {
+            x = _mm_loadu_si128((const __m128i*)in);
+        }
+        in += n;
+        if (decrypt) {
+            x = _mm_xor_si128(x, k);
+            if (n < 16) {
+                _mm_storeu_si128((__m128i*)block, x);
+                memcpy(out, block, n);
+                memset(block + n, 0, 16 - n);
+                x = _mm_loadu_si128((const __m128i*)block);
+            } else {
+                _mm_storeu_si128((__m128i*)out, x);
+            }
+            t = _mm_xor_si128(t, x);
+            if (len) {
+                k = _mm_loadu_si128((const __m128i*)ctr);
+                IncrementCounter(ctr);
+                EncryptHW2(rk, &t, &k);
+            } else {
+                t = EncryptHW(rk, t);
+            }
+        } else {
+            c = _mm_loadu_si128((const __m128i*)ctr);
+            IncrementCounter(ctr);
+            t = _mm_xor_si128(t, x);
+            EncryptHW2(rk, &t, &c);
+            x = _mm_xor_si128(x, c);
+            if (n < 16) {
+                _mm_storeu_si128((__m128i*)block, x);
+                memcpy(out, block, n);
+            } else {
+                _mm_storeu_si128((__m128i*)out, x);
+            }
+        }
+        out += n;
+    }
+    _mm_storeu_si128((__m128i*)mac, t);
+}
+
+#elif defined(__aarch64__)
+
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+uint8_t AJ_AES_HW_Supported(void)
+{
+    static int8_t supported = -1;
+
+    if (supported < 0) {
+        supported = (getauxval(AT_HWCAP) & HWCAP_AES) ? 1 : 0;
+    }
+    return (uint8_t)supported;
+}
+
+/*
+ * AESE does AddRoundKey before SubBytes/ShiftRows so the last round key is
+ * applied with a plain XOR.
+ */
+__attribute__((target("+crypto")))
+static uint8x16_t EncryptHW(const uint8x16_t* rk, uint8x16_t b)
+{
+    int i;
+    for (i = 0; i < 9; ++i) {
+        b = vaesmcq_u8(vaeseq_u8(b, rk[i]));
+    }
+    return veorq_u8(vaeseq_u8(b, rk[9]), rk[10]);
+}
+
+__attribute__((target("+crypto")))
+static void LoadSchedule(uint8x16_t* rk, const AJ_AES_Key* ks)
+{
+    int i;
+    for (i = 0; i < 11; ++i) {
+        rk[i] = vld1q_u8((const uint8_t*)&ks->fkey[4 * i]);
+    }
+}
+
+__attribute__((target("+crypto")))
+void AJ_AES_HW_CTR_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    uint8x16_t rk[11];
+    uint8x16_t b[HW_CTR_BLOCKS];
+    uint8_t pad[16];
+    int i;
+    int j;
+
+    LoadSchedule(rk, ks);
+    while (len >= (16 * HW_CTR_BLOCKS)) {
+        for (j = 0; j < HW_CTR_BLOCKS; ++j) {
+            b[j] = vld1q_u8(ctr);
+            IncrementCounter(ctr);
+        }
+        for (i = 0; i < 9; ++i) {
+            for (j = 0; j < HW_CTR_BLOCKS; ++j) {
+                b[j] = vaesmcq_u8(vaeseq_u8(b[j], rk[i]));
+            }
+        }
+        for (j = 0; j < HW_CTR_BLOCKS; ++j) {
+            b[j] = veorq_u8(vaeseq_u8(b[j], rk[9]), rk[10]);
+            vst1q_u8(out, veorq_u8(b[j], vld1q_u8(in)));
+            in += 16;
+            out += 16;
+        }
+        len -= 16 * HW_CTR_BLOCKS;
+    }
+    while (len) {
+        uint32_t n = (len < 16) ? len : 16;
+        vst1q_u8(pad, EncryptHW(rk, vld1q_u8(ctr)));
+        IncrementCounter(ctr);
+        len -= n;
+        for (i = 0; i < (int)n; ++i) {
+            *out++ = pad[i] ^ *in++;
+        }
+    }
+}
+
+__attribute__((target("+crypto")))
+void AJ_AES_HW_CBC_MAC_128(const AJ_AES_Key* ks, const uint8_t* in, uint32_t len, uint8_t* mac)
+{
+    uint8x16_t rk[11];
+    uint8x16_t t;
+
+    LoadSchedule(rk, ks);
+    t = vld1q_u8(mac);
+    while (len) {
+        t = EncryptHW(rk, veorq_u8(t, vld1q_u8(in)));
+        in += 16;
+        len -= 16;
+    }
+    vst1q_u8(mac, t);
+}
+
+__attribute__((target("+crypto")))
+static void EncryptHW2(const uint8x16_t* rk, uint8x16_t* a, uint8x16_t* b)
+{
+    int i;
+    uint8x16_t x = *a;
+    uint8x16_t y = *b;
+
+    for (i = 0; i < 9; ++i) {
+        x = vaesmcq_u8(vaeseq_u8(x, rk[i]));
+        y = vaesmcq_u8(vaeseq_u8(y, rk[i]));
+    }
+    *a = veorq_u8(vaeseq_u8(x, rk[9]), rk[10]);
+    *b = veorq_u8(vaeseq_u8(y, rk[9]), rk[10]);
+}
+
+__attribute__((target("+crypto")))
+void AJ_AES_HW_CCM_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt)
+{
+    uint8x16_t rk[11];
+    uint8x16_t t;
+    uint8x16_t k;
+    uint8x16_t x;
+    uint8x16_t c;
+    uint8_t block[16];
+
+    LoadSchedule(rk, ks);
+    t = vld1q_u8(mac);
+    if (decrypt && len) {
+        k = EncryptHW(rk, vld1q_u8(ctr));
+        IncrementCounter(ctr);
+    }
+    while (len) {
+        uint32_t n = (len < 16) ? len : 16;
+
+        len -= n;
+        memset(block, 0, sizeof(block));
+        memcpy(block, in, n);
+        x = vld1q_u8(block);
+        in += n;
+        if (decrypt) {
+            x = veorq_u8(x, k);
+            vst1q_u8(block, x);
+            memcpy(out, block, n);
+            if (n < 16) {
+                memset(block + n, 0, 16 - n);
+                x = vld1q_u8(block);
+            }
+            t = veorq_u8(t, x);
+            if (len) {
+                k = vld1q_u8(ctr);
+                IncrementCounter(ctr);
+                EncryptHW2(rk, &t, &k);
+            } else {
+                t = EncryptHW(rk, t);
+            }
+        } else {
+            c = vld1q_u8(ctr);
+            IncrementCounter(ctr);
+            t = veorq_u8(t, x);
+            EncryptHW2(rk, &t, &c);
+            vst1q_u8(block, veorq_u8(x, c));
+            memcpy(out, block, n);
+        }
+        out += n;
+    }
+    vst1q_u8(mac, t);
+}
+
+#endif
+
+#endif // AJ_AES_HW_ACCEL
+
+#endif // AJ_TARGET_POSIX
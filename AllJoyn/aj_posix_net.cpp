@@ -0,0 +1,333 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#define AJ_MODULE NET
+
+#include "aj_target.h"
+
+#if defined(AJ_TARGET_POSIX) && !defined(AJ_NET_CC3000)
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "aj_bufio.h"
+#include "aj_net.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+
+/*
+ * IANA assigned IPv4 multicast group for AllJoyn.
+ */
+static const char AJ_IPV4_MULTICAST_GROUP[] = "224.0.0.113";
+
+/*
+ * IANA assigned UDP multicast port for AllJoyn
+ */
+#define AJ_UDP_PORT 9956
+
+#define INVALID_SOCKET (-1)
+
+/*
+ * The socket descriptors live in the I/O buffer context
+ */
+#define SOCKET_OF(buf) ((int)(intptr_t)(buf)->context)
+
+static int tcpSock = INVALID_SOCKET;
+static int mcastSock = INVALID_SOCKET;
+
+/*
+ * Same sizing as the Arduino target so host measurements are representative.
+ */
+static uint8_t rxData[1454];
+static uint8_t txData[1024];
+
+/*
+ * Read-ahead between the socket and the I/O buffer, as on the Arduino target
+ */
+#define AJ_RX_RING_SIZE 512
+#define AJ_RX_DIRECT_READ (AJ_RX_RING_SIZE / 2)
+static uint8_t rxRingData[AJ_RX_RING_SIZE];
+static AJ_RingBuffer rxRing;
+
+/*
+ * Wait until the socket is readable or the timeout expires
+ */
+static AJ_Status WaitReadable(int sock, uint32_t timeout)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    do {
+        ret = poll(&pfd, 1, (int)timeout);
+    } while ((ret == -1) && (errno == EINTR));
+
+    if (ret == 0) {
+        return AJ_ERR_TIMEOUT;
+    }
+    if ((ret < 0) || (pfd.revents & (POLLERR | POLLNVAL))) {
+        return AJ_ERR_READ;
+    }
+    return AJ_OK;
+}
+
+AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
+{
+    ssize_t ret;
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    AJ_InfoPrintf(("AJ_Net_Send(buf=0x%p)\n", buf));
+
+    while (tx > 0) {
+        ret = send(SOCKET_OF(buf), buf->readPtr, tx, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            AJ_ErrPrintf(("AJ_Net_Send(): send() failed. errno=%d, status=AJ_ERR_WRITE\n", errno));
+            return AJ_ERR_WRITE;
+        }
+        buf->readPtr += ret;
+        tx -= (uint32_t)ret;
+    }
+    AJ_IO_BUF_RESET(buf);
+
+    AJ_InfoPrintf(("AJ_Net_Send(): status=AJ_OK\n"));
+    return AJ_OK;
+}
+
+static ssize_t RecvRetry(int sock, uint8_t* data, size_t len)
+{
+    ssize_t ret;
+
+    do {
+        ret = recv(sock, data, len, 0);
+    } while ((ret == -1) && (errno == EINTR));
+    return ret;
+}
+
+AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    AJ_Status status;
+    ssize_t ret;
+    uint16_t contig;
+    uint8_t* ringPtr;
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), len);
+
+    AJ_InfoPrintf(("AJ_Net_Recv(buf=0x%p, len=%d., timeout=%d.)\n", buf, len, timeout));
+
+    if (AJ_RING_BUF_AVAIL(&rxRing) == 0) {
+        status = WaitReadable(SOCKET_OF(buf), timeout);
+        if (status != AJ_OK) {
+            AJ_InfoPrintf(("AJ_Net_Recv(): status=%s\n", AJ_StatusText(status)));
+            return status;
+        }
+        if (rx >= AJ_RX_DIRECT_READ) {
+            ringPtr = buf->writePtr;
+            contig = (uint16_t)rx;
+        } else {
+            rxRing.head = rxRing.tail = 0;
+            ringPtr = AJ_RingBufWritePtr(&rxRing, &contig);
+        }
+        ret = RecvRetry(SOCKET_OF(buf), ringPtr, contig);
+        if (ret <= 0) {
+            /*
+             * Zero bytes from a readable socket means the peer closed the connection
+             */
+            AJ_ErrPrintf(("AJ_Net_Recv(): recv() failed. errno=%d, status=AJ_ERR_READ\n", (ret == 0) ? 0 : errno));
+            return AJ_ERR_READ;
+        }
+        AJ_DumpBytes("Recv", ringPtr, (uint32_t)ret);
+        if (ringPtr == buf->writePtr) {
+            buf->writePtr += ret;
+            return AJ_OK;
+        }
+        AJ_RingBufCommit(&rxRing, (uint16_t)ret);
+    }
+    buf->writePtr += AJ_RingBufRead(&rxRing, buf->writePtr, (uint16_t)rx);
+
+    AJ_InfoPrintf(("AJ_Net_Recv(): status=AJ_OK\n"));
+    return AJ_OK;
+}
+
+AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr)
+{
+    struct sockaddr_in sin;
+    int one = 1;
+
+    AJ_InfoPrintf(("AJ_Net_Connect(nexSock=0x%p, port=%d., addrType=%d., addr=0x%p)\n", netSock, port, addrType, addr));
+
+    if (addrType != AJ_ADDR_IPV4) {
+        AJ_ErrPrintf(("AJ_Net_Connect(): only IPv4 is supported. status=AJ_ERR_CONNECT\n"));
+        return AJ_ERR_CONNECT;
+    }
+    tcpSock = socket(AF_INET, SOCK_STREAM, 0);
+    if (tcpSock == INVALID_SOCKET) {
+        AJ_ErrPrintf(("AJ_Net_Connect(): socket() failed. errno=%d, status=AJ_ERR_CONNECT\n", errno));
+        return AJ_ERR_CONNECT;
+    }
+    /*
+     * AllJoyn messages are small and latency sensitive
+     */
+    setsockopt(tcpSock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    sin.sin_addr.s_addr = *addr;
+    if (connect(tcpSock, (struct sockaddr*)&sin, sizeof(sin)) == -1) {
+        AJ_ErrPrintf(("AJ_Net_Connect(): connect() failed. errno=%d, status=AJ_ERR_CONNECT\n", errno));
+        close(tcpSock);
+        tcpSock = INVALID_SOCKET;
+        return AJ_ERR_CONNECT;
+    }
+    AJ_RingBufInit(&rxRing, rxRingData, sizeof(rxRingData));
+    AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)(intptr_t)tcpSock);
+    netSock->rx.recv = AJ_Net_Recv;
+    AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)(intptr_t)tcpSock);
+    netSock->tx.send = AJ_Net_Send;
+
+    AJ_InfoPrintf(("AJ_Net_Connect(): status=AJ_OK\n"));
+    return AJ_OK;
+}
+
+void AJ_Net_Disconnect(AJ_NetSocket* netSock)
+{
+    AJ_InfoPrintf(("AJ_Net_Disconnect(nexSock=0x%p)\n", netSock));
+
+    if (tcpSock != INVALID_SOCKET) {
+        shutdown(tcpSock, SHUT_RDWR);
+        close(tcpSock);
+        tcpSock = INVALID_SOCKET;
+    }
+}
+
+AJ_Status AJ_Net_SendTo(AJ_IOBuffer* buf)
+{
+    ssize_t ret;
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+    struct sockaddr_in sin;
+
+    AJ_InfoPrintf(("AJ_Net_SendTo(buf=0x%p)\n", buf));
+
+    if (tx > 0) {
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(AJ_UDP_PORT);
+        inet_pton(AF_INET, AJ_IPV4_MULTICAST_GROUP, &sin.sin_addr);
+        ret = sendto(SOCKET_OF(buf), buf->readPtr, tx, MSG_NOSIGNAL, (struct sockaddr*)&sin, sizeof(sin));
+        if (ret == -1) {
+            AJ_ErrPrintf(("AJ_Net_SendTo(): sendto() failed. errno=%d, status=AJ_ERR_WRITE\n", errno));
+            return AJ_ERR_WRITE;
+        }
+        buf->readPtr += ret;
+    }
+    AJ_IO_BUF_RESET(buf);
+    AJ_InfoPrintf(("AJ_Net_SendTo(): status=AJ_OK\n"));
+    return AJ_OK;
+}
+
+AJ_Status AJ_Net_RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    AJ_Status status;
+    ssize_t ret;
+    uint32_t rx = AJ_IO_BUF_SPACE(buf);
+
+    AJ_InfoPrintf(("AJ_Net_RecvFrom(buf=0x%p, len=%d., timeout=%d.)\n", buf, len, timeout));
+
+    rx = min(rx, len);
+    status = WaitReadable(SOCKET_OF(buf), timeout);
+    if (status != AJ_OK) {
+        AJ_InfoPrintf(("AJ_Net_RecvFrom(): status=%s\n", AJ_StatusText(status)));
+        return status;
+    }
+    ret = recvfrom(SOCKET_OF(buf), buf->writePtr, rx, 0, NULL, 0);
+    if (ret == -1) {
+        AJ_ErrPrintf(("AJ_Net_RecvFrom(): recvfrom() failed. errno=%d, status=AJ_ERR_READ\n", errno));
+        return AJ_ERR_READ;
+    }
+    AJ_DumpBytes("AJ_Net_RecvFrom", buf->writePtr, (uint32_t)ret);
+    buf->writePtr += ret;
+
+    AJ_InfoPrintf(("AJ_Net_RecvFrom(): status=AJ_OK\n"));
+    return AJ_OK;
+}
+
+AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
+{
+    struct sockaddr_in sin;
+    struct ip_mreq mreq;
+    int one = 1;
+
+    AJ_InfoPrintf(("AJ_Net_MCastUp(nexSock=0x%p)\n", netSock));
+
+    mcastSock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (mcastSock == INVALID_SOCKET) {
+        AJ_ErrPrintf(("AJ_Net_MCastUp(): socket() failed. errno=%d, status=AJ_ERR_READ\n", errno));
+        return AJ_ERR_READ;
+    }
+    /*
+     * A routing daemon or a second client on the same host may already own the port
+     */
+    setsockopt(mcastSock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(AJ_UDP_PORT);
+    sin.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(mcastSock, (struct sockaddr*)&sin, sizeof(sin)) == -1) {
+        AJ_ErrPrintf(("AJ_Net_MCastUp(): bind() failed. errno=%d, status=AJ_ERR_READ\n", errno));
+        close(mcastSock);
+        mcastSock = INVALID_SOCKET;
+        return AJ_ERR_READ;
+    }
+    inet_pton(AF_INET, AJ_IPV4_MULTICAST_GROUP, &mreq.imr_multiaddr);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(mcastSock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1) {
+        /*
+         * Not fatal, a daemon on the loopback interface still answers
+         */
+        AJ_WarnPrintf(("AJ_Net_MCastUp(): IP_ADD_MEMBERSHIP failed. errno=%d\n", errno));
+    }
+    AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)(intptr_t)mcastSock);
+    netSock->rx.recv = AJ_Net_RecvFrom;
+    AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)(intptr_t)mcastSock);
+    netSock->tx.send = AJ_Net_SendTo;
+
+    AJ_InfoPrintf(("AJ_Net_MCastUp(): status=AJ_OK\n"));
+    return AJ_OK;
+}
+
+void AJ_Net_MCastDown(AJ_NetSocket* netSock)
+{
+    AJ_InfoPrintf(("AJ_Net_MCastDown(nexSock=0x%p)\n", netSock));
+
+    if (mcastSock != INVALID_SOCKET) {
+        close(mcastSock);
+        mcastSock = INVALID_SOCKET;
+    }
+}
+
+#endif // AJ_TARGET_POSIX && !AJ_NET_CC3000
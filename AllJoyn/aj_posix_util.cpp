@@ -0,0 +1,142 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include "aj_target.h"
+
+#ifdef AJ_TARGET_POSIX
+
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include "aj_util.h"
+
+void AJ_Sleep(uint32_t time)
+{
+    struct timespec ts;
+
+    ts.tv_sec = time / 1000;
+    ts.tv_nsec = (long)(time % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) == -1) {
+    }
+}
+
+uint32_t AJ_GetElapsedTime(AJ_Time* timer, uint8_t cumulative)
+{
+    uint32_t elapsed;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (uint32_t)((1000 * (now.tv_sec - timer->seconds)) + ((now.tv_nsec / 1000000) - timer->milliseconds));
+    if (!cumulative) {
+        timer->seconds = (uint32_t)now.tv_sec;
+        timer->milliseconds = (uint16_t)(now.tv_nsec / 1000000);
+    }
+    return elapsed;
+}
+
+void AJ_InitTimer(AJ_Time* timer)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timer->seconds = (uint32_t)now.tv_sec;
+    timer->milliseconds = (uint16_t)(now.tv_nsec / 1000000);
+}
+
+void* AJ_Malloc(size_t sz)
+{
+    return malloc(sz);
+}
+
+void* AJ_Realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void AJ_Free(void* mem)
+{
+    if (mem) {
+        free(mem);
+    }
+}
+
+void ram_diag()
+{
+    AJ_Printf("SRAM usage (stack, heap, static): %d, %d, %d\n",
+              stack_used(),
+              heap_used(),
+              static_used());
+}
+
+uint8_t AJ_StartReadFromStdIn()
+{
+    return FALSE;
+}
+
+uint8_t AJ_StopReadFromStdIn()
+{
+    return FALSE;
+}
+
+char* AJ_GetCmdLine(char* buf, size_t num)
+{
+    struct pollfd pfd;
+
+    /*
+     * Mirror the Arduino behavior of only returning a line when input is waiting
+     */
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    if ((poll(&pfd, 1, 0) > 0) && fgets(buf, (int)num, stdin)) {
+        buf[strcspn(buf, "\n")] = '\0';
+        return buf;
+    } else {
+        return NULL;
+    }
+}
+
+#ifndef NDEBUG
+
+uint8_t dbgCONFIGUREME = 0;
+uint8_t dbgNET = 0;
+uint8_t dbgTARGET_CRYPTO = 0;
+uint8_t dbgTARGET_NVRAM = 0;
+uint8_t dbgTARGET_UTIL = 0;
+
+int _AJ_DbgEnabled(char* module)
+{
+    char buffer[64];
+    char* env;
+
+    env = getenv("ER_DEBUG_ALL");
+    if (env && (strcmp(env, "1") == 0)) {
+        return TRUE;
+    }
+    snprintf(buffer, sizeof(buffer), "ER_DEBUG_%s", module);
+    env = getenv(buffer);
+    if (env && (strcmp(env, "1") == 0)) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
+
+#endif // AJ_TARGET_POSIX
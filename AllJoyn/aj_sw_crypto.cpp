@@ -19,15 +19,12 @@
 
 #include "aj_target.h"
 #include "aj_crypto.h"
+#include "aj_config.h"
 
-
-#define MAX_SCHEDULE_LEN 48
-
-typedef struct {
-    uint32_t fkey[MAX_SCHEDULE_LEN];
-} AES_CTX;
-
-static AES_CTX aes_context;
+/*
+ * Key schedule used by the AJ_AES_Enable() block API
+ */
+static AJ_AES_Key aes_context;
 
 #define ROTL8(x)  ((((uint32_t)(x)) << 8)  | (((uint32_t)(x)) >> 24))
 #define ROTL16(x) ((((uint32_t)(x)) << 16) | (((uint32_t)(x)) >> 16))
@@ -43,6 +40,7 @@ static AES_CTX aes_context;
 #define ROW_2(x)   (uint8_t)((x) >> 16)
 #define ROW_3(x)   (uint8_t)((x) >> 24)
 
+#ifndef AJ_AES_CONST_TIME
 
 /* The Rijndael S-box matrix */
 static const uint8_t sbox[256] = {
@@ -99,36 +97,14 @@ static const uint32_t ftable[256] = {
     0xc3414182, 0xb0999929, 0x772d2d5a, 0x110f0f1e, 0xcbb0b07b, 0xfc5454a8, 0xd6bbbb6d, 0x3a16162c
 };
 
-static const uint32_t Rconst[12] =
+#endif
+
+static const uint32_t Rconst[10] =
 {
-    0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36, 0x6c, 0xd8
+    0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
 };
 
-
-#define round_column(x0, x1, x2, x3) \
-    ftable[ROW_0(x0)] ^ ROTL8(ftable[ROW_1(x1)]) ^ ROTL16(ftable[ROW_2(x2)]) ^  ROTL24(ftable[ROW_3(x3)])
-
-/*
- * yn are inputs xn are outputs
- */
-#define round(y0, y1, y2, y3, x0, x1, x2, x3, key) \
-    y0 = round_column(x0, x1, x2, x3) ^ *key++; \
-    y1 = round_column(x1, x2, x3, x0) ^ *key++; \
-    y2 = round_column(x2, x3, x0, x1) ^ *key++; \
-    y3 = round_column(x3, x0, x1, x2) ^ *key++;
-
-#define lastround_column(x0, x1, x2, x3) \
-    (uint32_t)sbox[ROW_0(x0)] ^ SHFL8(sbox[ROW_1(x1)]) ^ SHFL16(sbox[ROW_2(x2)]) ^ SHFL24(sbox[ROW_3(x3)])
-
-/*
- * yn are inputs xn are outputs
- */
-#define lastround(y0, y1, y2, y3, x0, x1, x2, x3, key) \
-    y0 = lastround_column(x0, x1, x2, x3) ^ *key++; \
-    y1 = lastround_column(x1, x2, x3, x0) ^ *key++; \
-    y2 = lastround_column(x2, x3, x0, x1) ^ *key++; \
-    y3 = lastround_column(x3, x0, x1, x2) ^ *key++;
-
+#define ROUNDS 10
 
 static void Pack32(uint32_t* u32, const uint8_t* u8)
 {
@@ -157,15 +133,43 @@ static void Unpack32(uint8_t* u8, const uint32_t* u32)
 #endif
 }
 
-static uint32_t SubBytes(uint32_t a)
+#ifndef AJ_AES_CONST_TIME
+
+/*
+ * T-table AES. A single 1KB table is used for all four columns; the rotations
+ * are free on ARM where they fold into the barrel shifter.
+ */
+
+#define round_column(x0, x1, x2, x3) \
+    ftable[ROW_0(x0)] ^ ROTL8(ftable[ROW_1(x1)]) ^ ROTL16(ftable[ROW_2(x2)]) ^  ROTL24(ftable[ROW_3(x3)])
+
+/*
+ * yn are inputs xn are outputs
+ */
+#define round(y0, y1, y2, y3, x0, x1, x2, x3, key) \
+    y0 = round_column(x0, x1, x2, x3) ^ *key++; \
+    y1 = round_column(x1, x2, x3, x0) ^ *key++; \
+    y2 = round_column(x2, x3, x0, x1) ^ *key++; \
+    y3 = round_column(x3, x0, x1, x2) ^ *key++;
+
+#define lastround_column(x0, x1, x2, x3) \
+    (uint32_t)sbox[ROW_0(x0)] ^ SHFL8(sbox[ROW_1(x1)]) ^ SHFL16(sbox[ROW_2(x2)]) ^ SHFL24(sbox[ROW_3(x3)])
+
+/*
+ * yn are inputs xn are outputs
+ */
+#define lastround(y0, y1, y2, y3, x0, x1, x2, x3, key) \
+    y0 = lastround_column(x0, x1, x2, x3) ^ *key++; \
+    y1 = lastround_column(x1, x2, x3, x0) ^ *key++; \
+    y2 = lastround_column(x2, x3, x0, x1) ^ *key++; \
+    y3 = lastround_column(x3, x0, x1, x2) ^ *key++;
+
+static uint32_t SubWord(uint32_t a)
 {
     return (uint32_t)sbox[(uint8_t)(a)] | (sbox[(uint8_t)(a >> 8)] << 8) | (sbox[(uint8_t)(a >> 16)] << 16) | (sbox[(uint8_t)(a >> 24)] << 24);
 }
 
-#define ROUNDS 10
-
-
-static void EncryptRounds(uint32_t* out, uint32_t* in, uint32_t* key)
+static void EncryptRounds(uint32_t* out, const uint32_t* in, const uint32_t* key)
 {
     int i;
     uint32_t x0 = in[0];
@@ -191,63 +195,559 @@ static void EncryptRounds(uint32_t* out, uint32_t* in, uint32_t* key)
     out[3] = x3;
 }
 
-void AJ_AES_Enable(const uint8_t* key)
+/*
+ * Two independent blocks, interleaved round by round so the table lookups of
+ * one block can issue while the other is waiting on memory.
+ */
+static void EncryptRounds2(uint32_t* a, uint32_t* b, const uint32_t* key)
+{
+    int i;
+    uint32_t a0 = a[0];
+    uint32_t a1 = a[1];
+    uint32_t a2 = a[2];
+    uint32_t a3 = a[3];
+    uint32_t b0 = b[0];
+    uint32_t b1 = b[1];
+    uint32_t b2 = b[2];
+    uint32_t b3 = b[3];
+    uint32_t c0, c1, c2, c3;
+    uint32_t d0, d1, d2, d3;
+    const uint32_t* k2;
+
+    for (i = 0; i < 4; i++) {
+        k2 = key;
+        round(c0, c1, c2, c3, a0, a1, a2, a3, key);
+        round(d0, d1, d2, d3, b0, b1, b2, b3, k2);
+        k2 = key;
+        round(a0, a1, a2, a3, c0, c1, c2, c3, key);
+        round(b0, b1, b2, b3, d0, d1, d2, d3, k2);
+    }
+    k2 = key;
+    round(c0, c1, c2, c3, a0, a1, a2, a3, key);
+    round(d0, d1, d2, d3, b0, b1, b2, b3, k2);
+    k2 = key;
+    lastround(a0, a1, a2, a3, c0, c1, c2, c3, key);
+    lastround(b0, b1, b2, b3, d0, d1, d2, d3, k2);
+
+    a[0] = a0;
+    a[1] = a1;
+    a[2] = a2;
+    a[3] = a3;
+    b[0] = b0;
+    b[1] = b1;
+    b[2] = b2;
+    b[3] = b3;
+}
+
+#else // AJ_AES_CONST_TIME
+
+/*
+ * Constant-time AES. There are no secret dependent table lookups or branches:
+ * SubBytes is computed for all 16 state bytes at once with the Boyar-Peralta
+ * S-box circuit on bit planes, the linear layers work on 32 bit columns.
+ */
+
+/*
+ * Transpose an 8x8 bit matrix held one row per byte
+ */
+static uint64_t Transpose8(uint64_t x)
+{
+    uint64_t t;
+
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+/*
+ * Apply the S-box to bit planes, q[i] holds bit i of each byte
+ */
+static void SboxPlanes(uint32_t* q)
 {
+    uint32_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint32_t y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11, y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+    uint32_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11, z12, z13, z14, z15, z16, z17;
+    uint32_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint32_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint32_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint32_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint32_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+    /*
+     * Top linear transformation
+     */
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+    /*
+     * Non-linear section
+     */
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+    /*
+     * Bottom linear transformation
+     */
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+/*
+ * SubBytes on the four state columns of two blocks. Each plane holds 16 bytes
+ * of x in the low half and 16 bytes of y in the high half.
+ */
+static void SubStates(uint32_t* x, uint32_t* y)
+{
+    uint32_t q[8];
+    uint64_t xl = Transpose8((uint64_t)x[0] | ((uint64_t)x[1] << 32));
+    uint64_t xh = Transpose8((uint64_t)x[2] | ((uint64_t)x[3] << 32));
+    uint64_t yl = Transpose8((uint64_t)y[0] | ((uint64_t)y[1] << 32));
+    uint64_t yh = Transpose8((uint64_t)y[2] | ((uint64_t)y[3] << 32));
     int i;
-    uint32_t* fkey = aes_context.fkey;
+
+    for (i = 0; i < 8; ++i) {
+        q[i] = (uint32_t)((xl >> (8 * i)) & 0xFF) | (uint32_t)(((xh >> (8 * i)) & 0xFF) << 8) |
+               (uint32_t)(((yl >> (8 * i)) & 0xFF) << 16) | (uint32_t)(((yh >> (8 * i)) & 0xFF) << 24);
+    }
+    SboxPlanes(q);
+    xl = xh = yl = yh = 0;
+    for (i = 0; i < 8; ++i) {
+        xl |= (uint64_t)(q[i] & 0xFF) << (8 * i);
+        xh |= (uint64_t)((q[i] >> 8) & 0xFF) << (8 * i);
+        yl |= (uint64_t)((q[i] >> 16) & 0xFF) << (8 * i);
+        yh |= (uint64_t)(q[i] >> 24) << (8 * i);
+    }
+    xl = Transpose8(xl);
+    xh = Transpose8(xh);
+    yl = Transpose8(yl);
+    yh = Transpose8(yh);
+    x[0] = (uint32_t)xl;
+    x[1] = (uint32_t)(xl >> 32);
+    x[2] = (uint32_t)xh;
+    x[3] = (uint32_t)(xh >> 32);
+    y[0] = (uint32_t)yl;
+    y[1] = (uint32_t)(yl >> 32);
+    y[2] = (uint32_t)yh;
+    y[3] = (uint32_t)(yh >> 32);
+}
+
+static uint32_t SubWord(uint32_t a)
+{
+    uint32_t x[4] = { a, 0, 0, 0 };
+    uint32_t y[4] = { 0, 0, 0, 0 };
+    SubStates(x, y);
+    return x[0];
+}
+
+/*
+ * Multiply each byte by 2 in GF(2^8)
+ */
+#define XTIME(w) ((((w) & 0x7F7F7F7F) << 1) ^ ((((w) >> 7) & 0x01010101) * 0x1B))
+
+#define ROTR8(x)  ROTL24(x)
+#define ROTR16(x) ROTL16(x)
+#define ROTR24(x) ROTL8(x)
+
+/*
+ * Row r of the output column comes from column (c + r) of the input
+ */
+#define SHIFT_COLUMN(x0, x1, x2, x3) \
+    (((x0) & 0x000000FF) | ((x1) & 0x0000FF00) | ((x2) & 0x00FF0000) | ((x3) & 0xFF000000))
+
+static uint32_t MixColumn(uint32_t w)
+{
+    uint32_t r = ROTR8(w);
+    return XTIME(w ^ r) ^ r ^ ROTR16(w) ^ ROTR24(w);
+}
+
+/*
+ * ShiftRows, MixColumns (except in the last round) and AddRoundKey
+ */
+static void LinearLayer(uint32_t* x, const uint32_t* key, int last)
+{
+    uint32_t y0 = SHIFT_COLUMN(x[0], x[1], x[2], x[3]);
+    uint32_t y1 = SHIFT_COLUMN(x[1], x[2], x[3], x[0]);
+    uint32_t y2 = SHIFT_COLUMN(x[2], x[3], x[0], x[1]);
+    uint32_t y3 = SHIFT_COLUMN(x[3], x[0], x[1], x[2]);
+
+    if (!last) {
+        y0 = MixColumn(y0);
+        y1 = MixColumn(y1);
+        y2 = MixColumn(y2);
+        y3 = MixColumn(y3);
+    }
+    x[0] = y0 ^ key[0];
+    x[1] = y1 ^ key[1];
+    x[2] = y2 ^ key[2];
+    x[3] = y3 ^ key[3];
+}
+
+/*
+ * Two blocks share the S-box evaluation so this costs little more than one
+ */
+static void EncryptRounds2(uint32_t* a, uint32_t* b, const uint32_t* key)
+{
+    int i;
+
+    for (i = 1; i <= ROUNDS; ++i, key += 4) {
+        SubStates(a, b);
+        LinearLayer(a, key, i == ROUNDS);
+        LinearLayer(b, key, i == ROUNDS);
+    }
+}
+
+static void EncryptRounds(uint32_t* out, const uint32_t* in, const uint32_t* key)
+{
+    uint32_t x[4];
+    uint32_t y[4] = { 0, 0, 0, 0 };
+
+    memcpy(x, in, sizeof(x));
+    EncryptRounds2(x, y, key);
+    memcpy(out, x, sizeof(x));
+}
+
+#endif // AJ_AES_CONST_TIME
+
+/*
+ * Encrypt a block that has been packed into words
+ */
+static void EncryptBlock(const AJ_AES_Key* ks, uint32_t* out, const uint32_t* in)
+{
+    uint32_t tmp[4];
+
+    tmp[0] = in[0] ^ ks->fkey[0];
+    tmp[1] = in[1] ^ ks->fkey[1];
+    tmp[2] = in[2] ^ ks->fkey[2];
+    tmp[3] = in[3] ^ ks->fkey[3];
+    EncryptRounds(out, tmp, &ks->fkey[4]);
+}
+
+/*
+ * Encrypt two independent blocks that have been packed into words
+ */
+static void EncryptBlock2(const AJ_AES_Key* ks, uint32_t* out0, const uint32_t* in0, uint32_t* out1, const uint32_t* in1)
+{
+    uint32_t a[4];
+    uint32_t b[4];
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        a[i] = in0[i] ^ ks->fkey[i];
+        b[i] = in1[i] ^ ks->fkey[i];
+    }
+    EncryptRounds2(a, b, &ks->fkey[4]);
+    memcpy(out0, a, sizeof(a));
+    memcpy(out1, b, sizeof(b));
+}
+
+/*
+ * The counter field is big-endian (dumb idea given everything else is processed little endian)
+ */
+static void IncrementCounter(uint32_t* counter)
+{
+    /*
+     * Pack32() loads the counter bytes little-endian on any host so swap them, increment the
+     * full 32 bits and swap them back
+     */
+    uint32_t c = counter[3];
+
+    c = (c >> 24) | ((c >> 8) & 0x0000FF00) | ((c << 8) & 0x00FF0000) | (c << 24);
+    ++c;
+    counter[3] = (c >> 24) | ((c >> 8) & 0x0000FF00) | ((c << 8) & 0x00FF0000) | (c << 24);
+}
+
+void AJ_AES_ExpandKey(AJ_AES_Key* ks, const uint8_t* key)
+{
+    int i;
+    uint32_t* fkey = ks->fkey;
 
     Pack32(fkey, key);
-    for (i = 0; i <= ROUNDS; ++i, fkey += 4) {
-        fkey[4] = fkey[0] ^ SubBytes(ROTL24(fkey[3])) ^ Rconst[i];
+    for (i = 0; i < ROUNDS; ++i, fkey += 4) {
+        fkey[4] = fkey[0] ^ SubWord(ROTL24(fkey[3])) ^ Rconst[i];
         fkey[5] = fkey[1] ^ fkey[4];
         fkey[6] = fkey[2] ^ fkey[5];
         fkey[7] = fkey[3] ^ fkey[6];
     }
 }
 
-void AJ_AES_Disable(void)
-{
-    memset(&aes_context, 0, sizeof(aes_context));
-}
-
-void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+void AJ_AES_CTR_128_Expanded(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
 {
     uint32_t counter[4];
 
+#ifdef AJ_AES_HW_ACCEL
+    if (AJ_AES_HW_Supported()) {
+        AJ_AES_HW_CTR_128(ks, in, out, len, ctr);
+        return;
+    }
+#endif
     Pack32(counter, ctr);
 
     while (len) {
         uint32_t tmp[4];
-        uint32_t i;
         uint32_t n = min(len, 16);
         uint8_t* p = (uint8_t*)tmp;
 
-        for (i = 0; i < 4; ++i) {
-            tmp[i] = counter[i] ^ aes_context.fkey[i];
-        }
-        EncryptRounds(tmp, tmp, &aes_context.fkey[4]);
+        EncryptBlock(ks, tmp, counter);
         len -= n;
         while (n--) {
             *out++ = *p++ ^ *in++;
         }
-        /*
-         * The counter field is big-endian (dumb idea given everything else is processed little endian)
-         */
-#if HOST_IS_LITTLE_ENDIAN
-        /*
-         * A big-endian increment of a 32 bit counter on a little-endian CPU.
-         * Only supports counter values up to 2^16 because that is all we need
-         */
-        if (counter[3] == 0xFF000000) {
-            counter[3] += 0x00010000;
+        IncrementCounter(counter);
+    }
+
+    Unpack32(ctr, counter);
+}
+
+void AJ_AES_CBC_MAC_128(const AJ_AES_Key* ks, const uint8_t* in, uint32_t len, uint8_t* mac)
+{
+    uint32_t xorbuf[4];
+    uint32_t ivt[4];
+
+    AJ_ASSERT((len % 16) == 0);
+
+#ifdef AJ_AES_HW_ACCEL
+    if (AJ_AES_HW_Supported()) {
+        AJ_AES_HW_CBC_MAC_128(ks, in, len, mac);
+        return;
+    }
+#endif
+    Pack32(ivt, mac);
+    while (len) {
+        int i;
+        Pack32(xorbuf, in);
+        for (i = 0; i < 4; ++i) {
+            xorbuf[i] ^= ivt[i];
         }
-        counter[3] += 0x01000000;
-#else
-        counter[3] += 1;
+        EncryptBlock(ks, ivt, xorbuf);
+        in += 16;
+        len -= 16;
+    }
+    Unpack32(mac, ivt);
+}
+
+void AJ_AES_CCM_128(const AJ_AES_Key* ks, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt)
+{
+    uint32_t counter[4];
+    uint32_t t[4];
+    uint32_t k[4];
+    uint32_t x[4];
+    uint32_t p[4];
+    uint8_t block[16];
+    int i;
+
+#ifdef AJ_AES_HW_ACCEL
+    if (AJ_AES_HW_Supported()) {
+        AJ_AES_HW_CCM_128(ks, in, out, len, ctr, mac, decrypt);
+        return;
+    }
 #endif
+    Pack32(counter, ctr);
+    Pack32(t, mac);
+    /*
+     * When decrypting the MAC input depends on the key stream so the key stream
+     * runs one block ahead and is paired with the MAC of the previous block.
+     */
+    if (decrypt && len) {
+        EncryptBlock(ks, k, counter);
+        IncrementCounter(counter);
     }
+    while (len) {
+        uint32_t n = min(len, 16);
 
+        len -= n;
+        if (n < 16) {
+            memset(block, 0, sizeof(block));
+        }
+        memcpy(block, in, n);
+        in += n;
+        Pack32(p, block);
+        if (decrypt) {
+            for (i = 0; i < 4; ++i) {
+                p[i] ^= k[i];
+            }
+            Unpack32(block, p);
+            memcpy(out, block, n);
+            if (n < 16) {
+                /*
+                 * The MAC is over the zero padded plain text
+                 */
+                memset(block + n, 0, 16 - n);
+                Pack32(p, block);
+            }
+            for (i = 0; i < 4; ++i) {
+                x[i] = p[i] ^ t[i];
+            }
+            if (len) {
+                EncryptBlock2(ks, t, x, k, counter);
+                IncrementCounter(counter);
+            } else {
+                EncryptBlock(ks, t, x);
+            }
+        } else {
+            for (i = 0; i < 4; ++i) {
+                x[i] = p[i] ^ t[i];
+            }
+            EncryptBlock2(ks, t, x, k, counter);
+            IncrementCounter(counter);
+            for (i = 0; i < 4; ++i) {
+                p[i] ^= k[i];
+            }
+            Unpack32(block, p);
+            memcpy(out, block, n);
+        }
+        out += n;
+    }
     Unpack32(ctr, counter);
+    Unpack32(mac, t);
+}
+
+void AJ_AES_Enable(const uint8_t* key)
+{
+    AJ_AES_ExpandKey(&aes_context, key);
+}
+
+void AJ_AES_Disable(void)
+{
+    memset(&aes_context, 0, sizeof(aes_context));
+}
+
+void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    /*
+     * The key was expanded by AJ_AES_Enable()
+     */
+    (void)key;
+    AJ_AES_CTR_128_Expanded(&aes_context, in, out, len, ctr);
 }
 
 void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* iv)
@@ -255,6 +755,7 @@ void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out,
     uint32_t xorbuf[4];
     uint32_t ivt[4];
 
+    (void)key;
     AJ_ASSERT((len % 16) == 0);
 
     Pack32(ivt, iv);
@@ -262,9 +763,9 @@ void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out,
         int i;
         Pack32(xorbuf, in);
         for (i = 0; i < 4; ++i) {
-            xorbuf[i] ^= ivt[i] ^ aes_context.fkey[i];
+            xorbuf[i] ^= ivt[i];
         }
-        EncryptRounds(ivt, xorbuf, &aes_context.fkey[4]);
+        EncryptBlock(&aes_context, ivt, xorbuf);
         Unpack32(out, ivt);
         out += 16;
         in += 16;
@@ -278,7 +779,8 @@ void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out)
     uint32_t in32[4];
     uint32_t out32[4];
 
+    (void)key;
     Pack32(in32, in);
-    EncryptRounds(out32, in32, &aes_context.fkey[4]);
+    EncryptBlock(&aes_context, out32, in32);
     Unpack32(out, out32);
 }
@@ -19,14 +19,32 @@
  *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  ******************************************************************************/
 
+/*
+ * Anything not built by the Arduino toolchain is a POSIX host build (Linux or
+ * similar). The host target runs the same core against BSD sockets, a
+ * file-backed NVRAM and clock_gettime() so it can be profiled off-board.
+ */
+#if !defined(ARDUINO) && !defined(AJ_TARGET_POSIX)
+#define AJ_TARGET_POSIX
+#endif
+
+/*
+ * AJ_NET_CC3000 swaps the host's BSD socket transport for the Arduino one, so
+ * AJ_Net_* go through Triton_WiFi and the CC3000 emulator in Triton_WiFi/host.
+ */
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
+
+#ifndef AJ_TARGET_POSIX
 typedef signed char int8_t;           /** 8-bit signed integer */
 typedef unsigned char uint8_t;        /** 8-bit unsigned integer */
 typedef signed long long int64_t;     /** 64-bit signed integer */
 typedef unsigned long long uint64_t;  /** 64-bit unsigned integer */
 
+#endif
+
 typedef uint16_t suint32_t;  /* amount of data sent into a socket */
 
 
@@ -52,6 +70,21 @@ typedef uint16_t suint32_t;  /* amount of data sent into a socket */
 #endif
 
 // Begin Memory Diagnostics
+#ifdef AJ_TARGET_POSIX
+
+/*
+ * There is no fixed RAM map on the host; only the heap figure is meaningful.
+ */
+inline int stack_used() {
+    return 0;
+}
+
+inline int static_used() {
+    return 0;
+}
+
+#else
+
 static const char* ramstart = (char*)0x20070000;
 static const char* ramend = (char*)0x20088000;
 extern char _end;
@@ -65,6 +98,8 @@ inline int static_used() {
     return (&_end - ramstart);
 }
 
+#endif
+
 inline int heap_used() {
     struct mallinfo mi = mallinfo();
     return (mi.uordblks);
@@ -77,6 +112,16 @@ void ram_diag();
 #define HOST_IS_LITTLE_ENDIAN  TRUE
 #define HOST_IS_BIG_ENDIAN     FALSE
 
+/*
+ * Host CPUs usually have AES instructions, the software AES is only used if a
+ * runtime check says they are missing.
+ */
+#if defined(AJ_TARGET_POSIX) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#ifndef AJ_NO_AES_HW_ACCEL
+#define AJ_AES_HW_ACCEL
+#endif
+#endif
+
 //#ifdef WIFI_UDP_WORKING
 //    #include <WiFi.h>
 //    #include <WiFiUdp.h>
@@ -17,9 +17,12 @@
  *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  ******************************************************************************/
 
+#include "aj_target.h"
+
+#ifndef AJ_TARGET_POSIX
+
 #include "Arduino.h"    // for digitalRead, digitalWrite, etc
 
-#include "aj_target.h"
 #include "aj_crypto.h"
 
 int analogPin = 3;
@@ -65,3 +68,5 @@ void AJ_RandBytes(uint8_t* rand, uint32_t len)
     }
     AJ_AES_Disable();
 }
+
+#endif // AJ_TARGET_POSIX
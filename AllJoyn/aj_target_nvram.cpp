@@ -20,19 +20,62 @@
 #include "aj_nvram.h"
 #include "aj_target_nvram.h"
 
+#ifdef AJ_TARGET_POSIX
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 uint8_t AJ_EMULATED_NVRAM[AJ_NVRAM_SIZE];
 uint8_t* AJ_NVRAM_BASE_ADDRESS;
 
-extern void AJ_NVRAM_Layout_Print();
+#ifdef AJ_TARGET_POSIX
+/*
+ * On the host the NVRAM is a shared mapping of a file so credentials and the local GUID
+ * survive a restart, including a restart after the process was killed part way through a
+ * write. The file name can be set with AJ_NVRAM_FILE.
+ */
+static uint8_t _AJ_MapNVFile()
+{
+    const char* name = getenv("AJ_NVRAM_FILE");
+    struct stat st;
+    void* nv;
+    int fd;
+
+    if (!name) {
+        name = "ajtcl.nvram";
+    }
+    fd = open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        return FALSE;
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size != AJ_NVRAM_SIZE)) {
+        if (ftruncate(fd, AJ_NVRAM_SIZE) != 0) {
+            close(fd);
+            return FALSE;
+        }
+    }
+    nv = mmap(NULL, AJ_NVRAM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (nv == MAP_FAILED) {
+        return FALSE;
+    }
+    AJ_NVRAM_BASE_ADDRESS = (uint8_t*)nv;
+    return TRUE;
+}
+#endif
 
-void AJ_NVRAM_Init()
+uint8_t _AJ_NVRAM_Init()
 {
     AJ_NVRAM_BASE_ADDRESS = AJ_EMULATED_NVRAM;
-    static uint8_t inited = FALSE;
-    if (!inited) {
-        inited = TRUE;
-        _AJ_NVRAM_Clear();
+#ifdef AJ_TARGET_POSIX
+    if (_AJ_MapNVFile()) {
+        return (*((uint32_t*)AJ_NVRAM_BASE_ADDRESS) == AJ_NV_SENTINEL);
     }
+#endif
+    return FALSE;
 }
 
 void _AJ_NV_Write(void* dest, void* buf, uint16_t size)
@@ -45,36 +88,13 @@ void _AJ_NV_Read(void* src, void* buf, uint16_t size)
     memcpy(buf, src, size);
 }
 
-void _AJ_NVRAM_Clear()
+void _AJ_NV_Erase(void* dest, uint16_t size)
 {
-    memset((uint8_t*)AJ_NVRAM_BASE_ADDRESS, INVALID_DATA_BYTE, AJ_NVRAM_SIZE);
-    *((uint32_t*)AJ_NVRAM_BASE_ADDRESS) = AJ_NV_SENTINEL;
+    memset(dest, INVALID_DATA_BYTE, size);
 }
 
-// Compact the storage by removing invalid entries
-AJ_Status _AJ_CompactNVStorage()
+void _AJ_NVRAM_Clear()
 {
-    uint16_t capacity = 0;
-    uint16_t id = 0;
-    uint16_t* data = (uint16_t*)(AJ_NVRAM_BASE_ADDRESS + SENTINEL_OFFSET);
-    uint8_t* writePtr = (uint8_t*)data;
-    uint16_t entrySize = 0;
-    uint16_t garbage = 0;
-    //AJ_NVRAM_Layout_Print();
-    while ((uint8_t*)data < (uint8_t*)AJ_NVRAM_END_ADDRESS && *data != INVALID_DATA) {
-        id = *data;
-        capacity = *(data + 1);
-        entrySize = ENTRY_HEADER_SIZE + capacity;
-        if (id != INVALID_ID) {
-            _AJ_NV_Write(writePtr, data, entrySize);
-            writePtr += entrySize;
-        } else {
-            garbage += entrySize;
-        }
-        data += entrySize >> 1;
-    }
-
-    memset(writePtr, INVALID_DATA_BYTE, garbage);
-    //AJ_NVRAM_Layout_Print();
-    return AJ_OK;
+    memset((uint8_t*)AJ_NVRAM_BASE_ADDRESS, INVALID_DATA_BYTE, AJ_NVRAM_SIZE);
+    *((uint32_t*)AJ_NVRAM_BASE_ADDRESS) = AJ_NV_SENTINEL;
 }
@@ -22,24 +22,55 @@
 #include "alljoyn.h"
 
 /*
- * Identifies an AJ NVRAM block
+ * Identifies an AJ NVRAM block. The NVRAM is laid out as a log of records so the sentinel
+ * changed from "AJNV" when the log format was introduced.
  */
-#define AJ_NV_SENTINEL ('A' | ('J' << 8) | ('N' << 16) | ('V' << 24))
+#define AJ_NV_SENTINEL ('A' | ('J' << 8) | ('N' << 16) | ('L' << 24))
 #define INVALID_ID (0)
 #define INVALID_DATA (0xFFFF)
 #define INVALID_DATA_BYTE (0xFF)
 #define SENTINEL_OFFSET (4)
 #define WORD_ALIGN(x) ((x & 0x3) ? ((x >> 2) + 1) << 2 : x)
+#ifndef AJ_NVRAM_SIZE
 #define AJ_NVRAM_SIZE (2024)
+#endif
+
+/*
+ * Number of slots in the RAM index of data sets, must be a power of 2
+ */
+#ifndef AJ_NVRAM_INDEX_SIZE
+#define AJ_NVRAM_INDEX_SIZE (128)
+#endif
 
+/*
+ * Every version of a data set is appended to the log as a record: a header, the data and a
+ * trailer. A record is only valid once its trailer has been written.
+ */
 typedef struct _NV_EntryHeader {
     uint16_t id;           /**< The unique id */
     uint16_t capacity;     /**< The data set size */
+    uint16_t seq;          /**< Sequence number orders the records in the log */
+    uint16_t check;        /**< CRC over the fields above so a torn header is detected */
 } NV_EntryHeader;
 
+typedef struct _NV_EntryTrailer {
+    uint16_t crc;          /**< CRC over the header and data */
+    uint16_t commit;       /**< Set to NV_COMMIT_MARK when the record is complete */
+} NV_EntryTrailer;
+
+#define NV_COMMIT_MARK (0xA55A)
+
 #define ENTRY_HEADER_SIZE (sizeof(NV_EntryHeader))
+#define ENTRY_TRAILER_SIZE (sizeof(NV_EntryTrailer))
 #define AJ_NVRAM_END_ADDRESS (AJ_NVRAM_BASE_ADDRESS + AJ_NVRAM_SIZE)
 
+/**
+ * Map or allocate the NVRAM and load any saved contents
+ *
+ * @return TRUE if the NVRAM holds a valid AJ NVRAM block, FALSE if it needs to be cleared
+ */
+uint8_t _AJ_NVRAM_Init();
+
 /**
  * Write a block of data to NVRAM
  *
@@ -58,6 +89,13 @@ void _AJ_NV_Write(void* dest, void* buf, uint16_t size);
  */
 void _AJ_NV_Read(void* src, void* buf, uint16_t size);
 
+/**
+ * Return a block of NVRAM to the erased state
+ *
+ * @param dest  Pointer a location of NVRAM
+ * @param size  The number of bytes to be erased
+ */
+void _AJ_NV_Erase(void* dest, uint16_t size);
 
 /**
  * Erase the whole NVRAM sector and write the sentinel data
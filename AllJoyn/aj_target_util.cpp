@@ -17,8 +17,11 @@
  *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  ******************************************************************************/
 
-#include "Arduino.h"
 #include "aj_target.h"
+
+#ifndef AJ_TARGET_POSIX
+
+#include "Arduino.h"
 #include "aj_util.h"
 
 typedef struct time_struct {
@@ -116,3 +119,5 @@ int _AJ_DbgEnabled(char* module)
 }
 
 #endif
+
+#endif // AJ_TARGET_POSIX
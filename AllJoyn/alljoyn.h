@@ -34,6 +34,7 @@
 #include "aj_connect.h"
 #include "aj_about.h"
 #include "aj_helper.h"
+#include "aj_marshal.h"
 
 /**
  * @}
@@ -22,6 +22,53 @@
 #include "aj_crypto.h"
 #include "aj_debug.h"
 
+/*
+ * Amount of data to push through CCM between timer checks and the minimum time to measure for
+ */
+#define BENCH_BYTES (64 * 1024)
+#define BENCH_MS    500
+
+/*
+ * Throughput of CCM encrypt+MAC with a pre-expanded key, as used for messages to an authenticated peer
+ */
+static AJ_Status Throughput(uint32_t msgLen)
+{
+    static const uint8_t nonce[5] = { 0x00, 0x01, 0x02, 0x03, 0x04 };
+    static uint8_t msg[4096 + 16];
+    AJ_AES_Key ks;
+    uint8_t key[16];
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t count = 0;
+    uint32_t i;
+
+    memset(msg, 0xA5, sizeof(msg));
+    AJ_RandBytes(key, sizeof(key));
+    AJ_AES_ExpandKey(&ks, key);
+
+    AJ_InitTimer(&timer);
+    do {
+        for (i = 0; i < (BENCH_BYTES / msgLen); ++i) {
+            AJ_Status status = AJ_Encrypt_CCM_Expanded(&ks, msg, msgLen, 16, 8, nonce, sizeof(nonce));
+            if (status != AJ_OK) {
+                return status;
+            }
+        }
+        count += i;
+        elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    } while (elapsed < BENCH_MS);
+    /*
+     * Bytes per ms is (nearly) KB per second
+     */
+    i = (uint32_t)(((uint64_t)count * msgLen) / elapsed);
+    AJ_Printf("CCM %4u byte messages: %u.%02u MB/s", msgLen, i / 1000, (i % 1000) / 10);
+#ifdef F_CPU
+    AJ_Printf(", %u cycles/byte", (uint32_t)(((uint64_t)elapsed * (F_CPU / 1000)) / ((uint64_t)count * msgLen)));
+#endif
+    AJ_Printf("\n");
+    return AJ_OK;
+}
+
 typedef struct {
     const char* key;     /* AES key */
     const char* nonce;   /* Nonce */
@@ -302,6 +349,55 @@ static TEST_CASE const testVector[] = {
         "0001",
         "0051C0EED548220130D4",
         8
+    },
+    /*
+     * The vectors below use a 5 byte nonce like secure AllJoyn messages and have bodies of
+     * several blocks with partial last blocks.
+     */
+    {
+        /* =============== 40 byte header, 0 byte body ================== */
+        "404142434445464748494A4B4C4D4E4F",
+        "1011121314",
+        40,
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D14",
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D1418C7145B7D6C7551",
+        8
+    },
+    {
+        /* =============== 40 byte header, 17 byte body ================== */
+        "404142434445464748494A4B4C4D4E4F",
+        "1011121314",
+        40,
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D141B222930373E454C535A61686F767D848B",
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D14BB6A3FDEAB987183CF0E6AC3ACAAF3C2D040F3AC299828F7C3",
+        8
+    },
+    {
+        /* =============== 72 byte header, 100 byte body ================== */
+        "404142434445464748494A4B4C4D4E4F",
+        "1011121314",
+        72,
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D141B222930373E454C535A61686F767D848B9299A0A7AEB5BCC3CAD1D8DFE6EDF4FB020910171E252C333A41484F565D646B727980878E959CA3AAB1B8BFC6CDD4DBE2E9F0F7FE050C131A21282F363D444B525960676E757C838A91989FA6ADB4BBC2C9D0D7DEE5ECF3FA01080F161D242B323940474E555C636A71787F868D949BA2A9B0",
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D141B222930373E454C535A61686F767D848B9299A0A7AEB5BCC3CAD1D8DFE6EDF45B4A1FFE8BB811E3AF6E4AE38C8AD3223058E5AFF0B66709901B6575F716597B4151B9F2F38D288E9711EB151BD38221B304A92461C5C67E9BC895FD377A2FCFA51FF8C11618E4AD5154B92E0EFEE2D08EE5EBC7381E33A95E2979647D38664C4E222538032E4C3780621246",
+        8
+    },
+    {
+        /* =============== 24 byte header, 160 byte body ================== */
+        "404142434445464748494A4B4C4D4E4F",
+        "1011121314",
+        24,
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EAF1F8FF060D141B222930373E454C535A61686F767D848B9299A0A7AEB5BCC3CAD1D8DFE6EDF4FB020910171E252C333A41484F565D646B727980878E959CA3AAB1B8BFC6CDD4DBE2E9F0F7FE050C131A21282F363D444B525960676E757C838A91989FA6ADB4BBC2C9D0D7DEE5ECF3FA01080F161D242B323940474E555C636A71787F868D949BA2A9B0B7BEC5CCD3DAE1E8EFF6FD04",
+        "030A11181F262D343B424950575E656C737A81888F969DA40BFAAF2E5B68E1137FBEFA533CDA83524008B51F4006B7D960EBB5A527A6E92B1121C9A2A3DD983E47C11BE5EB0352910354F95411B5962E2B78452DE78ADF1F75AF4891464894DD0104099EBE2E32207E353B7788AE63F92E5929342D88D69C9ED2D5E8862D56A7B2CD5B0B0A2DA80A63160E68F51DCEFEB81EF944DC2D4E1B44C6370342679C35E8FAB38AD2E549BB8F1ECB731C9D41A48FF563E190620E4B50AE2ACA11DFE11C",
+        8
+    },
+    {
+        /* =============== 1 byte header, 33 byte body ================== */
+        "404142434445464748494A4B4C4D4E4F",
+        "1011121314",
+        1,
+        "030A11181F262D343B424950575E656C737A81888F969DA4ABB2B9C0C7CED5DCE3EA",
+        "03AA590EF1BA8B00F4DE1D5BFC9DB9E23521AB14A0E1A5563E8108140A8605484C70AD882433586FDEF41CCC51948DCA0B67",
+        16
     }
 };
 
@@ -309,12 +405,12 @@ int AJ_Main(void)
 {
     AJ_Status status = AJ_OK;
     size_t i;
-    char out[128];
+    char out[512];
 
     for (i = 0; i < ArraySize(testVector); i++) {
 
         uint8_t key[16];
-        uint8_t msg[64];
+        uint8_t msg[256];
         uint8_t nonce[16];
         uint32_t nlen = (uint32_t)strlen(testVector[i].nonce) / 2;
         uint32_t mlen = (uint32_t)strlen(testVector[i].input) / 2;
@@ -349,8 +445,90 @@ int AJ_Main(void)
         AJ_Printf("Passed and verified test #%zu\n", i);
     }
 
+    {
+        /*
+         * A message of more than 511 blocks, the most a 16 bit counter reaches before it wraps.
+         * The expected bytes are windows at the start, past 8 KB and at the end (with the tag).
+         */
+        static const uint32_t offset[3] = { 0, 8192, 19968 };
+        static const char* const expect[3] = {
+            "030A11181F262D343B424950575E656C737A81888F969DA4E202C64EFD6F35CCA1AB1945AD66885A",
+            "6CEA51D72A89B0A40A7A1C9ACB347520D018DEA02AA863D4F8C8B82E69FA1F38436147EBD7D41706",
+            "3BA0FC2744165416EDD627831938487738141C2CEA707CF5D6DD00EC5D99BEA6501BAC41E40FE8CA"
+        };
+        static uint8_t msg[20000 + 8];
+        uint8_t key[16];
+        uint8_t nonce[13];
+        uint32_t j;
+
+        AJ_HexToRaw("404142434445464748494A4B4C4D4E4F", 0, key, sizeof(key));
+        AJ_HexToRaw("101112131415161718191A1B1C", 0, nonce, sizeof(nonce));
+        for (j = 0; j < 20000; ++j) {
+            msg[j] = (uint8_t)(j * 7 + 3);
+        }
+        status = AJ_Encrypt_CCM(key, msg, 20000, 24, 8, nonce, sizeof(nonce));
+        if (status != AJ_OK) {
+            AJ_Printf("Encryption failed (%d) for the long message\n", status);
+            goto ErrorExit;
+        }
+        for (j = 0; j < ArraySize(offset); ++j) {
+            AJ_RawToHex(msg + offset[j], 40, out, sizeof(out), FALSE);
+            if (strcmp(out, expect[j]) != 0) {
+                AJ_Printf("Encrypt verification failure for the long message at %u\n%s\n", offset[j], out);
+                goto ErrorExit;
+            }
+        }
+        status = AJ_Decrypt_CCM(key, msg, 20000, 24, 8, nonce, sizeof(nonce));
+        if (status != AJ_OK) {
+            AJ_Printf("Authentication failure (%d) for the long message\n", status);
+            goto ErrorExit;
+        }
+        for (j = 0; j < 20000; ++j) {
+            if (msg[j] != (uint8_t)(j * 7 + 3)) {
+                AJ_Printf("Decrypt verification failure for the long message at %u\n", j);
+                goto ErrorExit;
+            }
+        }
+        AJ_Printf("Passed and verified the long message test\n");
+    }
+
     AJ_Printf("AES CCM unit test PASSED\n");
 
+    {
+        /*
+         * FIPS-197 appendix C.1 through the expanded key API
+         */
+        static const char expect[] = "69C4E0D86A7B0430D8CDB78070B4C55A";
+        AJ_AES_Key ks;
+        uint8_t key[16];
+        uint8_t ctr[16];
+        uint8_t block[16];
+
+        AJ_HexToRaw("000102030405060708090A0B0C0D0E0F", 0, key, sizeof(key));
+        AJ_HexToRaw("00112233445566778899AABBCCDDEEFF", 0, ctr, sizeof(ctr));
+        AJ_AES_ExpandKey(&ks, key);
+        memset(block, 0, sizeof(block));
+        AJ_AES_CTR_128_Expanded(&ks, block, block, sizeof(block), ctr);
+        AJ_RawToHex(block, sizeof(block), out, sizeof(out), FALSE);
+        if (strcmp(out, expect) != 0) {
+            AJ_Printf("AES block verification failure\n%s\n", out);
+            goto ErrorExit;
+        }
+        AJ_Printf("AES block test PASSED\n");
+    }
+
+    status = Throughput(64);
+    if (status == AJ_OK) {
+        status = Throughput(512);
+    }
+    if (status == AJ_OK) {
+        status = Throughput(4096);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("CCM throughput failed (%d)\n", status);
+        goto ErrorExit;
+    }
+
     {
         static const char expect[] = "F19787716404918CA20F174CFF2E165F21B17A70C472480AE91891B5BB8DD261CBD4273612D41BC6";
         const char secret[] = "1234ABCDE";
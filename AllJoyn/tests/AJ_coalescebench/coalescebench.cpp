@@ -0,0 +1,360 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Outbound write coalescing: a receiver runs in a child process connected over a socket pair, no
+ * daemon is needed. Bursts of signals with a 16 byte payload are sent with coalescing off and at
+ * several thresholds, and the signals/s and number of socket writes are printed for each. The
+ * receiver checks every signal arrives in order. Then a held back signal is checked to be sent
+ * within the coalescing delay while the sender waits in AJ_UnmarshalMsg().
+ */
+#define AJ_MODULE COALESCEBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+
+#ifdef AJ_TARGET_POSIX
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+uint8_t dbgCOALESCEBENCH = 0;
+
+#ifdef AJ_TARGET_POSIX
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.sensor",
+    "!Reading data>ay",
+    "!Ping seq>u",
+    "!Pong seq>u",
+    "?Count count>u errors>u",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/sensor", sensorInterfaces },
+    { NULL }
+};
+
+static AJ_Object ProxyObjects[] = {
+    { "/sensor", sensorInterfaces },
+    { NULL }
+};
+
+#define APP_READING AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_PING    AJ_APP_MESSAGE_ID(0, 0, 1)
+#define APP_PONG    AJ_APP_MESSAGE_ID(0, 0, 2)
+#define APP_COUNT   AJ_APP_MESSAGE_ID(0, 0, 3)
+#define PRX_COUNT   AJ_PRX_MESSAGE_ID(0, 0, 3)
+
+#define BENCH_SIGNALS  20000
+#define PAYLOAD_SIZE   16
+#define COALESCE_DELAY 2
+
+/*
+ * Host sleeps can overshoot by more than 10 ms
+ */
+#define MAX_LATENESS   50
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1454];
+
+static const uint16_t thresholds[] = { 0, 128, 512, 768 };
+
+static uint32_t writes;
+
+static AJ_Status SockSend(AJ_IOBuffer* buf)
+{
+    ++writes;
+    while (AJ_IO_BUF_AVAIL(buf)) {
+        ssize_t ret = send((int)(intptr_t)buf->context, buf->readPtr, AJ_IO_BUF_AVAIL(buf), MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return AJ_ERR_WRITE;
+        }
+        buf->readPtr += ret;
+    }
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status SockRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    struct pollfd pfd;
+    ssize_t ret;
+
+    pfd.fd = (int)(intptr_t)buf->context;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, (int)timeout) == 0) {
+        return AJ_ERR_TIMEOUT;
+    }
+    ret = recv(pfd.fd, buf->writePtr, AJ_IO_BUF_SPACE(buf), 0);
+    if (ret <= 0) {
+        return AJ_ERR_READ;
+    }
+    buf->writePtr += ret;
+    return AJ_OK;
+}
+
+static void InitBus(AJ_BusAttachment* bus, int sock, const char* name)
+{
+    memset(bus, 0, sizeof(AJ_BusAttachment));
+    AJ_IOBufInit(&bus->sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, (void*)(intptr_t)sock);
+    bus->sock.tx.send = SockSend;
+    AJ_IOBufInit(&bus->sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, (void*)(intptr_t)sock);
+    bus->sock.rx.recv = SockRecv;
+    /*
+     * There is no daemon so make up a unique name for the header checks
+     */
+    strcpy(bus->uniqueName, name);
+}
+
+/*
+ * Counts readings, which carry a sequence number in the first 4 bytes, and answers pings
+ */
+static void Receiver(int sock)
+{
+    AJ_BusAttachment bus;
+    AJ_Status status = AJ_OK;
+    uint32_t count = 0;
+    uint32_t errors = 0;
+
+    InitBus(&bus, sock, ":receiver.1");
+    while (status != AJ_ERR_READ) {
+        AJ_Message msg;
+        AJ_Message reply;
+        const uint8_t* data;
+        size_t len;
+        uint32_t seq;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 10000);
+        if (status != AJ_OK) {
+            continue;
+        }
+        switch (msg.msgId) {
+        case APP_READING:
+            status = AJ_UnmarshalArgs(&msg, "ay", &data, &len);
+            if ((status != AJ_OK) || (len != PAYLOAD_SIZE) || (memcpy(&seq, data, 4), seq != count)) {
+                ++errors;
+            }
+            ++count;
+            break;
+
+        case APP_PING:
+            status = AJ_UnmarshalArgs(&msg, "u", &seq);
+            if (status == AJ_OK) {
+                status = AJ_MarshalSignal(&bus, &reply, APP_PONG, ":client.1", 0, 0, 0);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalArgs(&reply, "u", seq);
+            }
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            }
+            break;
+
+        case APP_COUNT:
+            status = AJ_MarshalReplyMsg(&msg, &reply);
+            if (status == AJ_OK) {
+                status = AJ_MarshalArgs(&reply, "uu", count, errors);
+            }
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            }
+            count = 0;
+            errors = 0;
+            break;
+        }
+        AJ_CloseMsg(&msg);
+    }
+    _exit(0);
+}
+
+static AJ_Status SendReading(AJ_BusAttachment* bus, uint32_t seq)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint8_t data[PAYLOAD_SIZE];
+
+    memset(data, 0, sizeof(data));
+    memcpy(data, &seq, 4);
+    status = AJ_MarshalSignal(bus, &msg, APP_READING, ":receiver.1", 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "ay", data, sizeof(data));
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * The method call is not held back so it also sends any readings that are
+ */
+static AJ_Status GetCount(AJ_BusAttachment* bus, uint32_t* count, uint32_t* errors)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    status = AJ_MarshalMethodCall(bus, &msg, PRX_COUNT, ":receiver.1", 0, 0, 5000);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    while (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(bus, &msg, 5000);
+        if ((status == AJ_OK) && (msg.msgId == AJ_REPLY_ID(PRX_COUNT))) {
+            status = AJ_UnmarshalArgs(&msg, "uu", count, errors);
+            AJ_CloseMsg(&msg);
+            break;
+        }
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status Bench(AJ_BusAttachment* bus, uint16_t threshold)
+{
+    AJ_Status status;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t count = 0;
+    uint32_t errors = 0;
+    uint32_t i;
+
+    status = AJ_SetTxCoalescing(bus, threshold, COALESCE_DELAY);
+    writes = 0;
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < BENCH_SIGNALS) && (status == AJ_OK); ++i) {
+        status = SendReading(bus, i);
+    }
+    if (status == AJ_OK) {
+        status = GetCount(bus, &count, &errors);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if ((status != AJ_OK) || (count != BENCH_SIGNALS) || errors) {
+        AJ_Printf("Threshold %u failed: %s, %u received, %u errors\n", threshold, AJ_StatusText(status), count, errors);
+        return AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Threshold %3u: %u signals in %u ms, %u signals/s, %u writes\n", threshold, count, elapsed,
+              elapsed ? (uint32_t)(((uint64_t)count * 1000) / elapsed) : 0, writes);
+    return AJ_OK;
+}
+
+/*
+ * A held back ping must go out within the coalescing delay while we wait for the pong
+ */
+static AJ_Status Deadline(AJ_BusAttachment* bus)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Time timer;
+    uint32_t elapsed = 0;
+    uint32_t seq = 0;
+    uint32_t held;
+
+    status = AJ_SetTxCoalescing(bus, 768, COALESCE_DELAY);
+    writes = 0;
+    AJ_InitTimer(&timer);
+    if (status == AJ_OK) {
+        status = AJ_MarshalSignal(bus, &msg, APP_PING, ":receiver.1", 0, 0, 0);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "u", 1234);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    held = writes;
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(bus, &msg, 1000);
+    }
+    if (status == AJ_OK) {
+        elapsed = AJ_GetElapsedTime(&timer, TRUE);
+        if (msg.msgId == APP_PONG) {
+            status = AJ_UnmarshalArgs(&msg, "u", &seq);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if ((status != AJ_OK) || held || (seq != 1234) || (elapsed > MAX_LATENESS)) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Deadline test %s: ping held for %u writes, pong after %u ms\n", (status == AJ_OK) ? "PASSED" : "FAILED", held, elapsed);
+    AJ_SetTxCoalescing(bus, 0, 0);
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_BusAttachment bus;
+    int socks[2];
+    pid_t child;
+    size_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, ProxyObjects);
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) == -1) {
+        return 1;
+    }
+    child = fork();
+    if (child == 0) {
+        close(socks[0]);
+        Receiver(socks[1]);
+    }
+    close(socks[1]);
+    InitBus(&bus, socks[0], ":client.1");
+
+    for (i = 0; (i < ArraySize(thresholds)) && (status == AJ_OK); ++i) {
+        status = Bench(&bus, thresholds[i]);
+    }
+    if (status == AJ_OK) {
+        status = Deadline(&bus);
+    }
+    close(socks[0]);
+    waitpid(child, NULL, 0);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#else
+
+int AJ_Main(void)
+{
+    AJ_Printf("The coalescing benchmark needs a POSIX host\n");
+    return 0;
+}
+
+#endif
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
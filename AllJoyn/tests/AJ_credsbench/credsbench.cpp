@@ -0,0 +1,146 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Peer credential store: fills every credential slot, checks that storing one more peer evicts
+ * only the least recently used credential, then times a reconnect storm where every stored peer
+ * looks up its credential and stores a refreshed one.
+ */
+#define AJ_MODULE CREDSBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_creds.h>
+#include <aj_nvram.h>
+#include <aj_crypto.h>
+#include <aj_config.h>
+
+#ifdef AJ_TARGET_POSIX
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+uint8_t dbgCREDSBENCH = 0;
+
+#define STORM_ROUNDS 200
+
+static AJ_PeerCred peers[AJ_MAX_CREDS + 1];
+
+static uint8_t HasCredential(const AJ_PeerCred* peer)
+{
+    AJ_PeerCred cred;
+
+    if (AJ_GetRemoteCredential(&peer->guid, &cred) != AJ_OK) {
+        return FALSE;
+    }
+    return memcmp(&cred, peer, sizeof(cred)) == 0;
+}
+
+static AJ_Status Evict()
+{
+    AJ_Status status = AJ_OK;
+    const size_t victim = AJ_MAX_CREDS / 2;
+    size_t i;
+
+    AJ_ClearCredentials();
+    for (i = 0; (i < AJ_MAX_CREDS) && (status == AJ_OK); ++i) {
+        status = AJ_StoreCredential(&peers[i]);
+    }
+    /*
+     * Use every credential except the victim
+     */
+    for (i = 0; (i < AJ_MAX_CREDS) && (status == AJ_OK); ++i) {
+        if ((i != victim) && !HasCredential(&peers[i])) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_StoreCredential(&peers[AJ_MAX_CREDS]);
+    }
+    for (i = 0; (i <= AJ_MAX_CREDS) && (status == AJ_OK); ++i) {
+        if (HasCredential(&peers[i]) == (i == victim)) {
+            AJ_Printf("Peer %u %s\n", (uint32_t)i, (i == victim) ? "was not evicted" : "is missing");
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    AJ_Printf("Eviction test with %u slots %s\n", AJ_MAX_CREDS, (status == AJ_OK) ? "PASSED" : "FAILED");
+    return status;
+}
+
+static AJ_Status Storm()
+{
+    AJ_Status status = AJ_OK;
+    AJ_PeerCred cred;
+    AJ_Time timer;
+    uint32_t elapsed;
+    size_t round;
+    size_t i;
+
+    AJ_ClearCredentials();
+    for (i = 0; (i < AJ_MAX_CREDS) && (status == AJ_OK); ++i) {
+        status = AJ_StoreCredential(&peers[i]);
+    }
+    AJ_InitTimer(&timer);
+    for (round = 0; (round < STORM_ROUNDS) && (status == AJ_OK); ++round) {
+        for (i = 0; (i < AJ_MAX_CREDS) && (status == AJ_OK); ++i) {
+            status = AJ_GetRemoteCredential(&peers[i].guid, &cred);
+            if (status == AJ_OK) {
+                status = AJ_StoreCredential(&cred);
+            }
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        AJ_Printf("Reconnect storm FAILED\n");
+        return status;
+    }
+    AJ_Printf("Reconnect storm with %u peers: %u re-authentications in %u ms\n", AJ_MAX_CREDS, (uint32_t)(STORM_ROUNDS * AJ_MAX_CREDS), elapsed);
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    size_t i;
+
+#ifdef AJ_TARGET_POSIX
+    setenv("AJ_NVRAM_FILE", "credsbench.nvram", 1);
+    unlink("credsbench.nvram");
+#endif
+    AJ_Initialize();
+    for (i = 0; i < ArraySize(peers); ++i) {
+        AJ_RandBytes((uint8_t*)&peers[i], sizeof(AJ_PeerCred));
+    }
+    status = Evict();
+    if (status == AJ_OK) {
+        status = Storm();
+    }
+    AJ_ClearCredentials();
+#ifdef AJ_TARGET_POSIX
+    unlink("credsbench.nvram");
+#endif
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Cost of answering Introspect for every object of the services sample object tree (the same
+ * table services.cpp registers). The replies are marshalled into a TX buffer that is thrown
+ * away so only XML generation and marshalling are measured. No daemon is needed.
+ */
+#define AJ_MODULE INTROSPECTBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+#include "ControlPanelGenerated.h"
+#include "Services_Common.h"
+
+uint8_t dbgINTROSPECTBENCH = 0;
+
+static AJ_Object AppObjects[] = {
+    IOE_SERVICES_APPOBJECTS
+    CONTROLPANELAPPOBJECTS
+    { NULL, NULL }
+};
+
+#define INTROSPECT_ITERATIONS 500
+
+static uint8_t txBuffer[1024];
+static uint32_t txBytes;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    txBytes += AJ_IO_BUF_AVAIL(buf);
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status Introspect(AJ_BusAttachment* bus, const char* objPath)
+{
+    AJ_Status status;
+    AJ_MsgHeader hdr;
+    AJ_Message msg;
+    AJ_Message reply;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memset(&msg, 0, sizeof(msg));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    hdr.serialNum = 1;
+    msg.hdr = &hdr;
+    msg.bus = bus;
+    msg.msgId = AJ_METHOD_INTROSPECT;
+    msg.sender = ":bench.2";
+    msg.objPath = objPath;
+
+    status = AJ_HandleIntrospectRequest(&msg, &reply);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&reply);
+    }
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_BusAttachment bus;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t calls = 0;
+    size_t i;
+    size_t j;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    strcpy(bus.uniqueName, ":bench.1");
+
+    txBytes = 0;
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < INTROSPECT_ITERATIONS) && (status == AJ_OK); ++i) {
+        for (j = 0; AppObjects[j].path && (status == AJ_OK); ++j) {
+            status = Introspect(&bus, AppObjects[j].path);
+            ++calls;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        AJ_Printf("Introspect of %s failed with %s\n", AppObjects[j - 1].path, AJ_StatusText(status));
+        return 1;
+    }
+    AJ_Printf("%u introspects, %u bytes in %u ms, %u ns per introspect",
+              calls, txBytes, elapsed, (uint32_t)(((uint64_t)elapsed * 1000000) / calls));
+#ifdef F_CPU
+    AJ_Printf(", %u cycles per introspect", (uint32_t)(((uint64_t)elapsed * (F_CPU / 1000)) / calls));
+#endif
+    AJ_Printf("\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <Triton_WiFi.h>
+#include <ccspi.h>
+#include <SPI.h>
+#include <alljoyn.h>
+
+//your wifi ssid and password
+#define WLAN_SSID       "CSU"          // cannot be longer than 32 characters!
+#define WLAN_PASS       "12345abcde"
+// Security can be WLAN_SEC_UNSEC, WLAN_SEC_WEP, WLAN_SEC_WPA or WLAN_SEC_WPA2
+#define WLAN_SECURITY   WLAN_SEC_WPA2
+
+int AJ_Main(void);
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial) ;
+
+    if (!wifi.begin()) {
+        Serial.println(F("Couldn't begin()! Check your wiring?"));
+        while (1) ;
+    }
+    if (!wifi.connectToAP(WLAN_SSID, WLAN_PASS, WLAN_SECURITY)) {
+        Serial.println(F("Failed!"));
+        while (1) ;
+    }
+    while (!wifi.checkDHCP()) {
+        delay(100);
+    }
+}
+
+void loop() {
+    AJ_Main();
+    while (1) ;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Round-trip latency of a method call (AJ_MarshalMethodCall -> reply) against
+ * the basic_service sample. Prints the p50/p99/max over LATENCY_SAMPLES calls.
+ * The "AJ method call" lines of Triton_WiFi/host/cc3k_bench time the same
+ * round trip through AJ_Net and an emulated CC3000 without a daemon.
+ */
+#define AJ_MODULE LATENCY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <aj_debug.h>
+#include <alljoyn.h>
+
+static const char ServiceName[] = "org.alljoyn.Bus.sample";
+static const uint16_t ServicePort = 25;
+
+uint8_t dbgLATENCY = 0;
+
+static const char* const sampleInterface[] = {
+    "org.alljoyn.Bus.sample",
+    "?Dummy foo<i",
+    "?Dummy2 fee<i",
+    "?cat inStr1<s inStr2<s outStr>s",
+    NULL
+};
+
+static const AJ_InterfaceDescription sampleInterfaces[] = {
+    sampleInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/sample", sampleInterfaces },
+    { NULL }
+};
+
+#define LATENCY_CAT AJ_PRX_MESSAGE_ID(0, 0, 2)
+
+#define LATENCY_SAMPLES    200
+#define CONNECT_TIMEOUT    (1000 * 60)
+#define UNMARSHAL_TIMEOUT  (1000 * 5)
+#define METHOD_TIMEOUT     (1000 * 5)
+
+static uint32_t samples[LATENCY_SAMPLES];
+
+static int CompareSamples(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static AJ_Status RoundTrip(AJ_BusAttachment* bus, uint32_t sessionId, uint32_t* elapsed)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Time timer;
+
+    AJ_InitTimer(&timer);
+    status = AJ_MarshalMethodCall(bus, &msg, LATENCY_CAT, ServiceName, sessionId, 0, METHOD_TIMEOUT);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "ss", "Hello ", "World!");
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    while (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(bus, &msg, UNMARSHAL_TIMEOUT);
+        if (status != AJ_OK) {
+            break;
+        }
+        if (msg.msgId == AJ_REPLY_ID(LATENCY_CAT)) {
+            *elapsed = AJ_GetElapsedTime(&timer, TRUE);
+            AJ_CloseMsg(&msg);
+            break;
+        }
+        status = AJ_BusHandleBusMessage(&msg);
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    uint32_t sessionId = 0;
+    size_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(NULL, AppObjects);
+
+    status = AJ_StartClient(&bus, NULL, CONNECT_TIMEOUT, FALSE, ServiceName, ServicePort, &sessionId, NULL);
+    if (status != AJ_OK) {
+        AJ_Printf("StartClient returned %s\n", AJ_StatusText(status));
+        return 1;
+    }
+    for (i = 0; (i < LATENCY_SAMPLES) && (status == AJ_OK); ++i) {
+        status = RoundTrip(&bus, sessionId, &samples[i]);
+    }
+    AJ_Disconnect(&bus);
+
+    if (status != AJ_OK) {
+        AJ_Printf("Round trip %u failed with %s\n", (unsigned)i, AJ_StatusText(status));
+        return 1;
+    }
+    qsort(samples, LATENCY_SAMPLES, sizeof(samples[0]), CompareSamples);
+    AJ_Printf("method call round trip over %u calls: p50 %u ms, p99 %u ms, max %u ms\n",
+              LATENCY_SAMPLES,
+              samples[LATENCY_SAMPLES / 2],
+              samples[(LATENCY_SAMPLES * 99) / 100],
+              samples[LATENCY_SAMPLES - 1]);
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Dispatch cost of AJ_LookupMessageId() with the services and generated control panel objects
+ * registered, the same object table services.cpp registers. Every method and signal member of
+ * the application objects is looked up in turn. Members such as the properties interface resolve to
+ * the standard object wildcards so the first pass records the id each query resolves to and the
+ * timed passes check they keep getting it. No daemon is needed.
+ */
+#define AJ_MODULE LOOKUPBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_msg_priv.h>
+#include "ControlPanelGenerated.h"
+#include "Services_Common.h"
+
+uint8_t dbgLOOKUPBENCH = 0;
+
+static AJ_Object AppObjects[] = {
+    IOE_SERVICES_APPOBJECTS
+    CONTROLPANELAPPOBJECTS
+    { NULL, NULL }
+};
+
+#define LOOKUP_MAX_QUERIES 256
+#define LOOKUP_ITERATIONS  2000
+
+typedef struct {
+    uint32_t msgId;      /**< Resolved message id, AJ_INVALID_MSG_ID until the first lookup */
+    uint8_t msgType;
+    const char* objPath;
+    const char* iface;
+    char member[32];
+    char signature[32];
+} Query;
+
+static Query queries[LOOKUP_MAX_QUERIES];
+
+/*
+ * Build one query for every method and signal member of the application objects
+ */
+static size_t BuildQueries(void)
+{
+    size_t n = 0;
+    uint8_t pIndex;
+
+    for (pIndex = 0; AppObjects[pIndex].path; ++pIndex) {
+        const AJ_InterfaceDescription* interfaces = AppObjects[pIndex].interfaces;
+        uint8_t iIndex;
+
+        for (iIndex = 0; interfaces && interfaces[iIndex]; ++iIndex) {
+            AJ_InterfaceDescription desc = interfaces[iIndex];
+            uint8_t mIndex;
+
+            for (mIndex = 0; desc[mIndex + 1] && (n < LOOKUP_MAX_QUERIES); ++mIndex) {
+                const char* encoding = desc[mIndex + 1];
+                Query* q = &queries[n];
+                AJ_Message msg;
+                uint8_t secure;
+                size_t len;
+
+                if ((*encoding != '?') && (*encoding != '!')) {
+                    continue;
+                }
+                q->msgType = (*encoding == '?') ? AJ_MSG_METHOD_CALL : AJ_MSG_SIGNAL;
+                q->msgId = AJ_INVALID_MSG_ID;
+                memset(&msg, 0, sizeof(msg));
+                if (AJ_InitMessageFromMsgId(&msg, AJ_APP_MESSAGE_ID(pIndex, iIndex, mIndex), q->msgType, &secure) != AJ_OK) {
+                    continue;
+                }
+                q->objPath = AppObjects[pIndex].path;
+                q->iface = msg.iface;
+                for (len = 0; encoding[len + 1] && (encoding[len + 1] != ' ') && (len < sizeof(q->member) - 1); ++len) {
+                    q->member[len] = encoding[len + 1];
+                }
+                q->member[len] = '\0';
+                strncpy(q->signature, msg.signature, sizeof(q->signature) - 1);
+                ++n;
+            }
+        }
+    }
+    return n;
+}
+
+static AJ_Status Lookup(Query* q)
+{
+    AJ_Status status;
+    AJ_MsgHeader hdr;
+    AJ_Message msg;
+    uint8_t secure;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memset(&msg, 0, sizeof(msg));
+    hdr.msgType = q->msgType;
+    msg.hdr = &hdr;
+    msg.objPath = q->objPath;
+    msg.iface = q->iface;
+    msg.member = q->member;
+    msg.signature = q->signature;
+    status = AJ_LookupMessageId(&msg, &secure);
+    if ((status == AJ_OK) && (q->msgId == AJ_INVALID_MSG_ID)) {
+        q->msgId = msg.msgId;
+    } else if ((status == AJ_OK) && (msg.msgId != q->msgId)) {
+        AJ_Printf("%s %s.%s identified as %08x expected %08x\n", q->objPath, q->iface, q->member, msg.msgId, q->msgId);
+        status = AJ_ERR_NO_MATCH;
+    }
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Time timer;
+    uint32_t elapsed;
+    size_t numQueries;
+    size_t i;
+    size_t j;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    numQueries = BuildQueries();
+    /*
+     * First pass checks every member resolves and records the message id
+     */
+    for (j = 0; (j < numQueries) && (status == AJ_OK); ++j) {
+        status = Lookup(&queries[j]);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("Lookup of %s %s.%s failed with %s\n", queries[j - 1].objPath, queries[j - 1].iface, queries[j - 1].member, AJ_StatusText(status));
+        return 1;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < LOOKUP_ITERATIONS) && (status == AJ_OK); ++i) {
+        for (j = 0; (j < numQueries) && (status == AJ_OK); ++j) {
+            status = Lookup(&queries[j]);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        return 1;
+    }
+    AJ_Printf("%u members, %u lookups in %u ms, %u lookups/s\n",
+              (uint32_t)numQueries, (uint32_t)(numQueries * LOOKUP_ITERATIONS), elapsed,
+              elapsed ? (uint32_t)(((uint64_t)numQueries * LOOKUP_ITERATIONS * 1000) / elapsed) : 0);
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
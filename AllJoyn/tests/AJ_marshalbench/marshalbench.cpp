@@ -0,0 +1,435 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Send-path marshalling cost: the notification signal is marshalled with AJ_MarshalArgs() and
+ * the container calls the way the notification producer does it, and then with AJ_Marshal().
+ * Checks that both produce the same bytes, that nested and mismatched arguments are handled, and
+ * prints the time per message for each. No daemon is needed.
+ */
+#define AJ_MODULE MARSHALBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+
+uint8_t dbgMARSHALBENCH = 0;
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.bench",
+    "!notify >q >i >q >s >s >ay >s >a{iv} >a{ss} >a(ss)",
+    "!nested >a(yba{sv}(nx)) >ad >o >g >t",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/bench", benchInterfaces },
+    { NULL }
+};
+
+#define BENCH_NOTIFY AJ_APP_MESSAGE_ID(0, 0, 0)
+#define BENCH_NESTED AJ_APP_MESSAGE_ID(0, 0, 1)
+
+#define BENCH_ITERATIONS 100000
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+/*
+ * The last message sent, the serial number is cleared so messages can be compared
+ */
+static uint8_t wireBuffer[1024];
+static size_t wireBytes = 0;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    wireBytes = AJ_IO_BUF_AVAIL(buf);
+    memcpy(wireBuffer, buf->readPtr, wireBytes);
+    memset(wireBuffer + 8, 0, 4);
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+typedef struct {
+    const char* key;
+    const char* value;
+} Pair;
+
+static const uint8_t appId[16] = { 0x5d, 0x1b, 0x42, 0x9c, 0x60, 0x0e, 0x4f, 0x1a, 0x8b, 0x7c, 0x11, 0x2d, 0x93, 0xe4, 0x05, 0xfa };
+static const Pair customAttrs[] = { { "color", "red" }, { "priority", "high" } };
+static const Pair texts[] = { { "en", "The front door is open" }, { "de", "Die Haustuer ist offen" }, { "fr", "La porte d'entree est ouverte" } };
+static const int32_t iconUrlKey = 0;
+static const char iconUrl[] = "http://example.com/icons/door.png";
+static const int32_t iconPathKey = 2;
+static const char iconPath[] = "/icons/door";
+
+/*
+ * Marshals the notification the same way AJNS_Producer_MarshalNotificationMsg() does
+ */
+static AJ_Status MarshalArgs(AJ_Message* msg)
+{
+    AJ_Status status;
+    AJ_Arg array;
+    AJ_Arg entry;
+    size_t i;
+
+    status = AJ_MarshalArgs(msg, "qiqss", 2, 0x1234, 0, "3ad4e5f6", "Front door");
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "ay", appId, sizeof(appId));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "s", "Door monitor");
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(msg, &array, AJ_ARG_ARRAY);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(msg, &entry, AJ_ARG_DICT_ENTRY);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "i", iconUrlKey);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalVariant(msg, "s");
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "s", iconUrl);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &entry);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(msg, &entry, AJ_ARG_DICT_ENTRY);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "i", iconPathKey);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalVariant(msg, "s");
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "s", iconPath);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &entry);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &array);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(msg, &array, AJ_ARG_ARRAY);
+    }
+    for (i = 0; (status == AJ_OK) && (i < ArraySize(customAttrs)); ++i) {
+        status = AJ_MarshalArgs(msg, "{ss}", customAttrs[i].key, customAttrs[i].value);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &array);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalContainer(msg, &array, AJ_ARG_ARRAY);
+    }
+    for (i = 0; (status == AJ_OK) && (i < ArraySize(texts)); ++i) {
+        status = AJ_MarshalArgs(msg, "(ss)", texts[i].key, texts[i].value);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(msg, &array);
+    }
+    return status;
+}
+
+typedef AJ_DictEntryOf<int32_t, AJ_VariantOf<const char*> > Attr;
+typedef AJ_DictEntryOf<const char*, const char*> CustomAttr;
+typedef AJ_StructOf<const char*, const char*> Text;
+
+/*
+ * Same notification with AJ_Marshal(), the argument arrays are built up front the way an
+ * application would keep them
+ */
+static AJ_Status Marshal(AJ_Message* msg)
+{
+    AJ_Status status;
+    Attr attrs[2];
+    CustomAttr custom[ArraySize(customAttrs)];
+    Text text[ArraySize(texts)];
+    AJ_ArrayOf<uint8_t> appIdArray = { appId, sizeof(appId) };
+    AJ_ArrayOf<Attr> attrArray = { attrs, ArraySize(attrs) };
+    AJ_ArrayOf<CustomAttr> customArray = { custom, ArraySize(custom) };
+    AJ_ArrayOf<Text> textArray = { text, ArraySize(text) };
+    size_t i;
+
+    attrs[0].key = iconUrlKey;
+    attrs[0].val.val = iconUrl;
+    attrs[1].key = iconPathKey;
+    attrs[1].val.val = iconPath;
+    for (i = 0; i < ArraySize(customAttrs); ++i) {
+        custom[i].key = customAttrs[i].key;
+        custom[i].val = customAttrs[i].value;
+    }
+    for (i = 0; i < ArraySize(texts); ++i) {
+        text[i].m1 = texts[i].key;
+        text[i].m2 = texts[i].value;
+    }
+    /*
+     * There are more than eight arguments so they go in two calls
+     */
+    status = AJ_Marshal(msg, (uint16_t)2, (int32_t)0x1234, (uint16_t)0, "3ad4e5f6", "Front door", appIdArray, "Door monitor");
+    if (status == AJ_OK) {
+        status = AJ_Marshal(msg, attrArray, customArray, textArray);
+    }
+    return status;
+}
+
+static AJ_Status SendNotify(AJ_BusAttachment* bus, AJ_Status (*marshal)(AJ_Message*))
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    status = AJ_MarshalSignal(bus, &msg, BENCH_NOTIFY, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = marshal(&msg);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Deeper nesting than the notification, with 8 byte alignment inside structs and variants
+ */
+static AJ_Status SendNested(AJ_BusAttachment* bus, uint8_t useTemplates)
+{
+    typedef AJ_DictEntryOf<const char*, AJ_VariantOf<AJ_StructOf<uint64_t, const char*> > > Prop;
+    typedef AJ_StructOf<uint8_t, bool, AJ_ArrayOf<Prop>, AJ_StructOf<int16_t, int64_t> > Item;
+    static const double doubles[] = { 1.5, -2.25, 1e100 };
+    AJ_Status status;
+    AJ_Message msg;
+    Prop props[2] = { { "a", { { 7, "seven" } } }, { "bb", { { 0x123456789ULL, "big" } } } };
+    Item items[2];
+    AJ_ArrayOf<Item> itemArray = { items, ArraySize(items) };
+    AJ_ArrayOf<double> doubleArray = { doubles, ArraySize(doubles) };
+    AJ_ObjPathArg path = { "/org/alljoyn/bench" };
+    AJ_SignatureArg sig = { "a{sv}" };
+    AJ_Arg array;
+    AJ_Arg item;
+    AJ_Arg dict;
+    AJ_Arg inner;
+    size_t i;
+    size_t j;
+
+    items[0].m1 = 1;
+    items[0].m2 = true;
+    items[0].m3.elems = props;
+    items[0].m3.count = ArraySize(props);
+    items[0].m4.m1 = -3;
+    items[0].m4.m2 = -4;
+    items[1].m1 = 2;
+    items[1].m2 = false;
+    items[1].m3.elems = NULL;
+    items[1].m3.count = 0;
+    items[1].m4.m1 = 5;
+    items[1].m4.m2 = 6;
+
+    status = AJ_MarshalSignal(bus, &msg, BENCH_NESTED, NULL, 0, 0, 0);
+    if (status != AJ_OK) {
+        return status;
+    }
+    if (useTemplates) {
+        status = AJ_Marshal(&msg, itemArray, doubleArray, path, sig, (uint64_t)42);
+    } else {
+        status = AJ_MarshalContainer(&msg, &array, AJ_ARG_ARRAY);
+        for (i = 0; (status == AJ_OK) && (i < ArraySize(items)); ++i) {
+            status = AJ_MarshalContainer(&msg, &item, AJ_ARG_STRUCT);
+            if (status == AJ_OK) {
+                status = AJ_MarshalArgs(&msg, "yb", items[i].m1, (uint32_t)items[i].m2);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalContainer(&msg, &dict, AJ_ARG_ARRAY);
+            }
+            for (j = 0; (status == AJ_OK) && (j < items[i].m3.count); ++j) {
+                status = AJ_MarshalArgs(&msg, "{sv}", props[j].key, "(ts)", props[j].val.val.m1, props[j].val.val.m2);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalCloseContainer(&msg, &dict);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalContainer(&msg, &inner, AJ_ARG_STRUCT);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalArgs(&msg, "nx", items[i].m4.m1, items[i].m4.m2);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalCloseContainer(&msg, &inner);
+            }
+            if (status == AJ_OK) {
+                status = AJ_MarshalCloseContainer(&msg, &item);
+            }
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(&msg, &array);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "ad", doubles, sizeof(doubles));
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "ogt", path.path, sig.sig, (uint64_t)42);
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Both ways of marshalling must put the same bytes on the wire
+ */
+static AJ_Status Compare(AJ_BusAttachment* bus)
+{
+    AJ_Status status;
+    uint8_t legacy[sizeof(wireBuffer)];
+    size_t legacyBytes;
+    size_t notifyBytes;
+
+    status = SendNotify(bus, MarshalArgs);
+    if (status != AJ_OK) {
+        return status;
+    }
+    memcpy(legacy, wireBuffer, wireBytes);
+    legacyBytes = wireBytes;
+    status = SendNotify(bus, Marshal);
+    if (status != AJ_OK) {
+        return status;
+    }
+    if ((wireBytes != legacyBytes) || (memcmp(legacy, wireBuffer, wireBytes) != 0)) {
+        AJ_Printf("notify: AJ_Marshal() output differs from AJ_MarshalArgs()\n");
+        return AJ_ERR_FAILURE;
+    }
+    notifyBytes = wireBytes;
+    status = SendNested(bus, FALSE);
+    if (status != AJ_OK) {
+        return status;
+    }
+    memcpy(legacy, wireBuffer, wireBytes);
+    legacyBytes = wireBytes;
+    status = SendNested(bus, TRUE);
+    if (status != AJ_OK) {
+        return status;
+    }
+    if ((wireBytes != legacyBytes) || (memcmp(legacy, wireBuffer, wireBytes) != 0)) {
+        AJ_Printf("nested: AJ_Marshal() output differs from AJ_MarshalArgs()\n");
+        return AJ_ERR_FAILURE;
+    }
+    AJ_Printf("notify %u bytes, nested %u bytes: output matches\n", (uint32_t)notifyBytes, (uint32_t)wireBytes);
+    return AJ_OK;
+}
+
+/*
+ * Arguments that do not match the signature or do not fit are refused without writing anything
+ */
+static AJ_Status Refuse(AJ_BusAttachment* bus)
+{
+    static char big[sizeof(txBuffer)];
+    AJ_Status status;
+    AJ_Message msg;
+    uint8_t* writePtr;
+
+    status = AJ_MarshalSignal(bus, &msg, BENCH_NOTIFY, NULL, 0, 0, 0);
+    if (status != AJ_OK) {
+        return status;
+    }
+    writePtr = bus->sock.tx.writePtr;
+    status = AJ_Marshal(&msg, (uint16_t)2, (uint32_t)0x1234);
+    if ((status != AJ_ERR_SIGNATURE) || (bus->sock.tx.writePtr != writePtr)) {
+        AJ_Printf("mismatched signature not refused: %s\n", AJ_StatusText(status));
+        return AJ_ERR_FAILURE;
+    }
+    memset(big, 'x', sizeof(big) - 1);
+    status = AJ_Marshal(&msg, (uint16_t)2, (int32_t)0x1234, (uint16_t)0, (const char*)big);
+    if ((status != AJ_ERR_RESOURCES) || (bus->sock.tx.writePtr != writePtr)) {
+        AJ_Printf("oversized arguments not refused: %s\n", AJ_StatusText(status));
+        return AJ_ERR_FAILURE;
+    }
+    AJ_IO_BUF_RESET(&bus->sock.tx);
+    return AJ_OK;
+}
+
+static AJ_Status Bench(AJ_BusAttachment* bus, const char* name, AJ_Status (*marshal)(AJ_Message*))
+{
+    AJ_Status status = AJ_OK;
+    AJ_Time timer;
+    uint32_t elapsed;
+    size_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < BENCH_ITERATIONS) && (status == AJ_OK); ++i) {
+        status = SendNotify(bus, marshal);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        AJ_Printf("%s failed with %s\n", name, AJ_StatusText(status));
+        return status;
+    }
+    AJ_Printf("%-14s %u messages in %u ms, %u ns/message\n", name, BENCH_ITERATIONS, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / BENCH_ITERATIONS));
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    /*
+     * There is no daemon so make up a unique name for the header checks
+     */
+    strcpy(bus.uniqueName, ":bench.1");
+
+    status = Compare(&bus);
+    if (status == AJ_OK) {
+        status = Refuse(&bus);
+    }
+    if (status == AJ_OK) {
+        status = Bench(&bus, "AJ_MarshalArgs", MarshalArgs);
+    }
+    if (status == AJ_OK) {
+        status = Bench(&bus, "AJ_Marshal", Marshal);
+    }
+    AJ_Printf("%s\n", (status == AJ_OK) ? "PASSED" : "FAILED");
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
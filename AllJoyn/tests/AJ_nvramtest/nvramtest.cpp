@@ -0,0 +1,333 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * NVRAM log tests: times open/read/close with 64 data sets, rewrites the data sets until the log
+ * has wrapped many times, checks that an uncommitted write does not replace the committed data and
+ * on the host kills a writer process at random points and checks every data set survives intact.
+ */
+#define AJ_MODULE NVRAMTEST
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_nvram.h>
+
+#ifdef AJ_TARGET_POSIX
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+uint8_t dbgNVRAMTEST = 0;
+
+#define BENCH_SETS       64
+#define BENCH_ITERATIONS 2000
+#define REWRITES         5000
+
+#define CRASH_SETS       8
+#define CRASH_ITERATIONS 200
+
+#define NV_ID(n) (AJ_NVRAM_ID_FOR_APPS + (n))
+
+/*
+ * Data set n is filled with copies of a generation number, the size varies with n
+ */
+static uint16_t SetSize(uint16_t n)
+{
+    return (uint16_t)(4 * (1 + (n % 5)));
+}
+
+static AJ_Status WriteSet(uint16_t n, uint32_t gen)
+{
+    AJ_NV_DATASET* handle = AJ_NVRAM_Open(NV_ID(n), "w", SetSize(n));
+    uint16_t i;
+
+    if (!handle) {
+        return AJ_ERR_FAILURE;
+    }
+    /*
+     * Write a word at a time so a crash can land part way through
+     */
+    for (i = 0; i < SetSize(n); i += 4) {
+        if (AJ_NVRAM_Write(&gen, 4, handle) != 4) {
+            AJ_NVRAM_Close(handle);
+            return AJ_ERR_WRITE;
+        }
+    }
+    return AJ_NVRAM_Close(handle);
+}
+
+static AJ_Status CheckSet(uint16_t n, uint32_t* gen)
+{
+    AJ_NV_DATASET* handle = AJ_NVRAM_Open(NV_ID(n), "r", 0);
+    uint32_t words[5];
+    uint16_t i;
+
+    if (!handle) {
+        AJ_Printf("Data set %u missing\n", n);
+        return AJ_ERR_FAILURE;
+    }
+    if (AJ_NVRAM_Read(words, SetSize(n), handle) != SetSize(n)) {
+        AJ_NVRAM_Close(handle);
+        return AJ_ERR_READ;
+    }
+    AJ_NVRAM_Close(handle);
+    for (i = 1; i < SetSize(n) / 4; ++i) {
+        if (words[i] != words[0]) {
+            AJ_Printf("Data set %u is torn\n", n);
+            return AJ_ERR_FAILURE;
+        }
+    }
+    *gen = words[0];
+    return AJ_OK;
+}
+
+static AJ_Status Bench()
+{
+    AJ_Status status = AJ_OK;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t gen;
+    uint16_t n;
+    size_t i;
+
+    AJ_NVRAM_Clear();
+    for (n = 0; (n < BENCH_SETS) && (status == AJ_OK); ++n) {
+        status = WriteSet(n, n);
+    }
+    if (status != AJ_OK) {
+        AJ_Printf("Failed to create %u data sets\n", BENCH_SETS);
+        return status;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < BENCH_ITERATIONS) && (status == AJ_OK); ++i) {
+        for (n = 0; (n < BENCH_SETS) && (status == AJ_OK); ++n) {
+            status = CheckSet(n, &gen);
+            if ((status == AJ_OK) && (gen != n)) {
+                status = AJ_ERR_FAILURE;
+            }
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        AJ_Printf("Open/read FAILED\n");
+        return status;
+    }
+    AJ_Printf("Open/read/close with %u data sets: %u in %u ms, %u ns each\n", BENCH_SETS, BENCH_ITERATIONS * BENCH_SETS, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / (BENCH_ITERATIONS * BENCH_SETS)));
+    return AJ_OK;
+}
+
+/*
+ * Rewriting the data sets moves the log around the NVRAM many times over
+ */
+static AJ_Status Rewrite()
+{
+    AJ_Status status = AJ_OK;
+    uint32_t gen;
+    uint16_t n;
+    size_t i;
+
+    for (i = 0; (i < REWRITES) && (status == AJ_OK); ++i) {
+        status = WriteSet((uint16_t)(i % BENCH_SETS), (uint32_t)i);
+    }
+    for (n = 0; (n < BENCH_SETS) && (status == AJ_OK); ++n) {
+        status = CheckSet(n, &gen);
+        if ((status == AJ_OK) && ((gen % BENCH_SETS) != n)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    /*
+     * Deleted data sets must stay deleted and their space must be reused
+     */
+    for (n = 0; (n < BENCH_SETS) && (status == AJ_OK); n += 2) {
+        status = AJ_NVRAM_Delete(NV_ID(n));
+    }
+    for (i = 0; (i < REWRITES) && (status == AJ_OK); ++i) {
+        status = WriteSet((uint16_t)(1 + 2 * (i % (BENCH_SETS / 2))), (uint32_t)i);
+    }
+    for (n = 0; (n < BENCH_SETS) && (status == AJ_OK); ++n) {
+        if (AJ_NVRAM_Exist(NV_ID(n)) != (n & 1)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    AJ_Printf("Rewrite test %s\n", (status == AJ_OK) ? "PASSED" : "FAILED");
+    return status;
+}
+
+/*
+ * A data set opened for writing does not replace the old data until it is closed
+ */
+static AJ_Status Uncommitted()
+{
+    AJ_Status status;
+    AJ_NV_DATASET* handle;
+    uint32_t next = 0xDEAD;
+    uint32_t gen = 0;
+
+    status = WriteSet(1, 1234);
+    handle = AJ_NVRAM_Open(NV_ID(1), "w", SetSize(1));
+    if (!handle) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        AJ_NVRAM_Write(&next, 4, handle);
+        AJ_NVRAM_Write(&next, 4, handle);
+        status = CheckSet(1, &gen);
+        if ((status == AJ_OK) && (gen != 1234)) {
+            status = AJ_ERR_FAILURE;
+        }
+        AJ_NVRAM_Close(handle);
+    }
+    if (status == AJ_OK) {
+        status = CheckSet(1, &gen);
+        if ((status == AJ_OK) && (gen != next)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    AJ_Printf("Uncommitted write test %s\n", (status == AJ_OK) ? "PASSED" : "FAILED");
+    return status;
+}
+
+#ifdef AJ_TARGET_POSIX
+/*
+ * Keeps rewriting the data sets until it is killed
+ */
+static void Writer(int ready)
+{
+    uint32_t gen = 0;
+    uint16_t n;
+
+    AJ_NVRAM_Init();
+    for (n = 0; n < CRASH_SETS; ++n) {
+        if (!AJ_NVRAM_Exist(NV_ID(n)) && (WriteSet(n, 0) != AJ_OK)) {
+            _exit(1);
+        }
+    }
+    if (write(ready, &gen, 1) != 1) {
+        _exit(1);
+    }
+    while (TRUE) {
+        ++gen;
+        for (n = 0; n < CRASH_SETS; ++n) {
+            if (WriteSet(n, gen) != AJ_OK) {
+                _exit(1);
+            }
+        }
+    }
+}
+
+/*
+ * Recovers the log and checks every data set is present and intact, then checks the log can
+ * still be written
+ */
+static int Checker()
+{
+    uint32_t gen;
+    uint16_t n;
+
+    AJ_NVRAM_Init();
+    for (n = 0; n < CRASH_SETS; ++n) {
+        if (CheckSet(n, &gen) != AJ_OK) {
+            return 1;
+        }
+        if (WriteSet(n, gen) != AJ_OK) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static AJ_Status Crash()
+{
+    int i;
+
+    for (i = 0; i < CRASH_ITERATIONS; ++i) {
+        int fds[2];
+        int rc;
+        char c;
+        pid_t pid;
+
+        if (pipe(fds) != 0) {
+            return AJ_ERR_FAILURE;
+        }
+        pid = fork();
+        if (pid == 0) {
+            Writer(fds[1]);
+        }
+        if (read(fds[0], &c, 1) != 1) {
+            AJ_Printf("Writer failed\n");
+            return AJ_ERR_FAILURE;
+        }
+        close(fds[0]);
+        close(fds[1]);
+        usleep(rand() % 2000);
+        kill(pid, SIGKILL);
+        waitpid(pid, &rc, 0);
+
+        pid = fork();
+        if (pid == 0) {
+            _exit(Checker());
+        }
+        waitpid(pid, &rc, 0);
+        if (!WIFEXITED(rc) || WEXITSTATUS(rc)) {
+            AJ_Printf("Crash test FAILED after %d crashes\n", i + 1);
+            return AJ_ERR_FAILURE;
+        }
+    }
+    AJ_Printf("Crash test PASSED: %d crashes\n", CRASH_ITERATIONS);
+    return AJ_OK;
+}
+#endif
+
+int AJ_Main(void)
+{
+    AJ_Status status = AJ_OK;
+
+#ifdef AJ_TARGET_POSIX
+    /*
+     * The crash test runs before this process opens the NVRAM, each child recovers it from scratch
+     */
+    setenv("AJ_NVRAM_FILE", "nvramtest.nvram", 1);
+    unlink("nvramtest.nvram");
+    status = Crash();
+#endif
+    if (status == AJ_OK) {
+        AJ_NVRAM_Init();
+        status = Bench();
+    }
+    if (status == AJ_OK) {
+        status = Rewrite();
+    }
+    if (status == AJ_OK) {
+        status = Uncommitted();
+    }
+#ifdef AJ_TARGET_POSIX
+    unlink("nvramtest.nvram");
+#endif
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
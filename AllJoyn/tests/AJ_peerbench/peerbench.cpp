@@ -0,0 +1,344 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Secure peer table: checks least recently used eviction and full length bus names, then times
+ * encrypted signals sent to and received from 1, 8 and 32 authenticated peers in turn. Session
+ * keys are installed directly and messages go through a memory "wire", no daemon is needed.
+ *
+ * Build the library with AJ_NAME_MAP_GUID_SIZE of at least 32 for the 32 peer run.
+ */
+#define AJ_MODULE PEERBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+#include <aj_guid.h>
+#include <aj_crypto.h>
+#include <aj_config.h>
+
+uint8_t dbgPEERBENCH = 0;
+
+static const char* const peerInterface[] = {
+    "$org.alljoyn.peerbench",
+    "!data >ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription peerInterfaces[] = {
+    peerInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/peer", peerInterfaces },
+    { NULL }
+};
+
+#define PEER_DATA AJ_APP_MESSAGE_ID(0, 0, 0)
+
+#define MAX_PEERS       32
+#define BODY_LEN        64
+#define BENCH_MESSAGES  64000
+
+static const uint16_t peerCounts[] = { 1, 8, MAX_PEERS };
+
+static uint8_t wireBuffer[MAX_PEERS * 256];
+static size_t wireBytes = 0;
+static size_t wireOffset = 0;
+
+static uint8_t txBuffer[512];
+static uint8_t rxBuffer[512];
+
+static uint8_t body[BODY_LEN];
+
+static char peerNames[MAX_PEERS + 1][16];
+static char serviceNames[MAX_PEERS + 1][32];
+static uint8_t peerKeys[MAX_PEERS + 1][16];
+
+static char longName[AJ_MAX_NAME_SIZE + 2];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wireBytes + tx) > sizeof(wireBuffer)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wireBuffer + wireBytes, buf->readPtr, tx);
+    AJ_IO_BUF_RESET(buf);
+    wireBytes += tx;
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), len);
+
+    rx = min(rx, (uint32_t)(wireBytes - wireOffset));
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wireBuffer + wireOffset, rx);
+    buf->writePtr += rx;
+    wireOffset += rx;
+    return AJ_OK;
+}
+
+static AJ_Status AddPeer(uint16_t peer, uint8_t role)
+{
+    AJ_Status status;
+    AJ_GUID guid;
+
+    memset(&guid, peer, sizeof(guid));
+    status = AJ_GUID_AddNameMapping(&guid, peerNames[peer], serviceNames[peer]);
+    if (status == AJ_OK) {
+        status = AJ_SetSessionKey(peerNames[peer], peerKeys[peer], role);
+    }
+    return status;
+}
+
+static uint8_t HasPeer(uint16_t peer)
+{
+    const AJ_GUID* guid = AJ_GUID_Find(serviceNames[peer]);
+    return guid && (guid->val[0] == peer) && (AJ_GUID_Find(peerNames[peer]) == guid);
+}
+
+static AJ_Status Evict()
+{
+    AJ_Status status = AJ_OK;
+    const uint16_t victim = AJ_NAME_MAP_GUID_SIZE / 2;
+    uint16_t i;
+
+    AJ_GUID_ClearNameMap();
+    for (i = 0; (i < AJ_NAME_MAP_GUID_SIZE) && (status == AJ_OK); ++i) {
+        status = AddPeer(i, AJ_ROLE_KEY_INITIATOR);
+    }
+    /*
+     * Use every peer except the victim
+     */
+    for (i = 0; (i < AJ_NAME_MAP_GUID_SIZE) && (status == AJ_OK); ++i) {
+        if ((i != victim) && !HasPeer(i)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (status == AJ_OK) {
+        status = AddPeer(AJ_NAME_MAP_GUID_SIZE, AJ_ROLE_KEY_INITIATOR);
+    }
+    for (i = 0; (i <= AJ_NAME_MAP_GUID_SIZE) && (status == AJ_OK); ++i) {
+        if (HasPeer(i) == (i == victim)) {
+            AJ_Printf("Peer %u %s\n", i, (i == victim) ? "was not evicted" : "is missing");
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    AJ_Printf("Eviction test %s\n", (status == AJ_OK) ? "PASSED" : "FAILED");
+    return status;
+}
+
+/*
+ * Names are packed into a pool, a name of AJ_MAX_NAME_SIZE may need the room of several peers
+ */
+static AJ_Status LongNames()
+{
+    AJ_Status status = AJ_OK;
+    AJ_GUID guid;
+    uint16_t kept = 0;
+    uint16_t i;
+
+    AJ_GUID_ClearNameMap();
+    for (i = 0; (i < AJ_NAME_MAP_GUID_SIZE - 1) && (status == AJ_OK); ++i) {
+        status = AddPeer(i, AJ_ROLE_KEY_INITIATOR);
+    }
+    memset(&guid, 0xAA, sizeof(guid));
+    memset(longName, 'n', sizeof(longName) - 1);
+    longName[0] = ':';
+    longName[sizeof(longName) - 1] = 0;
+    /*
+     * One character too long
+     */
+    if (status == AJ_OK) {
+        status = (AJ_GUID_AddNameMapping(&guid, longName, NULL) == AJ_ERR_RESOURCES) ? AJ_OK : AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        longName[AJ_MAX_NAME_SIZE] = 0;
+        status = AJ_GUID_AddNameMapping(&guid, longName, longName + 1);
+    }
+    if ((status == AJ_OK) && ((AJ_GUID_Find(longName) == NULL) || (AJ_GUID_Find(longName + 1) == NULL))) {
+        status = AJ_ERR_FAILURE;
+    }
+    /*
+     * The peers that were not evicted to make room must still be found by name
+     */
+    for (i = 0; (i < AJ_NAME_MAP_GUID_SIZE - 1) && (status == AJ_OK); ++i) {
+        if (HasPeer(i)) {
+            ++kept;
+        } else if (AJ_GUID_Find(peerNames[i])) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    /*
+     * Deleting the long name moves the name of a peer added after it
+     */
+    if ((status == AJ_OK) && AJ_GUID_Find(longName)) {
+        status = AddPeer(AJ_NAME_MAP_GUID_SIZE, AJ_ROLE_KEY_INITIATOR);
+    }
+    if (status == AJ_OK) {
+        AJ_GUID_DeleteNameMapping(longName);
+        if (AJ_GUID_Find(longName) || AJ_GUID_Find(longName + 1) || !HasPeer(AJ_NAME_MAP_GUID_SIZE)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    AJ_Printf("Long name test %s, %u of %u peers kept\n", (status == AJ_OK) ? "PASSED" : "FAILED", kept, AJ_NAME_MAP_GUID_SIZE - 1);
+    return status;
+}
+
+/*
+ * The sender is set to the peer's name so the receiver decrypts with that peer's session key
+ */
+static AJ_Status SendTo(AJ_BusAttachment* bus, uint16_t peer)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    strcpy(bus->uniqueName, peerNames[peer]);
+    status = AJ_MarshalSignal(bus, &msg, PEER_DATA, peerNames[peer], 0, AJ_FLAG_ENCRYPTED, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "ay", body, BODY_LEN);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status ReceiveAll(AJ_BusAttachment* bus, uint16_t peers)
+{
+    AJ_Status status = AJ_OK;
+    uint16_t i;
+
+    wireOffset = 0;
+    for (i = 0; (i < peers) && (status == AJ_OK); ++i) {
+        AJ_Message msg;
+        uint8_t* data;
+        size_t len;
+
+        status = AJ_UnmarshalMsg(bus, &msg, 0);
+        if (status != AJ_OK) {
+            break;
+        }
+        if ((msg.msgId != PEER_DATA) || strcmp(msg.sender, peerNames[i])) {
+            status = AJ_ERR_UNEXPECTED;
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "ay", &data, &len);
+        }
+        if ((status == AJ_OK) && ((len != BODY_LEN) || memcmp(data, body, BODY_LEN))) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status Bench(AJ_BusAttachment* bus, uint16_t peers)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Time timer;
+    uint32_t txTime;
+    uint32_t rxTime;
+    uint32_t rounds = BENCH_MESSAGES / peers;
+    uint32_t r;
+    uint16_t i;
+
+    AJ_GUID_ClearNameMap();
+    for (i = 0; (i < peers) && (status == AJ_OK); ++i) {
+        status = AddPeer(i, AJ_ROLE_KEY_INITIATOR);
+    }
+    AJ_InitTimer(&timer);
+    for (r = 0; (r < rounds) && (status == AJ_OK); ++r) {
+        wireBytes = 0;
+        for (i = 0; (i < peers) && (status == AJ_OK); ++i) {
+            status = SendTo(bus, i);
+        }
+    }
+    txTime = AJ_GetElapsedTime(&timer, TRUE);
+    /*
+     * The receiving end of a session uses the opposite role
+     */
+    for (i = 0; (i < peers) && (status == AJ_OK); ++i) {
+        status = AJ_SetSessionKey(peerNames[i], peerKeys[i], AJ_ROLE_KEY_RESPONDER);
+    }
+    AJ_InitTimer(&timer);
+    for (r = 0; (r < rounds) && (status == AJ_OK); ++r) {
+        status = ReceiveAll(bus, peers);
+    }
+    rxTime = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        AJ_Printf("%u peers failed with %s\n", peers, AJ_StatusText(status));
+        return status;
+    }
+    AJ_Printf("%2u peers: %u messages, send %u msgs/s, receive %u msgs/s\n", peers, rounds * peers,
+              txTime ? (uint32_t)(((uint64_t)rounds * peers * 1000) / txTime) : 0,
+              rxTime ? (uint32_t)(((uint64_t)rounds * peers * 1000) / rxTime) : 0);
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    size_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    for (i = 0; i < sizeof(body); ++i) {
+        body[i] = (uint8_t)(i * 7 + 3);
+    }
+    for (i = 0; i <= MAX_PEERS; ++i) {
+        sprintf(peerNames[i], ":peer%u.%u", (uint32_t)i, (uint32_t)(i * 3 + 1));
+        sprintf(serviceNames[i], "org.alljoyn.peer%u", (uint32_t)i);
+        AJ_RandBytes(peerKeys[i], 16);
+    }
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    status = Evict();
+    if (status == AJ_OK) {
+        status = LongNames();
+    }
+    for (i = 0; (i < ArraySize(peerCounts)) && (status == AJ_OK); ++i) {
+        if (peerCounts[i] > AJ_NAME_MAP_GUID_SIZE) {
+            AJ_Printf("%2u peers: skipped, AJ_NAME_MAP_GUID_SIZE is %u\n", peerCounts[i], AJ_NAME_MAP_GUID_SIZE);
+        } else {
+            status = Bench(&bus, peerCounts[i]);
+        }
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,410 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Method call pipelining: a local echo service runs in a child process connected over a socket
+ * pair, no daemon is needed. The client keeps 1 to AJ_NUM_REPLY_CONTEXTS calls in flight, issuing
+ * the next call from each call's completion callback, and prints the calls/s for each window. Then
+ * a window of calls the service does not answer is checked to time out in order, and a reply with
+ * the wrong signature is checked to still complete its call.
+ */
+#define AJ_MODULE PIPELINEBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+#include <aj_config.h>
+
+#ifdef AJ_TARGET_POSIX
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+uint8_t dbgPIPELINEBENCH = 0;
+
+#ifdef AJ_TARGET_POSIX
+
+static const char* const echoInterface[] = {
+    "org.alljoyn.echo",
+    "?Echo val<u val>u",
+    "?Drop val<u",
+    "?Garble val<u val>s",
+    NULL
+};
+
+static const AJ_InterfaceDescription echoInterfaces[] = {
+    echoInterface,
+    NULL
+};
+
+/*
+ * The caller expects Garble to return a uint32
+ */
+static const char* const garbledInterface[] = {
+    "org.alljoyn.echo",
+    "?Echo val<u val>u",
+    "?Drop val<u",
+    "?Garble val<u val>u",
+    NULL
+};
+
+static const AJ_InterfaceDescription garbledInterfaces[] = {
+    garbledInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/echo", echoInterfaces },
+    { NULL }
+};
+
+static AJ_Object ProxyObjects[] = {
+    { "/echo", garbledInterfaces },
+    { NULL }
+};
+
+#define APP_ECHO  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define APP_DROP  AJ_APP_MESSAGE_ID(0, 0, 1)
+#define PRX_ECHO  AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define PRX_DROP  AJ_PRX_MESSAGE_ID(0, 0, 1)
+#define APP_GARBLE  AJ_APP_MESSAGE_ID(0, 0, 2)
+#define PRX_GARBLE  AJ_PRX_MESSAGE_ID(0, 0, 2)
+
+#define BENCH_CALLS    20000
+#define DROP_TIMEOUT   50
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1454];
+
+static const uint16_t windows[] = { 1, 4, 16, 64, 256 };
+
+typedef struct {
+    AJ_BusAttachment* bus;
+    uint32_t sent;
+    uint32_t done;
+    uint32_t errors;
+    AJ_Time start;
+    uint32_t elapsed;
+} Pipeline;
+
+static AJ_Status SockSend(AJ_IOBuffer* buf)
+{
+    while (AJ_IO_BUF_AVAIL(buf)) {
+        ssize_t ret = send((int)(intptr_t)buf->context, buf->readPtr, AJ_IO_BUF_AVAIL(buf), MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return AJ_ERR_WRITE;
+        }
+        buf->readPtr += ret;
+    }
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status SockRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    struct pollfd pfd;
+    ssize_t ret;
+
+    pfd.fd = (int)(intptr_t)buf->context;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, (int)timeout) == 0) {
+        return AJ_ERR_TIMEOUT;
+    }
+    ret = recv(pfd.fd, buf->writePtr, AJ_IO_BUF_SPACE(buf), 0);
+    if (ret <= 0) {
+        return AJ_ERR_READ;
+    }
+    buf->writePtr += ret;
+    return AJ_OK;
+}
+
+static void InitBus(AJ_BusAttachment* bus, int sock, const char* name)
+{
+    memset(bus, 0, sizeof(AJ_BusAttachment));
+    AJ_IOBufInit(&bus->sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, (void*)(intptr_t)sock);
+    bus->sock.tx.send = SockSend;
+    AJ_IOBufInit(&bus->sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, (void*)(intptr_t)sock);
+    bus->sock.rx.recv = SockRecv;
+    /*
+     * There is no daemon so make up a unique name for the header checks
+     */
+    strcpy(bus->uniqueName, name);
+}
+
+static void EchoService(int sock)
+{
+    AJ_BusAttachment bus;
+    AJ_Status status = AJ_OK;
+
+    InitBus(&bus, sock, ":echo.1");
+    while (status != AJ_ERR_READ) {
+        AJ_Message msg;
+        AJ_Message reply;
+        uint32_t val;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 10000);
+        if ((status == AJ_OK) && ((msg.msgId == APP_ECHO) || (msg.msgId == APP_GARBLE))) {
+            status = AJ_UnmarshalArgs(&msg, "u", &val);
+            if (status == AJ_OK) {
+                status = AJ_MarshalReplyMsg(&msg, &reply);
+            }
+            if ((status == AJ_OK) && (msg.msgId == APP_ECHO)) {
+                status = AJ_MarshalArgs(&reply, "u", val);
+            }
+            if ((status == AJ_OK) && (msg.msgId == APP_GARBLE)) {
+                status = AJ_MarshalArgs(&reply, "s", "garbled");
+            }
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            }
+        }
+        AJ_CloseMsg(&msg);
+    }
+    _exit(0);
+}
+
+static AJ_Status Call(Pipeline* pipe, uint32_t msgId, uint32_t timeout, AJ_ReplyHandler handler);
+
+static void EchoDone(AJ_Message* reply, void* context, AJ_Status status)
+{
+    Pipeline* pipe = (Pipeline*)context;
+    uint32_t val;
+
+    if ((status != AJ_OK) || (reply->hdr->msgType != AJ_MSG_METHOD_RET) || (AJ_UnmarshalArgs(reply, "u", &val) != AJ_OK) || (val != reply->replySerial)) {
+        ++pipe->errors;
+    }
+    if (++pipe->done == BENCH_CALLS) {
+        pipe->elapsed = AJ_GetElapsedTime(&pipe->start, TRUE);
+    }
+    /*
+     * Keep the pipeline full
+     */
+    if (pipe->sent < BENCH_CALLS) {
+        if (Call(pipe, PRX_ECHO, 0, EchoDone) != AJ_OK) {
+            ++pipe->errors;
+        }
+    }
+}
+
+static void DropDone(AJ_Message* reply, void* context, AJ_Status status)
+{
+    Pipeline* pipe = (Pipeline*)context;
+
+    /*
+     * The calls were all made at the start so none should time out early
+     */
+    pipe->elapsed = AJ_GetElapsedTime(&pipe->start, TRUE);
+    if ((status != AJ_ERR_TIMEOUT) || (reply->hdr->msgType != AJ_MSG_ERROR) || strcmp(reply->error, AJ_ErrTimeout) || (pipe->elapsed < DROP_TIMEOUT)) {
+        ++pipe->errors;
+    }
+    ++pipe->done;
+}
+
+static void GarbleDone(AJ_Message* reply, void* context, AJ_Status status)
+{
+    Pipeline* pipe = (Pipeline*)context;
+
+    if ((status != AJ_ERR_SIGNATURE) || (reply->hdr->msgType != AJ_MSG_ERROR) || strcmp(reply->error, AJ_ErrRejected) || (reply->msgId != AJ_REPLY_ID(PRX_GARBLE))) {
+        ++pipe->errors;
+    }
+    ++pipe->done;
+}
+
+static AJ_Status Call(Pipeline* pipe, uint32_t msgId, uint32_t timeout, AJ_ReplyHandler handler)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    status = AJ_MarshalMethodCall(pipe->bus, &msg, msgId, ":echo.1", 0, 0, timeout);
+    if (status == AJ_OK) {
+        status = AJ_SetReplyHandler(&msg, handler, pipe);
+    }
+    if (status == AJ_OK) {
+        /*
+         * The echo service returns the serial number of the call
+         */
+        status = AJ_MarshalArgs(&msg, "u", msg.hdr->serialNum);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status == AJ_OK) {
+        ++pipe->sent;
+    }
+    return status;
+}
+
+static AJ_Status Wait(Pipeline* pipe, uint32_t count)
+{
+    AJ_Status status = AJ_OK;
+
+    while ((pipe->done < count) && (status == AJ_OK)) {
+        AJ_Message msg;
+        status = AJ_UnmarshalMsg(pipe->bus, &msg, 1000);
+        /*
+         * Every reply should have been passed to a completion callback
+         */
+        if (status == AJ_OK) {
+            AJ_CloseMsg(&msg);
+            status = AJ_ERR_UNEXPECTED;
+        }
+        if ((status == AJ_ERR_TIMEOUT) && (pipe->done < count)) {
+            status = AJ_OK;
+        }
+    }
+    return (status == AJ_ERR_TIMEOUT) ? AJ_OK : status;
+}
+
+static AJ_Status Bench(AJ_BusAttachment* bus, uint16_t window)
+{
+    AJ_Status status = AJ_OK;
+    Pipeline pipe;
+    uint32_t elapsed;
+    uint16_t i;
+
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.bus = bus;
+    AJ_InitTimer(&pipe.start);
+    for (i = 0; (i < window) && (status == AJ_OK); ++i) {
+        status = Call(&pipe, PRX_ECHO, 0, EchoDone);
+    }
+    if (status == AJ_OK) {
+        status = Wait(&pipe, BENCH_CALLS);
+    }
+    elapsed = pipe.elapsed;
+    if ((status != AJ_OK) || pipe.errors) {
+        AJ_Printf("Window %u failed: %s, %u errors\n", window, AJ_StatusText(status), pipe.errors);
+        return AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Window %3u: %u calls in %u ms, %u calls/s\n", window, pipe.done, elapsed,
+              elapsed ? (uint32_t)(((uint64_t)pipe.done * 1000) / elapsed) : 0);
+    return AJ_OK;
+}
+
+static AJ_Status Timeouts(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+    Pipeline pipe;
+    uint32_t elapsed;
+    uint16_t i;
+
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.bus = bus;
+    AJ_InitTimer(&pipe.start);
+    for (i = 0; (i < AJ_NUM_REPLY_CONTEXTS) && (status == AJ_OK); ++i) {
+        status = Call(&pipe, PRX_DROP, DROP_TIMEOUT, DropDone);
+    }
+    /*
+     * Every reply context is in use
+     */
+    if ((status == AJ_OK) && (Call(&pipe, PRX_DROP, DROP_TIMEOUT, DropDone) != AJ_ERR_RESOURCES)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = Wait(&pipe, AJ_NUM_REPLY_CONTEXTS);
+    }
+    /*
+     * The last call should be reported soon after it timed out
+     */
+    elapsed = pipe.elapsed;
+    if ((status != AJ_OK) || pipe.errors || (pipe.done != AJ_NUM_REPLY_CONTEXTS) || (elapsed > 4 * DROP_TIMEOUT)) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Timeout test %s: %u calls timed out in %u ms\n", (status == AJ_OK) ? "PASSED" : "FAILED", pipe.done, elapsed);
+    return status;
+}
+
+static AJ_Status Rejected(AJ_BusAttachment* bus)
+{
+    AJ_Status status;
+    Pipeline pipe;
+
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.bus = bus;
+    status = Call(&pipe, PRX_GARBLE, 0, GarbleDone);
+    if (status == AJ_OK) {
+        status = Wait(&pipe, 1);
+    }
+    if ((status != AJ_OK) || pipe.errors || (pipe.done != 1)) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Rejected reply test %s\n", (status == AJ_OK) ? "PASSED" : "FAILED");
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_BusAttachment bus;
+    int socks[2];
+    pid_t child;
+    size_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, ProxyObjects);
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) == -1) {
+        return 1;
+    }
+    child = fork();
+    if (child == 0) {
+        close(socks[0]);
+        EchoService(socks[1]);
+    }
+    close(socks[1]);
+    InitBus(&bus, socks[0], ":client.1");
+
+    for (i = 0; (i < ArraySize(windows)) && (status == AJ_OK); ++i) {
+        if (windows[i] <= AJ_NUM_REPLY_CONTEXTS) {
+            status = Bench(&bus, windows[i]);
+        }
+    }
+    if (status == AJ_OK) {
+        status = Timeouts(&bus);
+    }
+    if (status == AJ_OK) {
+        status = Rejected(&bus);
+    }
+    close(socks[0]);
+    waitpid(child, NULL, 0);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#else
+
+int AJ_Main(void)
+{
+    AJ_Printf("The pipelining benchmark needs a POSIX host\n");
+    return 0;
+}
+
+#endif
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
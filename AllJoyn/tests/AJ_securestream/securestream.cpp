@@ -0,0 +1,226 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Encrypted messages larger than the I/O buffers: a secure signal with a 2000 byte body is
+ * delivered through a 256 byte TX buffer into a memory "wire" and received twice, once into an RX
+ * buffer big enough to hold it and once into a 256 byte RX buffer, which must reject it as the MAC
+ * cannot be checked before the body is handed out. A copy with a corrupted body byte must fail
+ * authentication. No daemon is needed.
+ */
+#define AJ_MODULE SECURESTREAM
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+#include <aj_guid.h>
+
+uint8_t dbgSECURESTREAM = 0;
+
+static const char* const streamInterface[] = {
+    "$org.alljoyn.stream",
+    "!blob data>ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription streamInterfaces[] = {
+    streamInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/stream", streamInterfaces },
+    { NULL }
+};
+
+#define STREAM_BLOB AJ_APP_MESSAGE_ID(0, 0, 0)
+
+#define BODY_LEN  2000
+#define CHUNK_LEN 100
+
+static uint8_t wireBuffer[BODY_LEN + 256];
+static size_t wireBytes = 0;
+static size_t wireOffset = 0;
+
+static uint8_t txBuffer[256];
+static uint8_t smallRxBuffer[256];
+static uint8_t largeRxBuffer[BODY_LEN + 256];
+
+static uint8_t body[BODY_LEN];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wireBytes + tx) > sizeof(wireBuffer)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wireBuffer + wireBytes, buf->readPtr, tx);
+    AJ_IO_BUF_RESET(buf);
+    wireBytes += tx;
+    return AJ_OK;
+}
+
+/*
+ * Returns odd sized reads so the MAC and the cipher text blocks get split across calls
+ */
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), 37);
+
+    rx = min(rx, (uint32_t)(wireBytes - wireOffset));
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wireBuffer + wireOffset, rx);
+    buf->writePtr += rx;
+    wireOffset += rx;
+    return AJ_OK;
+}
+
+static AJ_Status Send(AJ_BusAttachment* bus)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint32_t len = BODY_LEN;
+    size_t i;
+
+    wireBytes = 0;
+    status = AJ_MarshalSignal(bus, &msg, STREAM_BLOB, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsgPartial(&msg, len + 4);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(&msg, &len, 4);
+    }
+    for (i = 0; (i < BODY_LEN) && (status == AJ_OK); i += CHUNK_LEN) {
+        status = AJ_MarshalRaw(&msg, body + i, CHUNK_LEN);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status Receive(AJ_BusAttachment* bus, uint8_t* rxBuffer, size_t rxLen)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    const void* data;
+    size_t actual;
+    size_t got = 0;
+
+    wireOffset = 0;
+    AJ_IOBufInit(&bus->sock.rx, rxBuffer, rxLen, AJ_IO_BUF_RX, NULL);
+    bus->sock.rx.recv = RxFunc;
+
+    status = AJ_UnmarshalMsg(bus, &msg, 0);
+    if (status != AJ_OK) {
+        return status;
+    }
+    if (msg.msgId != STREAM_BLOB) {
+        status = AJ_ERR_UNEXPECTED;
+    }
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalRaw(&msg, &data, 4, &actual);
+        if ((status == AJ_OK) && (*(const uint32_t*)data != BODY_LEN)) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+    }
+    while ((status == AJ_OK) && (got < BODY_LEN)) {
+        status = AJ_UnmarshalRaw(&msg, &data, BODY_LEN - got, &actual);
+        if ((status == AJ_OK) && memcmp(data, body + got, actual)) {
+            AJ_Printf("Body mismatch at offset %u\n", (uint32_t)got);
+            status = AJ_ERR_UNMARSHAL;
+        }
+        got += actual;
+    }
+    if (status == AJ_OK) {
+        status = AJ_CloseMsg(&msg);
+    } else {
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status Check(const char* what, AJ_Status status, AJ_Status expect)
+{
+    if (status != expect) {
+        AJ_Printf("%s FAILED: got %s expected %s\n", what, AJ_StatusText(status), AJ_StatusText(expect));
+        return AJ_ERR_FAILURE;
+    }
+    AJ_Printf("%s PASSED\n", what);
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    AJ_GUID guid;
+    uint8_t groupKey[16];
+    size_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    for (i = 0; i < sizeof(body); ++i) {
+        body[i] = (uint8_t)(i * 7 + 3);
+    }
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    /*
+     * There is no daemon so make up a unique name and share our group key with ourself
+     */
+    strcpy(bus.uniqueName, ":stream.1");
+    memset(&guid, 0x5A, sizeof(guid));
+    AJ_GetGroupKey(NULL, groupKey);
+    status = AJ_GUID_AddNameMapping(&guid, bus.uniqueName, NULL);
+    if (status == AJ_OK) {
+        status = AJ_SetGroupKey(bus.uniqueName, groupKey);
+    }
+    if (status == AJ_OK) {
+        status = Check("Streamed encrypt", Send(&bus), AJ_OK);
+    }
+    if (status == AJ_OK) {
+        status = Check("Buffered decrypt", Receive(&bus, largeRxBuffer, sizeof(largeRxBuffer)), AJ_OK);
+    }
+    if (status == AJ_OK) {
+        status = Check("Oversized decrypt", Receive(&bus, smallRxBuffer, sizeof(smallRxBuffer)), AJ_ERR_RESOURCES);
+    }
+    /*
+     * Corrupt a byte near the end of the body
+     */
+    if (status == AJ_OK) {
+        wireBuffer[wireBytes - 20] ^= 1;
+        status = Check("Tampered buffered decrypt", Receive(&bus, largeRxBuffer, sizeof(largeRxBuffer)), AJ_ERR_SECURITY);
+    }
+    if (status == AJ_OK) {
+        status = Check("Tampered oversized decrypt", Receive(&bus, smallRxBuffer, sizeof(smallRxBuffer)), AJ_ERR_RESOURCES);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
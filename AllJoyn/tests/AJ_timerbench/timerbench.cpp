@@ -0,0 +1,243 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Timer wheel: runs 500 timers at mixed periods, sleeping exactly as long as AJ_RunExpiredTimers
+ * says, and checks every timer fired on time. Half the timers are cancelled part way through by
+ * another timer's handler. Also times setting and cancelling timers with the pool full.
+ *
+ * Build the library with AJ_MAX_TIMERS of at least 512.
+ */
+#define AJ_MODULE TIMERBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_helper.h>
+#include <aj_config.h>
+
+uint8_t dbgTIMERBENCH = 0;
+
+#define BENCH_TIMERS     500
+#define BENCH_RUN_TIME   3000
+#define BENCH_CANCEL_AT  1500
+#define BENCH_ROUNDS     200
+/*
+ * Allows for the host scheduler waking us late, the wheel itself never reports a late deadline
+ */
+#define MAX_LATENESS     50
+
+#if AJ_MAX_TIMERS <= BENCH_TIMERS
+#error Build with AJ_MAX_TIMERS of at least 512
+#endif
+
+typedef struct {
+    uint32_t id;
+    uint32_t period;
+    uint32_t expected;
+    uint32_t fires;
+    uint32_t late;
+    uint8_t oneShot;
+    uint8_t cancelled;
+} BenchTimer;
+
+static const uint32_t periods[] = { 7, 20, 50, 125, 400, 1000, 2500 };
+
+static BenchTimer timers[BENCH_TIMERS];
+static AJ_Time epoch;
+static uint32_t badFires;
+
+static uint32_t Now()
+{
+    return AJ_GetElapsedTime(&epoch, TRUE);
+}
+
+static void Fired(void* context)
+{
+    BenchTimer* t = (BenchTimer*)context;
+    uint32_t now = Now();
+
+    if (t->cancelled || (t->oneShot && t->fires)) {
+        ++badFires;
+        return;
+    }
+    if ((int32_t)(now - t->expected) < 0) {
+        ++badFires;
+    } else if (now - t->expected > t->late) {
+        t->late = now - t->expected;
+    }
+    t->expected += t->period;
+    ++t->fires;
+}
+
+static void CancelHalf(void* context)
+{
+    size_t i;
+
+    for (i = 1; i < BENCH_TIMERS; i += 2) {
+        if (!(timers[i].oneShot && timers[i].fires)) {
+            AJ_CancelTimer(timers[i].id);
+        }
+        timers[i].cancelled = TRUE;
+    }
+}
+
+static AJ_Status Capacity()
+{
+    static uint32_t ids[AJ_MAX_TIMERS];
+    AJ_Status status = AJ_OK;
+    size_t i;
+
+    for (i = 0; (i < AJ_MAX_TIMERS) && (status == AJ_OK); ++i) {
+        ids[i] = AJ_SetTimer(100000, Fired, NULL, 0);
+        if (!ids[i]) {
+            status = AJ_ERR_RESOURCES;
+        }
+    }
+    if ((status == AJ_OK) && AJ_SetTimer(100000, Fired, NULL, 0)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        AJ_CancelTimer(ids[AJ_MAX_TIMERS / 2]);
+        if (AJ_SetTimer(100000, Fired, NULL, 0) != ids[AJ_MAX_TIMERS / 2]) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    for (i = 0; i < AJ_MAX_TIMERS; ++i) {
+        if (ids[i]) {
+            AJ_CancelTimer(ids[i]);
+        }
+    }
+    if ((status == AJ_OK) && (AJ_GetNextTimeout() != (uint32_t) -1)) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Capacity test %s\n", (status == AJ_OK) ? "PASSED" : "FAILED");
+    return status;
+}
+
+static AJ_Status SetCancel()
+{
+    static uint32_t ids[BENCH_TIMERS];
+    AJ_Time timer;
+    uint32_t elapsed;
+    size_t i;
+    size_t r;
+
+    AJ_InitTimer(&timer);
+    for (r = 0; r < BENCH_ROUNDS; ++r) {
+        for (i = 0; i < BENCH_TIMERS; ++i) {
+            ids[i] = AJ_SetTimer(periods[i % ArraySize(periods)] * (1 + i % 13), Fired, NULL, 0);
+            if (!ids[i]) {
+                return AJ_ERR_RESOURCES;
+            }
+        }
+        for (i = 0; i < BENCH_TIMERS; ++i) {
+            AJ_CancelTimer(ids[(i * 7) % BENCH_TIMERS]);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_Printf("Set/cancel with %u timers: %u pairs in %u ms, %u ns each\n", BENCH_TIMERS, BENCH_ROUNDS * BENCH_TIMERS, elapsed,
+              (uint32_t)(((uint64_t)elapsed * 1000000) / (BENCH_ROUNDS * BENCH_TIMERS)));
+    return AJ_OK;
+}
+
+static AJ_Status Run()
+{
+    AJ_Status status = AJ_OK;
+    uint32_t runs = 0;
+    uint32_t fires = 0;
+    uint32_t late = 0;
+    uint32_t now;
+    size_t i;
+
+    AJ_InitTimer(&epoch);
+    badFires = 0;
+    for (i = 0; i < BENCH_TIMERS; ++i) {
+        BenchTimer* t = &timers[i];
+        uint32_t first = (uint32_t)(i * 37) % 1000;
+
+        memset(t, 0, sizeof(BenchTimer));
+        t->period = periods[i % ArraySize(periods)];
+        t->oneShot = (i % 5) == 4;
+        t->expected = Now() + first;
+        t->id = AJ_SetTimer(first, Fired, t, t->oneShot ? 0 : t->period);
+        if (!t->id) {
+            return AJ_ERR_RESOURCES;
+        }
+    }
+    if (!AJ_SetTimer(BENCH_CANCEL_AT, CancelHalf, NULL, 0)) {
+        return AJ_ERR_RESOURCES;
+    }
+    while ((now = Now()) < BENCH_RUN_TIME) {
+        uint32_t wait = AJ_RunExpiredTimers();
+        ++runs;
+        now = Now();
+        if (now < BENCH_RUN_TIME) {
+            AJ_Sleep(min(wait, BENCH_RUN_TIME - now));
+        }
+    }
+    for (i = 0; i < BENCH_TIMERS; ++i) {
+        BenchTimer* t = &timers[i];
+        uint32_t first = (uint32_t)(i * 37) % 1000;
+        uint32_t end = t->cancelled ? BENCH_CANCEL_AT : BENCH_RUN_TIME;
+        uint32_t expect = t->oneShot ? 1 : (end - first) / t->period + 1;
+
+        /*
+         * Allow one fire either way for a deadline that falls close to the end of the run
+         */
+        if ((t->fires + 1 < expect) || (t->fires > expect + 1)) {
+            AJ_Printf("Timer %u fired %u times, expected %u\n", (uint32_t)i, t->fires, expect);
+            status = AJ_ERR_FAILURE;
+        }
+        if (!t->cancelled && !(t->oneShot && t->fires)) {
+            AJ_CancelTimer(t->id);
+        }
+        fires += t->fires;
+        late = max(late, t->late);
+    }
+    if (badFires) {
+        AJ_Printf("%u timers fired early or after being cancelled\n", badFires);
+        status = AJ_ERR_FAILURE;
+    }
+    if (late > MAX_LATENESS) {
+        status = AJ_ERR_FAILURE;
+    }
+    AJ_Printf("Mixed period test %s: %u fires in %u runs, latest by %u ms\n", (status == AJ_OK) ? "PASSED" : "FAILED", fires, runs, late);
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+
+    status = Capacity();
+    if (status == AJ_OK) {
+        status = SetCancel();
+    }
+    if (status == AJ_OK) {
+        status = Run();
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
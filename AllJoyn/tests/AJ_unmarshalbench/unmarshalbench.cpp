@@ -0,0 +1,237 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright (c) 2014, AllSeen Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for any
+ *    purpose with or without fee is hereby granted, provided that the above
+ *    copyright notice and this permission notice appear in all copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/*
+ * Receive-path throughput: signals with 1, 64 and 1400 byte bodies are marshalled into a memory
+ * "wire" and then pulled back through an AJ_RingBuffer the same way AJ_Net_Recv does it. Prints
+ * the bytes/s through AJ_UnmarshalMsg() for each body size. No daemon is needed.
+ */
+#define AJ_MODULE UNMARSHALBENCH
+
+#include <aj_debug.h>
+#include <alljoyn.h>
+#include <aj_bufio.h>
+
+uint8_t dbgUNMARSHALBENCH = 0;
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.bench",
+    "!blob data>ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/bench", benchInterfaces },
+    { NULL }
+};
+
+#define BENCH_BLOB AJ_APP_MESSAGE_ID(0, 0, 0)
+
+#define BENCH_MSGS_PER_FILL 4
+#define BENCH_ITERATIONS    20000
+
+static uint8_t wireBuffer[BENCH_MSGS_PER_FILL * 1536];
+static size_t wireBytes = 0;
+static size_t wireOffset = 0;
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1454];
+
+static uint8_t ringData[512];
+static AJ_RingBuffer ring;
+
+static uint8_t body[1400];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((wireBytes + tx) > sizeof(wireBuffer)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(wireBuffer + wireBytes, buf->readPtr, tx);
+    AJ_IO_BUF_RESET(buf);
+    wireBytes += tx;
+    return AJ_OK;
+}
+
+/*
+ * Stands in for a socket read, returns up to len bytes from the wire
+ */
+static uint32_t WireRead(uint8_t* dest, uint32_t len)
+{
+    len = min(len, (uint32_t)(wireBytes - wireOffset));
+    memcpy(dest, wireBuffer + wireOffset, len);
+    wireOffset += len;
+    return len;
+}
+
+/*
+ * Same shape as AJ_Net_Recv(): small requests are served from the ring, large ones bypass it
+ */
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    uint16_t contig;
+    uint8_t* ringPtr;
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), len);
+
+    if (AJ_RING_BUF_AVAIL(&ring) == 0) {
+        if (wireOffset == wireBytes) {
+            return AJ_ERR_TIMEOUT;
+        }
+        if (rx >= (sizeof(ringData) / 2)) {
+            buf->writePtr += WireRead(buf->writePtr, rx);
+            return AJ_OK;
+        }
+        ring.head = ring.tail = 0;
+        ringPtr = AJ_RingBufWritePtr(&ring, &contig);
+        AJ_RingBufCommit(&ring, (uint16_t)WireRead(ringPtr, contig));
+    }
+    buf->writePtr += AJ_RingBufRead(&ring, buf->writePtr, (uint16_t)rx);
+    return AJ_OK;
+}
+
+static AJ_Status Fill(AJ_BusAttachment* bus, uint16_t bodyLen)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    uint32_t len = bodyLen;
+    size_t i;
+
+    wireBytes = 0;
+    wireOffset = 0;
+    for (i = 0; (i < BENCH_MSGS_PER_FILL) && (status == AJ_OK); ++i) {
+        status = AJ_MarshalSignal(bus, &msg, BENCH_BLOB, NULL, 0, 0, 0);
+        /*
+         * The array is marshalled raw so bodies bigger than the TX buffer can be streamed out
+         */
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsgPartial(&msg, len + 4);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalRaw(&msg, &len, 4);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalRaw(&msg, body, len);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+    }
+    return status;
+}
+
+/*
+ * The body is pulled through AJ_UnmarshalRaw() because a 1400 byte array plus the header does not
+ * fit in the RX buffer in one piece
+ */
+static AJ_Status Drain(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    const void* data;
+    size_t actual;
+    size_t got;
+    size_t i;
+
+    for (i = 0; (i < BENCH_MSGS_PER_FILL) && (status == AJ_OK); ++i) {
+        status = AJ_UnmarshalMsg(bus, &msg, 0);
+        if (status != AJ_OK) {
+            break;
+        }
+        if (msg.msgId != BENCH_BLOB) {
+            status = AJ_ERR_UNEXPECTED;
+        }
+        for (got = 0; (status == AJ_OK) && (got < msg.hdr->bodyLen); got += actual) {
+            status = AJ_UnmarshalRaw(&msg, &data, msg.hdr->bodyLen - got, &actual);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * The wire is filled once and replayed so only the receive path is timed
+ */
+static AJ_Status Bench(AJ_BusAttachment* bus, uint16_t bodyLen)
+{
+    AJ_Status status;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t bytes;
+    size_t i;
+
+    status = Fill(bus, bodyLen);
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < BENCH_ITERATIONS) && (status == AJ_OK); ++i) {
+        wireOffset = 0;
+        status = Drain(bus);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status != AJ_OK) {
+        AJ_Printf("%u byte body failed with %s\n", bodyLen, AJ_StatusText(status));
+        return status;
+    }
+    bytes = wireBytes * BENCH_ITERATIONS;
+    AJ_Printf("%4u byte body: %u messages, %u bytes in %u ms, %u bytes/s\n",
+              bodyLen, BENCH_ITERATIONS * BENCH_MSGS_PER_FILL, bytes, elapsed,
+              elapsed ? (uint32_t)(((uint64_t)bytes * 1000) / elapsed) : 0);
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+    AJ_RingBufInit(&ring, ringData, sizeof(ringData));
+    /*
+     * There is no daemon so make up a unique name for the header checks
+     */
+    strcpy(bus.uniqueName, ":bench.1");
+
+    status = Bench(&bus, 1);
+    if (status == AJ_OK) {
+        status = Bench(&bus, 64);
+    }
+    if (status == AJ_OK) {
+        status = Bench(&bus, 1400);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
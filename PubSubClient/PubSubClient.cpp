@@ -7,9 +7,39 @@
 #include "PubSubClient.h"
 #include <string.h>
 
+// States of a publish queue entry
+#define MQTT_QUEUED   0 // PUBLISH to be sent
+#define MQTT_SENT     1 // PUBLISH sent, waiting for PUBACK or PUBREC
+#define MQTT_RELEASE  2 // PUBREL to be sent
+#define MQTT_RELEASED 3 // PUBREL sent, waiting for PUBCOMP
+#define MQTT_DONE     4 // acknowledged, dropped once it reaches the head
+
+// States of the reader of incoming packets
+#define MQTT_READ_TYPE   0 // waiting for a packet's first byte
+#define MQTT_READ_LENGTH 1 // in its remaining length field
+#define MQTT_READ_BODY   2 // reading the rest of it into inBuffer
+#define MQTT_READ_TOPIC  3 // reading topic and message id of a streamed PUBLISH
+#define MQTT_READ_CHUNK  4 // reading a streamed PUBLISH's payload
+#define MQTT_READ_SKIP   5 // dropping readOffset bytes of a packet too long
+
 PubSubClient::PubSubClient() {
    this->_client = NULL;
    this->stream = NULL;
+   this->writeInPlace = NULL;
+   this->chunkCallback = NULL;
+   this->publishRemaining = 0;
+   this->publishStaged = 0;
+   this->publishOk = false;
+   this->publishOpen = false;
+   this->queue = NULL;
+   this->queueCount = 0;
+   this->queueSent = 0;
+   this->topicPool = NULL;
+   this->readState = MQTT_READ_TYPE;
+   this->readPos = 0;
+   this->connackPending = false;
+   this->cleanSession = true;
+   this->loopBins = NULL;
 }
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, void (*callback)(char*,uint8_t*,unsigned int), Client& client) {
@@ -19,6 +49,21 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, void (*callback)(char*,ui
    this->port = port;
    this->domain = NULL;
    this->stream = NULL;
+   this->writeInPlace = NULL;
+   this->chunkCallback = NULL;
+   this->publishRemaining = 0;
+   this->publishStaged = 0;
+   this->publishOk = false;
+   this->publishOpen = false;
+   this->queue = NULL;
+   this->queueCount = 0;
+   this->queueSent = 0;
+   this->topicPool = NULL;
+   this->readState = MQTT_READ_TYPE;
+   this->readPos = 0;
+   this->connackPending = false;
+   this->cleanSession = true;
+   this->loopBins = NULL;
 }
 
 PubSubClient::PubSubClient(char* domain, uint16_t port, void (*callback)(char*,uint8_t*,unsigned int), Client& client) {
@@ -27,6 +72,21 @@ PubSubClient::PubSubClient(char* domain, uint16_t port, void (*callback)(char*,u
    this->domain = domain;
    this->port = port;
    this->stream = NULL;
+   this->writeInPlace = NULL;
+   this->chunkCallback = NULL;
+   this->publishRemaining = 0;
+   this->publishStaged = 0;
+   this->publishOk = false;
+   this->publishOpen = false;
+   this->queue = NULL;
+   this->queueCount = 0;
+   this->queueSent = 0;
+   this->topicPool = NULL;
+   this->readState = MQTT_READ_TYPE;
+   this->readPos = 0;
+   this->connackPending = false;
+   this->cleanSession = true;
+   this->loopBins = NULL;
 }
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, void (*callback)(char*,uint8_t*,unsigned int), Client& client, Stream& stream) {
@@ -36,6 +96,21 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, void (*callback)(char*,ui
    this->port = port;
    this->domain = NULL;
    this->stream = &stream;
+   this->writeInPlace = NULL;
+   this->chunkCallback = NULL;
+   this->publishRemaining = 0;
+   this->publishStaged = 0;
+   this->publishOk = false;
+   this->publishOpen = false;
+   this->queue = NULL;
+   this->queueCount = 0;
+   this->queueSent = 0;
+   this->topicPool = NULL;
+   this->readState = MQTT_READ_TYPE;
+   this->readPos = 0;
+   this->connackPending = false;
+   this->cleanSession = true;
+   this->loopBins = NULL;
 }
 
 PubSubClient::PubSubClient(char* domain, uint16_t port, void (*callback)(char*,uint8_t*,unsigned int), Client& client, Stream& stream) {
@@ -44,6 +119,21 @@ PubSubClient::PubSubClient(char* domain, uint16_t port, void (*callback)(char*,u
    this->domain = domain;
    this->port = port;
    this->stream = &stream;
+   this->writeInPlace = NULL;
+   this->chunkCallback = NULL;
+   this->publishRemaining = 0;
+   this->publishStaged = 0;
+   this->publishOk = false;
+   this->publishOpen = false;
+   this->queue = NULL;
+   this->queueCount = 0;
+   this->queueSent = 0;
+   this->topicPool = NULL;
+   this->readState = MQTT_READ_TYPE;
+   this->readPos = 0;
+   this->connackPending = false;
+   this->cleanSession = true;
+   this->loopBins = NULL;
 }
 
 boolean PubSubClient::connect(char *id) {
@@ -59,8 +149,35 @@ boolean PubSubClient::connect(char *id, char* willTopic, uint8_t willQos, uint8_
    return connect(id,NULL,NULL,willTopic,willQos,willRetain,willMessage);
 }
 
+// Waits in loop() for the CONNACK, up to MQTT_KEEPALIVE seconds
 boolean PubSubClient::connect(char *id, char *user, char *pass, char* willTopic, uint8_t willQos, uint8_t willRetain, char* willMessage) {
-   if (!connected()) {
+   if (!startConnect(id,user,pass,willTopic,willQos,willRetain,willMessage)) {
+      return false;
+   }
+   while (connecting()) {
+      loop();
+   }
+   return connected();
+}
+
+boolean PubSubClient::startConnect(char *id) {
+   return startConnect(id,NULL,NULL,0,0,0,0);
+}
+
+boolean PubSubClient::startConnect(char *id, char *user, char *pass) {
+   return startConnect(id,user,pass,0,0,0,0);
+}
+
+boolean PubSubClient::startConnect(char *id, char* willTopic, uint8_t willQos, uint8_t willRetain, char* willMessage)
+{
+   return startConnect(id,NULL,NULL,willTopic,willQos,willRetain,willMessage);
+}
+
+// Opens the connection and sends CONNECT without waiting for the CONNACK.
+// loop() takes it when it comes: connecting() is true until then, and
+// connected() once it accepted the connection.
+boolean PubSubClient::startConnect(char *id, char *user, char *pass, char* willTopic, uint8_t willQos, uint8_t willRetain, char* willMessage) {
+   if (!connected() && !connackPending && !publishOpen) {
       int result = 0;
       
       if (domain != NULL) {
@@ -70,20 +187,20 @@ boolean PubSubClient::connect(char *id, char *user, char *pass, char* willTopic,
       }
       
       if (result) {
-         nextMsgId = 1;
+         if (queueCount == 0) {
+            nextMsgId = 1; // queued messages keep their ids across connections
+         }
          uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p',MQTTPROTOCOLVERSION};
          // Leave room in the buffer for header and variable length field
-         uint16_t length = 5;
+         uint16_t length = MQTT_PACKET_START;
          unsigned int j;
          for (j = 0;j<9;j++) {
             buffer[length++] = d[j];
          }
 
-         uint8_t v;
+         uint8_t v = cleanSession ? 0x02 : 0x00;
          if (willTopic) {
-            v = 0x06|(willQos<<3)|(willRetain<<5);
-         } else {
-            v = 0x02;
+            v = v|0x04|(willQos<<3)|(willRetain<<5);
          }
 
          if(user != NULL) {
@@ -111,23 +228,10 @@ boolean PubSubClient::connect(char *id, char *user, char *pass, char* willTopic,
             }
          }
          
-         write(MQTTCONNECT,buffer,length-5);
-         
-         lastInActivity = lastOutActivity = millis();
-         
-         while (!_client->available()) {
-            unsigned long t = millis();
-            if (t-lastInActivity > MQTT_KEEPALIVE*1000UL) {
-               _client->stop();
-               return false;
-            }
-         }
-         uint8_t llen;
-         uint16_t len = readPacket(&llen);
-         
-         if (len == 4 && buffer[3] == 0) {
-            lastInActivity = millis();
-            pingOutstanding = false;
+         resetReader();
+         if (write(MQTTCONNECT,buffer,length-MQTT_PACKET_START)) {
+            lastInActivity = lastOutActivity = millis();
+            connackPending = true;
             return true;
          }
       }
@@ -136,68 +240,175 @@ boolean PubSubClient::connect(char *id, char *user, char *pass, char* willTopic,
    return false;
 }
 
-uint8_t PubSubClient::readByte() {
-   while(!_client->available()) {}
-   return _client->read();
+// True from startConnect() until the CONNACK came or the connection failed
+boolean PubSubClient::connecting() {
+   return !connected() && connackPending;
 }
 
-uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
-   uint16_t len = 0;
-   buffer[len++] = readByte();
-   bool isPublish = (buffer[0]&0xF0) == MQTTPUBLISH;
-   uint32_t multiplier = 1;
-   uint16_t length = 0;
-   uint8_t digit = 0;
-   uint16_t skip = 0;
-   uint8_t start = 0;
-   
-   do {
-      digit = readByte();
-      buffer[len++] = digit;
-      length += (digit & 127) * multiplier;
-      multiplier *= 128;
-   } while ((digit & 128) != 0);
-   *lengthLength = len-1;
+void PubSubClient::resetReader() {
+   readState = MQTT_READ_TYPE;
+   readPos = 0;
+}
 
-   if (isPublish) {
-      // Read in topic length to calculate bytes to skip over for Stream writing
-      buffer[len++] = readByte();
-      buffer[len++] = readByte();
-      skip = (buffer[*lengthLength+1]<<8)+buffer[*lengthLength+2];
-      start = 2;
-      if (buffer[0]&MQTTQOS1) {
-         // skip message id
-         skip += 2;
+// Adds what has arrived, up to end, to the packet in inBuffer. True once it
+// reaches end, false when nothing more has arrived.
+boolean PubSubClient::readUntil(uint16_t end) {
+   while (readPos < end) {
+      int n = _client->available();
+      if (n <= 0) {
+         return false;
       }
+      if (n > end-readPos) {
+         n = end-readPos;
+      }
+      n = _client->read(inBuffer+readPos,n);
+      if (n <= 0) {
+         return false;
+      }
+      readPos += n;
    }
+   return true;
+}
 
-   for (uint16_t i = start;i<length;i++) {
-      digit = readByte();
-      if (this->stream) {
-         if (isPublish && len-*lengthLength-2>skip) {
-             this->stream->write(digit);
+// Whether loop() has used up the time it was given
+boolean PubSubClient::overBudget() {
+   return loopBudget != 0 && micros()-loopStart >= loopBudget;
+}
+
+// Reads what has arrived of the next packet into inBuffer and returns its
+// length once all of it is there, 0 until then. Nothing is waited for: a
+// packet that is still coming in is kept and read on by the next call.
+// PUBLISH payloads for chunkCallback, or the stream, go through the space
+// behind topic and message id a buffer full at a time; the length returned
+// for those is that of the whole packet. Packets too long for the buffer are
+// dropped. Streaming or dropping stops early when loop()'s time is up.
+uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
+   for (;;) {
+      uint16_t head = readLlen+1;
+      if (readState == MQTT_READ_TYPE || readState == MQTT_READ_LENGTH) {
+         if (!readUntil(readPos+1)) {
+            return 0;
+         }
+         uint8_t digit = inBuffer[readPos-1];
+         if (readState == MQTT_READ_TYPE) {
+            readState = MQTT_READ_LENGTH;
+            readLength = 0;
+            continue;
+         }
+         readLength += (uint32_t)(digit & 127) << (7*(readPos-2));
+         if ((digit & 128) != 0 && readPos < 5) {
+            continue;
+         }
+         readLlen = readPos-1;
+         if ((inBuffer[0]&0xF0) == MQTTPUBLISH && (this->chunkCallback || this->stream)) {
+            readHlen = 0;
+            readState = MQTT_READ_TOPIC;
+         } else if (readLength > (uint32_t)(MQTT_MAX_PACKET_SIZE-readPos)) {
+            readOffset = readLength;
+            readState = MQTT_READ_SKIP;
+         } else {
+            readState = MQTT_READ_BODY;
+         }
+      } else if (readState == MQTT_READ_BODY) {
+         if (!readUntil(head+readLength)) {
+            return 0;
+         }
+         break;
+      } else if (readState == MQTT_READ_TOPIC) {
+         if (readHlen == 0) {
+            if (readLength < 2) {
+               readOffset = readLength;
+               readState = MQTT_READ_SKIP;
+               continue;
+            }
+            if (!readUntil(head+2)) {
+               return 0;
+            }
+            readHlen = head+2+(inBuffer[head]<<8)+inBuffer[head+1];
+            if (inBuffer[0]&0x06) {
+               readHlen += 2; // message id
+            }
+            if (readHlen >= MQTT_MAX_PACKET_SIZE || readHlen > head+readLength) {
+               readOffset = readLength-2;
+               readState = MQTT_READ_SKIP;
+               continue;
+            }
+         }
+         if (!readUntil(readHlen)) {
+            return 0;
+         }
+         topicInPlace(head,(inBuffer[head]<<8)+inBuffer[head+1]);
+         readOffset = 0;
+         readState = MQTT_READ_CHUNK;
+      } else if (readState == MQTT_READ_CHUNK) {
+         uint32_t total = head+readLength-readHlen;
+         uint32_t left = total-readOffset;
+         uint16_t n = (left < (uint32_t)(MQTT_MAX_PACKET_SIZE-readHlen)) ? left : MQTT_MAX_PACKET_SIZE-readHlen;
+         if (!readUntil(readHlen+n)) {
+            return 0;
+         }
+         char* topic = (char*)inBuffer+head+1;
+         if (this->chunkCallback) {
+            this->chunkCallback(topic,readOffset,inBuffer+readHlen,n,total);
+         } else {
+            this->stream->write(inBuffer+readHlen,n);
+         }
+         readOffset += n;
+         readPos = readHlen;
+         if (readOffset == total) {
+            // put the topic back for loop() to find the message id behind it
+            uint16_t tl = readHlen-head-2-((inBuffer[0]&0x06) ? 2 : 0);
+            memmove(topic+1,topic,tl);
+            inBuffer[head+1] = (tl & 0xFF);
+            break;
+         }
+         if (overBudget()) {
+            return 0;
+         }
+      } else {
+         uint16_t n = (readOffset < MQTT_MAX_PACKET_SIZE) ? readOffset : MQTT_MAX_PACKET_SIZE;
+         readPos = 0;
+         boolean all = readUntil(n);
+         readOffset -= readPos;
+         if (readOffset == 0) {
+            resetReader();
+            return 0; // This will cause the packet to be ignored.
+         }
+         if (!all || overBudget()) {
+            return 0;
          }
       }
-      if (len < MQTT_MAX_PACKET_SIZE) {
-         buffer[len] = digit;
-      }
-      len++;
-   }
-   
-   if (!this->stream && len > MQTT_MAX_PACKET_SIZE) {
-       len = 0; // This will cause the packet to be ignored.
    }
-
-   return len;
+   *lengthLength = readLlen;
+   resetReader();
+   return readLlen+1+readLength;
 }
 
 boolean PubSubClient::loop() {
-   if (connected()) {
+   return loop(0);
+}
+
+// Handles what has arrived, never waiting for more: a packet still coming in
+// is finished by a later call. With a budget of 0 it stops after one packet,
+// otherwise it goes on with the next ones until budget microseconds are up.
+boolean PubSubClient::loop(unsigned long budget) {
+   boolean rc = connected() || connackPending;
+   loopStart = micros();
+   loopBudget = budget;
+   // Incoming packets, and the acks and pings they lead to, wait while a
+   // streamed PUBLISH is open: anything written now would land in its payload
+   if (rc && !publishOpen) {
       unsigned long t = millis();
-      if ((t - lastInActivity > MQTT_KEEPALIVE*1000UL) || (t - lastOutActivity > MQTT_KEEPALIVE*1000UL)) {
+      if (connackPending) {
+         if (t - lastInActivity > MQTT_KEEPALIVE*1000UL) {
+            _client->stop();
+            connackPending = false;
+            rc = false;
+         }
+      } else if ((t - lastInActivity > MQTT_KEEPALIVE*1000UL) || (t - lastOutActivity > MQTT_KEEPALIVE*1000UL)) {
          if (pingOutstanding) {
             _client->stop();
-            return false;
+            rc = false;
          } else {
             buffer[0] = MQTTPINGREQ;
             buffer[1] = 0;
@@ -207,38 +418,47 @@ boolean PubSubClient::loop() {
             pingOutstanding = true;
          }
       }
-      if (_client->available()) {
+      while (rc && _client->available()) {
          uint8_t llen;
-         uint16_t len = readPacket(&llen);
+         uint32_t len = readPacket(&llen);
          uint16_t msgId = 0;
          uint8_t *payload;
          if (len > 0) {
             lastInActivity = t;
-            uint8_t type = buffer[0]&0xF0;
-            if (type == MQTTPUBLISH) {
-               if (callback) {
-                  uint16_t tl = (buffer[llen+1]<<8)+buffer[llen+2];
-                  char topic[tl+1];
-                  for (uint16_t i=0;i<tl;i++) {
-                     topic[i] = buffer[llen+3+i];
+            uint8_t type = inBuffer[0]&0xF0;
+            if (type == MQTTCONNACK) {
+               if (connackPending) {
+                  connackPending = false;
+                  if (len == 4 && inBuffer[3] == 0) {
+                     pingOutstanding = false;
+                     // the server keeps the session from now on, so a
+                     // resent QoS 2 message is not delivered twice
+                     cleanSession = (queue == NULL);
+                     requeue();
+                     pumpQueue();
+                  } else {
+                     _client->stop();
+                     rc = false;
                   }
-                  topic[tl] = 0;
+               }
+            } else if (type == MQTTPUBLISH) {
+               if (callback || chunkCallback || topicPool) {
+                  uint16_t tl = (inBuffer[llen+1]<<8)+inBuffer[llen+2];
+                  payload = inBuffer+llen+3+tl;
                   // msgId only present for QOS>0
-                  if ((buffer[0]&0x06) == MQTTQOS1) {
-                    msgId = (buffer[llen+3+tl]<<8)+buffer[llen+3+tl+1];
-                    payload = buffer+llen+3+tl+2;
-                    callback(topic,payload,len-llen-3-tl-2);
-                    
-                    buffer[0] = MQTTPUBACK;
-                    buffer[1] = 2;
-                    buffer[2] = (msgId >> 8);
-                    buffer[3] = (msgId & 0xFF);
-                    _client->write(buffer,4);
-                    lastOutActivity = t;
-
-                  } else {
-                    payload = buffer+llen+3+tl;
-                    callback(topic,payload,len-llen-3-tl);
+                  if ((inBuffer[0]&0x06) == MQTTQOS1) {
+                    msgId = (inBuffer[llen+3+tl]<<8)+inBuffer[llen+3+tl+1];
+                    payload += 2;
+                  }
+                  if (!chunkCallback) {
+                     char* topic = topicInPlace(llen+1,tl);
+                     unsigned int plength = len-(payload-inBuffer);
+                     if ((topicPool == NULL || dispatch(0,topic,0,tl,payload,plength) == 0) && callback) {
+                        callback(topic,payload,plength);
+                     }
+                  }
+                  if ((inBuffer[0]&0x06) == MQTTQOS1) {
+                    writeAck(MQTTPUBACK,msgId);
                   }
                }
             } else if (type == MQTTPINGREQ) {
@@ -247,12 +467,27 @@ boolean PubSubClient::loop() {
                _client->write(buffer,2);
             } else if (type == MQTTPINGRESP) {
                pingOutstanding = false;
+            } else if (type == MQTTPUBACK || type == MQTTPUBREC || type == MQTTPUBCOMP) {
+               acknowledge(type,(inBuffer[llen+1]<<8)+inBuffer[llen+2]);
+               pumpQueue();
             }
          }
+         if (budget == 0 || overBudget()) {
+            break;
+         }
       }
-      return true;
    }
-   return false;
+   if (loopBins) {
+      // bin i counts calls that took less than 2^i microseconds
+      unsigned long d = micros()-loopStart;
+      uint8_t i = 0;
+      while (d > 0 && i < loopBinCount-1) {
+         d >>= 1;
+         i++;
+      }
+      loopBins[i]++;
+   }
+   return rc;
 }
 
 boolean PubSubClient::publish(char* topic, char* payload) {
@@ -264,9 +499,9 @@ boolean PubSubClient::publish(char* topic, uint8_t* payload, unsigned int plengt
 }
 
 boolean PubSubClient::publish(char* topic, uint8_t* payload, unsigned int plength, boolean retained) {
-   if (connected()) {
+   if (connected() && !publishOpen) {
       // Leave room in the buffer for header and variable length field
-      uint16_t length = 5;
+      uint16_t length = MQTT_PACKET_START;
       length = writeString(topic,buffer,length);
       uint16_t i;
       for (i=0;i<plength;i++) {
@@ -276,11 +511,26 @@ boolean PubSubClient::publish(char* topic, uint8_t* payload, unsigned int plengt
       if (retained) {
          header |= 1;
       }
-      return write(header,buffer,length-5);
+      return write(header,buffer,length-MQTT_PACKET_START);
    }
    return false;
 }
 
+// QoS 1 and 2 messages go through the publish queue, see setPublishQueue().
+// They are accepted while disconnected and false means the queue is full.
+boolean PubSubClient::publish(char* topic, uint8_t* payload, unsigned int plength, boolean retained, uint8_t qos) {
+   if (qos == 0) {
+      return publish(topic,payload,plength,retained);
+   }
+   if (qos > 2 || queue == NULL || !enqueue(topic,payload,plength,retained,qos)) {
+      return false;
+   }
+   if (connected() && !publishOpen) {
+      pumpQueue();
+   }
+   return true;
+}
+
 boolean PubSubClient::publish_P(char* topic, uint8_t* PROGMEM payload, unsigned int plength, boolean retained) {
    uint8_t llen = 0;
    uint8_t digit;
@@ -291,7 +541,7 @@ boolean PubSubClient::publish_P(char* topic, uint8_t* PROGMEM payload, unsigned
    uint8_t header;
    unsigned int len;
    
-   if (!connected()) {
+   if (!connected() || publishOpen) {
       return false;
    }
    
@@ -323,7 +573,121 @@ boolean PubSubClient::publish_P(char* topic, uint8_t* PROGMEM payload, unsigned
    
    lastOutActivity = millis();
    
-   return rc == tlen + 4 + plength;
+   return rc == 1 + llen + 2 + tlen + plength;
+}
+
+// Starts a PUBLISH whose payload of plength bytes follows in write() calls
+// and is finished by endPublish(). Small writes are gathered in the buffer,
+// a write of a buffer full or more goes straight to the client, in blocks of
+// at most MQTT_MAX_WRITE_SIZE, so the payload is not limited by
+// MQTT_MAX_PACKET_SIZE.
+// Until endPublish() nothing else may be written to the connection: other
+// publish(), subscribe(), unsubscribe() and startConnect() calls fail,
+// QoS 1 and 2 messages stay queued, and loop() leaves incoming packets,
+// with the acks they need, and keepalive pings for after endPublish().
+boolean PubSubClient::beginPublish(char* topic, uint32_t plength, boolean retained) {
+   if (!connected() || publishOpen) {
+      return false;
+   }
+   uint16_t tlen = strlen(topic);
+   if (tlen > MQTT_MAX_PACKET_SIZE-7) {
+      return false; // header, 4 length bytes and the topic length first
+   }
+   uint8_t* p = buffer+MQTT_TX_HEADROOM;
+   uint16_t pos = 0;
+   uint32_t len = plength+2+tlen;
+   uint8_t digit;
+   p[pos++] = MQTTPUBLISH | (retained ? 1 : 0);
+   do {
+      digit = len % 128;
+      len = len / 128;
+      if (len > 0) {
+         digit |= 0x80;
+      }
+      p[pos++] = digit;
+   } while(len>0);
+   publishStaged = writeString(topic,p,pos);
+   publishRemaining = plength;
+   publishOk = true;
+   publishOpen = true;
+   return true;
+}
+
+size_t PubSubClient::write(uint8_t data) {
+   return write(&data,1);
+}
+
+// Payload of the PUBLISH started by beginPublish(), anything beyond the
+// length given there is not written
+size_t PubSubClient::write(const uint8_t* data, size_t size) {
+   if (size > publishRemaining) {
+      size = publishRemaining;
+   }
+   if (size == 0) {
+      return 0;
+   }
+   publishRemaining -= size;
+   if (publishStaged+size > MQTT_MAX_PACKET_SIZE) {
+      if (!flushPublish()) {
+         return 0;
+      }
+      if (size >= MQTT_MAX_PACKET_SIZE) {
+         size_t done = 0;
+         while (done < size) {
+            size_t n = size-done;
+            if (n > MQTT_MAX_WRITE_SIZE) {
+               n = MQTT_MAX_WRITE_SIZE;
+            }
+            if (_client->write(data+done,n) != n) {
+               publishOk = false;
+               return 0;
+            }
+            done += n;
+         }
+         lastOutActivity = millis();
+         return size;
+      }
+   }
+   memcpy(buffer+MQTT_TX_HEADROOM+publishStaged,data,size);
+   publishStaged += size;
+   return size;
+}
+
+boolean PubSubClient::flushPublish() {
+   if (publishStaged > 0) {
+      uint8_t* p = buffer+MQTT_TX_HEADROOM;
+      size_t rc;
+      if (writeInPlace) {
+         rc = writeInPlace(p,publishStaged);
+      } else {
+         rc = _client->write(p,publishStaged);
+      }
+      if (rc != publishStaged) {
+         publishOk = false;
+      }
+      publishStaged = 0;
+      lastOutActivity = millis();
+   }
+   return publishOk;
+}
+
+// Sends what is left of the PUBLISH started by beginPublish(). False if a
+// write failed or less payload was written than announced, the connection
+// is then out of step with the server and should be dropped.
+boolean PubSubClient::endPublish() {
+   if (!publishOpen) {
+      return false;
+   }
+   boolean rc = flushPublish() && publishRemaining == 0;
+   publishRemaining = 0;
+   publishOk = false;
+   publishOpen = false;
+   // The server's packets were not read meanwhile, time its silence from now
+   lastInActivity = millis();
+   if (rc && connected()) {
+      pumpQueue();
+   }
+   return rc;
 }
 
 boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
@@ -343,16 +707,176 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
       llen++;
    } while(len>0);
 
-   buf[4-llen] = header;
+   buf[MQTT_PACKET_START-1-llen] = header;
    for (int i=0;i<llen;i++) {
-      buf[5-llen+i] = lenBuf[i];
+      buf[MQTT_PACKET_START-llen+i] = lenBuf[i];
+   }
+   if (writeInPlace) {
+      rc = writeInPlace(buf+(MQTT_PACKET_START-1-llen),length+1+llen);
+   } else {
+      rc = _client->write(buf+(MQTT_PACKET_START-1-llen),length+1+llen);
    }
-   rc = _client->write(buf+(4-llen),length+1+llen);
    
    lastOutActivity = millis();
    return (rc == 1+llen+length);
 }
 
+boolean PubSubClient::writeAck(uint8_t header, uint16_t msgId) {
+   buffer[0] = header;
+   buffer[1] = 2;
+   buffer[2] = (msgId >> 8);
+   buffer[3] = (msgId & 0xFF);
+   lastOutActivity = millis();
+   return _client->write(buffer,4) == 4;
+}
+
+// The entry at pos, or at the start of the ring if the one before it left
+// no room there
+uint16_t PubSubClient::queueEntry(uint16_t pos) {
+   if (pos+2 > queueSize || (queue[pos]|queue[pos+1]) == 0) {
+      return 0;
+   }
+   return pos;
+}
+
+// Adds a PUBLISH packet behind the last entry, wrapping around to the start
+// of the ring when it does not fit in front of the end
+boolean PubSubClient::enqueue(char* topic, uint8_t* payload, unsigned int plength, boolean retained, uint8_t qos) {
+   uint16_t tlen = strlen(topic);
+   uint32_t remaining = 2+tlen+2+plength;
+   uint8_t llen = (remaining < 128) ? 1 : (remaining < 16384) ? 2 : 3;
+   uint32_t len = MQTT_QUEUE_ENTRY_HEADER+1+llen+remaining;
+   uint16_t pos = queueTail;
+   uint8_t digit;
+
+   if (queueCount == 0) {
+      queueHead = queueTail = queueSend = pos = 0;
+   }
+   if (len > queueSize) {
+      return false;
+   }
+   if (queueCount > 0 && queueTail <= queueHead) {
+      if (pos+len > queueHead) {
+         return false;
+      }
+   } else if (pos+len > queueSize) {
+      if (queueCount > 0 && len > queueHead) {
+         return false;
+      }
+      if (pos+2 <= queueSize) {
+         queue[pos] = queue[pos+1] = 0;
+      }
+      pos = 0;
+   }
+
+   nextMsgId++;
+   if (nextMsgId == 0) {
+      nextMsgId = 1;
+   }
+   uint8_t* e = queue+pos;
+   uint16_t i = MQTT_QUEUE_ENTRY_HEADER;
+   e[0] = (len >> 8);
+   e[1] = (len & 0xFF);
+   e[2] = MQTT_QUEUED;
+   e[3] = (nextMsgId >> 8);
+   e[4] = (nextMsgId & 0xFF);
+   e[i++] = MQTTPUBLISH | (qos << 1) | (retained ? 1 : 0);
+   do {
+      digit = remaining % 128;
+      remaining = remaining / 128;
+      if (remaining > 0) {
+         digit |= 0x80;
+      }
+      e[i++] = digit;
+   } while(remaining>0);
+   i = writeString(topic,e,i);
+   e[i++] = e[3];
+   e[i++] = e[4];
+   memcpy(e+i,payload,plength);
+
+   queueTail = pos+len;
+   queueCount++;
+   return true;
+}
+
+// Sends queued PUBLISH and PUBREL packets while the window has room
+void PubSubClient::pumpQueue() {
+   while (queueSent < queueCount && inflight < window) {
+      uint16_t pos = queueEntry(queueSend);
+      uint8_t* e = queue+pos;
+      uint16_t len = (e[0]<<8)+e[1];
+      if (e[2] == MQTT_QUEUED) {
+         if (_client->write(e+MQTT_QUEUE_ENTRY_HEADER,len-MQTT_QUEUE_ENTRY_HEADER) != (size_t)(len-MQTT_QUEUE_ENTRY_HEADER)) {
+            return;
+         }
+         lastOutActivity = millis();
+         e[2] = MQTT_SENT;
+         inflight++;
+      } else if (e[2] == MQTT_RELEASE) {
+         if (!writeAck(MQTTPUBREL|MQTTQOS1,(e[3]<<8)+e[4])) {
+            return;
+         }
+         e[2] = MQTT_RELEASED;
+         inflight++;
+      }
+      queueSend = pos+len;
+      queueSent++;
+   }
+}
+
+// Moves the message with msgId on for a PUBACK, PUBREC or PUBCOMP and drops
+// the acknowledged messages at the head of the queue
+void PubSubClient::acknowledge(uint8_t type, uint16_t msgId) {
+   uint16_t pos = queueHead;
+   for (uint16_t n = 0; n < queueSent; n++) {
+      pos = queueEntry(pos);
+      uint8_t* e = queue+pos;
+      if ((e[3]<<8)+e[4] == msgId) {
+         if ((type == MQTTPUBACK && e[2] == MQTT_SENT) || (type == MQTTPUBCOMP && e[2] == MQTT_RELEASED)) {
+            e[2] = MQTT_DONE;
+            inflight--;
+         } else if (type == MQTTPUBREC && e[2] == MQTT_SENT) {
+            e[2] = writeAck(MQTTPUBREL|MQTTQOS1,msgId) ? MQTT_RELEASED : MQTT_RELEASE;
+         }
+         break;
+      }
+      pos += (e[0]<<8)+e[1];
+   }
+   while (queueCount > 0) {
+      queueHead = queueEntry(queueHead);
+      uint8_t* e = queue+queueHead;
+      if (e[2] != MQTT_DONE) {
+         break;
+      }
+      queueHead += (e[0]<<8)+e[1];
+      queueCount--;
+      queueSent--;
+   }
+   if (queueCount == 0) {
+      queueHead = queueTail = queueSend = 0;
+   }
+}
+
+// After a reconnect everything not acknowledged is sent again, PUBLISH with
+// DUP set and PUBREL for messages the server had already received
+void PubSubClient::requeue() {
+   uint16_t pos = queueHead;
+   for (uint16_t n = 0; n < queueSent; n++) {
+      pos = queueEntry(pos);
+      uint8_t* e = queue+pos;
+      if (e[2] == MQTT_SENT) {
+         e[2] = MQTT_QUEUED;
+         e[MQTT_QUEUE_ENTRY_HEADER] |= 0x08;
+      } else if (e[2] == MQTT_RELEASED) {
+         e[2] = MQTT_RELEASE;
+      }
+      pos += (e[0]<<8)+e[1];
+   }
+   queueSend = queueHead;
+   queueSent = 0;
+   inflight = 0;
+}
+
 boolean PubSubClient::subscribe(char* topic) {
   return subscribe(topic, 0);
 }
@@ -361,9 +885,9 @@ boolean PubSubClient::subscribe(char* topic, uint8_t qos) {
    if (qos < 0 || qos > 1)
      return false;
 
-   if (connected()) {
+   if (connected() && !publishOpen) {
       // Leave room in the buffer for header and variable length field
-      uint16_t length = 5;
+      uint16_t length = MQTT_PACKET_START;
       nextMsgId++;
       if (nextMsgId == 0) {
          nextMsgId = 1;
@@ -372,14 +896,14 @@ boolean PubSubClient::subscribe(char* topic, uint8_t qos) {
       buffer[length++] = (nextMsgId & 0xFF);
       length = writeString(topic, buffer,length);
       buffer[length++] = qos;
-      return write(MQTTSUBSCRIBE|MQTTQOS1,buffer,length-5);
+      return write(MQTTSUBSCRIBE|MQTTQOS1,buffer,length-MQTT_PACKET_START);
    }
    return false;
 }
 
 boolean PubSubClient::unsubscribe(char* topic) {
-   if (connected()) {
-      uint16_t length = 5;
+   if (connected() && !publishOpen) {
+      uint16_t length = MQTT_PACKET_START;
       nextMsgId++;
       if (nextMsgId == 0) {
          nextMsgId = 1;
@@ -387,16 +911,25 @@ boolean PubSubClient::unsubscribe(char* topic) {
       buffer[length++] = (nextMsgId >> 8);
       buffer[length++] = (nextMsgId & 0xFF);
       length = writeString(topic, buffer,length);
-      return write(MQTTUNSUBSCRIBE|MQTTQOS1,buffer,length-5);
+      return write(MQTTUNSUBSCRIBE|MQTTQOS1,buffer,length-MQTT_PACKET_START);
    }
    return false;
 }
 
+// Drops an open streamed PUBLISH, the server then sees the connection end
+// without a DISCONNECT and sends the will
 void PubSubClient::disconnect() {
-   buffer[0] = MQTTDISCONNECT;
-   buffer[1] = 0;
-   _client->write(buffer,2);
+   if (!publishOpen) {
+      buffer[0] = MQTTDISCONNECT;
+      buffer[1] = 0;
+      _client->write(buffer,2);
+   }
+   publishRemaining = 0;
+   publishStaged = 0;
+   publishOk = false;
+   publishOpen = false;
    _client->stop();
+   connackPending = false;
    lastInActivity = lastOutActivity = millis();
 }
 
@@ -414,14 +947,209 @@ uint16_t PubSubClient::writeString(char* string, uint8_t* buf, uint16_t pos) {
 }
 
 
+// Packets built in the buffer by write() are handed to writer instead of
+// Client::write(), with MQTT_TX_HEADROOM bytes in front of them that it may
+// overwrite and MQTT_TX_TAILROOM readable bytes behind them
+void PubSubClient::setWriteInPlace(size_t (*writer)(uint8_t*,uint16_t)) {
+   this->writeInPlace = writer;
+}
+
+// PUBLISH payloads are handed to callback as chunks of at most a buffer
+// full, with their offset and the payload's total length, instead of to the
+// callback given to the constructor. Payloads of any length can be read.
+void PubSubClient::setChunkCallback(void (*callback)(char*,uint32_t,uint8_t*,unsigned int,uint32_t)) {
+   this->chunkCallback = callback;
+}
+
+// QoS 1 and 2 messages are kept in storage, a ring of size bytes, until
+// they are acknowledged. Up to window of them are in flight at once, so a
+// stream of messages is not held to one round trip each. Messages published
+// while disconnected, and those not acknowledged when the connection drops,
+// are sent by the next successful connect(). The first connect after this
+// starts a clean session and later ones keep it, so the server remembers
+// which QoS 2 messages it has and the subscriptions carry over too.
+void PubSubClient::setPublishQueue(uint8_t* storage, uint16_t size, uint8_t window) {
+   this->cleanSession = true;
+   this->queue = storage;
+   this->queueSize = size;
+   this->queueHead = this->queueTail = this->queueSend = 0;
+   this->queueCount = this->queueSent = 0;
+   this->window = window ? window : 1;
+   this->inflight = 0;
+}
+
+// Number of QoS 1 and 2 messages not yet acknowledged
+uint16_t PubSubClient::queued() {
+   return queueCount;
+}
+
+// Counts the time each loop() call takes in bins[count]: bins[0] the calls
+// under a microsecond, bins[i] those from 2^(i-1) up to 2^i microseconds and
+// the last bin everything longer. The counts are left to the caller to read
+// and clear.
+void PubSubClient::setLoopHistogram(uint32_t* bins, uint8_t count) {
+   this->loopBins = (count > 0) ? bins : NULL;
+   this->loopBinCount = count;
+}
+
+// Incoming messages go to the handlers of the topic filters they match,
+// see addHandler(), and to the callback given to the constructor only if
+// there are none. The filters are kept as a trie of their levels in pool,
+// one node per level not shared with an earlier filter, and count must be
+// at least 2 (the first node is the root). Not used with setChunkCallback().
+void PubSubClient::setTopicPool(MQTTTopicNode* pool, uint8_t count) {
+   this->topicPool = pool;
+   this->topicPoolSize = count;
+   this->topicNodes = 1;
+   memset(pool,0,sizeof(MQTTTopicNode));
+}
+
+// Calls handler for messages whose topic matches filter, which may hold
+// + and # wildcards. The filter is not copied and must stay in place.
+// False if the filter is not valid or the pool is full.
+boolean PubSubClient::addHandler(char* filter, void (*handler)(char*,uint8_t*,unsigned int)) {
+   if (topicPool == NULL) {
+      return false;
+   }
+   uint8_t node = 0;
+   char* level = filter;
+   while (true) {
+      char* end = level;
+      while (*end && *end != '/') {
+         end++;
+      }
+      uint16_t length = end-level;
+      // wildcards take a whole level, # only the last one
+      if (length > 255 || (length > 1 && (memchr(level,'+',length) || memchr(level,'#',length))) ||
+          (length == 1 && *level == '#' && *end)) {
+         return false;
+      }
+      uint8_t last = 0;
+      uint8_t n = topicPool[node].child;
+      while (n != 0 && (topicPool[n].length != length || memcmp(topicPool[n].level,level,length) != 0)) {
+         last = n;
+         n = topicPool[n].next;
+      }
+      if (n == 0) {
+         if (topicNodes == topicPoolSize) {
+            return false;
+         }
+         n = topicNodes++;
+         topicPool[n].level = level;
+         topicPool[n].length = length;
+         topicPool[n].child = 0;
+         topicPool[n].next = 0;
+         topicPool[n].handler = NULL;
+         // siblings in the order they were added, so are their handlers
+         if (last) {
+            topicPool[last].next = n;
+         } else {
+            topicPool[node].child = n;
+         }
+      }
+      node = n;
+      if (*end == 0) {
+         break;
+      }
+      level = end+1;
+   }
+   topicPool[node].handler = handler;
+   return true;
+}
+
+// The filter's nodes stay in the pool for it to be added again
+boolean PubSubClient::removeHandler(char* filter) {
+   if (topicPool == NULL) {
+      return false;
+   }
+   uint8_t node = 0;
+   char* level = filter;
+   while (true) {
+      char* end = level;
+      while (*end && *end != '/') {
+         end++;
+      }
+      uint16_t length = end-level;
+      uint8_t n = topicPool[node].child;
+      while (n != 0 && (topicPool[n].length != length || memcmp(topicPool[n].level,level,length) != 0)) {
+         n = topicPool[n].next;
+      }
+      if (n == 0) {
+         return false;
+      }
+      node = n;
+      if (*end == 0) {
+         break;
+      }
+      level = end+1;
+   }
+   topicPool[node].handler = NULL;
+   return true;
+}
+
+// Calls the handlers of the filters below node that match the topic from
+// pos on, tl being the topic length. Returns how many were called.
+uint8_t PubSubClient::dispatch(uint8_t node, char* topic, uint16_t pos, uint16_t tl, uint8_t* payload, unsigned int plength) {
+   uint8_t calls = 0;
+   uint16_t end = pos;
+   while (end < tl && topic[end] != '/') {
+      end++;
+   }
+   for (uint8_t n = topicPool[node].child; n != 0; n = topicPool[n].next) {
+      MQTTTopicNode* f = &topicPool[n];
+      bool wildcard = f->length == 1 && (f->level[0] == '+' || f->level[0] == '#');
+      // topics starting with $ are not matched by a wildcard there
+      if (wildcard && pos == 0 && topic[0] == '$') {
+         continue;
+      }
+      if (wildcard && f->level[0] == '#') {
+         if (f->handler) {
+            f->handler(topic,payload,plength);
+            calls++;
+         }
+      } else if (wildcard || (f->length == end-pos && memcmp(f->level,topic+pos,f->length) == 0)) {
+         if (end < tl) {
+            calls += dispatch(n,topic,end+1,tl,payload,plength);
+            continue;
+         }
+         if (f->handler) {
+            f->handler(topic,payload,plength);
+            calls++;
+         }
+         // a/# matches a as well
+         for (uint8_t c = f->child; c != 0; c = topicPool[c].next) {
+            MQTTTopicNode* h = &topicPool[c];
+            if (h->length == 1 && h->level[0] == '#' && h->handler) {
+               h->handler(topic,payload,plength);
+               calls++;
+            }
+         }
+      }
+   }
+   return calls;
+}
+
+// Makes the topic of the PUBLISH in inBuffer, tl bytes behind its length
+// field at pos, a C string by moving it a byte back over that field. The
+// message id and payload behind it stay where they are.
+char* PubSubClient::topicInPlace(uint16_t pos, uint16_t tl) {
+   char* topic = (char*)inBuffer+pos+1;
+   memmove(topic,topic+1,tl);
+   topic[tl] = 0;
+   return topic;
+}
+
 boolean PubSubClient::connected() {
    boolean rc;
    if (_client == NULL ) {
       rc = false;
    } else {
       rc = (int)_client->connected();
-      if (!rc) _client->stop();
+      if (!rc) {
+         _client->stop();
+         connackPending = false;
+      }
    }
-   return rc;
+   return rc && !connackPending;
 }
 
@@ -14,6 +14,23 @@
 // MQTT_MAX_PACKET_SIZE : Maximum packet size
 #define MQTT_MAX_PACKET_SIZE 128
 
+// MQTT_TX_HEADROOM : Room kept in front of outgoing packets for a client that
+// writes its own headers there, see setWriteInPlace(). Triton_WiFi_Client
+// needs TXHEADROOM
+#define MQTT_TX_HEADROOM 26
+
+// MQTT_TX_TAILROOM : Room kept behind outgoing packets for such a client
+#define MQTT_TX_TAILROOM 1
+
+// MQTT_MAX_WRITE_SIZE : Most payload handed to the client in one write() while
+// streaming a PUBLISH. Triton_WiFi_Client sends a write as one CC3000 packet,
+// which holds a TCP segment
+#define MQTT_MAX_WRITE_SIZE 1460
+
+// Offset of an outgoing packet's variable header in the buffer, leaving room
+// in front of it for the fixed header and MQTT_TX_HEADROOM
+#define MQTT_PACKET_START (MQTT_TX_HEADROOM + 5)
+
 // MQTT_KEEPALIVE : keepAlive interval in Seconds
 #define MQTT_KEEPALIVE 15
 
@@ -38,17 +55,72 @@
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
 
-class PubSubClient {
+// Offset of the PUBLISH packet in a publish queue entry, behind its length,
+// state and message id
+#define MQTT_QUEUE_ENTRY_HEADER 5
+
+// One level of a topic filter in the subscription trie, see setTopicPool()
+typedef struct {
+   const char* level; // its text in the filter given to addHandler()
+   uint8_t length;
+   uint8_t child;     // first node of the next level, 0 for none
+   uint8_t next;      // next node on the same level, 0 for none
+   void (*handler)(char*,uint8_t*,unsigned int); // of a filter ending here
+} MQTTTopicNode;
+
+class PubSubClient : public Print {
 private:
    Client* _client;
-   uint8_t buffer[MQTT_MAX_PACKET_SIZE];
+   uint8_t buffer[MQTT_TX_HEADROOM + MQTT_MAX_PACKET_SIZE + MQTT_TX_TAILROOM];
    uint16_t nextMsgId;
    unsigned long lastOutActivity;
    unsigned long lastInActivity;
    bool pingOutstanding;
    void (*callback)(char*,uint8_t*,unsigned int);
-   uint16_t readPacket(uint8_t*);
-   uint8_t readByte();
+   void (*chunkCallback)(char*,uint32_t,uint8_t*,unsigned int,uint32_t);
+   size_t (*writeInPlace)(uint8_t*,uint16_t);
+   uint32_t publishRemaining;
+   uint16_t publishStaged;
+   boolean publishOk;
+   boolean publishOpen;
+   uint8_t inBuffer[MQTT_MAX_PACKET_SIZE];
+   uint8_t readState;
+   uint8_t readLlen;
+   uint16_t readPos;
+   uint16_t readHlen;
+   uint32_t readLength;
+   uint32_t readOffset;
+   bool connackPending;
+   boolean cleanSession;
+   unsigned long loopStart;
+   unsigned long loopBudget;
+   uint32_t* loopBins;
+   uint8_t loopBinCount;
+   uint32_t readPacket(uint8_t*);
+   boolean readUntil(uint16_t);
+   boolean overBudget();
+   void resetReader();
+   boolean flushPublish();
+   uint8_t* queue;
+   uint16_t queueSize;
+   uint16_t queueHead;
+   uint16_t queueTail;
+   uint16_t queueSend;
+   uint16_t queueCount;
+   uint16_t queueSent;
+   uint8_t window;
+   uint8_t inflight;
+   uint16_t queueEntry(uint16_t);
+   boolean enqueue(char*, uint8_t*, unsigned int, boolean, uint8_t);
+   void acknowledge(uint8_t, uint16_t);
+   void pumpQueue();
+   void requeue();
+   boolean writeAck(uint8_t, uint16_t);
+   MQTTTopicNode* topicPool;
+   uint8_t topicPoolSize;
+   uint8_t topicNodes;
+   uint8_t dispatch(uint8_t, char*, uint16_t, uint16_t, uint8_t*, unsigned int);
+   char* topicInPlace(uint16_t, uint16_t);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
    uint16_t writeString(char* string, uint8_t* buf, uint16_t pos);
    uint8_t *ip;
@@ -65,16 +137,36 @@ public:
    boolean connect(char *, char *, char *);
    boolean connect(char *, char *, uint8_t, uint8_t, char *);
    boolean connect(char *, char *, char *, char *, uint8_t, uint8_t, char*);
+   boolean startConnect(char *);
+   boolean startConnect(char *, char *, char *);
+   boolean startConnect(char *, char *, uint8_t, uint8_t, char *);
+   boolean startConnect(char *, char *, char *, char *, uint8_t, uint8_t, char*);
+   boolean connecting();
    void disconnect();
    boolean publish(char *, char *);
    boolean publish(char *, uint8_t *, unsigned int);
    boolean publish(char *, uint8_t *, unsigned int, boolean);
+   boolean publish(char *, uint8_t *, unsigned int, boolean, uint8_t qos);
    boolean publish_P(char *, uint8_t PROGMEM *, unsigned int, boolean);
+   boolean beginPublish(char *, uint32_t, boolean);
+   virtual size_t write(uint8_t);
+   virtual size_t write(const uint8_t *, size_t);
+   using Print::write;
+   boolean endPublish();
    boolean subscribe(char *);
    boolean subscribe(char *, uint8_t qos);
    boolean unsubscribe(char *);
    boolean loop();
+   boolean loop(unsigned long budget);
    boolean connected();
+   void setWriteInPlace(size_t(*)(uint8_t*,uint16_t));
+   void setChunkCallback(void(*)(char*,uint32_t,uint8_t*,unsigned int,uint32_t));
+   void setPublishQueue(uint8_t *, uint16_t, uint8_t window);
+   uint16_t queued();
+   void setTopicPool(MQTTTopicNode *, uint8_t);
+   boolean addHandler(char *, void(*)(char*,uint8_t*,unsigned int));
+   boolean removeHandler(char *);
+   void setLoopHistogram(uint32_t *, uint8_t);
 };
 
 
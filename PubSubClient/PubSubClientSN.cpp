@@ -0,0 +1,310 @@
+/*
+ PubSubClientSN.cpp - An MQTT-SN client for small messages over UDP.
+*/
+
+#include "PubSubClientSN.h"
+#include <string.h>
+
+// Client states
+#define MQTTSN_DISCONNECTED 0
+#define MQTTSN_ACTIVE       1
+#define MQTTSN_ASLEEP       2
+
+PubSubClientSN::PubSubClientSN(void (*callback)(uint16_t,uint8_t*,unsigned int), Client& client) {
+   this->_client = &client;
+   this->callback = callback;
+   this->state = MQTTSN_DISCONNECTED;
+   this->clientId = NULL;
+   this->nextMsgId = 0;
+   this->keepAlive = MQTTSN_KEEPALIVE;
+   this->pingOutstanding = false;
+}
+
+boolean PubSubClientSN::connect(char *id) {
+   return connect(id,MQTTSN_KEEPALIVE);
+}
+
+// Connects with a clean session. keepAlive, in seconds, is how often loop()
+// pings the gateway when there is no other traffic, 0 for never.
+boolean PubSubClientSN::connect(char *id, uint16_t keepAlive) {
+   out[1] = MQTTSNCONNECT;
+   out[2] = MQTTSNCLEAN;
+   out[3] = 0x01; // protocol id
+   out[4] = (keepAlive >> 8);
+   out[5] = (keepAlive & 0xFF);
+   out[0] = writeString(id,6);
+   if (out[0] == 0) {
+      return false;
+   }
+   this->keepAlive = keepAlive;
+   this->clientId = id;
+
+   if (request(MQTTSNCONNACK,0,0) == 0 || buffer[2] != 0) {
+      state = MQTTSN_DISCONNECTED;
+      return false;
+   }
+   state = MQTTSN_ACTIVE;
+   pingOutstanding = false;
+   lastInActivity = lastOutActivity = millis();
+   return true;
+}
+
+void PubSubClientSN::disconnect() {
+   out[0] = 2;
+   out[1] = MQTTSNDISCONNECT;
+   send();
+   state = MQTTSN_DISCONNECTED;
+}
+
+// Returns the id the gateway gave topic, 0 if it did not
+uint16_t PubSubClientSN::registerTopic(char* topic) {
+   if (state != MQTTSN_ACTIVE) {
+      return 0;
+   }
+   uint16_t id = msgId();
+   out[1] = MQTTSNREGISTER;
+   out[2] = 0;
+   out[3] = 0;
+   out[4] = (id >> 8);
+   out[5] = (id & 0xFF);
+   out[0] = writeString(topic,6);
+   if (out[0] == 0) {
+      return 0;
+   }
+   if (request(MQTTSNREGACK,4,id) == 0 || buffer[6] != 0) {
+      return 0;
+   }
+   return (buffer[2]<<8)+buffer[3];
+}
+
+boolean PubSubClientSN::publish(uint8_t topicType, uint16_t topicId, uint8_t* payload, uint8_t plength) {
+   return publish(topicType,topicId,payload,plength,MQTTSNQOS0,false);
+}
+
+// QoS 0 and 1 need a connection, QoS 1 waits for the PUBACK. QoS -1 is a
+// single datagram that needs no connection, not even while asleep, and so
+// only goes to predefined or short topic ids.
+boolean PubSubClientSN::publish(uint8_t topicType, uint16_t topicId, uint8_t* payload, uint8_t plength, uint8_t qos, boolean retained) {
+   uint16_t id = 0;
+   if (plength > MQTTSN_MAX_PACKET_SIZE-7) {
+      return false;
+   }
+   if (qos == MQTTSNQOSM1) {
+      if (topicType == MQTTSNTOPIC_NORMAL) {
+         return false;
+      }
+   } else if (state != MQTTSN_ACTIVE) {
+      return false;
+   }
+   if (qos == MQTTSNQOS1) {
+      id = msgId();
+   }
+   out[0] = 7+plength;
+   out[1] = MQTTSNPUBLISH;
+   out[2] = qos | topicType | (retained ? MQTTSNRETAIN : 0);
+   out[3] = (topicId >> 8);
+   out[4] = (topicId & 0xFF);
+   out[5] = (id >> 8);
+   out[6] = (id & 0xFF);
+   memcpy(out+7,payload,plength);
+   if (qos != MQTTSNQOS1) {
+      return send();
+   }
+   return request(MQTTSNPUBACK,4,id) != 0 && buffer[6] == 0;
+}
+
+// Returns the id of topic for the callback, 0 if the gateway refused
+uint16_t PubSubClientSN::subscribe(char* topic, uint8_t qos) {
+   if (state != MQTTSN_ACTIVE) {
+      return 0;
+   }
+   uint16_t id = msgId();
+   out[1] = MQTTSNSUBSCRIBE;
+   out[2] = qos | MQTTSNTOPIC_NORMAL;
+   out[3] = (id >> 8);
+   out[4] = (id & 0xFF);
+   out[0] = writeString(topic,5);
+   if (out[0] == 0) {
+      return 0;
+   }
+   if (request(MQTTSNSUBACK,5,id) == 0 || buffer[7] != 0) {
+      return 0;
+   }
+   return (buffer[3]<<8)+buffer[4];
+}
+
+boolean PubSubClientSN::subscribe(uint8_t topicType, uint16_t topicId, uint8_t qos) {
+   if (state != MQTTSN_ACTIVE) {
+      return false;
+   }
+   uint16_t id = msgId();
+   out[0] = 7;
+   out[1] = MQTTSNSUBSCRIBE;
+   out[2] = qos | topicType;
+   out[3] = (id >> 8);
+   out[4] = (id & 0xFF);
+   out[5] = (topicId >> 8);
+   out[6] = (topicId & 0xFF);
+   return request(MQTTSNSUBACK,5,id) != 0 && buffer[7] == 0;
+}
+
+// Tells the gateway the client sleeps for duration seconds. The gateway
+// keeps messages for it until checkIn() collects them, which must be
+// within duration; connect() ends the sleep.
+boolean PubSubClientSN::sleep(uint16_t duration) {
+   if (state == MQTTSN_DISCONNECTED) {
+      return false;
+   }
+   out[0] = 4;
+   out[1] = MQTTSNDISCONNECT;
+   out[2] = (duration >> 8);
+   out[3] = (duration & 0xFF);
+   if (request(MQTTSNDISCONNECT,0,0) == 0) {
+      return false;
+   }
+   state = MQTTSN_ASLEEP;
+   return true;
+}
+
+// Collects, through the callback, what the gateway kept while the client
+// was asleep. True once the gateway has sent it all, the client then
+// sleeps on.
+boolean PubSubClientSN::checkIn() {
+   if (state != MQTTSN_ASLEEP) {
+      return false;
+   }
+   out[1] = MQTTSNPINGREQ;
+   out[0] = writeString(clientId,2);
+   if (out[0] == 0) {
+      return false;
+   }
+   return request(MQTTSNPINGRESP,0,0) != 0;
+}
+
+boolean PubSubClientSN::loop() {
+   if (state == MQTTSN_DISCONNECTED) {
+      return false;
+   }
+   if (state == MQTTSN_ACTIVE && keepAlive) {
+      unsigned long t = millis();
+      if ((t - lastInActivity > keepAlive*1000UL) || (t - lastOutActivity > keepAlive*1000UL)) {
+         if (pingOutstanding) {
+            state = MQTTSN_DISCONNECTED;
+            return false;
+         }
+         uint8_t ping[2] = {2,MQTTSNPINGREQ};
+         _client->write(ping,2);
+         lastOutActivity = t;
+         lastInActivity = t;
+         pingOutstanding = true;
+      }
+   }
+   uint8_t len = readPacket();
+   if (len > 0) {
+      handle(len);
+   }
+   return state != MQTTSN_DISCONNECTED;
+}
+
+boolean PubSubClientSN::connected() {
+   return state == MQTTSN_ACTIVE;
+}
+
+uint16_t PubSubClientSN::msgId() {
+   nextMsgId++;
+   if (nextMsgId == 0) {
+      nextMsgId = 1;
+   }
+   return nextMsgId;
+}
+
+boolean PubSubClientSN::send() {
+   lastOutActivity = millis();
+   return _client->write(out,out[0]) == out[0];
+}
+
+// One datagram into the buffer, 0 if there is none or it is malformed
+uint8_t PubSubClientSN::readPacket() {
+   if (!_client->available()) {
+      return 0;
+   }
+   int len = _client->read(buffer,sizeof(buffer));
+   if (len < 2 || buffer[0] != len) {
+      return 0;
+   }
+   lastInActivity = millis();
+   return len;
+}
+
+// Packets not asked for. Acknowledgments are not built in out, which may
+// hold a request still waiting for its reply.
+void PubSubClientSN::handle(uint8_t len) {
+   uint8_t type = buffer[1];
+   if (type == MQTTSNPUBLISH && len >= 7) {
+      if (callback) {
+         callback((buffer[3]<<8)+buffer[4],buffer+7,len-7);
+      }
+      if ((buffer[2]&MQTTSNQOSM1) == MQTTSNQOS1) {
+         uint8_t ack[7] = {7,MQTTSNPUBACK,buffer[3],buffer[4],buffer[5],buffer[6],0};
+         _client->write(ack,7);
+      }
+   } else if (type == MQTTSNREGISTER && len >= 6) {
+      // the gateway names a topic it will publish to, e.g. for a wildcard
+      uint8_t ack[7] = {7,MQTTSNREGACK,buffer[2],buffer[3],buffer[4],buffer[5],0};
+      _client->write(ack,7);
+   } else if (type == MQTTSNPINGREQ) {
+      uint8_t resp[2] = {2,MQTTSNPINGRESP};
+      _client->write(resp,2);
+   } else if (type == MQTTSNPINGRESP) {
+      pingOutstanding = false;
+   } else if (type == MQTTSNDISCONNECT) {
+      state = MQTTSN_DISCONNECTED;
+   }
+}
+
+// Waits for a packet of type, and with msgId at idPos unless that is 0,
+// handling anything else that comes in meanwhile. Returns its length, 0 on
+// timeout.
+uint8_t PubSubClientSN::waitFor(uint8_t type, uint8_t idPos, uint16_t msgId) {
+   unsigned long start = millis();
+   while (millis() - start < MQTTSN_RETRY_TIME) {
+      uint8_t len = readPacket();
+      if (len == 0) {
+         continue;
+      }
+      if (buffer[1] == type && (idPos == 0 || (len >= idPos+2 && (buffer[idPos]<<8)+buffer[idPos+1] == msgId))) {
+         return len;
+      }
+      handle(len);
+   }
+   return 0;
+}
+
+// Sends the packet in out until the reply comes, see waitFor()
+uint8_t PubSubClientSN::request(uint8_t type, uint8_t idPos, uint16_t msgId) {
+   for (uint8_t i = 0; i < MQTTSN_RETRIES; i++) {
+      if (!send()) {
+         return 0;
+      }
+      uint8_t len = waitFor(type,idPos,msgId);
+      if (len > 0) {
+         return len;
+      }
+      if (out[1] == MQTTSNPUBLISH) {
+         out[2] |= MQTTSNDUP;
+      }
+   }
+   return 0;
+}
+
+// MQTT-SN strings run to the end of the packet, they have no length.
+// Returns the packet length, 0 if the string does not fit.
+uint8_t PubSubClientSN::writeString(char* string, uint8_t pos) {
+   while (*string) {
+      if (pos >= MQTTSN_MAX_PACKET_SIZE) {
+         return 0;
+      }
+      out[pos++] = *string++;
+   }
+   return pos;
+}
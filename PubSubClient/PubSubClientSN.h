@@ -0,0 +1,93 @@
+/*
+ PubSubClientSN.h - An MQTT-SN client for small messages over UDP.
+
+ Talks MQTT-SN 1.2 to a gateway through a Client whose connection is a
+ UDP socket, e.g. wifi.connectUDP(). Topics are 2 byte ids: registered
+ with registerTopic(), predefined in the gateway or short (2 character)
+ names, so no topic string goes with a PUBLISH.
+*/
+
+#ifndef PubSubClientSN_h
+#define PubSubClientSN_h
+
+#include <Arduino.h>
+#include "Client.h"
+
+// MQTTSN_MAX_PACKET_SIZE : Maximum datagram size. Longer incoming ones are
+// cut, requests whose topic or client id does not fit fail
+#define MQTTSN_MAX_PACKET_SIZE 64
+
+// MQTTSN_KEEPALIVE : Default keepAlive interval in Seconds
+#define MQTTSN_KEEPALIVE 15
+
+// MQTTSN_RETRY_TIME : How long to wait for a reply before sending again, in
+// milliseconds, and MQTTSN_RETRIES : how often
+#define MQTTSN_RETRY_TIME 1000
+#define MQTTSN_RETRIES    3
+
+#define MQTTSNCONNECT     0x04 // Client request to connect to Gateway
+#define MQTTSNCONNACK     0x05 // Connect Acknowledgment
+#define MQTTSNREGISTER    0x0A // Register a topic name for a topic id
+#define MQTTSNREGACK      0x0B // Register Acknowledgment
+#define MQTTSNPUBLISH     0x0C // Publish message
+#define MQTTSNPUBACK      0x0D // Publish Acknowledgment
+#define MQTTSNSUBSCRIBE   0x12 // Client Subscribe request
+#define MQTTSNSUBACK      0x13 // Subscribe Acknowledgment
+#define MQTTSNPINGREQ     0x16 // PING Request
+#define MQTTSNPINGRESP    0x17 // PING Response
+#define MQTTSNDISCONNECT  0x18 // Client is Disconnecting or going to sleep
+
+#define MQTTSNDUP         0x80
+#define MQTTSNRETAIN      0x10
+#define MQTTSNCLEAN       0x04
+
+#define MQTTSNQOS0        (0 << 5)
+#define MQTTSNQOS1        (1 << 5)
+#define MQTTSNQOSM1       (3 << 5) // QoS -1: no connection, no acknowledgment
+
+// Topic id types
+#define MQTTSNTOPIC_NORMAL     0x00 // registered with registerTopic()
+#define MQTTSNTOPIC_PREDEFINED 0x01 // agreed with the gateway beforehand
+#define MQTTSNTOPIC_SHORT      0x02 // a 2 character topic name
+
+// Topic id of a short topic name
+#define MQTTSN_SHORT_TOPIC(a,b) ((uint16_t)(((uint8_t)(a) << 8) | (uint8_t)(b)))
+
+class PubSubClientSN {
+private:
+   Client* _client;
+   uint8_t buffer[MQTTSN_MAX_PACKET_SIZE];
+   uint8_t out[MQTTSN_MAX_PACKET_SIZE];
+   uint16_t nextMsgId;
+   uint16_t keepAlive;
+   unsigned long lastOutActivity;
+   unsigned long lastInActivity;
+   bool pingOutstanding;
+   uint8_t state;
+   char* clientId;
+   void (*callback)(uint16_t,uint8_t*,unsigned int);
+   uint16_t msgId();
+   boolean send();
+   uint8_t readPacket();
+   void handle(uint8_t);
+   uint8_t waitFor(uint8_t, uint8_t, uint16_t);
+   uint8_t request(uint8_t, uint8_t, uint16_t);
+   uint8_t writeString(char*, uint8_t);
+public:
+   PubSubClientSN(void(*)(uint16_t,uint8_t*,unsigned int),Client& client);
+   boolean connect(char *);
+   boolean connect(char *, uint16_t);
+   void disconnect();
+   uint16_t registerTopic(char *);
+   boolean publish(uint8_t, uint16_t, uint8_t *, uint8_t);
+   boolean publish(uint8_t, uint16_t, uint8_t *, uint8_t, uint8_t qos, boolean);
+   uint16_t subscribe(char *, uint8_t qos);
+   boolean subscribe(uint8_t, uint16_t, uint8_t qos);
+   boolean sleep(uint16_t);
+   boolean checkIn();
+   boolean loop();
+   boolean connected();
+};
+
+
+#endif
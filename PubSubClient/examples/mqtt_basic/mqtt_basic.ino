@@ -60,6 +60,12 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // handle message arrived
 }
 
+// Sends MQTT packets straight from the client's buffer, without copying them
+// into the CC3000 transmit buffer
+size_t writeInPlace(uint8_t* buf, uint16_t len) {
+  return wifiClient.writeInPlace(buf, len);
+}
+
 
 
 
@@ -113,6 +119,7 @@ void setup()
   }
 wifi.printIPdotsRev(ip);
 
+client.setWriteInPlace(writeInPlace);
 if (client.connect("arduinoClient")) {
     client.publish("outTopic","Hi, I'm Triton!");
     client.subscribe("inTopic");
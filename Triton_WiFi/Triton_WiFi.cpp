@@ -27,6 +27,10 @@
 #include "utility/debug.h"
 #include "utility/sntp.h"
 
+#if (TXHEADROOM != SOCKET_SEND_HEADROOM) || (TXTAILROOM != SOCKET_SEND_TAILROOM)
+#error "TXHEADROOM/TXTAILROOM must match SOCKET_SEND_HEADROOM/SOCKET_SEND_TAILROOM"
+#endif
+
 uint8_t g_csPin, g_irqPin, g_vbatPin, g_IRQnum, g_SPIspeed;
 
 static const uint8_t dreqinttable[] = {
@@ -84,6 +88,9 @@ static const uint8_t dreqinttable[] = {
   60, 60, 61, 61, 62, 62, 63, 63, 64, 64, 
   65, 65, 66, 66, 67, 67, 68, 68, 69, 69,
   70, 70, 71, 71, 93, 93
+#elif defined(CC3K_EMULATOR) // host build, see host/Arduino.h
+  2, 0,
+  3, 1,
 #endif/* Oliver add 93 */
 };
 
@@ -156,7 +163,7 @@ Print* CC3KPrinter; // user specified output stream for general messages and deb
 #ifndef CC3000_TINY_DRIVER
 bool Triton_WiFi::scanSSIDs(uint32_t time)
 {
-  const unsigned long intervalTime[16] = { 2000, 2000, 2000, 2000,  2000,
+  const UINT32 intervalTime[16] = { 2000, 2000, 2000, 2000,  2000,
     2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000 };
 
   if (!_initialised)
@@ -175,7 +182,7 @@ bool Triton_WiFi::scanSSIDs(uint32_t time)
   // Set  SSID Scan params to includes channels above 11 
   CHECK_SUCCESS(
       wlan_ioctl_set_scan_params(time, 20, 100, 5, 0x1FFF, -120, 0, 300,
-          (unsigned long * ) &intervalTime),
+          (UINT32 * ) &intervalTime),
           "Failed setting params for SSID scan", false);
 
   return true;
@@ -964,7 +971,7 @@ bool Triton_WiFi::connectOpen(const char *ssid)
 //!         device and operates a led for indicate
 //
 //*****************************************************************************
-void CC3000_UsynchCallback(long lEventType, char * data, unsigned char length)
+void CC3000_UsynchCallback(INT32 lEventType, char * data, unsigned char length)
 {
   if (lEventType == HCI_EVNT_WLAN_ASYNC_SIMPLE_CONFIG_DONE)
   {
@@ -1351,17 +1358,19 @@ Triton_WiFi_Client Triton_WiFi::connectUDP(uint32_t destIP, uint16_t destPort)
     return Triton_WiFi_Client();
   }
 
-  return Triton_WiFi_Client(udp_socket);
+  return Triton_WiFi_Client(udp_socket, true);
 }
 
 
 /**********************************************************************/
 Triton_WiFi_Client::Triton_WiFi_Client(void) {
   _socket = -1;
+  _datagram = false;
 }
 
-Triton_WiFi_Client::Triton_WiFi_Client(uint16_t s) {
+Triton_WiFi_Client::Triton_WiFi_Client(uint16_t s, bool datagram) {
   _socket = s; 
+  _datagram = datagram;
   bufsiz = 0;
   _rx_buf_idx = 0;
 }
@@ -1369,6 +1378,7 @@ Triton_WiFi_Client::Triton_WiFi_Client(uint16_t s) {
 Triton_WiFi_Client::Triton_WiFi_Client(const Triton_WiFi_Client& copy) {
   // Copy all the members to construct this client.
   _socket = copy._socket;
+  _datagram = copy._datagram;
   bufsiz = copy.bufsiz;
   _rx_buf_idx = copy._rx_buf_idx;
   memcpy(_rx_buf, copy._rx_buf, RXBUFFERSIZE);
@@ -1377,6 +1387,7 @@ Triton_WiFi_Client::Triton_WiFi_Client(const Triton_WiFi_Client& copy) {
 void Triton_WiFi_Client::operator=(const Triton_WiFi_Client& other) {
   // Copy all the members to assign a new value to this client.
   _socket = other._socket;
+  _datagram = other._datagram;
   bufsiz = other.bufsiz;
   _rx_buf_idx = other._rx_buf_idx;
   memcpy(_rx_buf, other._rx_buf, RXBUFFERSIZE);
@@ -1452,13 +1463,17 @@ int Triton_WiFi_Client::connect(IPAddress destIP, uint16_t destPort)
   // if (CC3KPrinter != 0) CC3KPrinter->println(F("DONE"));
 
   _socket = tcp_socket;
+  _datagram = false;
   return 1;
 }
 
 uint8_t Triton_WiFi_Client::connected(void) { 
   if (_socket < 0) return false;
 
-  if (! available() && closed_sockets[_socket] == true) {
+  int16_t avail = available();
+  if (_socket < 0) return false; // the read-ahead found the socket inactive
+
+  if (! avail && closed_sockets[_socket] == true) {
     //if (CC3KPrinter != 0) CC3KPrinter->println("No more data, and closed!");
     closesocket(_socket);
     closed_sockets[_socket] = false;
@@ -1471,7 +1486,35 @@ uint8_t Triton_WiFi_Client::connected(void) {
 
 size_t Triton_WiFi_Client::write(const void *buf, uint16_t len, uint32_t flags)
 {
-  return send(_socket, buf, len, flags);
+  int16_t r = send(_socket, buf, len, flags);
+  // A negative result may be the failure of an earlier pipelined write
+  if ( r < 0 ) {
+    setWriteError(r);
+    return 0;
+  }
+  return r;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes len bytes at buf without copying them into the CC3000
+            transmit buffer. The TXHEADROOM bytes in front of buf are
+            overwritten with the packet headers and the TXTAILROOM bytes
+            behind it must be readable, so buf is normally carved out of a
+            larger buffer, e.g. uint8_t b[TXHEADROOM + N + TXTAILROOM] and
+            writeInPlace(b + TXHEADROOM, N).
+
+    @returns  The number of bytes written, 0 on error (see getWriteError)
+*/
+/**************************************************************************/
+size_t Triton_WiFi_Client::writeInPlace(uint8_t *buf, uint16_t len)
+{
+  int16_t r = send_in_place(_socket, buf, len, 0);
+  if ( r < 0 ) {
+    setWriteError(r);
+    return 0;
+  }
+  return r;
 }
 
 size_t Triton_WiFi_Client::write(const uint8_t *buf, size_t len)
@@ -1481,10 +1524,7 @@ size_t Triton_WiFi_Client::write(const uint8_t *buf, size_t len)
 
 size_t Triton_WiFi_Client::write(uint8_t c)
 {
-  int32_t r;
-  r = send(_socket, &c, 1, 0);
-  if ( r < 0 ) return 0;
-  return r;
+  return write(&c, 1, 0);
 }
 
 size_t Triton_WiFi_Client::fastrprint(const __FlashStringHelper *ifsh)
@@ -1561,10 +1601,33 @@ size_t Triton_WiFi_Client::fastrprintln(char *str) {
   return r;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Reads up to len bytes.  Read-ahead data is handed over first,
+            without HCI traffic.  Otherwise a read shorter than the buffer
+            fills the buffer, so the bytes after it are read ahead, and a
+            longer one (or one with flags, or any read of a datagram
+            socket) receives straight into buf.
+            Returns the number of bytes read or the recv() error.
+*/
+/**************************************************************************/
 int Triton_WiFi_Client::read(void *buf, uint16_t len, uint32_t flags) 
 {
-  return recv(_socket, buf, len, flags);
+  int16_t n = rxBuffered();
+
+  if ((n == 0) && (len < RXBUFFERSIZE) && (flags == 0) && !_datagram) {
+    int16_t r = fillRxBuffer();
+    if (r <= 0) return r;
+    n = r;
+  }
+  if (n == 0) {
+    return recv(_socket, buf, len, flags);
+  }
 
+  if (n > len) n = len;
+  memcpy(buf, _rx_buf + _rx_buf_idx, n);
+  _rx_buf_idx += n;
+  return n;
 }
 
 int Triton_WiFi_Client::read(uint8_t *buf, size_t len) 
@@ -1584,16 +1647,12 @@ void Triton_WiFi_Client::stop(){
 
 int Triton_WiFi_Client::read(void) 
 {
-  while ((bufsiz <= 0) || (bufsiz == _rx_buf_idx)) {
+  while (rxBuffered() == 0) {
     cc3k_int_poll();
     // buffer in some more data
-    bufsiz = recv(_socket, _rx_buf, sizeof(_rx_buf), 0);
-    if (bufsiz == -57) {
-      close();
+    if (fillRxBuffer() == -57) {
       return 0;
     }
-    //if (CC3KPrinter != 0) { CC3KPrinter->println("Read "); CC3KPrinter->print(bufsiz); CC3KPrinter->println(" bytes"); }
-    _rx_buf_idx = 0;
   }
   uint8_t ret = _rx_buf[_rx_buf_idx];
   _rx_buf_idx++;
@@ -1601,46 +1660,89 @@ int Triton_WiFi_Client::read(void)
   return ret;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Returns the number of bytes that can be read without waiting.
+            Only when the read-ahead buffer is empty does this ask the
+            CC3000, and if it has data the buffer is filled right away, so
+            the read() and peek() calls that follow need no HCI traffic.
+            A datagram socket is not read ahead, as that would cut its
+            datagrams at the buffer size; read() takes them whole.
+*/
+/**************************************************************************/
 int Triton_WiFi_Client::available(void) {
+  if (_datagram) {
+    return waitAvailable(0);
+  }
+  if ((rxBuffered() == 0) && waitAvailable(0)) {
+    fillRxBuffer();
+  }
+  return rxBuffered();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Block until data can be read, the peer closes the socket or
+            timeoutMs expires.  The CC3000 completes the select() command
+            as soon as the socket becomes ready, so this is a single HCI
+            transaction that sleeps on the device IRQ instead of polling.
+            Returns 0 on timeout or close; check connected() to tell them
+            apart.  The device enforces a 5 ms minimum timeout.
+*/
+/**************************************************************************/
+int Triton_WiFi_Client::waitAvailable(uint32_t timeoutMs) {
   // not open!
   if (_socket < 0) return 0;
 
-  if ((bufsiz > 0) // we have some data in the internal buffer
-      && (_rx_buf_idx < bufsiz)) {  // we havent already spit it all out
-    return (bufsiz - _rx_buf_idx);
-  }
+  int16_t n = rxBuffered();
+  if (n > 0) return n;
 
   // do a select() call on this socket
   timeval timeout;
   fd_set fd_read;
+  fd_set fd_except;
 
   memset(&fd_read, 0, sizeof(fd_read));
+  memset(&fd_except, 0, sizeof(fd_except));
   FD_SET(_socket, &fd_read);
+  FD_SET(_socket, &fd_except); // a remote close also ends the wait
 
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 5000; // 5 millisec
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_usec = (timeoutMs % 1000) * 1000;
 
-  int16_t s = select(_socket+1, &fd_read, NULL, NULL, &timeout);
+  int16_t s = select(_socket+1, &fd_read, NULL, &fd_except, &timeout);
   //if (CC3KPrinter != 0) } CC3KPrinter->print(F("Select: ")); CC3KPrinter->println(s); }
-  if (s == 1) return 1;  // some data is available to read
-  else return 0;  // no data is available
+  if ((s > 0) && FD_ISSET(_socket, &fd_read)) return 1;  // some data is available to read
+  else return 0;  // no data is available, or the socket was closed
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the maximum segment size of the TCP connection, the
+            most the CC3000 puts in one packet, or 0 if the socket is not
+            open.  This is one HCI transaction.
+*/
+/**************************************************************************/
+uint16_t Triton_WiFi_Client::mss(void) {
+  if (_socket < 0) return 0;
+  return getmssvalue(_socket);
 }
 
 void Triton_WiFi_Client::flush(){
-  // No flush implementation, unclear if necessary.
+  // Wait for pipelined writes, this returns at once if writes are not pipelined
+  int16_t r = send_flush(_socket);
+  if ( r != 0 ) {
+    setWriteError(r);
+  }
 }
 
 int Triton_WiFi_Client::peek(){
-  while ((bufsiz <= 0) || (bufsiz == _rx_buf_idx)) {
+  while (rxBuffered() == 0) {
     cc3k_int_poll();
     // buffer in some more data
-    bufsiz = recv(_socket, _rx_buf, sizeof(_rx_buf), 0);
-    if (bufsiz == -57) {
-      close();
+    if (fillRxBuffer() == -57) {
       return 0;
     }
-    //if (CC3KPrinter != 0) { CC3KPrinter->println("Read "); CC3KPrinter->print(bufsiz); CC3KPrinter->println(" bytes"); }
-    _rx_buf_idx = 0;
   }
   uint8_t ret = _rx_buf[_rx_buf_idx];
 
@@ -1648,10 +1750,46 @@ int Triton_WiFi_Client::peek(){
   return ret;
 }
 
+int16_t Triton_WiFi_Client::rxBuffered(void) {
+  return (bufsiz > (int16_t)_rx_buf_idx) ? (bufsiz - _rx_buf_idx) : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads ahead with one recv() into the empty internal buffer.
+            Closes the client when the CC3000 reports the socket inactive.
+            Returns what recv() returned.
+*/
+/**************************************************************************/
+int16_t Triton_WiFi_Client::fillRxBuffer(void) {
+  bufsiz = recv(_socket, _rx_buf, sizeof(_rx_buf), 0);
+  _rx_buf_idx = 0;
+  //if (CC3KPrinter != 0) { CC3KPrinter->println("Read "); CC3KPrinter->print(bufsiz); CC3KPrinter->println(" bytes"); }
+  if (bufsiz == -57) {
+    close();
+  }
+  return bufsiz;
+}
+
 void Triton_WiFi::setPrinter(Print* p) {
   CC3KPrinter = p;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Pipelines writes to all sockets. A write returns once the data
+            is in the CC3000 rather than when the CC3000 has sent it, so
+            back to back writes are only limited by the CC3000's free
+            buffers. A failed write is reported by the next write or by
+            flush(), which waits for all pipelined writes to complete.
+
+    @param  enable  true to pipeline writes, false to wait for each one
+*/
+/**************************************************************************/
+void Triton_WiFi::setSendPipelined(bool enable) {
+  set_send_pipelined(enable ? 1 : 0);
+}
+
 
 Triton_WiFi wifi(CC3K_CS, CC3K_IRQ, CC3K_VBAT,
                                          SPI_CLOCK_DIVIDER); // you can change this clock speed
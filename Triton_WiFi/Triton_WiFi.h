@@ -58,8 +58,16 @@
 #endif
 
 #define WLAN_CONNECT_TIMEOUT 10000  // how long to wait, in milliseconds
-#define RXBUFFERSIZE  64 // how much to buffer on the incoming side
+#ifndef RXBUFFERSIZE
+// How much to read ahead on the incoming side.  It changes the size of
+// Triton_WiFi_Client, so set it here or with a compiler -D for the whole
+// build, not in a sketch.  More than a TCP segment (1460) gains nothing.
+#define RXBUFFERSIZE  64
+#endif
 #define TXBUFFERSIZE  32 // how much to buffer on the outgoing side
+#define TXHEADROOM    26 // room writeInPlace() needs in front of the data
+#define TXTAILROOM    1  // and behind it
+#define TXSEGMENTSIZE 1460 // the most data to give one send(), a TCP segment
 
 #define WIFI_ENABLE 1
 #define WIFI_DISABLE 0
@@ -89,7 +97,7 @@ class Triton_WiFi;
 
 class Triton_WiFi_Client : public Client {
  public:
-  Triton_WiFi_Client(uint16_t s);
+  Triton_WiFi_Client(uint16_t s, bool datagram = false);
   Triton_WiFi_Client(void);
   Triton_WiFi_Client(const Triton_WiFi_Client& copy);
   void operator=(const Triton_WiFi_Client& other);
@@ -111,10 +119,13 @@ class Triton_WiFi_Client : public Client {
   size_t fastrprintln(const __FlashStringHelper *ifsh);
 
   size_t write(const void *buf, uint16_t len, uint32_t flags = 0);
+  size_t writeInPlace(uint8_t *buf, uint16_t len);
   int read(void *buf, uint16_t len, uint32_t flags = 0);
   int read(void);
   int32_t close(void);
   int available(void);
+  int waitAvailable(uint32_t timeoutMs);
+  uint16_t mss(void);
 
   int read(uint8_t *buf, size_t size);
   size_t write(const uint8_t *buf, size_t size);
@@ -123,11 +134,16 @@ class Triton_WiFi_Client : public Client {
   void stop();
   operator bool();
 
-  uint8_t _rx_buf[RXBUFFERSIZE], _rx_buf_idx;
+  uint8_t _rx_buf[RXBUFFERSIZE];
+  uint16_t _rx_buf_idx;
   int16_t bufsiz;
 
  private:
   int16_t _socket;
+  bool _datagram;
+
+  int16_t rxBuffered(void);
+  int16_t fillRxBuffer(void);
 
 };
 
@@ -136,6 +152,7 @@ class Triton_WiFi_Client : public Client {
 // instances of the client.  The client definition above can be pulled into a separate
 // header in a later change to make this cleaner.
 #include "Triton_WiFi_Server.h"
+#include "Triton_WiFi_BufferedClient.h"
 
 class Triton_WiFi {
   public:
@@ -190,6 +207,7 @@ class Triton_WiFi {
     #endif
 
     void setPrinter(Print*);
+    void setSendPipelined(bool enable);
 
   private:
     bool _initialised;
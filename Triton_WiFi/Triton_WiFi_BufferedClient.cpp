@@ -0,0 +1,186 @@
+/**************************************************************************/
+/*!
+  @file     Triton_WiFi_BufferedClient.cpp
+
+  This is a library for the Triton IoT rapid prototype platform
+
+  Check out the links below for our tutorials
+  These chips use SPI to communicate.
+   ----> https://www.neptcloud.com
+
+*/
+/**************************************************************************/
+#include "Triton_WiFi_BufferedClient.h"
+
+/**************************************************************************/
+/*!
+    @brief  Sets up a buffered client
+
+    @param  client  the client to write to, which must outlive this one
+    @param  buf     room for TXHEADROOM + data + TXTAILROOM bytes; a
+                    segment (TXSEGMENTSIZE bytes) of data is the most that
+                    is used
+    @param  size    the size of buf; if that leaves no room for data the
+                    writes go straight to the client
+*/
+/**************************************************************************/
+Triton_WiFi_BufferedClient::Triton_WiFi_BufferedClient(Triton_WiFi_Client* client, uint8_t *buf, uint16_t size)
+  : _client(client), _buf(buf),
+    _size((size > TXHEADROOM + TXTAILROOM) ? size : 0), _segment(0), _len(0), _since(0),
+    _delay(TXFLUSHDELAY), _sends(0), _bytes(0)
+{ }
+
+int Triton_WiFi_BufferedClient::connect(IPAddress ip, uint16_t port) {
+  _len = 0;
+  _segment = 0;
+  return _client->connect(ip, port);
+}
+
+int Triton_WiFi_BufferedClient::connect(const char *host, uint16_t port) {
+  _len = 0;
+  _segment = 0;
+  return _client->connect(host, port);
+}
+
+uint8_t Triton_WiFi_BufferedClient::connected(void) {
+  sendIfDue();
+  return _client->connected();
+}
+
+Triton_WiFi_BufferedClient::operator bool() {
+  return connected();
+}
+
+size_t Triton_WiFi_BufferedClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds size bytes to the buffer, sending it whenever it holds a
+            segment.  The segment size is asked of the CC3000 on the first
+            write after a connect, and again on later writes for as long
+            as it does not know it.
+
+    @returns  size, or 0 if a send failed (see getWriteError)
+*/
+/**************************************************************************/
+size_t Triton_WiFi_BufferedClient::write(const uint8_t *buf, size_t size) {
+  size_t n = 0;
+  uint16_t segment = _segment;
+
+  if (_size == 0) return _client->write(buf, size);
+  sendIfDue();
+  if (segment == 0) {
+    uint16_t mss = _client->mss();
+    segment = _size - TXHEADROOM - TXTAILROOM;
+    if (segment > TXSEGMENTSIZE) segment = TXSEGMENTSIZE;
+    if ((mss > 0) && (mss < segment)) segment = mss;
+    // Not connected yet, or a UDP socket: ask again next time
+    if (mss > 0) _segment = segment;
+    if ((_len >= segment) && !send()) return 0;
+  }
+  while (n < size) {
+    uint16_t k = segment - _len;
+    if (k > size - n) k = size - n;
+    if (_len == 0) _since = millis();
+    memcpy(_buf + TXHEADROOM + _len, buf + n, k);
+    _len += k;
+    n += k;
+    if ((_len == segment) && !send()) return 0;
+  }
+  return n;
+}
+
+size_t Triton_WiFi_BufferedClient::fastrprint(const char *str) {
+  return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Triton_WiFi_BufferedClient::fastrprint(const __FlashStringHelper *ifsh) {
+  const char PROGMEM *p = (const char PROGMEM *)ifsh;
+  size_t n = 0;
+  while (1) {
+    unsigned char c = pgm_read_byte(p++);
+    if (c == 0) break;
+    if (write(c) == 0) break;
+    n++;
+  }
+  return n;
+}
+
+int Triton_WiFi_BufferedClient::available(void) {
+  sendIfDue();
+  return _client->available();
+}
+
+// A read may wait for the reply to what is still in the buffer, so that is
+// sent first
+int Triton_WiFi_BufferedClient::read(void) {
+  send();
+  return _client->read();
+}
+
+int Triton_WiFi_BufferedClient::read(uint8_t *buf, size_t size) {
+  send();
+  return _client->read(buf, size);
+}
+
+int Triton_WiFi_BufferedClient::peek() {
+  send();
+  return _client->peek();
+}
+
+void Triton_WiFi_BufferedClient::flush() {
+  send();
+  _client->flush();
+}
+
+void Triton_WiFi_BufferedClient::stop() {
+  send();
+  _client->stop();
+  _segment = 0;
+}
+
+void Triton_WiFi_BufferedClient::setFlushDelay(uint16_t ms) {
+  _delay = ms;
+}
+
+uint32_t Triton_WiFi_BufferedClient::sends(void) {
+  return _sends;
+}
+
+uint32_t Triton_WiFi_BufferedClient::sentBytes(void) {
+  return _bytes;
+}
+
+void Triton_WiFi_BufferedClient::resetCounters(void) {
+  _sends = 0;
+  _bytes = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sends the buffer in place with one send() to the CC3000.
+            The buffer is emptied even if that fails.
+*/
+/**************************************************************************/
+bool Triton_WiFi_BufferedClient::send(void) {
+  uint16_t len = _len;
+
+  if (len == 0) return true;
+  _len = 0;
+  size_t r = _client->writeInPlace(_buf + TXHEADROOM, len);
+  _sends++;
+  _bytes += r;
+  if (r != len) {
+    setWriteError(_client->getWriteError());
+    return false;
+  }
+  return true;
+}
+
+void Triton_WiFi_BufferedClient::sendIfDue(void) {
+  if ((_len > 0) && (_delay > 0) && (millis() - _since >= _delay)) {
+    send();
+  }
+}
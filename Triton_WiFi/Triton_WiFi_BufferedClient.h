@@ -0,0 +1,88 @@
+/**************************************************************************/
+/*!
+  @file     Triton_WiFi_BufferedClient.h
+
+  This is a library for the Triton IoT rapid prototype platform
+
+   Check out the links below for our tutorials
+   These chips use SPI to communicate.
+	----> https://www.neptcloud.com
+
+  Every write to a Triton_WiFi_Client is a send() to the CC3000, a whole
+  HCI transaction, even for a single byte.  The buffered client collects
+  writes and sends them as one packet when a TCP segment is full, when
+  flush() is called, or once the oldest byte has waited the flush delay.
+
+*/
+/**************************************************************************/
+
+#ifndef TRITON_WIFI_BUFFEREDCLIENT_H
+#define TRITON_WIFI_BUFFEREDCLIENT_H
+
+#include "Triton_WiFi.h"
+
+#include "Client.h"
+
+#ifndef TXFLUSHDELAY
+// How long written bytes may wait for more, in milliseconds
+#define TXFLUSHDELAY  5
+#endif
+
+// Wraps a client and coalesces the writes to it.  The buffer is the
+// caller's, with TXHEADROOM bytes in front of the data and TXTAILROOM
+// behind it so it can be sent in place; bytes beyond a segment (see
+// Triton_WiFi_Client::mss(), at most TXSEGMENTSIZE) are not used.  Reads go to the client, after
+// what is buffered has been sent.
+class Triton_WiFi_BufferedClient : public Client {
+ public:
+  Triton_WiFi_BufferedClient(Triton_WiFi_Client* client, uint8_t *buf, uint16_t size);
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char *host, uint16_t port);
+
+  uint8_t connected(void);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buf, size_t size);
+  using Print::write;
+
+  size_t fastrprint(const char *str);
+  size_t fastrprint(const __FlashStringHelper *ifsh);
+
+  int available(void);
+  int read(void);
+  int read(uint8_t *buf, size_t size);
+  int peek();
+  // Send what is buffered and wait for pipelined writes.
+  void flush();
+  void stop();
+  operator bool();
+
+  // Set how long written bytes may wait for more, 0 to send them only when
+  // a segment is full or on flush().
+  void setFlushDelay(uint16_t ms);
+
+  // The sends to the CC3000 and the bytes they carried since the last
+  // resetCounters().
+  uint32_t sends(void);
+  uint32_t sentBytes(void);
+  void resetCounters(void);
+
+ private:
+  // Not owned, like Triton_WiFi_ClientRef's client.
+  Triton_WiFi_Client* _client;
+  uint8_t *_buf;
+  uint16_t _size;
+  // Bytes sent together, the smaller of the buffer and the segment size,
+  // 0 until the segment size is known.
+  uint16_t _segment;
+  uint16_t _len;
+  unsigned long _since;
+  uint16_t _delay;
+  uint32_t _sends;
+  uint32_t _bytes;
+
+  bool send(void);
+  void sendIfDue(void);
+};
+
+#endif
@@ -96,6 +96,11 @@ size_t Triton_WiFi_ClientRef::write(const void *buf, uint16_t len, uint32_t flag
   return _client->write(buf, len, flags);
 }
 
+size_t Triton_WiFi_ClientRef::writeInPlace(uint8_t *buf, uint16_t len) {
+  HANDLE_NULL(_client, 0);
+  return _client->writeInPlace(buf, len);
+}
+
 int Triton_WiFi_ClientRef::read(void *buf, uint16_t len, uint32_t flags) {
   HANDLE_NULL(_client, 0);
   return _client->read(buf, len, flags);
@@ -116,6 +121,11 @@ int Triton_WiFi_ClientRef::available(void) {
   return _client->available();
 }
 
+uint16_t Triton_WiFi_ClientRef::mss(void) {
+  HANDLE_NULL(_client, 0);
+  return _client->mss();
+}
+
 int Triton_WiFi_ClientRef::read(uint8_t *buf, size_t size) {
   HANDLE_NULL(_client, 0);
   return _client->read(buf, size);
@@ -195,10 +205,10 @@ void Triton_WiFi_Server::begin() {
   // the CC3000 does not close the listening socket when it's idle for more than 
   // 60 seconds (the default timeout).  See more information from:
   // http://e2e.ti.com/support/low_power_rf/f/851/t/292664.aspx
-  unsigned long aucDHCP       = 14400;
-  unsigned long aucARP        = 3600;
-  unsigned long aucKeepalive  = 30;
-  unsigned long aucInactivity = 0;
+  UINT32 aucDHCP       = 14400;
+  UINT32 aucARP        = 3600;
+  UINT32 aucKeepalive  = 30;
+  UINT32 aucInactivity = 0;
   cc3k_int_poll();
   if (netapp_timeout_values(&aucDHCP, &aucARP, &aucKeepalive, &aucInactivity) != 0) {
     CC3K_PRINTLN_F("Error setting inactivity timeout!");
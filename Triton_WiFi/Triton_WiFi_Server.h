@@ -54,10 +54,12 @@ class Triton_WiFi_ClientRef : public Client {
   size_t fastrprintln(const __FlashStringHelper *ifsh);
 
   size_t write(const void *buf, uint16_t len, uint32_t flags = 0);
+  size_t writeInPlace(uint8_t *buf, uint16_t len);
   int read(void *buf, uint16_t len, uint32_t flags = 0);
   int read(void);
   int32_t close(void);
   int available(void);
+  uint16_t mss(void);
 
   int read(uint8_t *buf, size_t size);
   size_t write(const uint8_t *buf, size_t size);
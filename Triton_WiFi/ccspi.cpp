@@ -312,7 +312,7 @@ long SpiFirstWrite(unsigned char *ucBuf, unsigned short usLength)
 
  */
 /**************************************************************************/
-long SpiWrite(unsigned char *pUserBuffer, unsigned short usLength)
+INT32 SpiWrite(unsigned char *pUserBuffer, unsigned short usLength)
 {
   unsigned char ucPad = 0;
 
@@ -614,7 +614,7 @@ void WriteWlanPin( unsigned char val )
 
  */
 /**************************************************************************/
-long ReadWlanInterruptPin(void)
+INT32 ReadWlanInterruptPin(void)
 {
   DEBUGPRINT_F("\tCC3000: ReadWlanInterruptPin - ");
   DEBUGPRINT_DEC(digitalRead(g_irqPin));
@@ -660,7 +660,7 @@ void WlanInterruptDisable()
 //!         since there is no patch in the host - it returns 0
 //
 //*****************************************************************************
-char *sendDriverPatch(unsigned long *Length) {
+char *sendDriverPatch(UINT32 *Length) {
   *Length = 0;
   return NULL;
 }
@@ -677,7 +677,7 @@ char *sendDriverPatch(unsigned long *Length) {
 //!         since there is no patch in the host - it returns 0
 //
 //*****************************************************************************
-char *sendBootLoaderPatch(unsigned long *Length) {
+char *sendBootLoaderPatch(UINT32 *Length) {
   *Length = 0;
   return NULL;
 }
@@ -694,7 +694,7 @@ char *sendBootLoaderPatch(unsigned long *Length) {
 //!         since there is no patch in the host - it returns 0
 //
 //*****************************************************************************
-char *sendWLFWPatch(unsigned long *Length) {
+char *sendWLFWPatch(UINT32 *Length) {
   *Length = 0;
   return NULL;
 }
@@ -63,20 +63,20 @@ extern unsigned char wlan_tx_buffer[];
 //*****************************************************************************
 extern void SpiOpen(gcSpiHandleRx pfRxHandler);
 extern void SpiClose(void);
-extern long SpiWrite(unsigned char *pUserBuffer, unsigned short usLength);
+extern INT32 SpiWrite(unsigned char *pUserBuffer, unsigned short usLength);
 extern void SpiResumeSpi(void);
 extern void SpiCleanGPIOISR(void);
 extern int  init_spi(void);
 extern long TXBufferIsEmpty(void);
 extern long RXBufferIsEmpty(void);
-extern void CC3000_UsynchCallback(long lEventType, char * data, unsigned char length);
+extern void CC3000_UsynchCallback(INT32 lEventType, char * data, unsigned char length);
 extern void WriteWlanPin( unsigned char val );
-extern long ReadWlanInterruptPin(void);
+extern INT32 ReadWlanInterruptPin(void);
 extern void WlanInterruptEnable();
 extern void WlanInterruptDisable();
-extern char *sendDriverPatch(unsigned long *Length);
-extern char *sendBootLoaderPatch(unsigned long *Length);
-extern char *sendWLFWPatch(unsigned long *Length);
+extern char *sendDriverPatch(UINT32 *Length);
+extern char *sendBootLoaderPatch(UINT32 *Length);
+extern char *sendWLFWPatch(UINT32 *Length);
 extern void SPI_IRQ(void);
 
 #endif
@@ -0,0 +1,159 @@
+/*************************************************** 
+  This is an example for measuring what writeInPlace() saves over
+  write() on the Triton IoT rapid prototype platform
+  ----> https://www.neptcloud.com/
+
+  write() copies every byte into the CC3000 transmit buffer behind
+  the packet headers, writeInPlace() builds the headers in the room
+  in front of the caller's data and sends it from there. For each
+  chunk size the sketch prints the bytes the driver copied per write
+  of each call, the cost of that copy and the time per write of both
+  calls, with
+  pipelined writes so the copy is not hidden behind the CC3000's
+  acknowledgement. Run a sink on a PC on the same network, for
+  example:
+
+    nc -l -k 5001 > /dev/null
+
+  and set SINK_IP to the PC's address. The driver only counts the
+  bytes it copies with CC3000_COUNT_COPIES defined in
+  utility/cc3000_common.h, without it the copied columns show -.
+ ****************************************************/
+
+#include <Triton_WiFi.h>
+#include <ccspi.h>
+#include <SPI.h>
+#include <string.h>
+#include "utility/debug.h"
+#include "utility/cc3000_common.h"
+
+#define WLAN_SSID       "myNetwork"        // cannot be longer than 32 characters!
+#define WLAN_PASS       "myPassword"
+// Security can be WLAN_SEC_UNSEC, WLAN_SEC_WEP, WLAN_SEC_WPA or WLAN_SEC_WPA2
+#define WLAN_SECURITY   WLAN_SEC_WPA2
+
+#define SINK_IP         wifi.IP2U32(192, 168, 1, 2)
+#define SINK_PORT       5001
+
+#define MAX_CHUNK_SIZE  1024
+#define WRITES          128
+#define COPIES          1000
+
+// The data sits between the room writeInPlace() needs, write() ignores it
+uint8_t chunkBuf[TXHEADROOM + MAX_CHUNK_SIZE + TXTAILROOM];
+uint8_t *chunk = chunkBuf + TXHEADROOM;
+// Stands in for the CC3000 transmit buffer to time the copy write() makes
+uint8_t txCopy[MAX_CHUNK_SIZE];
+
+const uint16_t sizes[] = { 64, 256, 1024 };
+
+/**************************************************************************/
+/*!
+    @brief  Returns the microseconds the driver's copy of size bytes takes
+*/
+/**************************************************************************/
+float copyTime(uint16_t size)
+{
+  unsigned long start = micros();
+  for (uint16_t i = 0; i < COPIES; i++)
+  {
+    memcpy(txCopy, chunk, size);
+    // keep the compiler from dropping the copies
+    chunk[0] = txCopy[size - 1];
+  }
+  return (float)(micros() - start) / COPIES;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the microseconds per write of size bytes, 0 on error.
+            copied gets the bytes the driver copied per write, 0 without
+            CC3000_COUNT_COPIES.
+*/
+/**************************************************************************/
+float writeTime(uint16_t size, bool inPlace, uint32_t *copied)
+{
+  *copied = 0;
+  Triton_WiFi_Client client = wifi.connectTCP(SINK_IP, SINK_PORT);
+  if (!client.connected())
+  {
+    Serial.println(F("Couldn't connect to the sink"));
+    return 0;
+  }
+
+  wifi.setSendPipelined(true);
+#ifdef CC3000_COUNT_COPIES
+  uint32_t copiedBefore = tSLInformation.NumberOfCopiedBytes;
+#endif
+  unsigned long start = micros();
+  uint16_t i;
+  for (i = 0; i < WRITES; i++)
+  {
+    size_t n = inPlace ? client.writeInPlace(chunk, size) : client.write(chunk, size, 0);
+    if (n == 0)
+    {
+      break;
+    }
+  }
+  client.flush();
+  unsigned long elapsed = micros() - start;
+#ifdef CC3000_COUNT_COPIES
+  *copied = (tSLInformation.NumberOfCopiedBytes - copiedBefore) / WRITES;
+#endif
+  wifi.setSendPipelined(false);
+  client.close();
+
+  if ((i < WRITES) || client.getWriteError())
+  {
+    Serial.print(F("write error ")); Serial.println(client.getWriteError());
+    return 0;
+  }
+  return (float)elapsed / WRITES;
+}
+
+void setup(void)
+{
+  Serial.begin(115200);
+  Serial.println(F("write() vs writeInPlace()\n"));
+
+  memset(chunk, 'x', MAX_CHUNK_SIZE);
+
+  if (!wifi.begin())
+  {
+    Serial.println(F("Unable to initialise the WiFi module! Check your wiring?"));
+    while(1);
+  }
+  if (!wifi.connectToAP(WLAN_SSID, WLAN_PASS, WLAN_SECURITY)) {
+    Serial.println(F("connect to AP Failed!"));
+    while(1);
+  }
+  while (!wifi.checkDHCP())
+  {
+    delay(100);
+  }
+
+  Serial.println(F("size  copied(write)  copied(inPlace)  copy us  write us  inPlace us"));
+  for (uint8_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    uint16_t size = sizes[s];
+    uint32_t copiedWrite, copiedInPlace;
+    float copyUs = copyTime(size);
+    float writeUs = writeTime(size, false, &copiedWrite);
+    float inPlaceUs = writeTime(size, true, &copiedInPlace);
+    Serial.print(size); Serial.print(F("  "));
+#ifdef CC3000_COUNT_COPIES
+    Serial.print(copiedWrite); Serial.print(F("  "));
+    Serial.print(copiedInPlace); Serial.print(F("  "));
+#else
+    Serial.print(F("-  -  "));
+#endif
+    Serial.print(copyUs); Serial.print(F("  "));
+    Serial.print(writeUs); Serial.print(F("  "));
+    Serial.println(inPlaceUs);
+  }
+}
+
+void loop(void)
+{
+  delay(1000);
+}
@@ -0,0 +1,105 @@
+/*************************************************** 
+  This is an example for measuring the TCP write throughput of
+  the Triton IoT rapid prototype platform
+  ----> https://www.neptcloud.com/
+
+  1 KB chunks are written to a TCP sink, first waiting for every
+  write to complete and then with pipelined writes. Run a sink on
+  a PC on the same network, for example:
+
+    nc -l -k 5001 > /dev/null
+
+  and set SINK_IP to the PC's address.
+ ****************************************************/
+
+#include <Triton_WiFi.h>
+#include <ccspi.h>
+#include <SPI.h>
+#include <string.h>
+#include "utility/debug.h"
+
+#define WLAN_SSID       "myNetwork"        // cannot be longer than 32 characters!
+#define WLAN_PASS       "myPassword"
+// Security can be WLAN_SEC_UNSEC, WLAN_SEC_WEP, WLAN_SEC_WPA or WLAN_SEC_WPA2
+#define WLAN_SECURITY   WLAN_SEC_WPA2
+
+#define SINK_IP         wifi.IP2U32(192, 168, 1, 2)
+#define SINK_PORT       5001
+
+#define CHUNK_SIZE      1024
+#define CHUNKS          256
+
+uint8_t chunk[CHUNK_SIZE];
+
+/**************************************************************************/
+/*!
+    @brief  Writes CHUNKS chunks and prints the throughput
+*/
+/**************************************************************************/
+void measure(bool pipelined)
+{
+  Triton_WiFi_Client client = wifi.connectTCP(SINK_IP, SINK_PORT);
+  if (!client.connected())
+  {
+    Serial.println(F("Couldn't connect to the sink"));
+    return;
+  }
+
+  wifi.setSendPipelined(pipelined);
+  unsigned long start = millis();
+  uint32_t sent = 0;
+  for (uint16_t i = 0; i < CHUNKS; i++)
+  {
+    size_t n = client.write(chunk, CHUNK_SIZE);
+    if (n == 0)
+    {
+      break;
+    }
+    sent += n;
+  }
+  // Pipelined writes are only done once the CC3000 has acknowledged them
+  client.flush();
+  unsigned long elapsed = millis() - start;
+  wifi.setSendPipelined(false);
+
+  Serial.print(pipelined ? F("Pipelined: ") : F("Blocking:  "));
+  Serial.print(sent); Serial.print(F(" bytes in "));
+  Serial.print(elapsed); Serial.print(F(" ms, "));
+  Serial.print(elapsed ? (sent * 1000UL) / elapsed : 0); Serial.print(F(" bytes/s"));
+  if (client.getWriteError())
+  {
+    Serial.print(F(", write error ")); Serial.print(client.getWriteError());
+  }
+  Serial.println();
+  client.close();
+}
+
+void setup(void)
+{
+  Serial.begin(115200);
+  Serial.println(F("TCP write throughput\n"));
+
+  memset(chunk, 'x', sizeof(chunk));
+
+  if (!wifi.begin())
+  {
+    Serial.println(F("Unable to initialise the WiFi module! Check your wiring?"));
+    while(1);
+  }
+  if (!wifi.connectToAP(WLAN_SSID, WLAN_PASS, WLAN_SECURITY)) {
+    Serial.println(F("connect to AP Failed!"));
+    while(1);
+  }
+  while (!wifi.checkDHCP())
+  {
+    delay(100);
+  }
+
+  measure(false);
+  measure(true);
+}
+
+void loop(void)
+{
+  delay(1000);
+}
@@ -0,0 +1,443 @@
+/**************************************************************************/
+/*!
+  @file     Arduino.cpp
+
+  Arduino core for the Linux host build, see Arduino.h
+*/
+/**************************************************************************/
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "cc3k_emu.h"
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+static void (*irqHandler)(void);
+static uint8_t irqEnabled = 1;
+static uint8_t inIrq;
+static uint8_t irqLevel = HIGH;
+static uint8_t irqPending;
+
+/**************************************************************************/
+/*!
+    @brief  Lets the emulator catch up and runs the interrupt handler on a
+            falling edge of CC3K_IRQ.  An edge inside the handler, with
+            interrupts off or while no handler is attached is held until
+            the handler can run, as the AVR's interrupt flag would be.
+*/
+/**************************************************************************/
+static void serviceIrq(void)
+{
+  uint8_t level;
+
+  cc3k_emu_poll();
+  level = cc3k_emu_irq();
+  if ((irqLevel == HIGH) && (level == LOW)) {
+    irqPending = 1;
+  }
+  irqLevel = level;
+  while (irqPending && irqHandler && irqEnabled && !inIrq) {
+    irqPending = 0;
+    inIrq = 1;
+    irqHandler();
+    inIrq = 0;
+  }
+}
+
+static uint64_t nowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t startNs = nowNs();
+
+/* *********************************************************************** */
+/*                                                                         */
+/* PINS AND INTERRUPTS                                                     */
+/*                                                                         */
+/* *********************************************************************** */
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin == PIN_SPI_SS3) {
+    cc3k_emu_cs(val);
+    serviceIrq();
+  } else if (pin == CC3K_VBAT) {
+    cc3k_emu_vbat(val);
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (pin != CC3K_IRQ) {
+    return LOW;
+  }
+  // the level the edge detection saw, so the driver never sees the line
+  // go low without the interrupt having been raised
+  serviceIrq();
+  return irqLevel;
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+  irqHandler = userFunc;
+  serviceIrq();
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+  irqHandler = 0;
+}
+
+void interrupts(void)
+{
+  irqEnabled = 1;
+  serviceIrq();
+}
+
+void noInterrupts(void)
+{
+  irqEnabled = 0;
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* TIME                                                                    */
+/*                                                                         */
+/* *********************************************************************** */
+
+unsigned long millis(void)
+{
+  serviceIrq();
+  return (unsigned long)((nowNs() - startNs) / 1000000);
+}
+
+unsigned long micros(void)
+{
+  serviceIrq();
+  return (unsigned long)((nowNs() - startNs) / 1000);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sleeps in short steps, running the emulator in between, so a
+            delay does not count as CPU time
+*/
+/**************************************************************************/
+static void sleepNs(uint64_t ns)
+{
+  uint64_t end = nowNs() + ns;
+  uint64_t now;
+
+  while ((now = nowNs()) < end) {
+    struct timespec ts;
+    uint64_t step = end - now;
+    if (step > 50000) {
+      step = 50000;
+    }
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)step;
+    nanosleep(&ts, NULL);
+    serviceIrq();
+  }
+}
+
+void delay(unsigned long ms)
+{
+  serviceIrq();
+  sleepNs((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  serviceIrq();
+  sleepNs((uint64_t)us * 1000);
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* SPI                                                                     */
+/*                                                                         */
+/* *********************************************************************** */
+
+void SPIClass::begin()
+{
+}
+
+void SPIClass::end()
+{
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  return cc3k_emu_transfer(data);
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* MISC                                                                    */
+/*                                                                         */
+/* *********************************************************************** */
+
+long random(long howbig)
+{
+  if (howbig == 0) {
+    return 0;
+  }
+  return random() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0) {
+    srandom(seed);
+  }
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* PRINT                                                                   */
+/*                                                                         */
+/* *********************************************************************** */
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *ifsh)
+{
+  return write(reinterpret_cast<const char *>(ifsh));
+}
+
+size_t Print::print(const char str[])
+{
+  return write(str);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char b, int base)
+{
+  return print((unsigned long)b, base);
+}
+
+size_t Print::print(int n, int base)
+{
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+  if (base == 0) {
+    return write((uint8_t)n);
+  }
+  if ((base == DEC) && (n < 0)) {
+    size_t t = print('-');
+    return t + printNumber(-(unsigned long)n, DEC);
+  }
+  return printNumber((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  if (base == 0) {
+    return write((uint8_t)n);
+  }
+  return printNumber(n, base);
+}
+
+size_t Print::print(double number, int digits)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, number);
+  return write(buf);
+}
+
+size_t Print::print(const Printable& x)
+{
+  return x.printTo(*this);
+}
+
+size_t Print::println(void)
+{
+  return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper *ifsh)
+{
+  size_t n = print(ifsh);
+  return n + println();
+}
+
+size_t Print::println(const char c[])
+{
+  size_t n = print(c);
+  return n + println();
+}
+
+size_t Print::println(char c)
+{
+  size_t n = print(c);
+  return n + println();
+}
+
+size_t Print::println(unsigned char b, int base)
+{
+  size_t n = print(b, base);
+  return n + println();
+}
+
+size_t Print::println(int num, int base)
+{
+  size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(unsigned int num, int base)
+{
+  size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(long num, int base)
+{
+  size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(unsigned long num, int base)
+{
+  size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(double num, int digits)
+{
+  size_t n = print(num, digits);
+  return n + println();
+}
+
+size_t Print::println(const Printable& x)
+{
+  size_t n = print(x);
+  return n + println();
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned long m = n;
+    n /= base;
+    char c = m - base * n;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+
+  return write(str);
+}
+
+size_t IPAddress::printTo(Print& p) const
+{
+  size_t n = 0;
+  for (int i = 0; i < 3; i++) {
+    n += p.print(_address[i], DEC);
+    n += p.print('.');
+  }
+  n += p.print(_address[3], DEC);
+  return n;
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* SERIAL                                                                  */
+/*                                                                         */
+/* *********************************************************************** */
+
+HardwareSerial::HardwareSerial() : _out(stdout)
+{
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+}
+
+void HardwareSerial::end()
+{
+}
+
+void HardwareSerial::setOutput(FILE *out)
+{
+  _out = out;
+}
+
+int HardwareSerial::available(void)
+{
+  return 0;
+}
+
+int HardwareSerial::read(void)
+{
+  return -1;
+}
+
+int HardwareSerial::peek(void)
+{
+  return -1;
+}
+
+void HardwareSerial::flush(void)
+{
+  if (_out) {
+    fflush(_out);
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (_out) {
+    fputc(c, _out);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  if (_out) {
+    fwrite(buffer, 1, size, _out);
+  }
+  return size;
+}
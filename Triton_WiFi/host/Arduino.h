@@ -0,0 +1,105 @@
+/**************************************************************************/
+/*!
+  @file     Arduino.h
+
+  The part of the Arduino core the Triton_WiFi driver uses, for the Linux
+  host build.  Pins CC3K_CS, CC3K_VBAT and CC3K_IRQ are wired to the
+  CC3000 emulator, time is the host's monotonic clock and an attached
+  interrupt handler runs on the falling edge of CC3K_IRQ, checked
+  whenever the driver calls into the core (digitalRead, SPI.transfer,
+  millis, delay ...), so it never preempts arbitrary code.
+*/
+/**************************************************************************/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+// Triton board wiring of the CC3000
+static const uint8_t CC3K_IRQ    = 3;
+static const uint8_t CC3K_VBAT   = 5;
+static const uint8_t PIN_SPI_SS3 = 10;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_byte_near(addr) pgm_read_byte(addr)
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void interrupts(void);
+void noInterrupts(void);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+// Serial prints to stdout, setOutput(NULL) silences it
+class HardwareSerial : public Stream {
+  public:
+    HardwareSerial();
+    void begin(unsigned long baud);
+    void end();
+    void setOutput(FILE *out);
+    virtual int available(void);
+    virtual int read(void);
+    virtual int peek(void);
+    virtual void flush(void);
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    operator bool() { return true; }
+  private:
+    FILE *_out;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,48 @@
+/**************************************************************************/
+/*!
+  @file     IPAddress.h
+
+  Arduino IPAddress for the Linux host build.  As on the board the
+  uint32_t conversions copy the four address bytes in memory order.
+*/
+/**************************************************************************/
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+#include <string.h>
+#include "Print.h"
+
+class IPAddress : public Printable {
+  public:
+    IPAddress() { memset(_address, 0, sizeof(_address)); }
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth) {
+      _address[0] = first;
+      _address[1] = second;
+      _address[2] = third;
+      _address[3] = fourth;
+    }
+    IPAddress(uint32_t address) { memcpy(_address, &address, sizeof(_address)); }
+    IPAddress(const uint8_t *address) { memcpy(_address, address, sizeof(_address)); }
+
+    operator uint32_t() const {
+      uint32_t a;
+      memcpy(&a, _address, sizeof(a));
+      return a;
+    }
+    bool operator==(const IPAddress& addr) const { return memcmp(addr._address, _address, sizeof(_address)) == 0; }
+
+    uint8_t operator[](int index) const { return _address[index]; }
+    uint8_t& operator[](int index) { return _address[index]; }
+
+    virtual size_t printTo(Print& p) const;
+
+    friend class Client;
+
+  private:
+    uint8_t _address[4];
+    uint8_t* raw_address() { return _address; }
+};
+
+#endif
@@ -0,0 +1,19 @@
+/**************************************************************************/
+/*!
+  @file     Server.h
+
+  Arduino Server for the Linux host build
+*/
+/**************************************************************************/
+
+#ifndef server_h
+#define server_h
+
+#include "Print.h"
+
+class Server : public Print {
+  public:
+    virtual void begin() = 0;
+};
+
+#endif
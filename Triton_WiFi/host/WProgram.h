@@ -0,0 +1,9 @@
+/**************************************************************************/
+/*!
+  @file     WProgram.h
+
+  Pre 1.0 name of Arduino.h
+*/
+/**************************************************************************/
+
+#include "Arduino.h"
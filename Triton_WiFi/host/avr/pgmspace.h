@@ -0,0 +1,11 @@
+/**************************************************************************/
+/*!
+  @file     pgmspace.h
+
+  Program memory is ordinary memory on the Linux host build, see Arduino.h
+*/
+/**************************************************************************/
+
+#include "../Arduino.h"
+
+#define memcpy_P(dest, src, n) memcpy((dest), (src), (n))
@@ -0,0 +1,1185 @@
+/**************************************************************************/
+/*!
+  @file     cc3k_bench.cpp
+
+  Runs the Triton_WiFi driver, AJ_Net_*, PubSubClient and PubSubClientSN on
+  Linux against the CC3000 emulator and reports, per operation, the wall time, the CPU time spent
+  in the driver (the emulator's own time taken out), the HCI traffic it
+  caused and the throughput.  The far end is cc3k_peer.cpp on 127.0.0.1.
+
+  Built from the repository root, driver and library sources with the
+  cc3k_host.h prefix, the emulator and peer without it:
+
+    D=Triton_WiFi; H=$D/host
+    P="-include $H/cc3k_host.h -I$H -I$D -IAllJoyn -IPubSubClient -DAJ_NET_CC3000"
+    find $D $D/utility -maxdepth 1 -name '*.cpp' > lib.txt
+    echo "AllJoyn/aj_net .cpp" >> lib.txt
+    ls $H/Arduino.cpp $H/cc3k_bench.cpp PubSubClient/PubSubClient.cpp \
+       PubSubClient/PubSubClientSN.cpp >> lib.txt
+    while read f; do g++ -O2 $P -c "$f" -o "$(basename "$f" .cpp | tr ' ' _).o"; done < lib.txt
+    for f in $(find AllJoyn -maxdepth 1 -name 'aj_*.cpp' ! -name 'aj_net*'); do
+             g++ -O2 -DAJ_NET_CC3000 -IAllJoyn -c $f; done
+    g++ -O2 -c $H/cc3k_emu.cpp $H/cc3k_peer.cpp
+    g++ *.o -lpthread -o cc3k_bench
+
+  Usage: cc3k_bench [-c credits] [-l latency_us] [-k spi_clock_hz]
+                    [-n bytes] [-o] [-v]
+
+  -o lists the HCI opcodes behind every line, -v lets the driver and
+  AllJoyn print to Serial (stdout).  spi/KB is the number of SPI
+  transactions (HCI commands, events and data packets) per KB moved.
+  The MQTT and MQTT-SN wire lines give the bytes sent per message, alone
+  and with the 40 byte TCP/IP or 28 byte UDP/IP header of every packet
+  (TCP ACKs left out).
+
+  The CPU column leaves out the SPI bit time (-k) and the emulator, but
+  not the shim's servicing inside delay(), which is most of it for begin
+  and connectOpen.
+*/
+/**************************************************************************/
+
+#include <Triton_WiFi.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "cc3k_emu.h"
+#include "cc3k_peer.h"
+#include "alljoyn.h"
+#include "aj_net.h"
+#include "aj_debug.h"
+#include "PubSubClient.h"
+#include "PubSubClientSN.h"
+
+#define CHUNK_SIZE   1024
+#define LARGE_CHUNK  (3 * CHUNK_SIZE) // more than one CC3000 packet
+#define CONNECTS     10
+#define AJ_ROUNDS    100
+#define AJ_MSG_SIZE  200
+#define MQTT_PAYLOAD (64UL * 1024)
+#define MQTT_TOPIC   "cc3k/bench/blob"
+#define QOS_MESSAGES 200
+#define QOS_PAYLOAD  32
+#define QOS_OFFLINE  32
+// The packet on which the peer drops the QoS 2 reconnect bench's connection,
+// one of the first window of PUBLISHes
+#define QOS_DROP     10
+#define WIRE_MESSAGES 200
+#define WIRE_PAYLOAD 16
+#define WIRE_TOPIC   "cc3k/bench/temp"
+#define SLEEP_KEPT   3
+#define DISPATCH_FILTERS  100
+#define DISPATCH_DEVICES  32
+#define DISPATCH_MESSAGES 200
+#define DISPATCH_ROUNDS   50
+#define LOOP_BINS         16
+#define LOOP_NS_PER_BYTE  20000
+#define LOOP_BUDGET       200
+#define PROGMEM_PAYLOAD   1024
+#define PROGMEM_MESSAGES  16
+#define PRINT_SIZE        2048
+#define PRINT_ROUNDS      16
+
+static uint16_t peerPort;
+static bool listOpcodes;
+static uint32_t totalBytes = 256 * 1024;
+static uint8_t chunk[TXHEADROOM + CHUNK_SIZE + TXTAILROOM];
+static uint32_t mqttReceived;
+static uint32_t mqttChunks;
+static bool mqttCorrupt;
+static uint8_t mqttQueue[2048];
+static uint32_t snDelivered;
+static char dispatchFilters[DISPATCH_FILTERS][24];
+static MQTTTopicNode dispatchPool[192];
+static uint32_t dispatchCalls;
+static uint8_t txBuffer[TXHEADROOM + 1460 + TXTAILROOM];
+static char printText[PRINT_SIZE + 1];
+
+/* *********************************************************************** */
+/*                                                                         */
+/* MEASURING                                                               */
+/*                                                                         */
+/* *********************************************************************** */
+
+typedef struct
+{
+  uint64_t wallNs;
+  uint64_t cpuNs;
+} Mark;
+
+static uint64_t clockNs(clockid_t id)
+{
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void markStart(Mark *m)
+{
+  cc3k_emu_reset_stats();
+  m->wallNs = clockNs(CLOCK_MONOTONIC);
+  m->cpuNs = clockNs(CLOCK_THREAD_CPUTIME_ID);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prints one result line
+
+    @param  name   what was measured
+    @param  m      taken by markStart() before it
+    @param  ops    how many times it was done
+    @param  bytes  payload moved, 0 for no throughput figure
+
+    @returns  The wall time in ns
+*/
+/**************************************************************************/
+static uint64_t markEnd(const char *name, const Mark *m, uint32_t ops, uint64_t bytes)
+{
+  uint64_t cpuNs = clockNs(CLOCK_THREAD_CPUTIME_ID) - m->cpuNs;
+  uint64_t wallNs = clockNs(CLOCK_MONOTONIC) - m->wallNs;
+  cc3k_emu_stats st;
+
+  cc3k_emu_get_stats(&st);
+  cpuNs = (cpuNs > st.emuNs) ? cpuNs - st.emuNs : 0;
+  if (ops == 0) {
+    ops = 1;
+  }
+  printf("%-22s %5u %10.1f %10.1f %7.1f %7.1f %7.1f %7.1f %9.0f",
+         name, ops,
+         wallNs / 1000.0 / ops, cpuNs / 1000.0 / ops,
+         (double)st.commands / ops, (double)st.dataPackets / ops,
+         (double)st.events / ops, (double)st.rxDataPackets / ops,
+         (double)st.spiBytes / ops);
+  if (bytes) {
+    printf(" %9.1f %7.1f", bytes * 1e9 / 1024.0 / wallNs,
+           st.spiTransactions * 1024.0 / bytes);
+  }
+  if (st.creditOverruns) {
+    printf("  %u credit overruns", st.creditOverruns);
+  }
+  printf("\n");
+  if (listOpcodes) {
+    for (int i = 0; (i < CC3K_EMU_MAX_OPCODES) && st.byOpcode[i].count; i++) {
+      printf("    0x%04x %u\n", st.byOpcode[i].opcode, st.byOpcode[i].count);
+    }
+  }
+  return wallNs;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prints what the messages since markStart() cost on the wire
+
+    @param  msgs      how many were sent
+    @param  wallNs    from markEnd()
+    @param  ipHeader  TCP/IP or UDP/IP header bytes per packet
+*/
+/**************************************************************************/
+static void wireLine(uint32_t msgs, uint64_t wallNs, uint32_t ipHeader)
+{
+  cc3k_emu_stats st;
+
+  cc3k_emu_get_stats(&st);
+  printf("%-22s %5s %10.1f B/msg %7.1f B/msg on IP %9.0f msgs/s\n", "", "",
+         (double)st.txBytes / msgs,
+         (double)(st.txBytes + (uint64_t)st.dataPackets * ipHeader) / msgs,
+         msgs * 1e9 / wallNs);
+}
+
+static void header(void)
+{
+  printf("%-22s %5s %10s %10s %7s %7s %7s %7s %9s %9s %7s\n",
+         "", "ops", "wall us", "cpu us", "cmds", "data", "events", "rxdata", "spi B",
+         "KB/s", "spi/KB");
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* OPERATIONS                                                              */
+/*                                                                         */
+/* *********************************************************************** */
+
+static bool openPeer(Triton_WiFi_Client *client, uint8_t mode)
+{
+  *client = wifi.connectTCP(wifi.IP2U32(127, 0, 0, 1), peerPort);
+  if (!client->connected()) {
+    printf("connect to the peer failed\n");
+    return false;
+  }
+  return client->write(&mode, 1, 0) == 1;
+}
+
+static void benchConnect(void)
+{
+  Triton_WiFi_Client client;
+  Mark m;
+
+  markStart(&m);
+  for (int i = 0; i < CONNECTS; i++) {
+    if (!openPeer(&client, CC3K_PEER_SINK)) {
+      return;
+    }
+    client.close();
+  }
+  markEnd("connect+close", &m, CONNECTS, 0);
+}
+
+static void benchWrite(bool inPlace, bool pipelined)
+{
+  Triton_WiFi_Client client;
+  uint8_t *data = chunk + TXHEADROOM;
+  uint32_t chunks = totalBytes / CHUNK_SIZE;
+  uint64_t sent = 0;
+  Mark m;
+
+  if (!openPeer(&client, CC3K_PEER_SINK)) {
+    return;
+  }
+  wifi.setSendPipelined(pipelined);
+  markStart(&m);
+  for (uint32_t i = 0; i < chunks; i++) {
+    size_t n = inPlace ? client.writeInPlace(data, CHUNK_SIZE)
+                       : client.write(data, CHUNK_SIZE, 0);
+    if (n == 0) {
+      printf("write failed, error %d\n", client.getWriteError());
+      break;
+    }
+    sent += n;
+  }
+  client.flush();
+  markEnd(inPlace ? (pipelined ? "writeInPlace pipelined" : "writeInPlace")
+                  : (pipelined ? "write pipelined" : "write"),
+          &m, chunks, sent);
+  wifi.setSendPipelined(false);
+  client.close();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads totalBytes from the source peer
+
+    @param  name  result line name
+    @param  size  bytes per read(buf, len), 1 reads byte by byte with
+                  available() and read() as PubSubClient does
+*/
+/**************************************************************************/
+static void benchRead(const char *name, uint16_t size)
+{
+  Triton_WiFi_Client client;
+  uint8_t request[4];
+  uint8_t buf[CHUNK_SIZE];
+  uint64_t received = 0;
+  uint32_t reads = 0;
+  Mark m;
+
+  if (!openPeer(&client, CC3K_PEER_SOURCE)) {
+    return;
+  }
+  request[0] = totalBytes & 0xFF;
+  request[1] = (totalBytes >> 8) & 0xFF;
+  request[2] = (totalBytes >> 16) & 0xFF;
+  request[3] = totalBytes >> 24;
+  markStart(&m);
+  client.write(request, sizeof(request), 0);
+  while (received < totalBytes) {
+    int r;
+    if (size == 1) {
+      while (!client.available() && client.connected()) {
+      }
+      if (!client.connected()) {
+        break;
+      }
+      buf[0] = client.read();
+      r = 1;
+    } else {
+      r = client.read(buf, size, 0);
+    }
+    if (r <= 0) {
+      break;
+    }
+    received += r;
+    reads++;
+  }
+  markEnd(name, &m, reads, received);
+  if (received != totalBytes) {
+    printf("read %llu of %u bytes\n", (unsigned long long)received, totalBytes);
+  }
+  client.close();
+}
+
+static void benchAllJoyn(void)
+{
+  AJ_NetSocket netSock;
+  uint32_t addr = 0x0100007F; // 127.0.0.1 in the byte order AJ_Net_Connect() takes
+  uint64_t moved = 0;
+  Mark m;
+
+  if (AJ_Net_Connect(&netSock, peerPort, AJ_ADDR_IPV4, &addr) != AJ_OK) {
+    printf("AJ_Net_Connect failed\n");
+    return;
+  }
+  *netSock.tx.writePtr++ = CC3K_PEER_ECHO;
+  netSock.tx.send(&netSock.tx);
+
+  markStart(&m);
+  for (int i = 0; i < AJ_ROUNDS; i++) {
+    uint32_t got = 0;
+
+    memset(netSock.tx.writePtr, 'a' + (i % 26), AJ_MSG_SIZE);
+    netSock.tx.writePtr += AJ_MSG_SIZE;
+    if (netSock.tx.send(&netSock.tx) != AJ_OK) {
+      printf("AJ_Net_Send failed\n");
+      break;
+    }
+    while (got < AJ_MSG_SIZE) {
+      uint8_t *start = netSock.rx.writePtr;
+      if (netSock.rx.recv(&netSock.rx, AJ_MSG_SIZE - got, 1000) != AJ_OK) {
+        printf("AJ_Net_Recv failed\n");
+        i = AJ_ROUNDS;
+        break;
+      }
+      got += netSock.rx.writePtr - start;
+    }
+    AJ_IO_BUF_RESET(&netSock.rx);
+    moved += 2 * got;
+  }
+  markEnd("AJ_Net echo", &m, AJ_ROUNDS, moved);
+  AJ_Net_Disconnect(&netSock);
+}
+
+/* The service and its proxy are the same object, the echo peer hands
+   every call back to be answered and then the reply to the caller */
+static const char* const ajEchoInterface[] = {
+  "org.alljoyn.cc3kbench",
+  "?Echo data<ay data>ay",
+  NULL
+};
+
+static const AJ_InterfaceDescription ajEchoInterfaces[] = {
+  ajEchoInterface,
+  NULL
+};
+
+static const AJ_Object ajEchoObjects[] = {
+  { "/cc3kbench", ajEchoInterfaces },
+  { NULL }
+};
+
+#define AJ_APP_ECHO  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define AJ_PRX_ECHO  AJ_PRX_MESSAGE_ID(0, 0, 0)
+
+static int compareNs(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* Answers the call that came back from the peer and reads the reply */
+static AJ_Status ajEchoRound(AJ_BusAttachment *bus)
+{
+  AJ_Message call;
+  AJ_Message reply;
+  uint8_t *data;
+  size_t len;
+  AJ_Status status;
+
+  status = AJ_UnmarshalMsg(bus, &call, 1000);
+  if (status != AJ_OK) {
+    return status;
+  }
+  if (call.msgId != AJ_APP_ECHO) {
+    status = AJ_ERR_UNEXPECTED;
+  }
+  if (status == AJ_OK) {
+    status = AJ_UnmarshalArgs(&call, "ay", &data, &len);
+  }
+  if (status == AJ_OK) {
+    status = AJ_MarshalReplyMsg(&call, &reply);
+  }
+  if (status == AJ_OK) {
+    status = AJ_MarshalArgs(&reply, "ay", data, len);
+  }
+  if (status == AJ_OK) {
+    status = AJ_DeliverMsg(&reply);
+  }
+  AJ_CloseMsg(&call);
+  if (status == AJ_OK) {
+    status = AJ_UnmarshalMsg(bus, &reply, 1000);
+    if ((status == AJ_OK) && (reply.msgId != AJ_REPLY_ID(AJ_PRX_ECHO))) {
+      status = AJ_ERR_UNEXPECTED;
+    }
+    AJ_CloseMsg(&reply);
+  }
+  return status;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Times AJ_ROUNDS AllJoyn method calls with an AJ_MSG_SIZE
+            argument, from AJ_MarshalMethodCall() to the reply, and prints
+            their median and 99th percentile.  Each is two AJ_Net round
+            trips through the echo peer.
+
+    @param  name     the result line
+    @param  delayUs  how long the echo peer holds each message, standing
+                     in for the network and a service that takes time
+*/
+/**************************************************************************/
+static void benchAllJoynCall(const char *name, uint32_t delayUs)
+{
+  AJ_BusAttachment bus;
+  uint32_t addr = 0x0100007F; // 127.0.0.1 in the byte order AJ_Net_Connect() takes
+  uint8_t payload[AJ_MSG_SIZE];
+  uint64_t ns[AJ_ROUNDS];
+  uint32_t rounds = 0;
+  AJ_Status status = AJ_OK;
+  Mark m;
+
+  memset(&bus, 0, sizeof(bus));
+  memset(payload, 'c', sizeof(payload));
+  AJ_Initialize();
+  AJ_RegisterObjects(ajEchoObjects, ajEchoObjects);
+  if (AJ_Net_Connect(&bus.sock, peerPort, AJ_ADDR_IPV4, &addr) != AJ_OK) {
+    printf("AJ_Net_Connect failed\n");
+    return;
+  }
+  strcpy(bus.uniqueName, ":cc3kbench.1");
+  *bus.sock.tx.writePtr++ = CC3K_PEER_ECHO;
+  bus.sock.tx.send(&bus.sock.tx);
+  cc3k_peer_echo_delay(delayUs);
+
+  markStart(&m);
+  for (; (rounds < AJ_ROUNDS) && (status == AJ_OK); rounds++) {
+    AJ_Message call;
+    uint64_t start = clockNs(CLOCK_MONOTONIC);
+
+    status = AJ_MarshalMethodCall(&bus, &call, AJ_PRX_ECHO, bus.uniqueName, 0, 0, 1000);
+    if (status == AJ_OK) {
+      status = AJ_MarshalArgs(&call, "ay", payload, sizeof(payload));
+    }
+    if (status == AJ_OK) {
+      status = AJ_DeliverMsg(&call);
+    }
+    if (status == AJ_OK) {
+      status = ajEchoRound(&bus);
+    }
+    ns[rounds] = clockNs(CLOCK_MONOTONIC) - start;
+  }
+  markEnd(name, &m, rounds, (uint64_t)rounds * 4 * AJ_MSG_SIZE);
+  cc3k_peer_echo_delay(0);
+  if (status != AJ_OK) {
+    printf("%s failed: %s\n", name, AJ_StatusText(status));
+  } else {
+    qsort(ns, rounds, sizeof(ns[0]), compareNs);
+    printf("%-22s %5s %10.1f p50 us %7.1f p99 us\n", "", "",
+           ns[rounds / 2] / 1000.0, ns[(rounds * 99) / 100] / 1000.0);
+  }
+  AJ_Net_Disconnect(&bus.sock);
+  AJ_RegisterObjects(NULL, NULL);
+}
+
+static void mqttChunk(char *topic, uint32_t offset, uint8_t *data,
+                      unsigned int length, uint32_t total)
+{
+  if ((offset != mqttReceived) || (total != MQTT_PAYLOAD) ||
+      strcmp(topic, MQTT_TOPIC)) {
+    mqttCorrupt = true;
+  }
+  for (unsigned int i = 0; i < length; i++) {
+    if (data[i] != (uint8_t)(offset + i)) {
+      mqttCorrupt = true;
+    }
+  }
+  mqttReceived += length;
+  mqttChunks++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Streams a MQTT_PAYLOAD PUBLISH out in writes of CHUNK_SIZE and
+            LARGE_CHUNK bytes in turn and, once the peer has sent it back,
+            in through the chunk callback
+*/
+/**************************************************************************/
+static void benchMqtt(void)
+{
+  Triton_WiFi_Client client;
+  PubSubClient mqtt((char *)"localhost", peerPort, NULL, client);
+  uint8_t block[LARGE_CHUNK];
+  uint32_t sent = 0;
+  uint32_t writes = 0;
+  bool ok;
+  Mark m;
+
+  mqtt.setChunkCallback(mqttChunk);
+  if (!mqtt.connect((char *)"cc3k-bench")) {
+    printf("MQTT connect failed\n");
+    return;
+  }
+
+  markStart(&m);
+  ok = mqtt.beginPublish((char *)MQTT_TOPIC, MQTT_PAYLOAD, false);
+  while (ok && (sent < MQTT_PAYLOAD)) {
+    uint32_t n = (writes++ & 1) ? LARGE_CHUNK : CHUNK_SIZE;
+
+    if (n > MQTT_PAYLOAD - sent) {
+      n = MQTT_PAYLOAD - sent;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      block[i] = (uint8_t)(sent + i);
+    }
+    ok = (mqtt.write(block, n) == n);
+    sent += n;
+    // Nothing may be written into the middle of the payload
+    if (ok && (sent == CHUNK_SIZE)) {
+      mqtt.loop();
+      if (mqtt.publish((char *)MQTT_TOPIC, (char *)"x") ||
+          mqtt.subscribe((char *)MQTT_TOPIC)) {
+        printf("MQTT sent a packet inside a streamed PUBLISH\n");
+        ok = false;
+      }
+    }
+  }
+  ok = mqtt.endPublish() && ok;
+  markEnd("MQTT beginPublish", &m, writes, MQTT_PAYLOAD);
+  if (!ok) {
+    printf("MQTT publish failed\n");
+  }
+
+  mqttReceived = mqttChunks = 0;
+  mqttCorrupt = false;
+  markStart(&m);
+  while ((mqttReceived < MQTT_PAYLOAD) && mqtt.loop()) {
+  }
+  markEnd("MQTT chunk callback", &m, mqttChunks, mqttReceived);
+  if ((mqttReceived != MQTT_PAYLOAD) || mqttCorrupt) {
+    printf("MQTT received %u of %lu bytes%s\n", mqttReceived, MQTT_PAYLOAD,
+           mqttCorrupt ? ", corrupted" : "");
+  }
+  mqtt.disconnect();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Publishes QOS_MESSAGES messages at qos with up to window of
+            them unacknowledged, or with offline set queues QOS_OFFLINE
+            of them before connecting and times their replay
+*/
+/**************************************************************************/
+static void benchMqttQos(uint8_t qos, uint8_t window, bool offline)
+{
+  Triton_WiFi_Client client;
+  PubSubClient mqtt((char *)"localhost", peerPort, NULL, client);
+  uint8_t payload[QOS_PAYLOAD];
+  uint32_t count = offline ? QOS_OFFLINE : QOS_MESSAGES;
+  uint32_t published = 0;
+  char name[32];
+  uint64_t wallNs;
+  Mark m;
+
+  memset(payload, 'q', sizeof(payload));
+  mqtt.setPublishQueue(mqttQueue, sizeof(mqttQueue), window);
+  if (offline) {
+    for (; published < count; published++) {
+      if (!mqtt.publish((char *)MQTT_TOPIC, payload, sizeof(payload), false, qos)) {
+        break;
+      }
+    }
+    markStart(&m);
+  }
+  if (!mqtt.connect((char *)"cc3k-bench")) {
+    printf("MQTT connect failed\n");
+    return;
+  }
+  if (!offline) {
+    markStart(&m);
+  }
+  for (; published < count; published++) {
+    while (!mqtt.publish((char *)MQTT_TOPIC, payload, sizeof(payload), false, qos)) {
+      if (!mqtt.loop()) {
+        break;
+      }
+    }
+  }
+  while (mqtt.queued() && mqtt.loop()) {
+  }
+  snprintf(name, sizeof(name), offline ? "MQTT QoS%u replay" : "MQTT QoS%u window %u", qos, window);
+  wallNs = markEnd(name, &m, count, count * QOS_PAYLOAD);
+  printf("%-22s %5s %10.0f msgs/s\n", "", "", count * 1e9 / wallNs);
+  if (mqtt.queued()) {
+    printf("MQTT %u messages not acknowledged\n", mqtt.queued());
+  }
+  mqtt.disconnect();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Publishes QOS_OFFLINE QoS 2 messages, has the peer drop the
+            connection while some are in flight, reconnects and checks
+            the replay delivered each of them exactly once
+*/
+/**************************************************************************/
+static void benchMqttReconnect(void)
+{
+  Triton_WiFi_Client client;
+  PubSubClient mqtt((char *)"localhost", peerPort, NULL, client);
+  uint8_t payload[QOS_PAYLOAD];
+  uint32_t published = 0;
+  uint32_t delivered;
+  Mark m;
+
+  memset(payload, 'r', sizeof(payload));
+  mqtt.setPublishQueue(mqttQueue, sizeof(mqttQueue), 16);
+  if (!mqtt.connect((char *)"cc3k-bench")) {
+    printf("MQTT connect failed\n");
+    return;
+  }
+  delivered = cc3k_peer_mqtt_delivered();
+  cc3k_peer_mqtt_drop(QOS_DROP);
+
+  markStart(&m);
+  for (; published < QOS_OFFLINE; published++) {
+    if (!mqtt.publish((char *)MQTT_TOPIC, payload, sizeof(payload), false, 2)) {
+      break;
+    }
+  }
+  while (mqtt.queued() && mqtt.loop()) {
+  }
+  if (!mqtt.connect((char *)"cc3k-bench")) {
+    printf("MQTT reconnect failed\n");
+    return;
+  }
+  while (mqtt.queued() && mqtt.loop()) {
+  }
+  markEnd("MQTT QoS2 reconnect", &m, published, published * QOS_PAYLOAD);
+  delivered = cc3k_peer_mqtt_delivered() - delivered;
+  if ((published != QOS_OFFLINE) || mqtt.queued() || (delivered != published)) {
+    printf("MQTT QoS2 reconnect delivered %u of %u messages, %u not acknowledged\n",
+           delivered, published, mqtt.queued());
+  }
+  mqtt.disconnect();
+}
+
+static void dispatchHandler(char *topic, uint8_t *payload, unsigned int length)
+{
+  dispatchCalls++;
+}
+
+/* What an application does without the trie: try every filter in turn */
+static bool filterMatches(const char *filter, const char *topic)
+{
+  while (*filter) {
+    if (*filter == '#') {
+      return true;
+    }
+    if (*filter == '+') {
+      while (*topic && (*topic != '/')) {
+        topic++;
+      }
+      filter++;
+    } else if (*filter++ != *topic++) {
+      return false;
+    }
+  }
+  return *topic == 0;
+}
+
+static void dispatchCallback(char *topic, uint8_t *payload, unsigned int length)
+{
+  for (int i = 0; i < DISPATCH_FILTERS; i++) {
+    if (filterMatches(dispatchFilters[i], topic)) {
+      dispatchCalls++;
+    }
+  }
+}
+
+/* DISPATCH_MESSAGES QoS 0 PUBLISH packets with a 4 byte payload */
+static size_t dispatchPackets(uint8_t *packets)
+{
+  size_t size = 0;
+
+  for (int i = 0; i < DISPATCH_MESSAGES; i++) {
+    char topic[24];
+    int d = i % DISPATCH_DEVICES;
+    int tl;
+    if (i % 3 == 0) {
+      tl = snprintf(topic, sizeof(topic), "home/dev%d/cmd", d);
+    } else if (i % 3 == 1) {
+      tl = snprintf(topic, sizeof(topic), "home/dev%d/config", d);
+    } else {
+      tl = snprintf(topic, sizeof(topic), "home/dev%d/ota/%d", d, i);
+    }
+    packets[size++] = MQTTPUBLISH;
+    packets[size++] = 2 + tl + 4;
+    packets[size++] = 0;
+    packets[size++] = tl;
+    memcpy(packets + size, topic, tl);
+    size += tl;
+    memcpy(packets + size, "data", 4);
+    size += 4;
+  }
+  return size;
+}
+
+/*
+ * A Client that hands out the same bytes over and over and drops what is
+ * written, so PubSubClient can be timed without the driver. Given nsPerByte
+ * the bytes arrive at that pace, like over a slow link.
+ */
+class ReplayClient : public Client {
+public:
+  ReplayClient(const uint8_t *data, size_t size, uint32_t nsPerByte = 0)
+    : _data(data), _size(size), _pos(0), _nsPerByte(nsPerByte), _read(0),
+      _start(clockNs(CLOCK_MONOTONIC)) {}
+  virtual int connect(IPAddress ip, uint16_t port) { return 1; }
+  virtual int connect(const char *host, uint16_t port) { return 1; }
+  virtual size_t write(uint8_t b) { return 1; }
+  virtual size_t write(const uint8_t *buf, size_t size) { return size; }
+  virtual int available()
+  {
+    size_t n = _size - _pos;
+    if (_nsPerByte) {
+      uint64_t arrived = (clockNs(CLOCK_MONOTONIC) - _start) / _nsPerByte - _read;
+      if (arrived < n) {
+        n = arrived;
+      }
+    }
+    return n;
+  }
+  virtual int read() { uint8_t b = _data[_pos]; _pos = (_pos + 1) % _size; _read++; return b; }
+  virtual int read(uint8_t *buf, size_t size)
+  {
+    if (size > _size - _pos) {
+      size = _size - _pos;
+    }
+    memcpy(buf, _data + _pos, size);
+    _pos = (_pos + size) % _size;
+    _read += size;
+    return size;
+  }
+  virtual int peek() { return _data[_pos]; }
+  virtual void flush() {}
+  virtual void stop() {}
+  virtual uint8_t connected() { return 1; }
+  virtual operator bool() { return true; }
+private:
+  const uint8_t *_data;
+  size_t _size;
+  size_t _pos;
+  uint32_t _nsPerByte;
+  uint64_t _read;
+  uint64_t _start;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Feeds DISPATCH_MESSAGES PUBLISH packets, each matching two of
+            DISPATCH_FILTERS filters, DISPATCH_ROUNDS times through loop()
+            and times it with the filters in a topic trie or tried one by
+            one by the callback.  No CC3000 is involved.
+*/
+/**************************************************************************/
+static void benchDispatch(bool trie)
+{
+  static uint8_t packets[DISPATCH_MESSAGES * 32];
+  size_t size;
+  int n = 0;
+  Mark m;
+
+  for (int d = 0; d < DISPATCH_DEVICES; d++) {
+    snprintf(dispatchFilters[n++], sizeof(dispatchFilters[0]), "home/dev%d/cmd", d);
+    snprintf(dispatchFilters[n++], sizeof(dispatchFilters[0]), "home/dev%d/config", d);
+    snprintf(dispatchFilters[n++], sizeof(dispatchFilters[0]), "home/dev%d/ota/+", d);
+  }
+  strcpy(dispatchFilters[n++], "home/+/status");
+  strcpy(dispatchFilters[n++], "home/#");
+  strcpy(dispatchFilters[n++], "$SYS/#");
+  strcpy(dispatchFilters[n++], "alerts/+/+");
+
+  size = dispatchPackets(packets);
+
+  ReplayClient client(packets, size);
+  PubSubClient mqtt((char *)"localhost", peerPort, trie ? NULL : dispatchCallback, client);
+  if (trie) {
+    mqtt.setTopicPool(dispatchPool, sizeof(dispatchPool) / sizeof(dispatchPool[0]));
+    for (int i = 0; i < DISPATCH_FILTERS; i++) {
+      if (!mqtt.addHandler(dispatchFilters[i], dispatchHandler)) {
+        printf("MQTT addHandler %s failed\n", dispatchFilters[i]);
+      }
+    }
+  }
+
+  dispatchCalls = 0;
+  markStart(&m);
+  for (uint32_t i = 0; i < DISPATCH_ROUNDS * DISPATCH_MESSAGES; i++) {
+    mqtt.loop();
+  }
+  markEnd(trie ? "MQTT dispatch trie" : "MQTT dispatch strcmp", &m, DISPATCH_ROUNDS * DISPATCH_MESSAGES, 0);
+  if (dispatchCalls != 2 * DISPATCH_ROUNDS * DISPATCH_MESSAGES) {
+    printf("MQTT dispatch made %u of %u handler calls\n", dispatchCalls,
+           2 * DISPATCH_ROUNDS * DISPATCH_MESSAGES);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Calls loop() until DISPATCH_MESSAGES PUBLISH packets have come
+            in, rounds times, arriving nsPerByte apart or all at once, and
+            prints how long the calls took from PubSubClient's histogram
+*/
+/**************************************************************************/
+static void benchLoopLatency(const char *name, uint32_t nsPerByte, unsigned long budget, uint32_t rounds)
+{
+  static uint8_t packets[DISPATCH_MESSAGES * 32];
+  uint32_t bins[LOOP_BINS];
+  uint32_t calls = 0;
+  size_t size = dispatchPackets(packets);
+  Mark m;
+
+  ReplayClient client(packets, size, nsPerByte);
+  PubSubClient mqtt((char *)"localhost", peerPort, dispatchHandler, client);
+  memset(bins, 0, sizeof(bins));
+  mqtt.setLoopHistogram(bins, LOOP_BINS);
+
+  dispatchCalls = 0;
+  markStart(&m);
+  while (dispatchCalls < rounds * DISPATCH_MESSAGES) {
+    mqtt.loop(budget);
+    calls++;
+  }
+  markEnd(name, &m, calls, 0);
+
+  printf("%-22s %5s   loop() us:", "", "");
+  for (int i = 0; i < LOOP_BINS; i++) {
+    if (bins[i]) {
+      printf(" <%lu %u", 1UL << i, bins[i]);
+    }
+  }
+  printf(", %.1f msgs/call\n", (double)dispatchCalls / calls);
+}
+
+/* Prints the sends to the CC3000 since markStart() per KB written */
+static void sendsLine(uint64_t bytes)
+{
+  cc3k_emu_stats st;
+
+  cc3k_emu_get_stats(&st);
+  printf("%-22s %5s %10.1f sends/KB\n", "", "", st.dataPackets * 1024.0 / bytes);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Publishes PROGMEM_MESSAGES payloads of PROGMEM_PAYLOAD bytes
+            with publish_P(), which writes them byte by byte, straight to
+            the client or through a buffered client
+*/
+/**************************************************************************/
+static void benchPublishP(bool buffered)
+{
+  static uint8_t payload[PROGMEM_PAYLOAD] PROGMEM;
+  Triton_WiFi_Client client;
+  Triton_WiFi_BufferedClient bufferedClient(&client, txBuffer, sizeof(txBuffer));
+  Client &c = buffered ? (Client &)bufferedClient : (Client &)client;
+  PubSubClient mqtt((char *)"localhost", peerPort, NULL, c);
+  uint64_t bytes = 0;
+  Mark m;
+
+  memset(payload, 'p', sizeof(payload));
+  if (!mqtt.connect((char *)"cc3k-bench")) {
+    printf("MQTT connect failed\n");
+    return;
+  }
+  markStart(&m);
+  for (int i = 0; i < PROGMEM_MESSAGES; i++) {
+    if (!mqtt.publish_P((char *)WIRE_TOPIC, payload, sizeof(payload), false)) {
+      printf("MQTT publish_P failed\n");
+      break;
+    }
+    bytes += sizeof(payload);
+  }
+  c.flush();
+  markEnd(buffered ? "publish_P buffered" : "publish_P", &m, PROGMEM_MESSAGES, bytes);
+  sendsLine(bytes);
+  mqtt.disconnect();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes PRINT_SIZE bytes of text with fastrprint(), which sends
+            TXBUFFERSIZE bytes at a time, or with the buffered client's
+*/
+/**************************************************************************/
+static void benchPrint(bool buffered)
+{
+  Triton_WiFi_Client client;
+  Triton_WiFi_BufferedClient bufferedClient(&client, txBuffer, sizeof(txBuffer));
+  const __FlashStringHelper *text = (const __FlashStringHelper *)printText;
+  uint64_t bytes = 0;
+  Mark m;
+
+  memset(printText, 'f', PRINT_SIZE);
+  if (!openPeer(&client, CC3K_PEER_SINK)) {
+    return;
+  }
+  markStart(&m);
+  for (int i = 0; i < PRINT_ROUNDS; i++) {
+    bytes += buffered ? bufferedClient.fastrprint(text) : client.fastrprint(text);
+  }
+  if (buffered) {
+    bufferedClient.flush();
+  }
+  markEnd(buffered ? "fastrprint buffered" : "fastrprint", &m, PRINT_ROUNDS, bytes);
+  sendsLine(bytes);
+  if (buffered && (bufferedClient.sends() * 1024.0 / bufferedClient.sentBytes() > 2)) {
+    printf("fastrprint buffered took %u sends\n", bufferedClient.sends());
+  }
+  client.close();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Connects and publishes WIRE_MESSAGES small messages at QoS 0
+            over TCP, for the MQTT-SN figures to be set against
+*/
+/**************************************************************************/
+static void benchMqttWire(void)
+{
+  Triton_WiFi_Client client;
+  PubSubClient mqtt((char *)"localhost", peerPort, NULL, client);
+  uint8_t payload[WIRE_PAYLOAD];
+  uint64_t wallNs;
+  Mark m;
+
+  memset(payload, 't', sizeof(payload));
+  markStart(&m);
+  if (!mqtt.connect((char *)"cc3k-bench")) {
+    printf("MQTT connect failed\n");
+    return;
+  }
+  wireLine(1, markEnd("MQTT connect", &m, 1, 0), 40);
+
+  markStart(&m);
+  for (int i = 0; i < WIRE_MESSAGES; i++) {
+    if (!mqtt.publish((char *)WIRE_TOPIC, payload, sizeof(payload))) {
+      printf("MQTT publish failed\n");
+      break;
+    }
+  }
+  wallNs = markEnd("MQTT QoS0 publish", &m, WIRE_MESSAGES, WIRE_MESSAGES * WIRE_PAYLOAD);
+  wireLine(WIRE_MESSAGES, wallNs, 40);
+  mqtt.disconnect();
+}
+
+/**************************************************************************/
+/*!
+    @brief  The same messages over MQTT-SN at qos: to a registered topic
+            id for QoS 0 and 1, to a short topic without connecting for
+            QoS -1
+*/
+/**************************************************************************/
+static void benchMqttSnWire(uint8_t qos)
+{
+  Triton_WiFi_Client client = wifi.connectUDP(wifi.IP2U32(127, 0, 0, 1), peerPort);
+  PubSubClientSN sn(NULL, client);
+  uint8_t payload[WIRE_PAYLOAD];
+  uint8_t topicType = MQTTSNTOPIC_SHORT;
+  uint16_t topicId = MQTTSN_SHORT_TOPIC('b', 't');
+  const char *name;
+  uint64_t wallNs;
+  Mark m;
+
+  memset(payload, 't', sizeof(payload));
+  if (qos != MQTTSNQOSM1) {
+    markStart(&m);
+    if (!sn.connect((char *)"cc3k-bench")) {
+      printf("MQTT-SN connect failed\n");
+      client.close();
+      return;
+    }
+    if (qos == MQTTSNQOS0) {
+      wireLine(1, markEnd("MQTT-SN connect", &m, 1, 0), 28);
+    }
+    topicType = MQTTSNTOPIC_NORMAL;
+    topicId = sn.registerTopic((char *)WIRE_TOPIC);
+    if (topicId == 0) {
+      printf("MQTT-SN register failed\n");
+    }
+    if (qos == MQTTSNQOS0) {
+      // A topic that does not fit in a datagram is refused, not cut short
+      char longTopic[MQTTSN_MAX_PACKET_SIZE];
+
+      memset(longTopic, 'l', sizeof(longTopic) - 1);
+      longTopic[sizeof(longTopic) - 1] = 0;
+      if (sn.registerTopic(longTopic) != 0) {
+        printf("MQTT-SN registered a topic longer than a packet\n");
+      }
+    }
+  }
+
+  name = (qos == MQTTSNQOSM1) ? "MQTT-SN QoS-1 publish" :
+         (qos == MQTTSNQOS0) ? "MQTT-SN QoS0 publish" : "MQTT-SN QoS1 publish";
+  markStart(&m);
+  for (int i = 0; i < WIRE_MESSAGES; i++) {
+    if (!sn.publish(topicType, topicId, payload, sizeof(payload), qos, false)) {
+      printf("MQTT-SN publish failed\n");
+      break;
+    }
+  }
+  wallNs = markEnd(name, &m, WIRE_MESSAGES, WIRE_MESSAGES * WIRE_PAYLOAD);
+  wireLine(WIRE_MESSAGES, wallNs, 28);
+  if (sn.connected()) {
+    sn.disconnect();
+  }
+  client.close();
+}
+
+static void snCallback(uint16_t topicId, uint8_t *payload, unsigned int length)
+{
+  if ((topicId == MQTTSN_SHORT_TOPIC('s', 'r')) && (length == WIRE_PAYLOAD)) {
+    snDelivered++;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Subscribes, goes to sleep, has SLEEP_KEPT messages kept for it
+            by the gateway and times collecting them with checkIn()
+*/
+/**************************************************************************/
+static void benchMqttSnSleep(void)
+{
+  Triton_WiFi_Client client = wifi.connectUDP(wifi.IP2U32(127, 0, 0, 1), peerPort);
+  PubSubClientSN sn(snCallback, client);
+  uint16_t topicId = MQTTSN_SHORT_TOPIC('s', 'r');
+  uint8_t payload[WIRE_PAYLOAD];
+  Mark m;
+
+  memset(payload, 's', sizeof(payload));
+  if (!sn.connect((char *)"cc3k-bench") ||
+      !sn.subscribe(MQTTSNTOPIC_SHORT, topicId, MQTTSNQOS0) ||
+      !sn.sleep(60)) {
+    printf("MQTT-SN sleep failed\n");
+    client.close();
+    return;
+  }
+  for (int i = 0; i < SLEEP_KEPT; i++) {
+    sn.publish(MQTTSNTOPIC_SHORT, topicId, payload, sizeof(payload), MQTTSNQOSM1, false);
+  }
+
+  snDelivered = 0;
+  markStart(&m);
+  if (!sn.checkIn()) {
+    printf("MQTT-SN checkIn failed\n");
+  }
+  markEnd("MQTT-SN checkIn", &m, 1, 0);
+  if (snDelivered != SLEEP_KEPT) {
+    printf("MQTT-SN checkIn delivered %u of %u\n", snDelivered, SLEEP_KEPT);
+  }
+  sn.disconnect();
+  client.close();
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* MAIN                                                                    */
+/*                                                                         */
+/* *********************************************************************** */
+
+int main(int argc, char **argv)
+{
+  cc3k_emu_config config;
+  bool verbose = false;
+  uint32_t ip;
+  Mark m;
+  int opt;
+
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  cc3k_emu_default_config(&config);
+  while ((opt = getopt(argc, argv, "c:l:k:n:ov")) != -1) {
+    switch (opt) {
+      case 'c': config.credits = atoi(optarg); break;
+      case 'l': config.latencyUs = atoi(optarg); break;
+      case 'k': config.spiClockHz = atoi(optarg); break;
+      case 'n': totalBytes = atoi(optarg); break;
+      case 'o': listOpcodes = true; break;
+      case 'v': verbose = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-c credits] [-l latency_us] [-k spi_clock_hz] [-n bytes] [-o] [-v]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (!verbose) {
+    Serial.setOutput(NULL);
+    AJ_DbgLevel = AJ_DEBUG_OFF;
+  }
+  wifi.setPrinter(verbose ? &Serial : NULL);
+  cc3k_emu_init(&config);
+  peerPort = cc3k_peer_start();
+  if (peerPort == 0) {
+    printf("peer failed to start\n");
+    return 1;
+  }
+  memset(chunk, 'x', sizeof(chunk));
+
+  printf("credits %u, latency %u us, SPI clock %u Hz, %u bytes\n\n",
+         config.credits, config.latencyUs, config.spiClockHz, totalBytes);
+  header();
+
+  markStart(&m);
+  if (!wifi.begin()) {
+    printf("begin failed\n");
+    return 1;
+  }
+  markEnd("begin", &m, 1, 0);
+
+  markStart(&m);
+  if (!wifi.connectOpen("cc3k-emu")) {
+    printf("connectOpen failed\n");
+    return 1;
+  }
+  while (!wifi.checkDHCP()) {
+    delay(1);
+  }
+  markEnd("connectOpen+DHCP", &m, 1, 0);
+
+  markStart(&m);
+  if (!wifi.getHostByName((char *)"localhost", &ip) || (ip != wifi.IP2U32(127, 0, 0, 1))) {
+    printf("getHostByName failed\n");
+  }
+  markEnd("getHostByName", &m, 1, 0);
+
+  benchConnect();
+  benchWrite(false, false);
+  benchWrite(false, true);
+  benchWrite(true, false);
+  benchWrite(true, true);
+  benchRead("read", CHUNK_SIZE);
+  benchRead("read 16", 16);
+  benchRead("read per byte", 1);
+  benchAllJoyn();
+  benchAllJoynCall("AJ method call", 0);
+  benchAllJoynCall("AJ method call 10ms", 10000);
+  benchMqtt();
+  benchMqttQos(1, 1, false);
+  benchMqttQos(1, 4, false);
+  benchMqttQos(1, 16, false);
+  benchMqttQos(2, 16, false);
+  benchMqttQos(1, 16, true);
+  benchMqttReconnect();
+  benchDispatch(false);
+  benchDispatch(true);
+  benchLoopLatency("MQTT loop trickled", LOOP_NS_PER_BYTE, 0, 1);
+  benchLoopLatency("MQTT loop", 0, 0, DISPATCH_ROUNDS);
+  benchLoopLatency("MQTT loop budget", 0, LOOP_BUDGET, DISPATCH_ROUNDS);
+  benchPublishP(false);
+  benchPublishP(true);
+  benchPrint(false);
+  benchPrint(true);
+  benchMqttWire();
+  benchMqttSnWire(MQTTSNQOS0);
+  benchMqttSnWire(MQTTSNQOSM1);
+  benchMqttSnWire(MQTTSNQOS1);
+  benchMqttSnSleep();
+
+  wifi.stop();
+  return 0;
+}
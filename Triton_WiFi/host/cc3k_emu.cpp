@@ -0,0 +1,998 @@
+/**************************************************************************/
+/*!
+  @file     cc3k_emu.cpp
+
+  CC3000 emulator for the Linux host build, see cc3k_emu.h.
+
+  This file is built without cc3k_host.h as it uses the host's socket API,
+  the HCI constants below mirror utility/hci.h.
+
+  Modelled:
+   - the SPI framing of ccspi.cpp: the IRQ line goes low when the host
+     asserts CS (ready to be written) or when a packet is waiting for the
+     host (with CS high), a transaction starting with 0x01 is a write and
+     one starting with 0x03 reads the waiting packet
+   - power up: IRQ goes low powerUpUs after WLAN_EN and stays low until
+     the first write
+   - buffer credits: HCI_CMND_READ_BUFFER_SIZE reports config.credits,
+     every data packet takes one and its HCI_EVNT_DATA_UNSOL_FREE_BUFF
+     returns it; data packets sent without a credit are counted
+   - latency: every response, data packet and unsolicited event becomes
+     visible to the host config.latencyUs after the command that caused
+     it, in order
+   - SPI clock: a transaction takes at least 8 * bytes / spiClockHz
+
+  socket, connect, send, sendto, recv, recvfrom, select, setsockopt,
+  closesocket and gethostbyname run on real sockets.  bind, listen and
+  accept fail, and commands that are not listed answer with a zero status,
+  which is enough for begin(), connectOpen()/connectSecure() and the
+  ioctls they use.
+*/
+/**************************************************************************/
+
+#include "cc3k_emu.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <vector>
+
+/* *********************************************************************** */
+/*                                                                         */
+/* HCI (utility/hci.h)                                                     */
+/*                                                                         */
+/* *********************************************************************** */
+
+#define HCI_TYPE_CMND  0x1
+#define HCI_TYPE_DATA  0x2
+#define HCI_TYPE_EVNT  0x4
+
+#define SPI_WRITE      1
+#define SPI_READ       3
+#define SPI_HEADER_SIZE 5
+
+#define HCI_CMND_WLAN_CONNECT              0x0001
+#define HCI_CMND_WLAN_DISCONNECT           0x0002
+#define HCI_CMND_EVENT_MASK                0x0008
+#define HCI_CMND_WLAN_IOCTL_STATUSGET      0x0009
+#define HCI_CMND_SOCKET                    0x1001
+#define HCI_CMND_BIND                      0x1002
+#define HCI_CMND_RECV                      0x1004
+#define HCI_CMND_ACCEPT                    0x1005
+#define HCI_CMND_LISTEN                    0x1006
+#define HCI_CMND_CONNECT                   0x1007
+#define HCI_CMND_BSD_SELECT                0x1008
+#define HCI_CMND_SETSOCKOPT                0x1009
+#define HCI_CMND_GETSOCKOPT                0x100A
+#define HCI_CMND_CLOSE_SOCKET              0x100B
+#define HCI_CMND_RECVFROM                  0x100D
+#define HCI_CMND_GETHOSTNAME               0x1010
+#define HCI_CMND_MDNS_ADVERTISE            0x1011
+#define HCI_CMND_GETMSSVALUE               0x1012
+#define HCI_CMND_READ_SP_VERSION           0x0207
+#define HCI_CMND_SIMPLE_LINK_START         0x4000
+#define HCI_CMND_READ_BUFFER_SIZE          0x400B
+#define HCI_NETAPP_DHCP                    0x2001
+#define HCI_NETAPP_IPCONFIG                0x2005
+
+#define HCI_CMND_SEND                      0x81
+#define HCI_CMND_SENDTO                    0x83
+#define HCI_DATA_RECVFROM                  0x84
+#define HCI_DATA_RECV                      0x85
+
+#define HCI_EVNT_SEND                      0x1003
+#define HCI_EVNT_SENDTO                    0x100F
+#define HCI_EVNT_DATA_UNSOL_FREE_BUFF      0x4100
+#define HCI_EVNT_WLAN_UNSOL_BASE           0x8000
+#define HCI_EVNT_WLAN_UNSOL_CONNECT        0x8001
+#define HCI_EVNT_WLAN_UNSOL_DISCONNECT     0x8002
+#define HCI_EVNT_WLAN_UNSOL_DHCP           0x8010
+#define HCI_EVNT_BSD_TCP_CLOSE_WAIT        0x8800
+
+#define CC3K_AF_INET         2
+#define CC3K_SOCK_STREAM     1
+#define CC3K_SOCK_DGRAM      2
+#define CC3K_SOCKOPT_RECV_NONBLOCK 0
+#define CC3K_SOCKOPT_RECV_TIMEOUT  1
+#define CC3K_SOCK_ON         0
+
+#define ERROR_SOCKET_INACTIVE (-57)
+
+#define MAX_SOCKETS     8     // M_IS_VALID_SD()
+#define MAX_RX_DATA     1460  // recv() payload per data packet, fits CC3000_RX_BUFFER_SIZE
+#define RECV_ARGS_SIZE  24    // sd, fromlen, ..., from (BSD_RECV_FROM_*_OFFSET)
+#define SPI_FRAME_MAX   2048
+#define SOCKET_POLL_NS  10000 // how often pending recv/select look at the sockets
+#define IRQ_GAP_NS      5000  // IRQ stays high this long after a transaction
+
+/* *********************************************************************** */
+/*                                                                         */
+/* STATE                                                                   */
+/*                                                                         */
+/* *********************************************************************** */
+
+typedef struct
+{
+  uint64_t due;             // visible to the host from this time
+  uint8_t  freesCredit;     // a free buffer event, the credit returns once it is read
+  std::vector<uint8_t> hci; // HCI packet
+} Packet;
+
+typedef struct
+{
+  int      fd;              // -1 when the descriptor is free
+  int      type;
+  uint8_t  recvNonBlocking;
+  uint32_t recvTimeoutMs;
+  uint8_t  closeWaitSent;
+} Socket;
+
+typedef struct
+{
+  uint8_t  active;
+  uint16_t opcode;
+  int32_t  sd;
+  uint32_t len;
+  uint32_t flags;
+  uint64_t deadline;        // 0 for none
+} PendingRecv;
+
+typedef struct
+{
+  uint8_t  active;
+  uint32_t nfds;
+  uint32_t rd, wr, ex;
+  uint64_t deadline;        // 0 for a blocking select
+} PendingSelect;
+
+static cc3k_emu_config cfg;
+static cc3k_emu_stats  st;
+
+static uint8_t  vbat;
+static uint64_t vbatOnNs;
+static uint8_t  started;    // first write done, regular IRQ handling from now on
+static uint8_t  cs = 1;
+static uint64_t csFallNs;
+static uint64_t csRiseNs;
+static uint32_t spiCount;
+static uint8_t  spiOp;
+static uint8_t  mosi[SPI_FRAME_MAX];
+static std::vector<uint8_t> miso;
+static uint8_t  misoValid;
+
+static std::deque<Packet> outbound;
+static uint64_t lastDue;
+static uint8_t  credits;
+static uint32_t eventMask;
+static uint8_t  wlanConnected;
+
+static Socket        sockets[MAX_SOCKETS];
+static PendingRecv   pendingRecv;
+static PendingSelect pendingSelect;
+static uint64_t      lastSocketPollNs;
+
+static uint64_t nowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Everything the emulator does is timed so the driver's share of the CPU
+ * can be worked out by the caller
+ */
+class EmuTimer {
+public:
+  EmuTimer() : start(nowNs()) {}
+  ~EmuTimer() { st.emuNs += nowNs() - start; }
+private:
+  uint64_t start;
+};
+
+/* *********************************************************************** */
+/*                                                                         */
+/* PACKETS TO THE HOST                                                     */
+/*                                                                         */
+/* *********************************************************************** */
+
+static void put32(std::vector<uint8_t> &v, uint32_t u)
+{
+  v.push_back(u & 0xFF);
+  v.push_back((u >> 8) & 0xFF);
+  v.push_back((u >> 16) & 0xFF);
+  v.push_back((u >> 24) & 0xFF);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void countOpcode(uint16_t opcode)
+{
+  for (int i = 0; i < CC3K_EMU_MAX_OPCODES; i++) {
+    if (st.byOpcode[i].count && (st.byOpcode[i].opcode == opcode)) {
+      st.byOpcode[i].count++;
+      return;
+    }
+    if (st.byOpcode[i].count == 0) {
+      st.byOpcode[i].opcode = opcode;
+      st.byOpcode[i].count = 1;
+      return;
+    }
+  }
+}
+
+static void queuePacket(const std::vector<uint8_t> &hci, uint8_t freesCredit)
+{
+  Packet p;
+  uint64_t due = nowNs() + (uint64_t)cfg.latencyUs * 1000;
+
+  // the host sees them in the order they were caused
+  if (due < lastDue) {
+    due = lastDue;
+  }
+  lastDue = due;
+  p.due = due;
+  p.freesCredit = freesCredit;
+  p.hci = hci;
+  outbound.push_back(p);
+}
+
+static void queueEvent(uint16_t opcode, uint8_t status, const std::vector<uint8_t> &params)
+{
+  std::vector<uint8_t> hci;
+
+  // masked unsolicited WLAN events are not sent
+  if ((opcode & HCI_EVNT_WLAN_UNSOL_BASE) && (opcode & eventMask & 0x7FFF)) {
+    return;
+  }
+  hci.push_back(HCI_TYPE_EVNT);
+  hci.push_back(opcode & 0xFF);
+  hci.push_back(opcode >> 8);
+  hci.push_back(1 + params.size());
+  hci.push_back(status);
+  hci.insert(hci.end(), params.begin(), params.end());
+  queuePacket(hci, opcode == HCI_EVNT_DATA_UNSOL_FREE_BUFF);
+}
+
+static void queueEvent32(uint16_t opcode, uint32_t value)
+{
+  std::vector<uint8_t> params;
+  put32(params, value);
+  queueEvent(opcode, 0, params);
+}
+
+static void queueData(uint8_t opcode, const uint8_t *args, const uint8_t *data, uint16_t len)
+{
+  std::vector<uint8_t> hci;
+  uint16_t total = RECV_ARGS_SIZE + len;
+
+  hci.push_back(HCI_TYPE_DATA);
+  hci.push_back(opcode);
+  hci.push_back(RECV_ARGS_SIZE);
+  hci.push_back(total & 0xFF);
+  hci.push_back(total >> 8);
+  hci.insert(hci.end(), args, args + RECV_ARGS_SIZE);
+  hci.insert(hci.end(), data, data + len);
+  queuePacket(hci, 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Frames the first due packet as ccspi.cpp reads it: the SPI
+            header, the HCI packet and a pad byte if the transfer would
+            otherwise end on an even length
+*/
+/**************************************************************************/
+static void frameForRead(void)
+{
+  const std::vector<uint8_t> &hci = outbound.front().hci;
+  size_t len = hci.size();
+
+  miso.assign(SPI_HEADER_SIZE, 0);
+  miso[0] = 0x02;
+  miso[3] = (len >> 8) & 0xFF;
+  miso[4] = len & 0xFF;
+  miso.insert(miso.end(), hci.begin(), hci.end());
+  if (!(miso.size() & 1)) {
+    miso.push_back(0);
+  }
+  misoValid = 1;
+}
+
+static uint8_t packetDue(void)
+{
+  return !outbound.empty() && (outbound.front().due <= nowNs());
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* SOCKETS                                                                 */
+/*                                                                         */
+/* *********************************************************************** */
+
+static int validSd(int32_t sd)
+{
+  return (sd >= 0) && (sd < MAX_SOCKETS) && (sockets[sd].fd >= 0);
+}
+
+/*
+ * CC3000 socket addresses are {family (little endian), port, address}, the
+ * last two in network order
+ */
+static void toSockaddrIn(const uint8_t *addr, struct sockaddr_in *sin)
+{
+  memset(sin, 0, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  memcpy(&sin->sin_port, addr + 2, 2);
+  memcpy(&sin->sin_addr, addr + 4, 4);
+}
+
+static void fromSockaddrIn(const struct sockaddr_in *sin, uint8_t *addr)
+{
+  addr[0] = CC3K_AF_INET;
+  addr[1] = 0;
+  memcpy(addr + 2, &sin->sin_port, 2);
+  memcpy(addr + 4, &sin->sin_addr, 4);
+}
+
+static void closeWait(int32_t sd)
+{
+  if (!sockets[sd].closeWaitSent) {
+    sockets[sd].closeWaitSent = 1;
+    queueEvent32(HCI_EVNT_BSD_TCP_CLOSE_WAIT, sd);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Polls a socket without blocking
+
+    @returns  bit 0 readable with data, bit 1 peer closed or error
+*/
+/**************************************************************************/
+static int socketState(int32_t sd)
+{
+  struct pollfd pfd;
+  uint8_t b;
+  int state = 0;
+
+  pfd.fd = sockets[sd].fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, 0) <= 0) {
+    return 0;
+  }
+  if (pfd.revents & (POLLERR | POLLNVAL)) {
+    state |= 2;
+  }
+  if (pfd.revents & (POLLIN | POLLHUP)) {
+    ssize_t n = recv(pfd.fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0) {
+      state |= 1;
+    } else if ((n == 0) && (sockets[sd].type == CC3K_SOCK_STREAM)) {
+      state |= 2;
+    }
+  }
+  if ((state & 2) && (sockets[sd].type == CC3K_SOCK_STREAM)) {
+    closeWait(sd);
+  }
+  return state;
+}
+
+static void completeRecv(int32_t sd, int32_t numBytes, const uint8_t *data, const struct sockaddr_in *from)
+{
+  std::vector<uint8_t> params;
+  uint8_t args[RECV_ARGS_SIZE];
+
+  put32(params, sd);
+  put32(params, numBytes);
+  put32(params, pendingRecv.flags);
+  queueEvent(pendingRecv.opcode, 0, params);
+  if (numBytes > 0) {
+    memset(args, 0, sizeof(args));
+    args[0] = sd;
+    args[4] = 8;
+    if (from) {
+      fromSockaddrIn(from, args + 16);
+    }
+    queueData((pendingRecv.opcode == HCI_CMND_RECVFROM) ? HCI_DATA_RECVFROM : HCI_DATA_RECV,
+              args, data, numBytes);
+    st.rxBytes += numBytes;
+  }
+  pendingRecv.active = 0;
+}
+
+static void serviceRecv(void)
+{
+  uint8_t data[MAX_RX_DATA];
+  struct sockaddr_in from;
+  socklen_t fromlen = sizeof(from);
+  int32_t sd = pendingRecv.sd;
+  uint32_t len = pendingRecv.len;
+  int state;
+  ssize_t n;
+
+  if (!validSd(sd)) {
+    completeRecv(sd, -1, NULL, NULL);
+    return;
+  }
+  state = socketState(sd);
+  if (state & 1) {
+    if (len > sizeof(data)) {
+      len = sizeof(data);
+    }
+    n = recvfrom(sockets[sd].fd, data, len, MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen);
+    if (n > 0) {
+      completeRecv(sd, n, data, &from);
+      return;
+    }
+  }
+  if (state & 2) {
+    completeRecv(sd, ERROR_SOCKET_INACTIVE, NULL, NULL);
+    return;
+  }
+  if (sockets[sd].recvNonBlocking ||
+      (pendingRecv.deadline && (nowNs() >= pendingRecv.deadline))) {
+    completeRecv(sd, 0, NULL, NULL);
+  }
+}
+
+static void serviceSelect(void)
+{
+  std::vector<uint8_t> params;
+  uint32_t rd = 0, wr = 0, ex = 0;
+  int32_t ready = 0;
+
+  for (uint32_t sd = 0; (sd < pendingSelect.nfds) && (sd < MAX_SOCKETS); sd++) {
+    uint32_t bit = 1UL << sd;
+    int state;
+
+    if (!((pendingSelect.rd | pendingSelect.wr | pendingSelect.ex) & bit)) {
+      continue;
+    }
+    if (!validSd(sd)) {
+      ex |= pendingSelect.ex & bit;
+      continue;
+    }
+    state = socketState(sd);
+    if ((state & 1) && (pendingSelect.rd & bit)) {
+      rd |= bit;
+    }
+    if (pendingSelect.wr & bit) {
+      wr |= bit;
+    }
+    if ((state & 2) && (pendingSelect.ex & bit)) {
+      ex |= bit;
+    }
+  }
+  for (uint32_t m = rd | wr | ex; m; m &= m - 1) {
+    ready++;
+  }
+  if (!ready && !(pendingSelect.deadline && (nowNs() >= pendingSelect.deadline))) {
+    return;
+  }
+  put32(params, ready);
+  put32(params, rd);
+  put32(params, wr);
+  put32(params, ex);
+  queueEvent(HCI_CMND_BSD_SELECT, 0, params);
+  pendingSelect.active = 0;
+}
+
+static void serviceSockets(uint8_t force)
+{
+  uint64_t now;
+
+  if (!pendingRecv.active && !pendingSelect.active) {
+    return;
+  }
+  now = nowNs();
+  if (!force && (now - lastSocketPollNs < SOCKET_POLL_NS)) {
+    return;
+  }
+  lastSocketPollNs = now;
+  if (pendingRecv.active) {
+    serviceRecv();
+  }
+  if (pendingSelect.active) {
+    serviceSelect();
+  }
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* PACKETS FROM THE HOST                                                   */
+/*                                                                         */
+/* *********************************************************************** */
+
+static int32_t doSocket(const uint8_t *args)
+{
+  uint32_t domain = get32(args);
+  uint32_t type = get32(args + 4);
+  int sysType;
+  int32_t sd;
+
+  if (domain != CC3K_AF_INET) {
+    return -1;
+  }
+  if (type == CC3K_SOCK_STREAM) {
+    sysType = SOCK_STREAM;
+  } else if (type == CC3K_SOCK_DGRAM) {
+    sysType = SOCK_DGRAM;
+  } else {
+    return -1;
+  }
+  for (sd = 0; sd < MAX_SOCKETS; sd++) {
+    if (sockets[sd].fd < 0) {
+      break;
+    }
+  }
+  if (sd == MAX_SOCKETS) {
+    return -1;
+  }
+  sockets[sd].fd = socket(AF_INET, sysType, 0);
+  if (sockets[sd].fd < 0) {
+    return -1;
+  }
+  if (sysType == SOCK_STREAM) {
+    int one = 1;
+    setsockopt(sockets[sd].fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  sockets[sd].type = type;
+  sockets[sd].recvNonBlocking = 0;
+  sockets[sd].recvTimeoutMs = 0;
+  sockets[sd].closeWaitSent = 0;
+  return sd;
+}
+
+static int32_t doConnect(const uint8_t *args)
+{
+  int32_t sd = get32(args);
+  struct sockaddr_in sin;
+
+  if (!validSd(sd)) {
+    return -1;
+  }
+  toSockaddrIn(args + 12, &sin);
+  if (connect(sockets[sd].fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int32_t doClose(const uint8_t *args)
+{
+  int32_t sd = get32(args);
+
+  if (!validSd(sd)) {
+    return -1;
+  }
+  close(sockets[sd].fd);
+  sockets[sd].fd = -1;
+  return 0;
+}
+
+static int32_t doSetSockOpt(const uint8_t *args)
+{
+  int32_t sd = get32(args);
+  uint32_t optname = get32(args + 8);
+  uint32_t optval = get32(args + 20);
+
+  if (!validSd(sd)) {
+    return -1;
+  }
+  if (optname == CC3K_SOCKOPT_RECV_NONBLOCK) {
+    sockets[sd].recvNonBlocking = (optval == CC3K_SOCK_ON);
+  } else if (optname == CC3K_SOCKOPT_RECV_TIMEOUT) {
+    sockets[sd].recvTimeoutMs = optval;
+  }
+  return 0;
+}
+
+static void doGetHostByName(const uint8_t *args)
+{
+  std::vector<uint8_t> params;
+  uint32_t nameLen = get32(args + 4);
+  char name[256];
+  struct addrinfo hints, *res = NULL;
+  uint32_t ip = 0;
+  int32_t ret = -1;
+
+  if (nameLen >= sizeof(name)) {
+    nameLen = sizeof(name) - 1;
+  }
+  memcpy(name, args + 8, nameLen);
+  name[nameLen] = 0;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  if ((getaddrinfo(name, NULL, &hints, &res) == 0) && res) {
+    ip = ntohl(((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr);
+    ret = 1;
+  }
+  if (res) {
+    freeaddrinfo(res);
+  }
+  put32(params, ret);
+  put32(params, ip);
+  queueEvent(HCI_CMND_GETHOSTNAME, 0, params);
+}
+
+static void ipconfigParams(std::vector<uint8_t> &params, uint8_t full)
+{
+  static const uint8_t mac[6] = { 0x08, 0x00, 0x28, 0xcc, 0x30, 0x00 };
+  static const char ssid[] = "cc3k-emu";
+  uint8_t ssidField[32];
+
+  put32(params, cfg.ip);                     // address
+  put32(params, 0xFF000000);                 // subnet
+  put32(params, cfg.ip);                     // gateway
+  put32(params, cfg.ip);                     // DHCP server
+  put32(params, cfg.ip);                     // DNS server
+  if (full) {
+    params.insert(params.end(), mac, mac + sizeof(mac));
+    memset(ssidField, 0, sizeof(ssidField));
+    memcpy(ssidField, ssid, sizeof(ssid) - 1);
+    params.insert(params.end(), ssidField, ssidField + sizeof(ssidField));
+  }
+}
+
+static void command(uint16_t opcode, const uint8_t *args, uint8_t argLen)
+{
+  std::vector<uint8_t> params;
+
+  st.commands++;
+  countOpcode(opcode);
+
+  switch (opcode) {
+    case HCI_CMND_SIMPLE_LINK_START:
+      queueEvent(opcode, 0, params);
+      break;
+
+    case HCI_CMND_READ_BUFFER_SIZE:
+      credits = cfg.credits;
+      params.push_back(cfg.credits);
+      params.push_back(cfg.bufferLength & 0xFF);
+      params.push_back(cfg.bufferLength >> 8);
+      queueEvent(opcode, 0, params);
+      break;
+
+    case HCI_CMND_EVENT_MASK:
+      eventMask = get32(args);
+      queueEvent32(opcode, 0);
+      break;
+
+    case HCI_CMND_WLAN_CONNECT:
+      queueEvent32(opcode, 0);
+      wlanConnected = 1;
+      queueEvent(HCI_EVNT_WLAN_UNSOL_CONNECT, 0, params);
+      ipconfigParams(params, 0);
+      queueEvent(HCI_EVNT_WLAN_UNSOL_DHCP, 0, params);
+      break;
+
+    case HCI_CMND_WLAN_DISCONNECT:
+      queueEvent32(opcode, 0);
+      if (wlanConnected) {
+        wlanConnected = 0;
+        queueEvent(HCI_EVNT_WLAN_UNSOL_DISCONNECT, 0, params);
+      }
+      break;
+
+    case HCI_CMND_WLAN_IOCTL_STATUSGET:
+      queueEvent32(opcode, wlanConnected ? 3 : 0);
+      break;
+
+    case HCI_NETAPP_IPCONFIG:
+      ipconfigParams(params, 1);
+      queueEvent(opcode, 0, params);
+      break;
+
+    case HCI_CMND_SOCKET:
+      queueEvent32(opcode, doSocket(args));
+      break;
+
+    case HCI_CMND_CONNECT:
+      queueEvent32(opcode, doConnect(args));
+      break;
+
+    case HCI_CMND_CLOSE_SOCKET:
+      queueEvent32(opcode, doClose(args));
+      break;
+
+    case HCI_CMND_SETSOCKOPT:
+      queueEvent32(opcode, doSetSockOpt(args));
+      break;
+
+    case HCI_CMND_GETSOCKOPT:
+      put32(params, 0);
+      queueEvent(opcode, 0, params);
+      break;
+
+    case HCI_CMND_BIND:
+    case HCI_CMND_LISTEN:
+      queueEvent32(opcode, (uint32_t)-1);
+      break;
+
+    case HCI_CMND_ACCEPT:
+      put32(params, get32(args));
+      put32(params, (uint32_t)-1);
+      params.insert(params.end(), 8, 0);
+      queueEvent(opcode, 0, params);
+      break;
+
+    case HCI_CMND_GETHOSTNAME:
+      doGetHostByName(args);
+      break;
+
+    case HCI_CMND_GETMSSVALUE:
+      put32(params, 1460);
+      queueEvent(opcode, 0, params);
+      break;
+
+    case HCI_CMND_RECV:
+    case HCI_CMND_RECVFROM:
+      pendingRecv.active = 1;
+      pendingRecv.opcode = opcode;
+      pendingRecv.sd = get32(args);
+      pendingRecv.len = get32(args + 4);
+      pendingRecv.flags = get32(args + 8);
+      pendingRecv.deadline = 0;
+      if (validSd(pendingRecv.sd) && sockets[pendingRecv.sd].recvTimeoutMs) {
+        pendingRecv.deadline = nowNs() + (uint64_t)sockets[pendingRecv.sd].recvTimeoutMs * 1000000;
+      }
+      serviceSockets(1);
+      break;
+
+    case HCI_CMND_BSD_SELECT:
+      pendingSelect.active = 1;
+      pendingSelect.nfds = get32(args);
+      pendingSelect.rd = get32(args + 24);
+      pendingSelect.wr = get32(args + 28);
+      pendingSelect.ex = get32(args + 32);
+      pendingSelect.deadline = 0;
+      if (!get32(args + 20)) {
+        pendingSelect.deadline = nowNs() + (uint64_t)get32(args + 36) * 1000000000ULL
+                               + (uint64_t)get32(args + 40) * 1000;
+      }
+      serviceSockets(1);
+      break;
+
+    default:
+      // status only events, ioctls answering with a 32 bit status and
+      // HCI_CMND_READ_SP_VERSION all take a zero
+      queueEvent32(opcode, 0);
+      break;
+  }
+}
+
+static void data(uint8_t opcode, const uint8_t *args, uint8_t argLen, const uint8_t *payload, uint16_t payloadLen)
+{
+  std::vector<uint8_t> params;
+  int32_t sd = get32(args);
+  uint32_t len = get32(args + 8);
+  int32_t sent = -1;
+
+  st.dataPackets++;
+  countOpcode(opcode);
+
+  if (credits == 0) {
+    st.creditOverruns++;
+  } else {
+    credits--;
+  }
+
+  if (len > payloadLen) {
+    len = payloadLen;
+  }
+  if (validSd(sd)) {
+    if (opcode == HCI_CMND_SENDTO) {
+      struct sockaddr_in sin;
+      toSockaddrIn(payload + len, &sin);
+      sent = sendto(sockets[sd].fd, payload, len, MSG_NOSIGNAL, (struct sockaddr *)&sin, sizeof(sin));
+    } else {
+      uint32_t off = 0;
+      while (off < len) {
+        ssize_t n = send(sockets[sd].fd, payload + off, len - off, MSG_NOSIGNAL);
+        if (n <= 0) {
+          break;
+        }
+        off += n;
+      }
+      sent = (off == len) ? (int32_t)len : ERROR_SOCKET_INACTIVE;
+    }
+  }
+  if (sent > 0) {
+    st.txBytes += sent;
+  }
+
+  put32(params, sd);
+  put32(params, sent);
+  queueEvent((opcode == HCI_CMND_SENDTO) ? HCI_EVNT_SENDTO : HCI_EVNT_SEND, 0, params);
+
+  // one handle with one buffer released
+  params.clear();
+  params.push_back(1);
+  params.push_back(0);
+  params.push_back(0);
+  params.push_back(0);
+  params.push_back(1);
+  params.push_back(0);
+  queueEvent(HCI_EVNT_DATA_UNSOL_FREE_BUFF, 0, params);
+}
+
+static void written(void)
+{
+  uint16_t len;
+  const uint8_t *hci = mosi + SPI_HEADER_SIZE;
+
+  if (spiCount < SPI_HEADER_SIZE + 1) {
+    return;
+  }
+  len = (mosi[1] << 8) | mosi[2];
+  if ((uint32_t)SPI_HEADER_SIZE + len > spiCount) {
+    return;
+  }
+  if (hci[0] == HCI_TYPE_CMND) {
+    command(hci[1] | (hci[2] << 8), hci + 4, hci[3]);
+  } else if (hci[0] == HCI_TYPE_DATA) {
+    uint8_t argLen = hci[2];
+    uint16_t total = hci[3] | (hci[4] << 8);
+    data(hci[1], hci + 5, argLen, hci + 5 + argLen, total - argLen);
+  }
+}
+
+/* *********************************************************************** */
+/*                                                                         */
+/* PUBLIC FUNCTIONS                                                        */
+/*                                                                         */
+/* *********************************************************************** */
+
+void cc3k_emu_default_config(cc3k_emu_config *config)
+{
+  config->credits = 6;
+  config->bufferLength = 1468;
+  config->latencyUs = 0;
+  config->spiClockHz = 0;
+  config->powerUpUs = 1000;
+  config->ip = 0x7F000001;
+}
+
+void cc3k_emu_init(const cc3k_emu_config *config)
+{
+  cfg = *config;
+  memset(&st, 0, sizeof(st));
+  for (int i = 0; i < MAX_SOCKETS; i++) {
+    sockets[i].fd = -1;
+  }
+}
+
+void cc3k_emu_vbat(uint8_t level)
+{
+  EmuTimer t;
+
+  if (level && !vbat) {
+    vbatOnNs = nowNs();
+  }
+  if (!level) {
+    // power down, sockets and queued packets go with it
+    for (int i = 0; i < MAX_SOCKETS; i++) {
+      if (sockets[i].fd >= 0) {
+        close(sockets[i].fd);
+        sockets[i].fd = -1;
+      }
+    }
+    outbound.clear();
+    pendingRecv.active = 0;
+    pendingSelect.active = 0;
+    started = 0;
+    wlanConnected = 0;
+  }
+  vbat = level;
+}
+
+uint8_t cc3k_emu_irq(void)
+{
+  if (!vbat || (nowNs() - vbatOnNs < (uint64_t)cfg.powerUpUs * 1000)) {
+    return 1;
+  }
+  if (!started || !cs) {
+    return 0;
+  }
+  // the next packet is announced with a fresh falling edge
+  if (nowNs() - csRiseNs < IRQ_GAP_NS) {
+    return 1;
+  }
+  return packetDue() ? 0 : 1;
+}
+
+void cc3k_emu_cs(uint8_t level)
+{
+  EmuTimer t;
+
+  if (level == cs) {
+    return;
+  }
+  cs = level;
+  if (!level) {
+    csFallNs = nowNs();
+    spiCount = 0;
+    misoValid = 0;
+    if (started && packetDue()) {
+      frameForRead();
+    }
+    return;
+  }
+
+  // a transaction ends, it took at least its bit time
+  st.spiTransactions++;
+  st.spiBytes += spiCount;
+  if (cfg.spiClockHz) {
+    uint64_t end = csFallNs + (uint64_t)spiCount * 8 * 1000000000ULL / cfg.spiClockHz;
+    while (nowNs() < end) {
+    }
+  }
+  if (spiOp == SPI_WRITE) {
+    started = 1;
+    written();
+  } else if ((spiOp == SPI_READ) && misoValid) {
+    if (outbound.front().freesCredit) {
+      credits++;
+    }
+    if (outbound.front().hci[0] == HCI_TYPE_EVNT) {
+      st.events++;
+    } else {
+      st.rxDataPackets++;
+    }
+    outbound.pop_front();
+  }
+  csRiseNs = nowNs();
+}
+
+uint8_t cc3k_emu_transfer(uint8_t out)
+{
+  uint8_t in = 0;
+
+  if (cs) {
+    return 0;
+  }
+  if (spiCount == 0) {
+    spiOp = out;
+  }
+  if (spiCount < SPI_FRAME_MAX) {
+    mosi[spiCount] = out;
+  }
+  if (misoValid && (spiCount < miso.size())) {
+    in = miso[spiCount];
+  }
+  spiCount++;
+  return in;
+}
+
+void cc3k_emu_poll(void)
+{
+  EmuTimer t;
+
+  serviceSockets(0);
+}
+
+void cc3k_emu_get_stats(cc3k_emu_stats *stats)
+{
+  *stats = st;
+}
+
+void cc3k_emu_reset_stats(void)
+{
+  memset(&st, 0, sizeof(st));
+}
@@ -0,0 +1,71 @@
+/**************************************************************************/
+/*!
+  @file     cc3k_emu.h
+
+  CC3000 emulator for the Linux host build.  It is an SPI slave speaking
+  the SimpleLink HCI protocol, so the unmodified ccspi.cpp/hci.cpp/
+  evnt_handler.cpp/socket.cpp/wlan.cpp stack talks to it as it would to
+  the chip.  Socket commands are carried out on real BSD sockets, the
+  access point is simulated: wlan_connect() always succeeds and DHCP
+  hands out the configured address.
+
+  The Arduino shim drives it through the pins (cc3k_emu_vbat,
+  cc3k_emu_cs, cc3k_emu_irq) and SPI (cc3k_emu_transfer) and calls
+  cc3k_emu_poll() whenever the driver enters the core.
+*/
+/**************************************************************************/
+
+#ifndef CC3K_EMU_H
+#define CC3K_EMU_H
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint8_t  credits;       // free buffers reported by HCI_CMND_READ_BUFFER_SIZE
+  uint16_t bufferLength;  // and their size
+  uint32_t latencyUs;     // command to event (or send to free buffer) delay
+  uint32_t spiClockHz;    // SPI bit rate, 0 for no limit
+  uint32_t powerUpUs;     // WLAN_EN high to IRQ low
+  uint32_t ip;            // address handed out by DHCP, a.b.c.d as a<<24|b<<16|c<<8|d
+} cc3k_emu_config;
+
+enum
+{
+  CC3K_EMU_MAX_OPCODES = 32
+};
+
+typedef struct
+{
+  uint16_t opcode;
+  uint32_t count;
+} cc3k_emu_opcode_count;
+
+typedef struct
+{
+  uint32_t spiTransactions;
+  uint32_t spiBytes;
+  uint32_t commands;          // HCI commands from the host
+  uint32_t dataPackets;       // HCI data packets from the host (send, sendto)
+  uint32_t events;            // HCI events to the host, including unsolicited
+  uint32_t rxDataPackets;     // HCI data packets to the host (recv, recvfrom)
+  uint32_t creditOverruns;    // data packets sent without a free buffer
+  uint64_t txBytes;           // payload written to the real sockets
+  uint64_t rxBytes;           // and read from them
+  uint64_t emuNs;             // time spent inside the emulator
+  cc3k_emu_opcode_count byOpcode[CC3K_EMU_MAX_OPCODES];
+} cc3k_emu_stats;
+
+void cc3k_emu_default_config(cc3k_emu_config *config);
+void cc3k_emu_init(const cc3k_emu_config *config);
+
+void cc3k_emu_vbat(uint8_t level);
+void cc3k_emu_cs(uint8_t level);
+uint8_t cc3k_emu_irq(void);
+uint8_t cc3k_emu_transfer(uint8_t mosi);
+void cc3k_emu_poll(void);
+
+void cc3k_emu_get_stats(cc3k_emu_stats *stats);
+void cc3k_emu_reset_stats(void);
+
+#endif
@@ -0,0 +1,89 @@
+/**************************************************************************/
+/*!
+  @file     cc3k_host.h
+
+  Forced include for building the Triton_WiFi driver on a Linux host
+  against the CC3000 emulator (cc3k_emu.cpp), see cc3k_bench.cpp for the
+  build line.  Every driver, Arduino shim and library file that talks to
+  the driver is compiled with -include cc3k_host.h; the emulator itself is
+  not, as it needs the real BSD socket API.
+
+  The CC3000 headers declare their own socket(), select(), fd_set,
+  timeval, time_t ... which collide with glibc.  The libc headers are
+  pulled in here first and the driver's names are then renamed to cc3k_*
+  so both sets can live in one process.
+*/
+/**************************************************************************/
+
+#ifndef CC3K_HOST_H
+#define CC3K_HOST_H
+
+#define CC3K_EMULATOR
+
+// utility/socket.h #undefs fd_set, so glibc's is the one renamed
+#define fd_set          host_fd_set
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <malloc.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/select.h>
+
+#ifdef __cplusplus
+#include <new>
+#endif
+
+#undef fd_set
+
+// data_types.h makes these long, which is 64 bits on LP64 hosts
+#define _INT32
+typedef int32_t INT32;
+#define _UINT32
+typedef uint32_t UINT32;
+
+// BSD socket API of utility/socket.h
+#define socket          cc3k_socket
+#define closesocket     cc3k_closesocket
+#define accept          cc3k_accept
+#define bind            cc3k_bind
+#define listen          cc3k_listen
+#define connect         cc3k_connect
+#define select          cc3k_select
+#define setsockopt      cc3k_setsockopt
+#define getsockopt      cc3k_getsockopt
+#define recv            cc3k_recv
+#define recvfrom        cc3k_recvfrom
+#define send            cc3k_send
+#define sendto          cc3k_sendto
+#define gethostbyname   cc3k_gethostbyname
+
+// Types of utility/socket.h and utility/cc3000_common.h
+#define __fd_mask       cc3k_fd_mask
+#define timeval         cc3k_timeval
+#define time_t          cc3k_time_t
+#define clock_t         cc3k_clock_t
+#define suseconds_t     cc3k_suseconds_t
+
+// and the macros utility/socket.h redefines
+#undef __FD_SETSIZE
+#undef __NFDBITS
+#undef __FDELT
+#undef __FDMASK
+#undef __FDS_BITS
+#undef __FD_ZERO
+#undef __FD_SET
+#undef __FD_CLR
+#undef __FD_ISSET
+#undef FD_ZERO
+#undef FD_SET
+#undef FD_CLR
+#undef FD_ISSET
+
+#endif
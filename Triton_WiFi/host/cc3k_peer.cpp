@@ -0,0 +1,489 @@
+/**************************************************************************/
+/*!
+  @file     cc3k_peer.cpp
+
+  TCP server and MQTT-SN gateway for the benchmark, see cc3k_peer.h
+*/
+/**************************************************************************/
+
+#include "cc3k_peer.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static int listenFd = -1;
+static int gatewayFd = -1;
+
+static int readAll(int fd, uint8_t *buf, size_t len)
+{
+  while (len) {
+    ssize_t n = recv(fd, buf, len, 0);
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static int writeAll(int fd, const uint8_t *buf, size_t len)
+{
+  while (len) {
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the rest of an MQTT fixed header after its first byte
+
+    @returns  The remaining length, -1 if the connection closed
+*/
+/**************************************************************************/
+static long mqttLength(int fd, uint8_t *lenBuf, int *lenLen)
+{
+  long length = 0;
+  long multiplier = 1;
+  uint8_t digit;
+
+  *lenLen = 0;
+  do {
+    if ((*lenLen == 4) || (readAll(fd, &digit, 1) < 0)) {
+      return -1;
+    }
+    lenBuf[(*lenLen)++] = digit;
+    length += (digit & 127) * multiplier;
+    multiplier *= 128;
+  } while (digit & 128);
+  return length;
+}
+
+#define MQTT_SESSION_IDS 64
+
+/* The session of the last client to connect: the QoS 2 messages it has
+   sent but not yet released, which a resent PUBLISH must not deliver
+   again.  A CONNECT with clean session set, or another client id, starts
+   a new one. */
+static struct {
+  pthread_mutex_t lock;
+  char clientId[32];
+  uint16_t held[MQTT_SESSION_IDS];
+  uint8_t heldCount;
+  uint32_t delivered;
+  uint32_t dropAfter;
+} session = { PTHREAD_MUTEX_INITIALIZER, "", { 0 }, 0, 0, 0 };
+
+static void sessionConnect(const uint8_t *body, size_t len)
+{
+  // protocol name, level, flags and keepalive come before the client id
+  size_t name = 2 + ((body[0] << 8) | body[1]);
+  size_t idLen;
+  bool clean;
+
+  if (name + 6 > len) {
+    return;
+  }
+  clean = (body[name + 1] & 0x02) != 0;
+  idLen = (body[name + 4] << 8) | body[name + 5];
+  if ((idLen >= sizeof(session.clientId)) || (name + 6 + idLen > len)) {
+    idLen = 0;
+  }
+  pthread_mutex_lock(&session.lock);
+  if (clean || (strlen(session.clientId) != idLen) ||
+      memcmp(session.clientId, body + name + 6, idLen)) {
+    memcpy(session.clientId, body + name + 6, idLen);
+    session.clientId[idLen] = 0;
+    session.heldCount = 0;
+  }
+  pthread_mutex_unlock(&session.lock);
+}
+
+/* A QoS 2 PUBLISH is delivered unless its id is held from before */
+static void sessionPublish(uint16_t msgId)
+{
+  pthread_mutex_lock(&session.lock);
+  uint8_t i = 0;
+  while ((i < session.heldCount) && (session.held[i] != msgId)) {
+    i++;
+  }
+  if ((i == session.heldCount) && (i < MQTT_SESSION_IDS)) {
+    session.held[session.heldCount++] = msgId;
+    session.delivered++;
+  }
+  pthread_mutex_unlock(&session.lock);
+}
+
+static void sessionRelease(uint16_t msgId)
+{
+  pthread_mutex_lock(&session.lock);
+  for (uint8_t i = 0; i < session.heldCount; i++) {
+    if (session.held[i] == msgId) {
+      session.held[i] = session.held[--session.heldCount];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&session.lock);
+}
+
+/* Whether the connection is to be dropped, with the packet taken in but
+   not answered */
+static bool sessionDrop(void)
+{
+  bool drop = false;
+
+  pthread_mutex_lock(&session.lock);
+  if (session.dropAfter) {
+    drop = (--session.dropAfter == 0);
+  }
+  pthread_mutex_unlock(&session.lock);
+  return drop;
+}
+
+static volatile uint32_t echoDelayUs;
+
+void cc3k_peer_echo_delay(uint32_t us)
+{
+  echoDelayUs = us;
+}
+
+uint32_t cc3k_peer_mqtt_delivered(void)
+{
+  pthread_mutex_lock(&session.lock);
+  uint32_t delivered = session.delivered;
+  pthread_mutex_unlock(&session.lock);
+  return delivered;
+}
+
+void cc3k_peer_mqtt_drop(uint32_t packets)
+{
+  pthread_mutex_lock(&session.lock);
+  session.dropAfter = packets;
+  pthread_mutex_unlock(&session.lock);
+}
+
+static void mqttLoopback(int fd, uint8_t *buf, size_t size)
+{
+  static const uint8_t connack[] = { 0x20, 2, 0, 0 };
+  uint8_t header = CC3K_PEER_MQTT;
+  uint8_t lenBuf[4];
+  int lenLen;
+
+  for (;;) {
+    long length = mqttLength(fd, lenBuf, &lenLen);
+    uint8_t type = header & 0xF0;
+    uint8_t qos = (header >> 1) & 3;
+    bool echo = (type == 0x30) && (qos == 0);
+    bool first = true;
+    uint8_t ack[4] = { 0, 2, 0, 0 };
+
+    if (length < 0) {
+      return;
+    }
+    if (echo && ((writeAll(fd, &header, 1) < 0) || (writeAll(fd, lenBuf, lenLen) < 0))) {
+      return;
+    }
+    // the body is forwarded or dropped as it arrives, PUBLISH can be any size
+    while (length) {
+      size_t chunk = ((size_t)length < size) ? (size_t)length : size;
+      if ((readAll(fd, buf, chunk) < 0) || (echo && (writeAll(fd, buf, chunk) < 0))) {
+        return;
+      }
+      if (first && (type == 0x10)) {
+        sessionConnect(buf, chunk);
+      } else if (first && (type == 0x30) && (chunk >= 4)) {
+        // the message id follows the topic
+        size_t id = 2 + ((buf[0] << 8) | buf[1]);
+        if (id + 2 <= chunk) {
+          ack[2] = buf[id];
+          ack[3] = buf[id + 1];
+        }
+      } else if (first && (chunk >= 2)) {
+        ack[2] = buf[0];
+        ack[3] = buf[1];
+      }
+      first = false;
+      length -= chunk;
+    }
+    if ((type == 0x30) && (qos == 2)) {
+      sessionPublish((ack[2] << 8) | ack[3]);
+    } else if (type == 0x60) {
+      sessionRelease((ack[2] << 8) | ack[3]);
+    }
+    if (sessionDrop()) {
+      return;
+    }
+    if ((type == 0x30) && qos) {
+      ack[0] = (qos == 1) ? 0x40 : 0x50;
+      writeAll(fd, ack, sizeof(ack));
+    } else if (type == 0x60) {
+      ack[0] = 0x70;
+      writeAll(fd, ack, sizeof(ack));
+    } else if (type == 0x10) {
+      writeAll(fd, connack, sizeof(connack));
+    } else if (type == 0x80) {
+      uint8_t suback[] = { 0x90, 3, ack[2], ack[3], 0 };
+      writeAll(fd, suback, sizeof(suback));
+    } else if (type == 0xC0) {
+      uint8_t pingresp[] = { 0xD0, 0 };
+      writeAll(fd, pingresp, sizeof(pingresp));
+    } else if (type == 0xE0) {
+      return;
+    }
+    if (readAll(fd, &header, 1) < 0) {
+      return;
+    }
+  }
+}
+
+static void *connection(void *arg)
+{
+  int fd = (int)(intptr_t)arg;
+  uint8_t buf[4096];
+  uint8_t mode;
+  ssize_t n;
+
+  if (readAll(fd, &mode, 1) == 0) {
+    switch (mode) {
+      case CC3K_PEER_SINK:
+        while (recv(fd, buf, sizeof(buf), 0) > 0) {
+        }
+        break;
+
+      case CC3K_PEER_ECHO:
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+          if (echoDelayUs) {
+            usleep(echoDelayUs);
+          }
+          if (writeAll(fd, buf, n) < 0) {
+            break;
+          }
+        }
+        break;
+
+      case CC3K_PEER_SOURCE:
+        if (readAll(fd, buf, 4) == 0) {
+          uint32_t count = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+          memset(buf, 'x', sizeof(buf));
+          while (count) {
+            uint32_t chunk = (count < sizeof(buf)) ? count : sizeof(buf);
+            if (writeAll(fd, buf, chunk) < 0) {
+              break;
+            }
+            count -= chunk;
+          }
+        }
+        break;
+
+      case CC3K_PEER_MQTT:
+        mqttLoopback(fd, buf, sizeof(buf));
+        break;
+    }
+  }
+  close(fd);
+  return NULL;
+}
+
+static void *server(void *arg)
+{
+  for (;;) {
+    int fd = accept(listenFd, NULL, NULL);
+    pthread_t thread;
+    int one = 1;
+
+    if (fd < 0) {
+      continue;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (pthread_create(&thread, NULL, connection, (void *)(intptr_t)fd) != 0) {
+      close(fd);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+  return NULL;
+}
+
+#define SN_TOPICS   16
+#define SN_KEPT     16
+
+/* The gateway's one client: who it is, what it subscribed to and what it
+   missed while asleep */
+static struct {
+  struct sockaddr_in addr;
+  bool asleep;
+  char names[SN_TOPICS][32];
+  uint8_t nameCount;
+  uint16_t subscribed[SN_TOPICS];
+  uint8_t subscribedCount;
+  uint8_t kept[SN_KEPT][256];
+  uint8_t keptCount;
+} sn;
+
+static void snSend(const uint8_t *buf, uint8_t len)
+{
+  sendto(gatewayFd, buf, len, 0, (struct sockaddr *)&sn.addr, sizeof(sn.addr));
+}
+
+/* Topic id of a registered name, registering it if it is new */
+static uint16_t snRegister(const uint8_t *name, size_t len)
+{
+  uint8_t i;
+
+  if (len >= sizeof(sn.names[0])) {
+    len = sizeof(sn.names[0]) - 1;
+  }
+  for (i = 0; i < sn.nameCount; i++) {
+    if ((strlen(sn.names[i]) == len) && (memcmp(sn.names[i], name, len) == 0)) {
+      return i + 1;
+    }
+  }
+  if (sn.nameCount == SN_TOPICS) {
+    return 0;
+  }
+  memcpy(sn.names[sn.nameCount], name, len);
+  sn.names[sn.nameCount][len] = 0;
+  return ++sn.nameCount;
+}
+
+static bool snSubscribed(uint16_t topicId)
+{
+  for (uint8_t i = 0; i < sn.subscribedCount; i++) {
+    if (sn.subscribed[i] == topicId) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Answers one MQTT-SN datagram
+*/
+/**************************************************************************/
+static void snHandle(uint8_t *buf, size_t len, struct sockaddr_in *from)
+{
+  uint8_t type = buf[1];
+
+  if (type == 0x04) {
+    // CONNECT, always clean
+    uint8_t connack[] = { 3, 0x05, 0 };
+    memset(&sn, 0, sizeof(sn));
+    sn.addr = *from;
+    snSend(connack, sizeof(connack));
+  } else if ((type == 0x0A) && (len >= 6)) {
+    // REGISTER
+    uint16_t id = snRegister(buf + 6, len - 6);
+    uint8_t regack[] = { 7, 0x0B, (uint8_t)(id >> 8), (uint8_t)id, buf[4], buf[5], (uint8_t)(id ? 0 : 2) };
+    snSend(regack, sizeof(regack));
+  } else if ((type == 0x12) && (len >= 7)) {
+    // SUBSCRIBE to a name or an id
+    uint16_t id = ((buf[2] & 3) == 0) ? snRegister(buf + 5, len - 5) : (uint16_t)((buf[5] << 8) | buf[6]);
+    uint8_t suback[] = { 8, 0x13, buf[2], 0, 0, buf[3], buf[4], 0 };
+    if ((buf[2] & 3) == 0) {
+      suback[3] = id >> 8;
+      suback[4] = id;
+    }
+    if (!snSubscribed(id) && (sn.subscribedCount < SN_TOPICS)) {
+      sn.subscribed[sn.subscribedCount++] = id;
+    }
+    snSend(suback, sizeof(suback));
+  } else if ((type == 0x0C) && (len >= 7)) {
+    // PUBLISH: acknowledge QoS 1, deliver at QoS 0 to a subscriber
+    uint16_t id = (buf[3] << 8) | buf[4];
+    if ((buf[2] & 0x60) == 0x20) {
+      uint8_t puback[] = { 7, 0x0D, buf[3], buf[4], buf[5], buf[6], 0 };
+      snSend(puback, sizeof(puback));
+    }
+    if (snSubscribed(id)) {
+      buf[2] &= 0x13;
+      buf[5] = 0;
+      buf[6] = 0;
+      if (!sn.asleep) {
+        snSend(buf, len);
+      } else if (sn.keptCount < SN_KEPT) {
+        memcpy(sn.kept[sn.keptCount++], buf, len);
+      }
+    }
+  } else if (type == 0x16) {
+    // PINGREQ, with the client id from a sleeping client checking in
+    uint8_t pingresp[] = { 2, 0x17 };
+    if ((len > 2) && sn.asleep) {
+      for (uint8_t i = 0; i < sn.keptCount; i++) {
+        snSend(sn.kept[i], sn.kept[i][0]);
+      }
+      sn.keptCount = 0;
+    }
+    snSend(pingresp, sizeof(pingresp));
+  } else if (type == 0x18) {
+    // DISCONNECT, with a duration to sleep
+    uint8_t disconnect[] = { 2, 0x18 };
+    sn.asleep = (len >= 4);
+    if (!sn.asleep) {
+      sn.subscribedCount = 0;
+    }
+    snSend(disconnect, sizeof(disconnect));
+  }
+}
+
+static void *gateway(void *arg)
+{
+  uint8_t buf[256];
+
+  for (;;) {
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t n = recvfrom(gatewayFd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromLen);
+
+    // the length byte must match, longer forms are not used
+    if ((n >= 2) && (buf[0] == n)) {
+      snHandle(buf, n, &from);
+    }
+  }
+  return NULL;
+}
+
+uint16_t cc3k_peer_start(void)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof(sin);
+  pthread_t thread;
+
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return 0;
+  }
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((bind(listenFd, (struct sockaddr *)&sin, sizeof(sin)) < 0) ||
+      (listen(listenFd, 8) < 0) ||
+      (getsockname(listenFd, (struct sockaddr *)&sin, &len) < 0) ||
+      (pthread_create(&thread, NULL, server, NULL) != 0)) {
+    close(listenFd);
+    listenFd = -1;
+    return 0;
+  }
+  pthread_detach(thread);
+
+  // the MQTT-SN gateway takes the same port number for UDP
+  gatewayFd = socket(AF_INET, SOCK_DGRAM, 0);
+  if ((gatewayFd < 0) ||
+      (bind(gatewayFd, (struct sockaddr *)&sin, sizeof(sin)) < 0) ||
+      (pthread_create(&thread, NULL, gateway, NULL) != 0)) {
+    return 0;
+  }
+  pthread_detach(thread);
+  return ntohs(sin.sin_port);
+}
@@ -0,0 +1,52 @@
+/**************************************************************************/
+/*!
+  @file     cc3k_peer.h
+
+  TCP server on 127.0.0.1 for cc3k_bench.cpp to talk to through the
+  driver.  Built without cc3k_host.h, like cc3k_emu.cpp.  The first byte
+  a client sends picks what the connection does:
+
+    'S'              read and discard until the client closes
+    'E'              echo everything back, after cc3k_peer_echo_delay()
+    'R' + count      send count bytes (32 bit little endian) and close
+    0x10             an MQTT CONNECT: answer it with a CONNACK, send
+                     every QoS 0 PUBLISH back to the client, PUBACK or
+                     PUBREC the QoS 1 and 2 ones, PUBCOMP, SUBACK and
+                     PINGRESP the rest, until DISCONNECT.  The session
+                     of the last client to connect is kept: a QoS 2
+                     PUBLISH resent before its PUBREL is not delivered
+                     again unless the client reconnected with clean
+                     session set
+
+  The same port on UDP is an MQTT-SN gateway for one client.  It registers
+  topic names, sends every PUBLISH to a subscribed topic back at QoS 0,
+  PUBACKs QoS 1 and, while the client sleeps, keeps those PUBLISHes until
+  a PINGREQ with its client id.
+*/
+/**************************************************************************/
+
+#ifndef CC3K_PEER_H
+#define CC3K_PEER_H
+
+#include <stdint.h>
+
+#define CC3K_PEER_SINK   'S'
+#define CC3K_PEER_ECHO   'E'
+#define CC3K_PEER_SOURCE 'R'
+#define CC3K_PEER_MQTT   0x10
+
+/* Starts the server threads, returns the port or 0 on failure */
+uint16_t cc3k_peer_start(void);
+
+/* Holds what the echo connections read for us microseconds before
+   sending it back, 0 (the default) to echo at once */
+void cc3k_peer_echo_delay(uint32_t us);
+
+/* QoS 2 messages delivered by the MQTT server so far */
+uint32_t cc3k_peer_mqtt_delivered(void);
+
+/* Closes the MQTT connection on the packets-th packet it receives from now
+   on, after taking that packet in but before answering it */
+void cc3k_peer_mqtt_drop(uint32_t packets);
+
+#endif
@@ -75,6 +75,10 @@ extern "C" {
 #define	SP_PORTION_SIZE	(32)
 
 // #define CC3000_TINY_DRIVER
+
+// Uncomment to count in tSLInformation.NumberOfCopiedBytes the data bytes
+// send() and sendto() copy into the transmit buffer, see SendCopyBench
+// #define CC3000_COUNT_COPIES
   
 /*Defines for minimal and maximal RX buffer size. This size includes the spi 
   header and hci header.
@@ -194,6 +198,9 @@ typedef void (*tWlanInterruptDisable)(void);
 
 typedef void (*tWriteWlanPin)(UINT8 val);
 
+// Socket descriptors are 0 to SL_MAX_SOCKETS - 1
+#define SL_MAX_SOCKETS	8
+
 typedef struct
 {
 	UINT16	 usRxEventOpcode;
@@ -215,11 +222,18 @@ typedef struct
 	UINT16	 usSlBufferLength;
 	UINT16	 usBufferSize;
 	UINT16	 usRxDataPending;
+	// Pipelined sends still waiting for their send event, per socket
+	UINT8	 ucSendEventsPending[SL_MAX_SOCKETS];
 
 	UINT32    NumberOfSentPackets;
 	UINT32    NumberOfReleasedPackets;
+#ifdef CC3000_COUNT_COPIES
+	// Data bytes send() and sendto() copied into the transmit buffer
+	UINT32    NumberOfCopiedBytes;
+#endif
 
 	UINT8	 InformHostOnTxComplete;
+	UINT8	 SendPipelined;
 }sSimplLinkInformation;
 
 extern volatile sSimplLinkInformation tSLInformation;
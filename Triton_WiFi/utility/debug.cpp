@@ -20,6 +20,10 @@ int getFreeRam(void) {
   char top;
   return &top - reinterpret_cast<char*>(sbrk(0));
 }
+#elif defined(CC3K_EMULATOR) // host build, nothing to report
+int getFreeRam(void) {
+  return 0;
+}
 #else // AVR 
 int getFreeRam(void)
 {
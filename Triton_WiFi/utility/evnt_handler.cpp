@@ -359,9 +359,10 @@ UINT8 * hci_event_handler(void *pRetParams, UINT8 *from, UINT8 *fromlen)
 						  pRetParams = ((CHAR *)pRetParams) + 4;
 						  STREAM_TO_UINT32((CHAR *)pucReceivedParams,SL_RECEIVE__FLAGS__OFFSET,*(UINT32 *)pRetParams);
 
-						  if(((tBsdReadReturnParams *)pRetParams)->iNumberOfBytes == ERROR_SOCKET_INACTIVE)
+						  // pRetParams has moved on to the flags, the struct starts at RetParams
+						  if(((tBsdReadReturnParams *)RetParams)->iNumberOfBytes == ERROR_SOCKET_INACTIVE)
 						    {
-						      set_socket_active_status(((tBsdReadReturnParams *)pRetParams)->iSocketDescriptor,SOCKET_STATUS_INACTIVE);
+						      set_socket_active_status(((tBsdReadReturnParams *)RetParams)->iSocketDescriptor,SOCKET_STATUS_INACTIVE);
 						    }
 						  break;
 						}
@@ -637,15 +638,41 @@ INT32 hci_unsol_event_handler(CHAR *event_hdr)
 			|| (event_type == HCI_EVNT_WRITE))
 	{
                 CHAR *pArg;
-                INT32 status;
+                INT32 status, sd;
 
 		DEBUGPRINT_F("\tSEND event response\n\r");
 
                 pArg = M_BSD_RESP_PARAMS_OFFSET(event_hdr);
+                STREAM_TO_UINT32(pArg, BSD_RSP_PARAMS_SOCKET_OFFSET,sd);
                 STREAM_TO_UINT32(pArg, BSD_RSP_PARAMS_STATUS_OFFSET,status);
 
+                // Events arrive in order so while the socket has pipelined sends
+                // outstanding this event belongs to one of them and nobody is
+                // waiting for it. A failure is kept and reported by the next send,
+                // the socket's other sends will not be acknowledged so stop
+                // counting them.
+                if ((event_type != HCI_EVNT_WRITE) && M_IS_VALID_SD(sd)
+                        && (tSLInformation.ucSendEventsPending[sd] != 0))
+                {
+                    tSLInformation.ucSendEventsPending[sd]--;
+                    if (status < 0)
+                    {
+                        tSLInformation.ucSendEventsPending[sd] = 0;
+                        tSLInformation.slTransmitDataError = status;
+                        update_socket_active_status(M_BSD_RESP_PARAMS_OFFSET(event_hdr));
+                    }
+                    return (1);
+                }
+
                 if (ERROR_SOCKET_INACTIVE == status)
                 {
+                    // A blocking send is waiting for this event, hand it over
+                    if (event_type == tSLInformation.usRxEventOpcode)
+                    {
+                        update_socket_active_status(M_BSD_RESP_PARAMS_OFFSET(event_hdr));
+                        return (0);
+                    }
+
                     // The only synchronous event that can come from SL device in form of
                     // command complete is "Command Complete" on data sent, in case SL device
                     // was unable to transmit
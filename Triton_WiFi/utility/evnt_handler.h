@@ -104,7 +104,7 @@ extern INT32 hci_unsolicited_event_handler(void);
 /* Init socket_active_status = 'all ones': init all sockets with SOCKET_STATUS_INACTIVE.
    Will be changed by 'set_socket_active_status' upon 'connect' and 'accept' calls */
 #define SOCKET_STATUS_INIT_VAL  0xFFFF
-#define M_IS_VALID_SD(sd) ((0 <= (sd)) && ((sd) <= 7))
+#define M_IS_VALID_SD(sd) ((0 <= (sd)) && ((sd) < SL_MAX_SOCKETS))
 #define M_IS_VALID_STATUS(status) (((status) == SOCKET_STATUS_ACTIVE)||((status) == SOCKET_STATUS_INACTIVE))
 
 extern UINT32 socket_active_status;
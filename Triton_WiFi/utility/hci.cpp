@@ -72,7 +72,10 @@ UINT16 hci_command_send(UINT16 usOpcode, UINT8 *pucBuff, UINT8 ucArgsLength)
 	stream = UINT16_TO_STREAM(stream, usOpcode);
 	UINT8_TO_STREAM(stream, ucArgsLength);
 	
-	//Update the opcode of the event we will be waiting for
+	//Update the opcode of the event we will be waiting for. It must be set
+	//before the write: a reply the IRQ handler reads before the caller gets
+	//to SimpleLinkWaitEvent() would otherwise be dropped as unsolicited
+	tSLInformation.usRxEventOpcode = usOpcode;
 	SpiWrite(pucBuff, ucArgsLength + SIMPLE_LINK_HCI_CMND_HEADER_SIZE);
 	
 	return(0);
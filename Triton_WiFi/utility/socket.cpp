@@ -143,6 +143,13 @@ INT16 HostFlowControlConsumeBuff(INT16 sd)
 		}
 #endif
 
+		// Pipelined sends wait here for credits so don't rely on catching
+		// the edge of the flow control event
+		if (0 == tSLInformation.usNumberOfFreeBuffers)
+		{
+			cc3k_int_poll();
+		}
+
 	} while(0 == tSLInformation.usNumberOfFreeBuffers);
 	
 	tSLInformation.usNumberOfFreeBuffers--;
@@ -262,6 +269,13 @@ INT32 closesocket(INT32 sd)
 	// since 'close' call may result in either OK (and then it closed) or error 
 	// mark this socket as invalid 
 	set_socket_active_status(sd, SOCKET_STATUS_INACTIVE);
+
+	// Events of pipelined sends that are still outstanding will not come now,
+	// or will be skipped as they are no longer counted
+	if (M_IS_VALID_SD(sd))
+	{
+		tSLInformation.ucSendEventsPending[sd] = 0;
+	}
 	
 	return(ret);
 }
@@ -973,6 +987,65 @@ INT16 recvfrom(INT32 sd, void *buf, INT32 len, INT32 flags, sockaddr *from,
 													HCI_CMND_RECVFROM));
 }
 
+//*****************************************************************************
+//
+//!  simple_link_send_packet
+//!
+//!  @param sd       socket handle
+//!  @param opcode   HCI_CMND_SEND or HCI_CMND_SENDTO
+//!  @param ptr      packet, SPI header room followed by the HCI header room,
+//!                  the arguments and the data
+//!  @param uArgSize arguments length
+//!  @param len      data length
+//!  @param to       destination address, NULL for send
+//!  @param tolen    destination address structure size
+//!
+//!  @return         Return the number of bytes transmitted, or the error
+//!                  of a send that was waited for
+//!
+//!  @brief          Write a data packet to the CC3000 and, unless sends are
+//!                  pipelined, wait for its send event
+//
+//*****************************************************************************
+static INT16 simple_link_send_packet(INT32 sd, INT32 opcode, UINT8 *ptr,
+	UINT8 uArgSize, INT32 len, const sockaddr *to, INT32 tolen)
+{
+	tBsdReadReturnParams tSocketSendEvent;
+
+	// A pipelined send's event is reaped by the unsolicited event handler,
+	// count it before sending as it can arrive as soon as the packet is written
+	if (tSLInformation.SendPipelined)
+	{
+		tSLInformation.ucSendEventsPending[sd]++;
+	}
+
+	// Initiate a HCI command
+	hci_data_send(opcode, ptr, uArgSize, len,(UINT8*)to, tolen);
+
+	if (tSLInformation.SendPipelined)
+	{
+		return (len);
+	}
+
+	// Earlier pipelined sends' events arrive first and are reaped on the way.
+	// Those of a socket that was closed or failed are no longer counted, skip
+	// them until our own arrives
+	do
+	{
+		if (opcode == HCI_CMND_SENDTO)
+			SimpleLinkWaitEvent(HCI_EVNT_SENDTO, &tSocketSendEvent);
+		else
+			SimpleLinkWaitEvent(HCI_EVNT_SEND, &tSocketSendEvent);
+	} while (tSocketSendEvent.iSocketDescriptor != sd);
+
+	if (tSocketSendEvent.iNumberOfBytes < 0)
+	{
+		return (tSocketSendEvent.iNumberOfBytes);
+	}
+
+	return	(len);
+}
+
 //*****************************************************************************
 //
 //!  simple_link_send
@@ -1000,7 +1073,6 @@ INT16 simple_link_send(INT32 sd, const void *buf, INT32 len, INT32 flags,
 	UINT8 *ptr, *pDataPtr, *args;
 	UINT32 addr_offset;
 	INT16 res;
-        tBsdReadReturnParams tSocketSendEvent;
 	
 	// Check the bsd_arguments
 	if (0 != (res = HostFlowControlConsumeBuff(sd)))
@@ -1056,6 +1128,9 @@ INT16 simple_link_send(INT32 sd, const void *buf, INT32 len, INT32 flags,
 	
 	// Copy the data received from user into the TX Buffer
 	ARRAY_TO_STREAM(pDataPtr, ((UINT8 *)buf), len);
+#ifdef CC3000_COUNT_COPIES
+	tSLInformation.NumberOfCopiedBytes += len;
+#endif
 	
 	// In case we are using SendTo, copy the to parameters
 	if (opcode == HCI_CMND_SENDTO)
@@ -1063,15 +1138,129 @@ INT16 simple_link_send(INT32 sd, const void *buf, INT32 len, INT32 flags,
 		ARRAY_TO_STREAM(pDataPtr, ((UINT8 *)to), tolen);
 	}
 	
-	// Initiate a HCI command
-	hci_data_send(opcode, ptr, uArgSize, len,(UINT8*)to, tolen);
-        
-         if (opcode == HCI_CMND_SENDTO)
-            SimpleLinkWaitEvent(HCI_EVNT_SENDTO, &tSocketSendEvent);
-         else
-            SimpleLinkWaitEvent(HCI_EVNT_SEND, &tSocketSendEvent);
-	
-	return	(len);
+	return(simple_link_send_packet(sd, opcode, ptr, uArgSize, len, to, tolen));
+}
+
+//*****************************************************************************
+//
+//!  send_in_place
+//!
+//!  @param sd       socket handle
+//!  @param buf      data, preceded by SOCKET_SEND_HEADROOM writable bytes and
+//!                  followed by SOCKET_SEND_TAILROOM readable bytes
+//!  @param len      data length
+//!  @param flags    On this version, this parameter is not supported
+//!
+//!  @return         Return the number of bytes transmitted, or -1 if an error
+//!                  occurred
+//!
+//!  @brief          Same as send() but the SPI and HCI headers are written
+//!                  into the headroom in front of the data and the packet is
+//!                  sent from there, the data is not copied into the HCI
+//!                  transmit buffer. The headroom is overwritten.
+//!
+//!  @sa             send
+//
+//*****************************************************************************
+INT16 send_in_place(INT32 sd, UINT8 *buf, INT32 len, INT32 flags)
+{
+	UINT8 *ptr, *args;
+	INT16 res;
+
+	// Check the bsd_arguments
+	if (0 != (res = HostFlowControlConsumeBuff(sd)))
+	{
+		return res;
+	}
+
+	//Update the number of sent packets
+	tSLInformation.NumberOfSentPackets++;
+
+	ptr = buf - SOCKET_SEND_HEADROOM;
+	args = (ptr + HEADERS_SIZE_DATA);
+
+	args = UINT32_TO_STREAM(args, sd);
+	args = UINT32_TO_STREAM(args, HCI_CMND_SEND_ARG_LENGTH - sizeof(sd));
+	args = UINT32_TO_STREAM(args, len);
+	args = UINT32_TO_STREAM(args, flags);
+
+	return(simple_link_send_packet(sd, HCI_CMND_SEND, ptr,
+		HCI_CMND_SEND_ARG_LENGTH, len, NULL, 0));
+}
+
+//*****************************************************************************
+//
+//!  set_send_pipelined
+//!
+//!  @param enable   non zero to pipeline sends, zero to wait for every send
+//!
+//!  @return         none
+//!
+//!  @brief          In pipelined mode send() and sendto() return as soon as
+//!                  the packet has been written to the CC3000 so back to back
+//!                  sends are only limited by the free buffer credits. The
+//!                  send events are reaped as they arrive and a failed send
+//!                  is reported by the next send() or send_flush().
+//!
+//!  @sa             send_flush
+//
+//*****************************************************************************
+
+void set_send_pipelined(UINT8 enable)
+{
+	tSLInformation.SendPipelined = enable;
+}
+
+//*****************************************************************************
+//
+//!  send_flush
+//!
+//!  @param sd       socket handle
+//!
+//!  @return         0 once every pipelined send has been acknowledged,
+//!                  otherwise the error of a failed send, -1 if the socket
+//!                  is not active or -3 on timeout (SEND_TIMEOUT_MS only)
+//!
+//!  @brief          Wait for the send events of the socket's pipelined sends
+//!
+//!  @sa             set_send_pipelined
+//
+//*****************************************************************************
+
+INT16 send_flush(INT32 sd)
+{
+#ifdef SEND_TIMEOUT_MS
+	unsigned long startTime = millis();
+#endif
+
+	if (!M_IS_VALID_SD(sd))
+		return -1;
+
+	while (0 != tSLInformation.ucSendEventsPending[sd])
+	{
+		if (tSLInformation.slTransmitDataError != 0)
+		{
+			break;
+		}
+		if(SOCKET_STATUS_ACTIVE != get_socket_active_status(sd))
+			return -1;
+
+#ifdef SEND_TIMEOUT_MS
+		if ((millis() - startTime) > SEND_TIMEOUT_MS)
+		{
+			return -3; /* Timeout */
+		}
+#endif
+		cc3k_int_poll();
+	}
+
+	if (tSLInformation.slTransmitDataError != 0)
+	{
+		errno = tSLInformation.slTransmitDataError;
+		tSLInformation.slTransmitDataError = 0;
+		return errno;
+	}
+	return 0;
 }
 
 
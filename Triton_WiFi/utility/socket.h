@@ -96,6 +96,11 @@ extern "C" {
 #define  SOCK_OFF               1			// socket blocking mode is enabled
 
 #define  MAX_PACKET_SIZE        1500
+
+// Room send_in_place() needs in front of the data for the SPI header, the HCI
+// data header and the send arguments, and behind it for the SPI pad byte
+#define  SOCKET_SEND_HEADROOM   26
+#define  SOCKET_SEND_TAILROOM   1
 #define  MAX_LISTEN_QUEUE       4
 
 #define  IOCTL_SOCKET_EVENTMASK
@@ -643,6 +648,64 @@ extern INT16 send(INT32 sd, const void *buf, INT32 len, INT32 flags);
 extern INT16 sendto(INT32 sd, const void *buf, INT32 len, INT32 flags, 
                   const sockaddr *to, socklen_t tolen);
 
+//*****************************************************************************
+//
+//!  set_send_pipelined
+//!
+//!  @param enable   non zero to pipeline sends, zero to wait for every send
+//!
+//!  @return         none
+//!
+//!  @brief          In pipelined mode send() and sendto() return as soon as
+//!                  the packet has been written to the CC3000. A failed send
+//!                  is reported by the next send() or send_flush().
+//!
+//!  @sa             send_flush
+//
+//*****************************************************************************
+
+extern void set_send_pipelined(UINT8 enable);
+
+//*****************************************************************************
+//
+//!  send_flush
+//!
+//!  @param sd       socket handle
+//!
+//!  @return         0 once every pipelined send has been acknowledged,
+//!                  otherwise the error of a failed send
+//!
+//!  @brief          Wait for the send events of all pipelined sends
+//!
+//!  @sa             set_send_pipelined
+//
+//*****************************************************************************
+
+extern INT16 send_flush(INT32 sd);
+
+//*****************************************************************************
+//
+//!  send_in_place
+//!
+//!  @param sd       socket handle
+//!  @param buf      data, preceded by SOCKET_SEND_HEADROOM writable bytes and
+//!                  followed by SOCKET_SEND_TAILROOM readable bytes
+//!  @param len      data length
+//!  @param flags    On this version, this parameter is not supported
+//!
+//!  @return         Return the number of bytes transmitted, or -1 if an
+//!                  error occurred
+//!
+//!  @brief          Same as send() but the packet is sent from the caller's
+//!                  buffer, the headers are written into the headroom and
+//!                  the data is not copied into the HCI transmit buffer
+//!
+//!  @sa             send
+//
+//*****************************************************************************
+
+extern INT16 send_in_place(INT32 sd, UINT8 *buf, INT32 len, INT32 flags);
+
 //*****************************************************************************
 //
 //!  mdnsAdvertiser
@@ -259,12 +259,16 @@ void wlan_start(UINT16 usPatchesAvailableAtHost)
 
 	tSLInformation.NumberOfSentPackets = 0;
 	tSLInformation.NumberOfReleasedPackets = 0;
+#ifdef CC3000_COUNT_COPIES
+	tSLInformation.NumberOfCopiedBytes = 0;
+#endif
 	tSLInformation.usRxEventOpcode = 0;
 	tSLInformation.usNumberOfFreeBuffers = 0;
 	tSLInformation.usSlBufferLength = 0;
 	tSLInformation.usBufferSize = 0;
 	tSLInformation.usRxDataPending = 0;
 	tSLInformation.slTransmitDataError = 0;
+	memset((void *)tSLInformation.ucSendEventsPending, 0, sizeof(tSLInformation.ucSendEventsPending));
 	tSLInformation.usEventOrDataReceived = 0;
 	tSLInformation.pucReceivedData = 0;
 